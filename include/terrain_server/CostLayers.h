@@ -0,0 +1,99 @@
+#ifndef TERRAIN_SERVER__COST_LAYERS__H
+#define TERRAIN_SERVER__COST_LAYERS__H
+
+#include <dwl/utils/EnvironmentRepresentation.h>
+
+#include <map>
+#include <vector>
+
+
+namespace terrain_server
+{
+
+/**
+ * @class CostLayers
+ * @brief Costs of the features (without weight) of the cells of the terrain
+ * map, i.e. one layer per feature. Every cell has a slot in the layers, and
+ * the layers are contiguous arrays, so the total cost of all the cells is
+ * re-summed with new weights in a vectorized pass, without recomputing the
+ * features
+ */
+class CostLayers
+{
+	public:
+		/** @brief Constructor function */
+		CostLayers();
+
+		/** @brief Destructor function */
+		~CostLayers();
+
+		/**
+		 * @brief Removes all the cells and sets the number of layers
+		 * @param unsigned int Number of layers, i.e. features
+		 */
+		void reset(unsigned int num_layers);
+
+		/** @brief Removes all the cells */
+		void clear();
+
+		/**
+		 * @brief Sets the costs of a cell
+		 * @param dwl::Vertex Vertex of the cell
+		 * @param const double* Cost of each layer
+		 */
+		void setCosts(dwl::Vertex vertex, const double* costs);
+
+		/**
+		 * @brief Removes a cell, its slot is reused by the next added cell
+		 * @param dwl::Vertex Vertex of the cell
+		 */
+		void removeCell(dwl::Vertex vertex);
+
+		/**
+		 * @brief Gets the costs of a cell
+		 * @param std::vector<double>& Cost of each layer
+		 * @param dwl::Vertex Vertex of the cell
+		 * @return Returns true if the cell has costs
+		 */
+		bool getCosts(std::vector<double>& costs, dwl::Vertex vertex) const;
+
+		/**
+		 * @brief Computes the weighted sum of the layers of all the slots
+		 * @param const std::vector<double>& Weight of each layer
+		 * @return Returns false if the number of weights doesn't match
+		 */
+		bool computeTotalCosts(const std::vector<double>& weights);
+
+		/** @brief Gets the total cost of a slot (see computeTotalCosts) */
+		double getTotalCost(unsigned int slot) const;
+
+		/** @brief Gets the cost of a layer of a slot */
+		double getCost(unsigned int layer, unsigned int slot) const;
+
+		/** @brief Gets the slots of the cells, ordered by vertex */
+		const std::map<dwl::Vertex, unsigned int>& getSlots() const;
+
+		/** @brief Gets the number of layers */
+		unsigned int getNumLayers() const;
+
+		/** @brief Gets the number of cells */
+		unsigned int size() const;
+
+
+	private:
+		/** @brief Slots of the cells */
+		std::map<dwl::Vertex, unsigned int> slots_;
+
+		/** @brief Slots of the removed cells */
+		std::vector<unsigned int> free_slots_;
+
+		/** @brief Cost of the slots per layer */
+		std::vector<std::vector<double> > layers_;
+
+		/** @brief Total cost of the slots */
+		std::vector<double> total_costs_;
+};
+
+} //@namespace terrain_server
+
+#endif
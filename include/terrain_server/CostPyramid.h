@@ -0,0 +1,179 @@
+#ifndef TERRAIN_SERVER__COST_PYRAMID__H
+#define TERRAIN_SERVER__COST_PYRAMID__H
+
+#include <dwl/environment/SpaceDiscretization.h>
+#include <dwl/utils/EnvironmentRepresentation.h>
+
+#include <unordered_map>
+#include <vector>
+
+
+namespace terrain_server
+{
+
+/**
+ * @class CostPyramid
+ * @brief Quadtree of the minimum and maximum cost and height of the cells of
+ * the terrain map. The level l groups the cells in squares of 2^l x 2^l
+ * keys, and only the nodes with cells are stored. The nodes are updated
+ * incrementally when a cell is set or removed, and the region queries (box
+ * or disc) prune the nodes with the pyramid, i.e. they visit the nodes on
+ * the border of the region instead of all its cells
+ */
+class CostPyramid
+{
+	public:
+		/** @brief Constructor function */
+		CostPyramid();
+
+		/** @brief Destructor function */
+		~CostPyramid();
+
+		/**
+		 * @brief Sets the resolution of the cells, i.e. the conversion between
+		 * the coordinates of the queries and the keys
+		 * @param double Plane resolution of the terrain map
+		 */
+		void setResolution(double resolution);
+
+		/**
+		 * @brief Sets the cost and height of a cell, i.e. its nodes are updated
+		 * @param const dwl::TerrainCell& Terrain cell
+		 */
+		void setCell(const dwl::TerrainCell& cell);
+
+		/**
+		 * @brief Removes a cell
+		 * @param const dwl::Key& Key of the cell
+		 */
+		void removeCell(const dwl::Key& key);
+
+		/**
+		 * @brief Replaces the cells of the pyramid, i.e. it's built level by
+		 * level
+		 * @param const std::vector<dwl::TerrainCell>& Terrain cells
+		 */
+		void build(const std::vector<dwl::TerrainCell>& cells);
+
+		/** @brief Removes all the cells */
+		void clear();
+
+		/**
+		 * @brief Gets the minimum cost of the cells inside a box, and the
+		 * position of the cell
+		 * @param double& Minimum cost
+		 * @param Eigen::Vector2d& Position of the cell with the minimum cost
+		 * @param const Eigen::Vector2d& Minimum corner of the box
+		 * @param const Eigen::Vector2d& Maximum corner of the box
+		 * @return Returns false if there isn't any cell in the box
+		 */
+		bool getMinCost(double& cost,
+						Eigen::Vector2d& position,
+						const Eigen::Vector2d& min,
+						const Eigen::Vector2d& max) const;
+
+		/**
+		 * @brief Gets the minimum cost of the cells inside a disc, and the
+		 * position of the cell
+		 * @param double& Minimum cost
+		 * @param Eigen::Vector2d& Position of the cell with the minimum cost
+		 * @param const Eigen::Vector2d& Centre of the disc
+		 * @param double Radius of the disc
+		 * @return Returns false if there isn't any cell in the disc
+		 */
+		bool getMinCostInDisc(double& cost,
+							  Eigen::Vector2d& position,
+							  const Eigen::Vector2d& centre,
+							  double radius) const;
+
+		/**
+		 * @brief Gets the maximum cost of the cells inside a box
+		 * @param double& Maximum cost
+		 * @param const Eigen::Vector2d& Minimum corner of the box
+		 * @param const Eigen::Vector2d& Maximum corner of the box
+		 * @return Returns false if there isn't any cell in the box
+		 */
+		bool getMaxCost(double& cost,
+						const Eigen::Vector2d& min,
+						const Eigen::Vector2d& max) const;
+
+		/**
+		 * @brief Gets the minimum and maximum height of the cells inside a box
+		 * @param double& Minimum height
+		 * @param double& Maximum height
+		 * @param const Eigen::Vector2d& Minimum corner of the box
+		 * @param const Eigen::Vector2d& Maximum corner of the box
+		 * @return Returns false if there isn't any cell in the box
+		 */
+		bool getHeightRange(double& min_height,
+							double& max_height,
+							const Eigen::Vector2d& min,
+							const Eigen::Vector2d& max) const;
+
+		/** @brief Gets the number of cells */
+		unsigned int size() const;
+
+
+	private:
+		/** @brief Cost and height bounds of the cells of a node */
+		struct Node
+		{
+			double min_cost, max_cost;
+			double min_height, max_height;
+		};
+
+		/** @brief Box or disc of a query in key units */
+		struct Region
+		{
+			bool overlaps(unsigned int level, uint32_t id) const;
+			bool contains(unsigned int level, uint32_t id) const;
+
+			bool is_disc;
+			double min_x, max_x, min_y, max_y;
+			double centre_x, centre_y, radius;
+		};
+
+		typedef std::unordered_map<uint32_t, Node> NodeMap;
+
+		/** @brief Gets the node id of a key in a level */
+		static uint32_t getNodeId(unsigned int key_x, unsigned int key_y,
+								  unsigned int level);
+
+		/** @brief Merges the bounds of a child into its node */
+		static void mergeNode(Node& node, const Node& child);
+
+		/** @brief Updates the nodes of the levels above a cell */
+		void updateParents(const dwl::Key& key);
+
+		/** @brief Gets the region of a box, it's false if the box is
+		 * outside the keys */
+		bool getBoxRegion(Region& region,
+						  const Eigen::Vector2d& min,
+						  const Eigen::Vector2d& max) const;
+
+		/** @brief Searches the cell with the minimum cost below a node */
+		void searchMinCost(double& cost, uint32_t& id, const Region& region,
+						   unsigned int level, uint32_t node_id) const;
+
+		/** @brief Searches the maximum cost below a node */
+		void searchMaxCost(double& cost, const Region& region,
+						   unsigned int level, uint32_t node_id) const;
+
+		/** @brief Searches the height range below a node */
+		void searchHeightRange(double& min_height, double& max_height,
+							   const Region& region,
+							   unsigned int level, uint32_t node_id) const;
+
+		/** @brief Gets the position of a cell */
+		void getPosition(Eigen::Vector2d& position, uint32_t id) const;
+
+		/** @brief Nodes per level, the level 0 are the cells */
+		std::vector<NodeMap> levels_;
+
+		/** @brief Conversion between coordinates and keys */
+		dwl::environment::SpaceDiscretization space_discretization_;
+};
+
+} //@namespace terrain_server
+
+#endif
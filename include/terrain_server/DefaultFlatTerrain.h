@@ -3,6 +3,7 @@
 
 #include <dwl/utils/RigidBodyDynamics.h>
 #include <dwl/utils/Orientation.h>
+#include <terrain_server/SceneGenerator.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <pcl_ros/point_cloud.h>
 #include <pcl/point_types.h>
@@ -13,20 +14,6 @@
 namespace terrain_server
 {
 
-struct Rectangle
-{
-	Rectangle() : center_x(0.), center_y(0.), width(0.), length(0.),
-			yaw(0.), resolution(0.), height(0.) {}
-
-	double center_x;
-	double center_y;
-	double width;
-	double length;
-	double yaw;
-	double resolution;
-	double height;
-};
-
 /**
  * @class DefaultFlatTerrain
  * @brief Class for building default flat terrain around the robot
@@ -40,11 +27,20 @@ class DefaultFlatTerrain
 		/** @brief Destructor function */
 		~DefaultFlatTerrain();
 
-		/** @brief Sets the flat terrain given the desired properties */
+		/** @brief Publishes the (cached) point cloud of the terrain */
 		void setFlatTerrain();
 
 
 	private:
+		/**
+		 * @brief Reads the scene primitives (stairs, gap, stepping stones,
+		 * slope and rough terrain) defined in the primitives list
+		 */
+		void readPrimitives();
+
+		/** @brief Builds the point cloud of the scene */
+		void buildCloud();
+
 		/** @brief ROS node handle */
 		ros::NodeHandle node_;
 
@@ -59,6 +55,12 @@ class DefaultFlatTerrain
 
 		std::vector<Rectangle> rectangles_;
 
+		/** @brief Generator of the scene */
+		SceneGenerator scene_;
+
+		/** @brief Cached point cloud message of the scene */
+		sensor_msgs::PointCloud2 cloud_msg_;
+
 		/** @brief World frame name */
 		std::string world_frame_;
 
@@ -0,0 +1,141 @@
+#ifndef TERRAIN_SERVER__DEPTH_IMAGE_BINNER__H
+#define TERRAIN_SERVER__DEPTH_IMAGE_BINNER__H
+
+#include <terrain_server/HeightBinner.h>
+
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+#include <vector>
+#include <stdint.h>
+
+
+namespace terrain_server
+{
+
+/** @brief Pinhole intrinsics of a depth camera */
+struct CameraIntrinsics
+{
+	CameraIntrinsics() : fx(0.), fy(0.), cx(0.), cy(0.) {}
+
+	double fx;
+	double fy;
+	double cx;
+	double cy;
+};
+
+
+/**
+ * @brief Organised depth image, i.e. it points to the rows of the image
+ * without copying them. The depths are in millimetres (UINT16) or metres
+ * (FLOAT32), and the invalid ones are zero or NaN
+ */
+struct DepthImage
+{
+	enum Encoding {UINT16, FLOAT32};
+
+	DepthImage() : data(NULL), width(0), height(0), step(0), encoding(FLOAT32) {}
+
+	const uint8_t* data;
+	unsigned int width;
+	unsigned int height;
+	unsigned int step;
+	Encoding encoding;
+};
+
+
+/**
+ * @class DepthImageBinner
+ * @brief Bins an organised depth image into a height grid in a single
+ * streaming pass, i.e. the rows are back-projected (a vectorized loop over
+ * precomputed ray directions) and transformed into the world frame without
+ * materialising a point cloud. The height of a cell is the maximum of its
+ * pixels. The normals are estimated from the adjacent pixels (cross product
+ * of the row and column differences), and they are averaged per cell. The
+ * curvature of a cell is the one of the plane fit of its pixels, i.e. the
+ * ratio of the smallest eigenvalue of their covariance, which is accumulated
+ * in the same pass
+ */
+class DepthImageBinner
+{
+	public:
+		/** @brief Constructor function */
+		DepthImageBinner();
+
+		/** @brief Destructor function */
+		~DepthImageBinner();
+
+		/**
+		 * @brief Sets the maximum relative depth jump between adjacent pixels
+		 * of a normal, i.e. the normals aren't estimated across depth edges
+		 * @param double Maximum relative depth jump
+		 */
+		void setMaxDepthJump(double max_jump);
+
+		/**
+		 * @brief Sets the range of the valid depths
+		 * @param double Minimum depth
+		 * @param double Maximum depth
+		 */
+		void setDepthRange(double min_depth, double max_depth);
+
+		/**
+		 * @brief Computes the heights and normals of the grid. The origin,
+		 * resolution and size of the grid have to be defined
+		 * @param HeightGrid& Height grid
+		 * @param const DepthImage& Depth image
+		 * @param const CameraIntrinsics& Intrinsics of the camera
+		 * @param const Eigen::Affine3d& Pose of the camera (optical frame) in
+		 * the world frame
+		 * @param float Minimum height of the points
+		 * @param float Maximum height of the points
+		 */
+		void compute(HeightGrid& grid,
+					 const DepthImage& image,
+					 const CameraIntrinsics& intrinsics,
+					 const Eigen::Affine3d& camera_pose,
+					 float min_z, float max_z);
+
+
+	private:
+		/**
+		 * @brief Back-projects a row of the image into the world frame. The
+		 * invalid pixels are NaN
+		 * @param const DepthImage& Depth image
+		 * @param unsigned int Row
+		 * @param float* Coordinates of the row (x, y and z blocks of width size)
+		 */
+		void backProjectRow(const DepthImage& image, unsigned int row, float* points);
+
+		/** @brief Maximum relative depth jump of a normal */
+		float max_jump_;
+
+		/** @brief Range of the valid depths */
+		float min_depth_, max_depth_;
+
+		/** @brief Ray directions of the columns and rows, i.e. (u - cx) / fx
+		 * and (v - cy) / fy */
+		std::vector<float> ray_x_, ray_y_;
+
+		/** @brief Camera rotation and translation */
+		Eigen::Matrix3f rotation_;
+		Eigen::Vector3f translation_;
+
+		/** @brief Depths and world coordinates of the current and next row */
+		std::vector<float> depths_;
+		std::vector<float> rows_[2];
+
+		/** @brief Sum of the normals of the cells, and their number */
+		std::vector<Eigen::Vector3f> normal_sums_;
+		std::vector<uint32_t> normal_counts_;
+
+		/** @brief Sum of the points of the cells and of their outer products,
+		 * and their number, i.e. the moments of the plane fit */
+		std::vector<Eigen::Vector3d> point_sums_;
+		std::vector<Eigen::Matrix3d> moment_sums_;
+		std::vector<uint32_t> point_counts_;
+};
+
+} //@namespace terrain_server
+
+#endif
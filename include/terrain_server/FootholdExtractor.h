@@ -0,0 +1,139 @@
+#ifndef TERRAIN_SERVER__FOOTHOLD_EXTRACTOR__H
+#define TERRAIN_SERVER__FOOTHOLD_EXTRACTOR__H
+
+#include <dwl/environment/SpaceDiscretization.h>
+#include <dwl/utils/EnvironmentRepresentation.h>
+
+#include <vector>
+
+
+namespace terrain_server
+{
+
+/** @brief Region of the foothold candidates w.r.t. the robot (without the
+ * yaw rotation), as the search areas */
+struct FootholdRegion
+{
+	double min_x, max_x;
+	double min_y, max_y;
+};
+
+/** @brief Foothold candidate, i.e. a cell of the terrain map */
+struct Foothold
+{
+	Eigen::Vector3d position;
+	Eigen::Vector3d normal;
+	double cost;
+	unsigned int region;
+};
+
+/**
+ * @class FootholdExtractor
+ * @brief Extracts a sparse set of ranked foothold candidates from the terrain
+ * map. A cell is acceptable if its cost is below a threshold and its normal
+ * is flat enough, and it's a candidate if all the cells within the clearance
+ * (a square window) are acceptable too, i.e. it's away from edges and holes.
+ * The candidates of a region are ranked by cost, and the non-maximum
+ * suppression picks the best ones, suppressing the candidates within the
+ * suppression radius of them. Everything runs on a grid of the region
+ * filled once per frame
+ */
+class FootholdExtractor
+{
+	public:
+		/** @brief Constructor function */
+		FootholdExtractor();
+
+		/** @brief Destructor function */
+		~FootholdExtractor();
+
+		/**
+		 * @brief Adds a region of the candidates
+		 * @param double Minimum Cartesian position in x-coordinate
+		 * @param double Maximum Cartesian position in x-coordinate
+		 * @param double Minimum Cartesian position in y-coordinate
+		 * @param double Maximum Cartesian position in y-coordinate
+		 */
+		void addRegion(double min_x, double max_x,
+					   double min_y, double max_y);
+
+		/** @brief Removes all the regions */
+		void clearRegions();
+
+		/**
+		 * @brief Sets the thresholds of the acceptable cells
+		 * @param double Maximum cost
+		 * @param double Minimum z-component of the normal
+		 * @param double Clearance from the non-acceptable (or unknown) cells
+		 */
+		void setThresholds(double max_cost,
+						   double min_normal_z,
+						   double clearance);
+
+		/**
+		 * @brief Sets the non-maximum suppression
+		 * @param double Suppression radius around a picked candidate
+		 * @param unsigned int Maximum number of candidates per region
+		 */
+		void setSuppression(double radius,
+							unsigned int max_candidates);
+
+		/**
+		 * @brief Computes the candidates of the regions, ranked by cost
+		 * within each region
+		 * @param std::vector<Foothold>& Foothold candidates
+		 * @param const dwl::TerrainDataMap& Cells of the terrain map
+		 * @param const dwl::environment::SpaceDiscretization& Discretization
+		 * of the terrain map
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 */
+		void compute(std::vector<Foothold>& candidates,
+					 const dwl::TerrainDataMap& terrain_map,
+					 const dwl::environment::SpaceDiscretization& discretization,
+					 const Eigen::Vector4d& robot_state);
+
+		/** @brief Gets the number of regions */
+		unsigned int getNumRegions() const;
+
+
+	private:
+		/**
+		 * @brief Computes the candidates of a region
+		 * @param std::vector<Foothold>& Foothold candidates
+		 * @param const dwl::TerrainDataMap& Cells of the terrain map
+		 * @param const dwl::environment::SpaceDiscretization& Discretization
+		 * of the terrain map
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 * @param unsigned int Index of the region
+		 */
+		void computeRegion(std::vector<Foothold>& candidates,
+						   const dwl::TerrainDataMap& terrain_map,
+						   const dwl::environment::SpaceDiscretization& discretization,
+						   const Eigen::Vector4d& robot_state,
+						   unsigned int region);
+
+		/** @brief Regions of the candidates */
+		std::vector<FootholdRegion> regions_;
+
+		/** @brief Thresholds of the acceptable cells */
+		double max_cost_, min_normal_z_, clearance_;
+
+		/** @brief Suppression radius and maximum number of candidates per
+		 * region */
+		double suppression_radius_;
+		unsigned int max_candidates_;
+
+		/** @brief Grid of the region, i.e. cells of the map, and counts of the
+		 * non-acceptable cells (summed-area table) */
+		std::vector<const dwl::TerrainCell*> cells_;
+		std::vector<unsigned int> edge_counts_;
+
+		/** @brief Candidates of the region ranked by cost, and the suppressed
+		 * cells */
+		std::vector<std::pair<double, unsigned int> > ranking_;
+		std::vector<bool> is_suppressed_;
+};
+
+} //@namespace terrain_server
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef TERRAIN_SERVER__HEIGHT_BINNER__H
+#define TERRAIN_SERVER__HEIGHT_BINNER__H
+
+#include <Eigen/Dense>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+
+namespace terrain_server
+{
+
+/**
+ * @brief Grid of heights, i.e. a 2.5D heightmap. The cell (i,j) covers
+ * [origin_x + i * resolution, origin_x + (i + 1) * resolution) along the
+ * x-axis (and the same along the y-axis), and its height is
+ * heights[j * width + i]. The empty cells are NaN. The normals and
+ * curvatures of the cells are optional (empty if they aren't estimated by
+ * the binning), and they are NaN in the cells without estimation
+ */
+struct HeightGrid
+{
+	HeightGrid() : origin_x(0.), origin_y(0.), resolution(0.), width(0), height(0) {}
+
+	double origin_x;
+	double origin_y;
+	double resolution;
+	unsigned int width;
+	unsigned int height;
+	std::vector<float> heights;
+	std::vector<Eigen::Vector3f> normals;
+	std::vector<float> curvatures;
+};
+
+
+/**
+ * @class HeightBinner
+ * @brief Bins a set of points (world frame) into a height grid. The height
+ * of a cell is the maximum or a percentile of the heights of its points.
+ * The cells of the points are computed in a branchless loop that is
+ * vectorized, and the points are split in chunks that are binned in
+ * parallel. The maximum is reduced from per-thread grids, and the percentile
+ * uses a counting sort of the points by cell, followed by a selection per cell.
+ * The chunks are run by a pool of workers, which is started by the first
+ * binning that needs more than one thread
+ */
+class HeightBinner
+{
+	public:
+		/** @brief Constructor function */
+		HeightBinner();
+
+		/** @brief Destructor function */
+		~HeightBinner();
+
+		/**
+		 * @brief Sets the height of the cells as a percentile of the heights
+		 * of their points, otherwise it's the maximum
+		 * @param bool Indicates if it's used the percentile
+		 * @param double Percentile in [0,1]
+		 */
+		void setPercentile(bool is_percentile, double percentile);
+
+		/**
+		 * @brief Sets the number of threads, i.e. the pool is stopped if it
+		 * has more workers than needed
+		 * @param unsigned int Number of threads (zero uses the hardware concurrency)
+		 */
+		void setNumThreads(unsigned int num_threads);
+
+		/**
+		 * @brief Computes the heights of the grid. The origin, resolution and
+		 * size of the grid have to be defined
+		 * @param HeightGrid& Height grid
+		 * @param const std::vector<Eigen::Vector3f>& Points in the world frame
+		 * (they have to be finite)
+		 * @param float Minimum height of the points
+		 * @param float Maximum height of the points
+		 */
+		void compute(HeightGrid& grid,
+					 const std::vector<Eigen::Vector3f>& points,
+					 float min_z, float max_z);
+
+
+	private:
+		/**
+		 * @brief Runs a function over a range split in chunks, one per thread.
+		 * The calling thread computes the first chunk, and the workers the
+		 * other ones
+		 * @param unsigned int Size of the range
+		 * @param unsigned int Number of threads
+		 * @param function Function of the thread, begin and end of a chunk
+		 */
+		void parallelFor(unsigned int size, unsigned int num_threads,
+						 const std::function<void(unsigned int, unsigned int,
+												  unsigned int)>& function);
+
+		/**
+		 * @brief Starts the missing workers of the threads, except the
+		 * calling one
+		 * @param unsigned int Number of threads
+		 */
+		void startWorkers(unsigned int num_threads);
+
+		/** @brief Stops and joins the workers */
+		void stopWorkers();
+
+		/**
+		 * @brief Loop of a worker, it runs its chunk of every task
+		 * @param unsigned int Thread of the worker
+		 * @param uint64_t Sequence number of the last task before the worker
+		 */
+		void runWorker(unsigned int thread, uint64_t sequence);
+
+		/** @brief Indicates if it's used the percentile */
+		bool is_percentile_;
+
+		/** @brief Percentile of the height */
+		double percentile_;
+
+		/** @brief Number of threads */
+		unsigned int num_threads_;
+
+		/** @brief Workers of the pool, the worker i runs the chunk i + 1 */
+		std::vector<std::thread> workers_;
+		std::mutex mutex_;
+		std::condition_variable task_condition_;
+		std::condition_variable done_condition_;
+
+		/** @brief Function, range, chunk size and number of threads of the
+		 * current task */
+		const std::function<void(unsigned int, unsigned int, unsigned int)>* task_;
+		unsigned int task_size_, task_chunk_, task_threads_;
+
+		/** @brief Sequence number of the tasks, and number of workers that
+		 * didn't finish the current one */
+		uint64_t task_sequence_;
+		unsigned int num_pending_;
+
+		/** @brief Indicates if the workers have to stop */
+		bool stop_;
+
+		/** @brief Cell of every point (-1 if it's outside the grid) */
+		std::vector<int32_t> cell_ids_;
+
+		/** @brief Maximum heights or point counts of the cells per thread */
+		std::vector<std::vector<float> > thread_heights_;
+		std::vector<std::vector<uint32_t> > thread_counts_;
+
+		/** @brief Heights of the points sorted by cell, and offsets of the cells */
+		std::vector<float> sorted_heights_;
+		std::vector<uint32_t> cell_offsets_;
+};
+
+} //@namespace terrain_server
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef TERRAIN_SERVER__INPUT_SOURCE__H
+#define TERRAIN_SERVER__INPUT_SOURCE__H
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+
+#include <terrain_server/TerrainMappingConfig.h>
+#include <terrain_server/HeightBinner.h>
+#include <terrain_server/DepthImageBinner.h>
+#include <terrain_server/UpdateScheduler.h>
+
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <tf/transform_listener.h>
+#include <tf/message_filter.h>
+#include <message_filters/subscriber.h>
+
+#include <boost/function.hpp>
+#include <string>
+#include <vector>
+
+
+namespace terrain_server
+{
+
+/**
+ * @class InputSource
+ * @brief Sensor input of the terrain map server, i.e. a point cloud (binned
+ * or integrated in the octree) or a depth image. Every source has its own
+ * callback queue, TF filter and ingestion thread, so the conversion,
+ * transformation and binning of the sources run in parallel. The result
+ * of a frame (a height grid or the points in the world frame) is given to
+ * the merge handler of the server
+ */
+class InputSource
+{
+	public:
+		/** @brief Types of source */
+		enum Type {POINTCLOUD, OCTREE, DEPTH};
+
+		/** @brief Handler that merges a frame of a source in the map */
+		typedef boost::function<void(InputSource&)> MergeHandler;
+
+		/**
+		 * @brief Handler that sets the bounds of the height grid of a frame
+		 * given the robot state (x, y, z, yaw)
+		 */
+		typedef boost::function<void(HeightGrid&, double&, double&,
+									 const Eigen::Vector4d&)> BoundsHandler;
+
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+		/** @brief Constructor function */
+		InputSource();
+
+		/** @brief Destructor function */
+		~InputSource();
+
+		/**
+		 * @brief Subscribes to the topics of the source and starts its thread
+		 * @param ros::NodeHandle Node handle of the topics
+		 * @param const std::string& Name of the source
+		 * @param Type Type of the source
+		 * @param const std::string& Topic of the point clouds or depth images
+		 * @param const std::string& Topic of the camera info (depth images)
+		 * @param tf::TransformListener& TF listener
+		 * @param const std::string& World frame
+		 * @param const std::string& Base frame
+		 * @param const TerrainMappingConfig& Configuration of the binning
+		 * @param BoundsHandler Handler of the bounds of the height grid
+		 * @param MergeHandler Handler of the frames
+		 */
+		void init(ros::NodeHandle node,
+				  const std::string& name,
+				  Type type,
+				  const std::string& topic,
+				  const std::string& camera_info_topic,
+				  tf::TransformListener& tf_listener,
+				  const std::string& world_frame,
+				  const std::string& base_frame,
+				  const TerrainMappingConfig& config,
+				  BoundsHandler bounds_handler,
+				  MergeHandler merge_handler);
+
+		/** @brief Gets the name of the source */
+		const std::string& getName() const;
+
+		/** @brief Gets the type of the source */
+		Type getType() const;
+
+		/** @brief Gets the height grid of the last frame */
+		const HeightGrid& getGrid() const;
+
+		/** @brief Gets the points (world frame) of the last frame */
+		const std::vector<Eigen::Vector3f>& getPoints() const;
+
+		/** @brief Gets the sensor origin (world frame) of the last frame */
+		const Eigen::Vector3d& getSensorOrigin() const;
+
+		/** @brief Gets the robot state (x, y, z, yaw) of the last frame */
+		const Eigen::Vector4d& getRobotState() const;
+
+		/** @brief Gets the robot pose of the last frame */
+		const Eigen::Vector3d& getRobotPosition() const;
+		const Eigen::Quaterniond& getRobotOrientation() const;
+
+		/** @brief Gets the arrival time (monotonic) of the last frame */
+		double getFrameTime() const;
+
+		/** @brief Gets the durations of the TF lookup and conversion of the
+		 * last frame, i.e. before the merge */
+		double getTfDuration() const;
+		double getConversionDuration() const;
+
+		/** @brief Indicates if the last frame had a TF error */
+		bool isTfFailure() const;
+
+		/** @brief Indicates if the last frame was skipped by the scheduler,
+		 * i.e. the robot didn't move and the input didn't change */
+		bool isSkipped() const;
+
+		/** @brief Forces the update of the next frame of the source */
+		void resetScheduler();
+
+
+	private:
+		/** @brief Callback function of the point clouds */
+		void pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& msg);
+
+		/** @brief Callback function of the depth images */
+		void depthImageCallback(const sensor_msgs::Image::ConstPtr& msg);
+
+		/** @brief Callback function of the camera info */
+		void cameraInfoCallback(const sensor_msgs::CameraInfo::ConstPtr& msg);
+
+		/**
+		 * @brief Looks up the sensor and robot poses of a frame
+		 * @param const std_msgs::Header& Header of the frame
+		 * @param Eigen::Affine3d& Pose of the sensor in the world frame
+		 * @return Returns false if there isn't the transformation
+		 */
+		bool lookupPoses(const std_msgs::Header& header,
+						 Eigen::Affine3d& sensor_pose);
+
+		/**
+		 * @brief Gets the signature of a point cloud, i.e. the mean range
+		 * (sensor frame) of a strided subset of its points
+		 * @param const sensor_msgs::PointCloud2& Point cloud
+		 */
+		double getSignature(const sensor_msgs::PointCloud2& cloud) const;
+
+		/**
+		 * @brief Gets the signature of a depth image, i.e. the mean depth of
+		 * a strided subset of its valid pixels
+		 * @param const DepthImage& Depth image
+		 */
+		double getSignature(const DepthImage& image) const;
+
+		/** @brief Name and type of the source */
+		std::string name_;
+		Type type_;
+
+		/** @brief Node handle with the callback queue of the source */
+		ros::NodeHandle node_;
+		ros::CallbackQueue queue_;
+		ros::AsyncSpinner* spinner_;
+
+		/** @brief Subscribers and TF filters */
+		message_filters::Subscriber<sensor_msgs::PointCloud2>* cloud_sub_;
+		tf::MessageFilter<sensor_msgs::PointCloud2>* tf_cloud_sub_;
+		message_filters::Subscriber<sensor_msgs::Image>* depth_sub_;
+		tf::MessageFilter<sensor_msgs::Image>* tf_depth_sub_;
+		ros::Subscriber camera_info_sub_;
+
+		/** @brief TF listener, and world and base frames */
+		tf::TransformListener* tf_listener_;
+		std::string world_frame_, base_frame_;
+
+		/** @brief Handlers of the bounds and the frames */
+		BoundsHandler bounds_handler_;
+		MergeHandler merge_handler_;
+
+		/** @brief Binners of the point clouds and depth images */
+		HeightBinner height_binner_;
+		DepthImageBinner depth_binner_;
+
+		/** @brief Intrinsics of the depth camera */
+		CameraIntrinsics intrinsics_;
+		bool is_camera_info_;
+
+		/** @brief Height grid and points of the last frame */
+		HeightGrid grid_;
+		std::vector<Eigen::Vector3f> points_;
+
+		/** @brief Sensor origin and robot pose of the last frame */
+		Eigen::Vector3d sensor_origin_;
+		Eigen::Vector4d robot_state_;
+		Eigen::Vector3d robot_position_;
+		Eigen::Quaterniond robot_orientation_;
+
+		/** @brief Scheduler of the frames of the source */
+		UpdateScheduler scheduler_;
+
+		/** @brief Timing of the last frame */
+		double frame_time_, tf_duration_, conversion_duration_;
+		bool is_tf_failure_;
+		bool is_skipped_;
+};
+
+} //@namespace terrain_server
+
+#endif
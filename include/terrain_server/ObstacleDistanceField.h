@@ -0,0 +1,154 @@
+#ifndef TERRAIN_SERVER__OBSTACLE_DISTANCE_FIELD__H
+#define TERRAIN_SERVER__OBSTACLE_DISTANCE_FIELD__H
+
+#include <dwl/utils/EnvironmentRepresentation.h>
+
+#include <map>
+#include <queue>
+#include <vector>
+
+
+namespace terrain_server
+{
+
+/**
+ * @class ObstacleDistanceField
+ * @brief Class for computing the 2D Euclidean distance to the nearest
+ * obstacle inside a fixed-size window of cells. The distances are updated
+ * incrementally when obstacles are added or removed (dynamic brushfire),
+ * i.e. only the cells affected by the changes are recomputed. The cells are
+ * described by the plane keys of the obstacle map
+ */
+class ObstacleDistanceField
+{
+	public:
+		/** @brief Constructor function */
+		ObstacleDistanceField();
+
+		/** @brief Destructor function */
+		~ObstacleDistanceField();
+
+		/**
+		 * @brief Sets the size of the window, and clears the distance field
+		 * @param unsigned int Number of cells along the x-axis
+		 * @param unsigned int Number of cells along the y-axis
+		 * @param unsigned int Maximum propagated distance (in cells)
+		 */
+		void setSize(unsigned int width,
+					 unsigned int height,
+					 unsigned int max_distance);
+
+		/**
+		 * @brief Moves the window to a new origin. If the origin changes,
+		 * the distance field is cleared
+		 * @param int Key of the origin along the x-axis
+		 * @param int Key of the origin along the y-axis
+		 * @return True if the origin changed
+		 */
+		bool setOrigin(int origin_x, int origin_y);
+
+		/**
+		 * @brief Sets the obstacles of the window given the obstacle map. It
+		 * adds the new obstacles, removes the old ones, and updates the
+		 * distance field
+		 * @param const std::map<dwl::Vertex, dwl::Cell>& Obstacle map
+		 */
+		void setObstacleMap(const std::map<dwl::Vertex, dwl::Cell>& obstacle_map);
+
+		/** @brief Adds an obstacle in a cell (it requires to call update) */
+		void setObstacle(int key_x, int key_y);
+
+		/** @brief Removes an obstacle of a cell (it requires to call update) */
+		void removeObstacle(int key_x, int key_y);
+
+		/** @brief Propagates the changes of obstacles */
+		void update();
+
+		/** @brief Clears the distance field */
+		void clear();
+
+		/**
+		 * @brief Gets the distance to the nearest obstacle (in cells). It
+		 * returns the maximum distance if the cell is outside the window or
+		 * if there isn't an obstacle closer than the maximum distance
+		 * @param int Key of the cell along the x-axis
+		 * @param int Key of the cell along the y-axis
+		 */
+		double getDistance(int key_x, int key_y) const;
+
+		/** @brief Indicates if a cell is inside the window */
+		bool isInside(int key_x, int key_y) const;
+
+		/** @brief Gets the origin of the window */
+		int getOriginX() const;
+		int getOriginY() const;
+
+		/** @brief Gets the size of the window */
+		unsigned int getWidth() const;
+		unsigned int getHeight() const;
+
+		/** @brief Gets the maximum propagated distance (in cells) */
+		unsigned int getMaxDistance() const;
+
+
+	private:
+		/** @brief Queueing state of a cell */
+		enum QueueState {NotQueued, Queued, Processed};
+
+		/** @brief Element of the open queue, i.e. squared distance and index */
+		typedef std::pair<int, unsigned int> QueueElement;
+
+		/** @brief Pushes a cell to the open queue */
+		void push(int sq_distance, unsigned int idx);
+
+		/** @brief Lowers the distance of the neighbors of a cell */
+		void lower(unsigned int idx);
+
+		/** @brief Raises (invalidates) the neighbors of a removed obstacle */
+		void raise(unsigned int idx);
+
+		/** @brief Computes the squared distance between two cells */
+		int getSquaredDistance(unsigned int idx1, unsigned int idx2) const;
+
+		/** @brief Squared distances to the nearest obstacle */
+		std::vector<int> sq_distance_;
+
+		/** @brief Index of the nearest obstacle (-1 for none) */
+		std::vector<int> obstacle_;
+
+		/** @brief Occupancy of the cells */
+		std::vector<unsigned char> occupied_;
+
+		/** @brief Indicates if a cell has to be raised */
+		std::vector<unsigned char> to_raise_;
+
+		/** @brief Queueing state of the cells */
+		std::vector<unsigned char> state_;
+
+		/** @brief Frame in which a cell was seen as obstacle */
+		std::vector<unsigned int> seen_;
+
+		/** @brief Indexes of the occupied cells */
+		std::vector<unsigned int> obstacles_;
+
+		/** @brief Open queue of the brushfire */
+		std::priority_queue<QueueElement, std::vector<QueueElement>,
+							std::greater<QueueElement> > open_;
+
+		/** @brief Origin of the window */
+		int origin_x_, origin_y_;
+
+		/** @brief Size of the window */
+		unsigned int width_, height_;
+
+		/** @brief Maximum propagated distance and its squared value */
+		unsigned int max_distance_;
+		int max_sq_distance_;
+
+		/** @brief Counter of the setObstacleMap calls */
+		unsigned int frame_;
+};
+
+} //@namespace terrain_server
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef TERRAIN_SERVER__OBSTACLE_MAP_PUBLISHER__H
+#define TERRAIN_SERVER__OBSTACLE_MAP_PUBLISHER__H
+
+#include <ros/ros.h>
+#include <dwl/utils/EnvironmentRepresentation.h>
+#include <terrain_server/ObstacleMap.h>
+#include <terrain_server/ObstacleMapDelta.h>
+
+#include <map>
+
+
+namespace terrain_server
+{
+
+/**
+ * @class ObstacleMapPublisher
+ * @brief Class for publishing the obstacle map and its changes. The map
+ * message is built in place from a reused buffer, and it's published only
+ * if the obstacle map changed since the last publication (and there is a
+ * subscriber). Optionally, it's
+ * published the added and removed cells with a sequence number. The messages
+ * can be built (update) and sent (publish) separately, i.e. the obstacle map
+ * is only needed for building them
+ */
+class ObstacleMapPublisher
+{
+	public:
+		/** @brief Constructor function */
+		ObstacleMapPublisher();
+
+		/** @brief Destructor function */
+		~ObstacleMapPublisher();
+
+		/**
+		 * @brief Declares the obstacle_map and obstacle_map_delta publishers
+		 * @param ros::NodeHandle ROS node handle used by the publishers
+		 * @param const std::string& Frame of the obstacle map
+		 * @param bool Indicates if it's published the delta stream
+		 */
+		void init(ros::NodeHandle node,
+				  const std::string& frame_id,
+				  bool publish_delta);
+
+		/**
+		 * @brief Publishes the obstacle map if it changed
+		 * @param const std::map<dwl::Vertex, dwl::Cell>& Obstacle map
+		 * @param double Resolution of the plane
+		 * @param double Resolution of the height
+		 */
+		void publish(const std::map<dwl::Vertex, dwl::Cell>& obstacle_map,
+					 double plane_size,
+					 double height_size);
+
+		/**
+		 * @brief Builds the messages of the obstacle map and its changes, they
+		 * are sent by publish()
+		 * @param const std::map<dwl::Vertex, dwl::Cell>& Obstacle map
+		 * @param double Resolution of the plane
+		 * @param double Resolution of the height
+		 */
+		void update(const std::map<dwl::Vertex, dwl::Cell>& obstacle_map,
+					double plane_size,
+					double height_size);
+
+		/** @brief Sends the messages built by the last update */
+		void publish();
+
+		/** @brief Resets the published state, i.e. the pending messages are
+		 * dropped and the next delta is a full map */
+		void reset();
+
+
+	private:
+		/** @brief Converts an obstacle cell to a cell message */
+		static void toCellMsg(terrain_server::Cell& cell_msg,
+							  const dwl::Cell& cell);
+
+		/**
+		 * @brief Computes the added and removed cells w.r.t. the last
+		 * published obstacle map
+		 * @param const std::map<dwl::Vertex, dwl::Cell>& Obstacle map
+		 * @return True if the obstacle map changed
+		 */
+		bool computeDelta(const std::map<dwl::Vertex, dwl::Cell>& obstacle_map);
+
+		/** @brief Obstacle map publisher */
+		ros::Publisher map_pub_;
+
+		/** @brief Obstacle map delta publisher */
+		ros::Publisher delta_pub_;
+
+		/** @brief Obstacle map message (reused buffer) */
+		terrain_server::ObstacleMap map_msg_;
+
+		/** @brief Obstacle map delta message (reused buffer) */
+		terrain_server::ObstacleMapDelta delta_msg_;
+
+		/** @brief Cells of the last published obstacle map, they are updated
+		 * with the changes of every publication */
+		std::map<dwl::Vertex, dwl::Cell> last_cells_;
+
+		/** @brief Sequence number of the delta stream */
+		unsigned int sequence_;
+
+		/** @brief Indicates if it's published the delta stream */
+		bool publish_delta_;
+
+		/** @brief Indicates if the next delta is a full map */
+		bool full_delta_;
+
+		/** @brief Indicates if the last changes weren't published in the map */
+		bool is_map_pending_;
+
+		/** @brief Indicates if the delta and map messages are built but not sent */
+		bool is_delta_ready_, is_map_ready_;
+};
+
+} //@namespace terrain_server
+
+#endif
@@ -8,12 +8,23 @@
 #include <octomap/math/Utils.h>
 
 #include <dwl/environment/ObstacleMap.h>
+#include <dwl/environment/SpaceDiscretization.h>
 #include <dwl/utils/Orientation.h>
 
 #include <Eigen/Dense>
 #include <vector>
 #include <geometry_msgs/PoseArray.h>
-#include <terrain_server/ObstacleMap.h>
+#include <terrain_server/ObstacleMapPublisher.h>
+#include <terrain_server/Statistics.h>
+#include <terrain_server/StatisticsPublisher.h>
+#include <terrain_server/TraceRecorder.h>
+#include <terrain_server/DumpTrace.h>
+#include <terrain_server/ObstacleDistanceField.h>
+#include <terrain_server/DistanceField.h>
+#include <terrain_server/ObstacleDistance.h>
+#include <terrain_server/OccupancyBitGrid.h>
+#include <terrain_server/PackedObstacleMap.h>
+#include <terrain_server/FootprintCollision.h>
 #include <terrain_server/TerrainCell.h>
 #include <std_srvs/Empty.h>
 
@@ -48,22 +59,74 @@ class ObstacleMapServer
 		 */
 		void octomapCallback(const octomap_msgs::Octomap::ConstPtr& msg);
 
-		/** @brief Publishes a reward map */
+		/** @brief Publishes the obstacle map if it changed */
 		void publishObstacleMap();
 
 		/** @brief Resets the obstacle map */
 		bool reset(std_srvs::Empty::Request& req, std_srvs::Empty::Response& resp);
 
+		/**
+		 * @brief Updates the distance field around the robot given the
+		 * current obstacle map
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 */
+		void updateDistanceField(const Eigen::Vector4d& robot_state);
+
+		/** @brief Publishes the distance field */
+		void publishDistanceField();
+
+		/**
+		 * @brief Gets the distance to the nearest obstacle. It returns the
+		 * maximum distance of the field if the position is outside it
+		 * @param const Eigen::Vector2d& Position of the query
+		 */
+		double getObstacleDistance(const Eigen::Vector2d& position);
+
+		/** @brief Gets the distance to the nearest obstacle (service) */
+		bool getDistance(terrain_server::ObstacleDistance::Request& req,
+						 terrain_server::ObstacleDistance::Response& res);
+
+		/**
+		 * @brief Updates the bit-packed occupancy grid around the robot
+		 * given the current obstacle map
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 */
+		void updateOccupancyGrid(const Eigen::Vector4d& robot_state);
+
+		/** @brief Publishes the bit-packed occupancy grid */
+		void publishOccupancyGrid();
+
+		/** @brief Gets the bit-packed occupancy grid */
+		const terrain_server::OccupancyBitGrid& getOccupancyGrid() const;
+
+		/** @brief Checks the collision of a footprint for a batch of poses */
+		bool checkFootprintCollision(terrain_server::FootprintCollision::Request& req,
+									 terrain_server::FootprintCollision::Response& res);
+
+		/** @brief Writes the recorded stage events as a Chrome trace */
+		bool dumpTrace(terrain_server::DumpTrace::Request& req,
+					   terrain_server::DumpTrace::Response& res);
+
 
 	private:
+		/** @brief Stages of the statistics */
+		enum Stage {FRAME_STAGE, DESERIALIZE_STAGE, TF_STAGE, OBSTACLE_MAP_STAGE,
+			MSG_BUILD_STAGE, DISTANCE_FIELD_STAGE, OCCUPANCY_GRID_STAGE};
+
+		/** @brief Counters of the statistics */
+		enum Counter {FRAMES_COUNTER, TF_FAILURES_COUNTER, MAP_SIZE_COUNTER};
+
+		/** @brief Declares the stages and counters of the statistics */
+		void initStatistics();
+
 		/** @brief ROS node handle */
 		ros::NodeHandle node_;
 
 		/** @brief Pointer to the ObstacleMap class */
 		dwl::environment::ObstacleMap obstacle_map_;
 
-		/** @brief Obstacle map publisher */
-		ros::Publisher obstacle_pub_;
+		/** @brief Obstacle map and delta publisher */
+		terrain_server::ObstacleMapPublisher obstacle_pub_;
 
 		/** @brief Octomap subcriber */
 		message_filters::Subscriber<octomap_msgs::Octomap>* octomap_sub_;
@@ -74,8 +137,65 @@ class ObstacleMapServer
 		/** @brief Reset service */
 		ros::ServiceServer reset_srv_;
 
-		/** @brief Obstacle map message */
-		terrain_server::ObstacleMap obstacle_map_msg_;
+		/** @brief Distance field of the obstacles around the robot */
+		terrain_server::ObstacleDistanceField distance_field_;
+
+		/** @brief Conversion routines between positions and keys of the
+		 * obstacle layers */
+		dwl::environment::SpaceDiscretization obstacle_discretization_;
+
+		/** @brief Distance field publisher */
+		ros::Publisher distance_pub_;
+
+		/** @brief Distance field message */
+		terrain_server::DistanceField distance_msg_;
+
+		/** @brief Distance query service */
+		ros::ServiceServer distance_srv_;
+
+		/** @brief Size of the window and maximum distance of the field */
+		double distance_field_size_;
+		double max_obstacle_distance_;
+
+		/** @brief Indicates if it's computed the distance field */
+		bool is_distance_field_;
+
+		/** @brief Bit-packed occupancy grid of the obstacles around the robot */
+		terrain_server::OccupancyBitGrid occupancy_grid_;
+
+		/** @brief Bit-packed occupancy grid publisher */
+		ros::Publisher occupancy_pub_;
+
+		/** @brief Bit-packed occupancy grid message */
+		terrain_server::PackedObstacleMap occupancy_msg_;
+
+		/** @brief Footprint collision service */
+		ros::ServiceServer collision_srv_;
+
+		/** @brief Size of the occupancy grid, its lowest height w.r.t. the
+		 * robot, and the number and height of its layers */
+		double occupancy_grid_size_;
+		double occupancy_min_z_;
+		int occupancy_layers_;
+		double occupancy_layer_height_;
+
+		/** @brief Indicates if it's computed the occupancy grid */
+		bool is_occupancy_grid_;
+
+		/** @brief Latency histograms of the stages and counters */
+		terrain_server::Statistics statistics_;
+
+		/** @brief Periodic publisher of the statistics */
+		terrain_server::StatisticsPublisher statistics_pub_;
+
+		/** @brief Ring buffer of the stage events */
+		terrain_server::TraceRecorder trace_;
+
+		/** @brief Dump trace service */
+		ros::ServiceServer trace_srv_;
+
+		/** @brief Number of received frames */
+		uint64_t num_frames_;
 
 		/** @brief TF listener */
 		tf::TransformListener tf_listener_;
@@ -85,9 +205,6 @@ class ObstacleMapServer
 
 		/** @brief World frame */
 		std::string world_frame_;
-
-		/** @brief Indicates if it was computed new information of the reward map */
-		bool new_information_;
 };
 
 } //@namespace terrain_server
@@ -0,0 +1,157 @@
+#ifndef TERRAIN_SERVER__OCCUPANCY_BIT_GRID__H
+#define TERRAIN_SERVER__OCCUPANCY_BIT_GRID__H
+
+#include <Eigen/Dense>
+#include <limits>
+#include <stdint.h>
+#include <vector>
+
+
+namespace terrain_server
+{
+
+/**
+ * @brief Robot footprint described by a polygon in the robot frame and a
+ * height range in the world frame
+ */
+struct Footprint
+{
+	Footprint() : min_z(-std::numeric_limits<double>::max()),
+			max_z(std::numeric_limits<double>::max()) {}
+
+	/** @brief Builds a rectangular footprint centred in the robot frame */
+	static Footprint rectangle(double length, double width,
+							   double min_z = -std::numeric_limits<double>::max(),
+							   double max_z = std::numeric_limits<double>::max());
+
+	std::vector<Eigen::Vector2d> polygon;
+	double min_z;
+	double max_z;
+};
+
+
+/**
+ * @class OccupancyBitGrid
+ * @brief Class for describing a bit-packed 2.5D occupancy grid, i.e. a set
+ * of 2D layers (height slices) where each row is packed in 64-bit words.
+ * The footprint collision queries rasterize the rotated polygon into row
+ * spans, and test them with word-wide masks against the layers that overlap
+ * the height range of the footprint
+ */
+class OccupancyBitGrid
+{
+	public:
+		/** @brief Constructor function */
+		OccupancyBitGrid();
+
+		/** @brief Destructor function */
+		~OccupancyBitGrid();
+
+		/**
+		 * @brief Sets the size of the grid, and clears it
+		 * @param unsigned int Number of cells along the x-axis
+		 * @param unsigned int Number of cells along the y-axis
+		 * @param unsigned int Number of height layers
+		 * @param double Resolution of the plane
+		 * @param double Height of the layers
+		 */
+		void setSize(unsigned int width,
+					 unsigned int height,
+					 unsigned int num_layers,
+					 double resolution,
+					 double layer_height);
+
+		/**
+		 * @brief Sets the position of the lower corner of the grid (it
+		 * doesn't move the occupied cells)
+		 * @param double Position along the x-axis
+		 * @param double Position along the y-axis
+		 * @param double Height of the lowest layer
+		 */
+		void setOrigin(double x, double y, double z);
+
+		/** @brief Clears all the occupied cells */
+		void clear();
+
+		/**
+		 * @brief Sets a cell as occupied given its position. The positions
+		 * outside the grid are ignored
+		 * @param const Eigen::Vector3d& Position of the cell
+		 */
+		void setOccupied(const Eigen::Vector3d& position);
+
+		/** @brief Indicates if a position is occupied */
+		bool isOccupied(const Eigen::Vector3d& position) const;
+
+		/**
+		 * @brief Checks if the footprint in a certain pose collides with an
+		 * occupied cell. The cells outside the grid are considered free
+		 * @param const Eigen::Vector3d& Pose of the robot (x, y, yaw)
+		 * @param const Footprint& Footprint of the robot
+		 */
+		bool isColliding(const Eigen::Vector3d& pose,
+						 const Footprint& footprint) const;
+
+		/**
+		 * @brief Checks a batch of poses. The layers that overlap the height
+		 * range of the footprint are merged once for the whole batch
+		 * @param std::vector<bool>& Collision result per pose
+		 * @param const std::vector<Eigen::Vector3d>& Poses of the robot (x, y, yaw)
+		 * @param const Footprint& Footprint of the robot
+		 * @return The number of colliding poses
+		 */
+		unsigned int checkCollisions(std::vector<bool>& collisions,
+									 const std::vector<Eigen::Vector3d>& poses,
+									 const Footprint& footprint) const;
+
+		/** @brief Gets the packed words (layer, row and word order) */
+		const std::vector<uint64_t>& getData() const;
+
+		/** @brief Gets the properties of the grid */
+		const Eigen::Vector3d& getOrigin() const;
+		unsigned int getWidth() const;
+		unsigned int getHeight() const;
+		unsigned int getNumLayers() const;
+		unsigned int getWordsPerRow() const;
+		double getResolution() const;
+		double getLayerHeight() const;
+
+
+	private:
+		/**
+		 * @brief Merges the layers that overlap a height range
+		 * @param std::vector<uint64_t>& Merged rows
+		 * @param double Minimum height
+		 * @param double Maximum height
+		 * @return False if no layer overlaps the height range
+		 */
+		bool mergeLayers(std::vector<uint64_t>& rows,
+						 double min_z, double max_z) const;
+
+		/**
+		 * @brief Checks if the footprint in a certain pose collides with the
+		 * merged rows
+		 */
+		bool isColliding(const std::vector<uint64_t>& rows,
+						 const Eigen::Vector3d& pose,
+						 const Footprint& footprint) const;
+
+		/** @brief Tests if there is an occupied cell in a span of a row */
+		bool testSpan(const uint64_t* row, int min_x, int max_x) const;
+
+		/** @brief Packed occupancy of the layers */
+		std::vector<uint64_t> data_;
+
+		/** @brief Position of the lower corner of the grid */
+		Eigen::Vector3d origin_;
+
+		/** @brief Size of the grid */
+		unsigned int width_, height_, num_layers_, words_per_row_;
+
+		/** @brief Resolution of the plane and height of the layers */
+		double resolution_, layer_height_;
+};
+
+} //@namespace terrain_server
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef TERRAIN_SERVER__SCENE_GENERATOR__H
+#define TERRAIN_SERVER__SCENE_GENERATOR__H
+
+#include <Eigen/Dense>
+#include <octomap/octomap.h>
+#include <vector>
+
+
+namespace terrain_server
+{
+
+struct Rectangle
+{
+	Rectangle() : center_x(0.), center_y(0.), width(0.), length(0.),
+			yaw(0.), resolution(0.), height(0.) {}
+
+	double center_x;
+	double center_y;
+	double width;
+	double length;
+	double yaw;
+	double resolution;
+	double height;
+};
+
+
+/**
+ * @class SceneGenerator
+ * @brief Class for building synthetic terrain scenes (rectangles, stairs,
+ * gaps, stepping stones, slopes and rough terrain) as a set of points. The
+ * scene is built once with a configurable density, and it can be emitted as
+ * a point cloud or directly as an octree. The random primitives are
+ * deterministic given their seed
+ */
+class SceneGenerator
+{
+	public:
+		/** @brief Constructor function */
+		SceneGenerator();
+
+		/** @brief Destructor function */
+		~SceneGenerator();
+
+		/** @brief Sets the position of the scene w.r.t. the world frame */
+		void setPosition(const Eigen::Vector3d& position);
+
+		/** @brief Removes all the points of the scene */
+		void clear();
+
+		/**
+		 * @brief Adds a flat rectangle
+		 * @param const Rectangle& Properties of the rectangle
+		 */
+		void addRectangle(const Rectangle& rectangle);
+
+		/**
+		 * @brief Adds a staircase that goes up along the yaw direction. Each
+		 * step has a tread and a riser
+		 * @param double Position of the first step along the x-axis
+		 * @param double Position of the centre line along the y-axis
+		 * @param double Yaw orientation
+		 * @param int Number of steps
+		 * @param double Height of the steps
+		 * @param double Length of the steps
+		 * @param double Width of the staircase
+		 * @param double Resolution of the points
+		 */
+		void addStairs(double x, double y, double yaw,
+					   int num_steps, double step_height,
+					   double step_length, double width,
+					   double resolution);
+
+		/**
+		 * @brief Adds a gap between two platforms
+		 * @param double Position of the gap centre along the x-axis
+		 * @param double Position of the gap centre along the y-axis
+		 * @param double Yaw orientation
+		 * @param double Length of the gap
+		 * @param double Length of each platform
+		 * @param double Width of the platforms
+		 * @param double Height of the platforms
+		 * @param double Resolution of the points
+		 */
+		void addGap(double x, double y, double yaw,
+					double gap_length, double platform_length,
+					double width, double height,
+					double resolution);
+
+		/**
+		 * @brief Adds a grid of square stepping stones with random height
+		 * @param double Position of the grid centre along the x-axis
+		 * @param double Position of the grid centre along the y-axis
+		 * @param double Yaw orientation
+		 * @param int Number of rows (along the yaw direction)
+		 * @param int Number of columns
+		 * @param double Size of the stones
+		 * @param double Distance between the stone centres
+		 * @param double Height of the stones
+		 * @param double Maximum deviation of the height of the stones
+		 * @param double Resolution of the points
+		 * @param unsigned int Seed of the random heights
+		 */
+		void addSteppingStones(double x, double y, double yaw,
+							   int rows, int cols,
+							   double stone_size, double spacing,
+							   double height, double height_noise,
+							   double resolution, unsigned int seed = 0);
+
+		/**
+		 * @brief Adds an inclined plane that goes up along the yaw direction
+		 * @param double Position of the slope centre along the x-axis
+		 * @param double Position of the slope centre along the y-axis
+		 * @param double Yaw orientation
+		 * @param double Length of the slope
+		 * @param double Width of the slope
+		 * @param double Height of the slope centre
+		 * @param double Inclination angle
+		 * @param double Resolution of the points
+		 */
+		void addSlope(double x, double y, double yaw,
+					  double length, double width,
+					  double height, double angle,
+					  double resolution);
+
+		/**
+		 * @brief Adds a rough terrain patch, i.e. random heights interpolated
+		 * bilinearly from a coarse lattice
+		 * @param double Position of the patch centre along the x-axis
+		 * @param double Position of the patch centre along the y-axis
+		 * @param double Length of the patch
+		 * @param double Width of the patch
+		 * @param double Mean height
+		 * @param double Maximum deviation of the height
+		 * @param double Distance between the random lattice points
+		 * @param double Resolution of the points
+		 * @param unsigned int Seed of the random heights
+		 */
+		void addRoughTerrain(double x, double y,
+							 double length, double width,
+							 double height, double amplitude,
+							 double wavelength, double resolution,
+							 unsigned int seed = 0);
+
+		/** @brief Gets the points of the scene (in the world frame) */
+		const std::vector<Eigen::Vector3d>& getPoints() const;
+
+		/**
+		 * @brief Inserts the points of the scene as occupied cells of an octree
+		 * @param octomap::OcTree& Octree
+		 */
+		void getOcTree(octomap::OcTree& octree) const;
+
+
+	private:
+		/**
+		 * @brief Adds the points of a horizontal patch given its local height
+		 * function, i.e. height = f(x,y) in the patch frame
+		 */
+		template<typename HeightFunction>
+		void addPatch(double x, double y, double yaw,
+					  double length, double width,
+					  double resolution,
+					  const HeightFunction& height);
+
+		/** @brief Adds a point given in a local frame */
+		void addLocalPoint(double x, double y, double yaw,
+						   double local_x, double local_y, double z);
+
+		/** @brief Points of the scene */
+		std::vector<Eigen::Vector3d> points_;
+
+		/** @brief Position of the scene w.r.t. the world frame */
+		Eigen::Vector3d position_;
+};
+
+} //@namespace terrain_server
+
+#endif
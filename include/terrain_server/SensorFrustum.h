@@ -0,0 +1,79 @@
+#ifndef TERRAIN_SERVER__SENSOR_FRUSTUM__H
+#define TERRAIN_SERVER__SENSOR_FRUSTUM__H
+
+#include <terrain_server/DepthImageBinner.h>
+
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+
+namespace terrain_server
+{
+
+/**
+ * @class SensorFrustum
+ * @brief Viewing frustum of a pinhole sensor in the world frame, i.e. the
+ * four side planes of the image borders and the planes of the minimum and
+ * maximum depths. It's used to restrict the columns of the map that are
+ * updated in a frame, since the columns that the sensor doesn't see can't
+ * have changed
+ */
+class SensorFrustum
+{
+	public:
+		/** @brief Constructor function, the frustum is empty */
+		SensorFrustum();
+
+		/** @brief Destructor function */
+		~SensorFrustum();
+
+		/**
+		 * @brief Sets the frustum of a sensor
+		 * @param const CameraIntrinsics& Intrinsics of the sensor
+		 * @param unsigned int Width of the image
+		 * @param unsigned int Height of the image
+		 * @param const Eigen::Affine3d& Pose of the sensor (optical frame) in
+		 * the world frame
+		 * @param double Minimum depth
+		 * @param double Maximum depth
+		 * @return Returns false if the intrinsics or image size aren't valid
+		 */
+		bool set(const CameraIntrinsics& intrinsics,
+				 unsigned int width, unsigned int height,
+				 const Eigen::Affine3d& sensor_pose,
+				 double min_depth, double max_depth);
+
+		/** @brief Removes the frustum */
+		void clear();
+
+		/** @brief Indicates if the frustum is set */
+		bool isSet() const;
+
+		/**
+		 * @brief Indicates if a vertical column intersects the frustum. The
+		 * planes are moved outwards by a margin, so the column is treated
+		 * as a cylinder of this radius
+		 * @param double Position of the column along the x-axis
+		 * @param double Position of the column along the y-axis
+		 * @param double Bottom of the column
+		 * @param double Top of the column
+		 * @param double Margin of the planes
+		 */
+		bool isColumnVisible(double x, double y,
+							 double min_z, double max_z,
+							 double margin = 0.) const;
+
+
+	private:
+		/** @brief Planes of the frustum (unit normal pointing inwards, and
+		 * offset), i.e. a point p is inside if normal.dot(p) + offset >= 0 */
+		Eigen::Vector3d normals_[6];
+		double offsets_[6];
+
+		/** @brief Indicates if the frustum is set */
+		bool is_set_;
+};
+
+} //@namespace terrain_server
+
+#endif
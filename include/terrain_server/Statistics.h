@@ -0,0 +1,189 @@
+#ifndef TERRAIN_SERVER__STATISTICS__H
+#define TERRAIN_SERVER__STATISTICS__H
+
+#include <terrain_server/Timer.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+namespace terrain_server
+{
+
+/**
+ * @brief Copy of the buckets of a latency histogram. It's used for
+ * computing the percentiles of a time window as the difference of two
+ * snapshots
+ */
+struct HistogramSnapshot
+{
+	HistogramSnapshot() : count(0), sum(0) {}
+
+	/** @brief Gets the p-th percentile (in seconds), with p in [0,1] */
+	double getPercentile(double p) const;
+
+	/** @brief Gets the mean (in seconds) */
+	double getMean() const;
+
+	/** @brief Gets the upper bound of the highest non-empty bucket (in seconds) */
+	double getMax() const;
+
+	/** @brief Subtracts a previous snapshot of the same histogram */
+	HistogramSnapshot operator-(const HistogramSnapshot& previous) const;
+
+	std::vector<uint64_t> buckets;
+	uint64_t count;
+	uint64_t sum;
+};
+
+
+/**
+ * @class LatencyHistogram
+ * @brief Lock-free histogram of durations. The buckets are log-linear
+ * over nanoseconds (8 buckets per power of two, i.e. a relative error
+ * below 7%), and the bucket of a sample is computed with bit operations.
+ * The samples are recorded with relaxed atomic increments, so the hot
+ * path never blocks a reader
+ */
+class LatencyHistogram
+{
+	public:
+		/** @brief Constructor function */
+		LatencyHistogram();
+
+		/** @brief Destructor function */
+		~LatencyHistogram();
+
+		/**
+		 * @brief Records a duration
+		 * @param double Duration in seconds
+		 */
+		void record(double duration);
+
+		/** @brief Copies the current buckets */
+		void getSnapshot(HistogramSnapshot& snapshot) const;
+
+		/** @brief Gets the number of recorded samples */
+		uint64_t getCount() const;
+
+		/** @brief Gets the bucket index of a duration in nanoseconds */
+		static unsigned int getBucket(uint64_t nanoseconds);
+
+		/** @brief Gets the lower bound (in nanoseconds) of a bucket */
+		static uint64_t getBucketLowerBound(unsigned int bucket);
+
+		/** @brief Number of buckets, i.e. up to 2^40 ns (~18 min) */
+		static const unsigned int NUM_BUCKETS = 312;
+
+
+	private:
+		/** @brief Buckets of the histogram */
+		std::atomic<uint64_t> buckets_[NUM_BUCKETS];
+
+		/** @brief Number of samples */
+		std::atomic<uint64_t> count_;
+
+		/** @brief Sum of the samples in nanoseconds */
+		std::atomic<uint64_t> sum_;
+};
+
+
+/**
+ * @class ScopedTimer
+ * @brief Records the monotonic time elapsed between its construction and
+ * destruction into a latency histogram
+ */
+class ScopedTimer
+{
+	public:
+		/** @brief Constructor function */
+		explicit ScopedTimer(LatencyHistogram& histogram) :
+				histogram_(histogram), start_time_(getMonotonicTime()) {}
+
+		/** @brief Destructor function */
+		~ScopedTimer() { histogram_.record(getMonotonicTime() - start_time_); }
+
+
+	private:
+		/** @brief Histogram of the scope */
+		LatencyHistogram& histogram_;
+
+		/** @brief Start time of the scope */
+		double start_time_;
+};
+
+
+/**
+ * @class Statistics
+ * @brief Set of named stage histograms and counters of a server. The
+ * stages and counters are added during the initialization, after that
+ * the recording is lock-free and it can be read from other threads
+ */
+class Statistics
+{
+	public:
+		/** @brief Constructor function */
+		Statistics();
+
+		/** @brief Destructor function */
+		~Statistics();
+
+		/**
+		 * @brief Adds a stage
+		 * @param const std::string& Name of the stage
+		 * @return Identifier of the stage
+		 */
+		unsigned int addStage(const std::string& name);
+
+		/**
+		 * @brief Adds a counter
+		 * @param const std::string& Name of the counter
+		 * @return Identifier of the counter
+		 */
+		unsigned int addCounter(const std::string& name);
+
+		/** @brief Gets the histogram of a stage */
+		LatencyHistogram& getStage(unsigned int stage);
+		const LatencyHistogram& getStage(unsigned int stage) const;
+
+		/** @brief Records a duration (in seconds) of a stage */
+		void record(unsigned int stage, double duration);
+
+		/** @brief Sets the value of a counter (e.g. the map size) */
+		void setCounter(unsigned int counter, uint64_t value);
+
+		/** @brief Increments the value of a counter */
+		void incrementCounter(unsigned int counter, uint64_t value = 1);
+
+		/** @brief Gets the value of a counter */
+		uint64_t getCounter(unsigned int counter) const;
+
+		/** @brief Gets the number of stages */
+		unsigned int getNumStages() const;
+
+		/** @brief Gets the number of counters */
+		unsigned int getNumCounters() const;
+
+		/** @brief Gets the name of a stage */
+		const std::string& getStageName(unsigned int stage) const;
+
+		/** @brief Gets the name of a counter */
+		const std::string& getCounterName(unsigned int counter) const;
+
+
+	private:
+		/** @brief Names and histograms of the stages */
+		std::vector<std::string> stage_names_;
+		std::vector<std::unique_ptr<LatencyHistogram> > stages_;
+
+		/** @brief Names and values of the counters */
+		std::vector<std::string> counter_names_;
+		std::vector<std::unique_ptr<std::atomic<uint64_t> > > counters_;
+};
+
+} //@namespace terrain_server
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef TERRAIN_SERVER__STATISTICS_PUBLISHER__H
+#define TERRAIN_SERVER__STATISTICS_PUBLISHER__H
+
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <terrain_server/Statistics.h>
+
+#include <vector>
+
+
+namespace terrain_server
+{
+
+/**
+ * @class StatisticsPublisher
+ * @brief Class for publishing periodically the statistics of a server as
+ * a diagnostic message. The latency percentiles of every stage are
+ * computed over the last period, i.e. from the difference of consecutive
+ * snapshots of the histograms
+ */
+class StatisticsPublisher
+{
+	public:
+		/** @brief Constructor function */
+		StatisticsPublisher();
+
+		/** @brief Destructor function */
+		~StatisticsPublisher();
+
+		/**
+		 * @brief Declares the statistics publisher and its timer
+		 * @param ros::NodeHandle ROS node handle used by the publisher
+		 * @param const std::string& Name of the diagnostic status
+		 * @param const Statistics* Statistics of the server
+		 * @param double Period of the publication (zero disables it)
+		 */
+		void init(ros::NodeHandle node,
+				  const std::string& name,
+				  const Statistics* statistics,
+				  double period);
+
+
+	private:
+		/** @brief Publishes the statistics of the last period */
+		void publish(const ros::TimerEvent& event);
+
+		/** @brief Adds a key value to the diagnostic status */
+		void addValue(const std::string& key, double value);
+
+		/** @brief Statistics publisher */
+		ros::Publisher statistics_pub_;
+
+		/** @brief Timer of the publication */
+		ros::Timer timer_;
+
+		/** @brief Statistics of the server */
+		const Statistics* statistics_;
+
+		/** @brief Diagnostic message (reused buffer) */
+		diagnostic_msgs::DiagnosticArray statistics_msg_;
+
+		/** @brief Snapshots of the stages in the last publication */
+		std::vector<HistogramSnapshot> last_snapshots_;
+
+		/** @brief Time of the last publication */
+		double last_time_;
+};
+
+} //@namespace terrain_server
+
+#endif
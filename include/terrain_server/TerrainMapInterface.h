@@ -9,8 +9,15 @@
 #include <dwl/utils/RigidBodyDynamics.h>
 #include <dwl/utils/EnvironmentRepresentation.h>
 #include <terrain_server/TerrainMap.h>
+#include <terrain_server/TerrainMapChunk.h>
+#include <terrain_server/CostPyramid.h>
 #include <terrain_server/TerrainData.h>
 #include <std_srvs/Empty.h>
+#include <std_msgs/Empty.h>
+
+#include <map>
+#include <mutex>
+#include <set>
 
 
 namespace terrain_server
@@ -27,14 +34,27 @@ class TerrainMapInterface
 
 		/**
 		 * @brief Creates a real-time subscriber of terrain map.
-		 * The name of the topic is defined as node_ns/terrain_map
+		 * The name of the topic is defined as node_ns/terrain_map, or
+		 * node_ns/terrain_map_chunks if the map is streamed. In that case,
+		 * the chunks are assembled in the map as they arrive
 		 * @param ros::NodeHandle ROS node handle used by the subscription
+		 * @param bool Indicates if it subscribes to the map chunks
 		 */
-		void init(ros::NodeHandle node);
+		void init(ros::NodeHandle node, bool streaming = false);
 
 		void updateTerrainMap();
 		bool resetTerrainMap();
 
+		/**
+		 * @brief Enables the cost pyramid of the received map, i.e. it's
+		 * updated with the map (or chunks) and it answers the region queries
+		 * @param bool Indicates if the pyramid is maintained
+		 */
+		void setCostPyramid(bool enable);
+
+		/** @brief Gets the cost pyramid of the received map */
+		const CostPyramid& getCostPyramid() const;
+
 		/**
 		 * @brief Gets the vector of terrain cells
 		 * @param dwl::TerrainData& Vector of terrain cells
@@ -75,12 +95,82 @@ class TerrainMapInterface
 		 */
 		void callback(const terrain_server::TerrainMapConstPtr& msg);
 
+		/**
+		 * @brief Callback method when a terrain map chunk arrives. A full
+		 * re-send of the chunks is requested if the end of the frame lists a
+		 * chunk that wasn't received, or if chunks of the frame were lost
+		 * @param const terrain_server::TerrainMapChunkConstPtr& Chunk message
+		 */
+		void chunkCallback(const terrain_server::TerrainMapChunkConstPtr& msg);
+
+		/** @brief Assembles the received chunks in the terrain map */
+		void updateTerrainChunks();
+
+		/**
+		 * @brief Converts a cell message to the dwl::TerrainCell format
+		 * @param dwl::TerrainCell& Terrain cell
+		 * @param const terrain_server::TerrainCell& Cell message
+		 */
+		void toTerrainCell(dwl::TerrainCell& cell,
+						   const terrain_server::TerrainCell& msg) const;
+
+		/** @brief Sets the resolutions of the received map */
+		void setResolution(double plane_size, double height_size);
+
+		/** @brief Adds the cells of a chunk to the terrain map and the cost
+		 * pyramid (if it's enabled) */
+		void addChunkCells(const std::vector<dwl::TerrainCell>& cells);
+
+		/** @brief Removes the cells of a chunk from the terrain map and the
+		 * cost pyramid (if it's enabled) */
+		void removeChunkCells(const std::vector<dwl::TerrainCell>& cells);
+
+		/** @brief Assembles the terrain data from the received chunks */
+		void assembleTerrainData();
+
+		/** @brief Terrain map that is updated cell by cell, i.e. only the
+		 * received chunks are applied to it */
+		class ChunkTerrainMap : public dwl::environment::TerrainMap
+		{
+			public:
+				void setMapResolution(double plane_size, double height_size);
+				void addCell(const dwl::TerrainCell& cell);
+				void removeCell(const dwl::TerrainCell& cell);
+		};
+
 		/** @brief Terrain map subscriber */
 		ros::Subscriber sub_;
 
 		/** @brief Realtime buffer for the terrain map message */
 		realtime_tools::RealtimeBuffer<terrain_server::TerrainMap> map_buffer_;
 
+		/** @brief Received chunks and their mutex, i.e. they are queued until
+		 * the next update */
+		std::vector<terrain_server::TerrainMapChunkConstPtr> chunk_queue_;
+		std::mutex chunk_mutex_;
+
+		/** @brief Ids of the received chunks and number of chunks received
+		 * since the last end of frame, i.e. they detect the lost chunks */
+		std::set<uint32_t> received_chunks_;
+		uint32_t num_received_chunks_;
+
+		/** @brief Publisher of the requests of a full re-send of the chunks */
+		ros::Publisher resend_pub_;
+
+		/** @brief Cells of the assembled chunks */
+		std::map<uint32_t, std::vector<dwl::TerrainCell> > chunks_;
+
+		/** @brief Pyramid of the costs and heights of the map, and indicates
+		 * if it's maintained */
+		CostPyramid pyramid_;
+		bool is_pyramid_;
+
+		/** @brief Conversion of the keys of the received cells */
+		dwl::environment::SpaceDiscretization space_discretization_;
+
+		/** @brief Indicates if the map is streamed in chunks */
+		bool is_streaming_;
+
 		/** @brief The terrain map clients */
 		ros::ServiceClient terrain_clt_;
 		ros::ServiceClient reset_clt_;
@@ -89,7 +179,7 @@ class TerrainMapInterface
 		terrain_server::TerrainMap map_msg_;
 
 		/** @brief Terrain map (or cells) */
-		std::shared_ptr<dwl::environment::TerrainMap> terrain_map_;
+		std::shared_ptr<ChunkTerrainMap> terrain_map_;
 		dwl::TerrainCell terrain_cell_;
 		dwl::TerrainData terrain_data_;
 
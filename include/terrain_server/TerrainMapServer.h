@@ -7,23 +7,40 @@
 #include <dwl/utils/Orientation.h>
 
 #include <terrain_server/TerrainMapping.h>
-#include <terrain_server/feature/SlopeFeature.h>
-#include <terrain_server/feature/HeightDeviationFeature.h>
-#include <terrain_server/feature/CurvatureFeature.h>
+#include <terrain_server/TerrainMappingConfig.h>
+#include <terrain_server/InputSource.h>
+#include <terrain_server/UpdateScheduler.h>
 
 
 #include <octomap_msgs/conversions.h>
 #include <octomap_msgs/Octomap.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <nav_msgs/Path.h>
 #include <terrain_server/TerrainMap.h>
+#include <terrain_server/TerrainMapChunk.h>
+#include <terrain_server/FootholdExtractor.h>
+#include <terrain_server/FootholdCandidates.h>
 #include <terrain_server/TerrainCell.h>
+#include <terrain_server/TerrainCostLayers.h>
+#include <terrain_server/ObstacleMapPublisher.h>
+#include <terrain_server/Statistics.h>
+#include <terrain_server/StatisticsPublisher.h>
+#include <terrain_server/TraceRecorder.h>
 #include <std_srvs/Empty.h>
+#include <std_msgs/Empty.h>
 #include <terrain_server/TerrainData.h>
+#include <terrain_server/RegionQuery.h>
+#include <terrain_server/DumpTrace.h>
+#include <terrain_server/SetFeatureWeights.h>
+#include <terrain_server/Snapshot.h>
 
 #include <tf/transform_datatypes.h>
 #include <tf/transform_listener.h>
 #include <tf/message_filter.h>
 #include <message_filters/subscriber.h>
 
+#include <atomic>
+#include <mutex>
 
 
 namespace terrain_server
@@ -51,6 +68,28 @@ class TerrainMapServer
 		 */
 		void octomapCallback(const octomap_msgs::Octomap::ConstPtr& msg);
 
+		/**
+		 * @brief Callback function when it arrives the camera info of the
+		 * sensor of the octomap, i.e. its frustum
+		 * @param const sensor_msgs::CameraInfo::ConstPtr& msg Camera info message
+		 */
+		void cameraInfoCallback(const sensor_msgs::CameraInfo::ConstPtr& msg);
+
+		/**
+		 * @brief Callback function when it arrives a planned path (e.g. a
+		 * footstep plan), i.e. the cells of a corridor along it are computed
+		 * ahead of the robot. An empty path removes the corridor
+		 * @param const nav_msgs::Path::ConstPtr& msg Path message
+		 */
+		void pathCallback(const nav_msgs::Path::ConstPtr& msg);
+
+		/**
+		 * @brief Callback function when a subscriber requests a full re-send
+		 * of the map chunks (e.g. it lost chunks)
+		 * @param const std_msgs::Empty::ConstPtr& msg Request message
+		 */
+		void resendCallback(const std_msgs::Empty::ConstPtr& msg);
+
 		/** @brief Resets the terrain map */
 		bool reset(std_srvs::Empty::Request& req,
 				   std_srvs::Empty::Response& resp);
@@ -59,11 +98,150 @@ class TerrainMapServer
 		bool getTerrainData(terrain_server::TerrainData::Request& req,
 							terrain_server::TerrainData::Response& res);
 
+		/**
+		 * @brief Gets the minimum cost of a box or disc, and the maximum cost
+		 * and height range of a box from the cost pyramid
+		 */
+		bool queryRegion(terrain_server::RegionQuery::Request& req,
+						 terrain_server::RegionQuery::Response& res);
+
+		/**
+		 * @brief Sets the weights of the features. The costs of the map are
+		 * re-summed from the cost layers, and the map is published again
+		 */
+		bool setFeatureWeights(terrain_server::SetFeatureWeights::Request& req,
+							   terrain_server::SetFeatureWeights::Response& res);
+
+		/** @brief Saves a snapshot of the terrain map */
+		bool saveSnapshot(terrain_server::Snapshot::Request& req,
+						  terrain_server::Snapshot::Response& res);
+
+		/** @brief Loads a snapshot of the terrain map, i.e. it replaces the map */
+		bool loadSnapshot(terrain_server::Snapshot::Request& req,
+						  terrain_server::Snapshot::Response& res);
+
+		/** @brief Writes the recorded stage events as a Chrome trace */
+		bool dumpTrace(terrain_server::DumpTrace::Request& req,
+					   terrain_server::DumpTrace::Response& res);
+
 		/** @brief Publishes a terrain map */
 		void publishTerrainMap();
 
+		/**
+		 * @brief Publishes a chunk of the terrain map. It's the chunk handler
+		 * of the terrain mapping, i.e. it's called as soon as the chunk is
+		 * computed
+		 * @param uint32_t Id of the chunk
+		 */
+		void publishTerrainChunk(uint32_t id);
+
+		/**
+		 * @brief Publishes the end of the frame of the streamed map, i.e. the
+		 * chunks of the map
+		 * @param bool Indicates if all the chunks are published before (e.g.
+		 * the costs were re-summed)
+		 */
+		void publishTerrainChunks(bool all_chunks);
+
+		/** @brief Publishes the cost of each feature of the terrain map */
+		void publishCostLayers();
+
+		/**
+		 * @brief Publishes the outputs of a frame. The messages are built with
+		 * the map locked, and they are sent after unlocking it
+		 * @param std::unique_lock<std::mutex>& Lock of the terrain map
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 */
+		void publishFrame(std::unique_lock<std::mutex>& map_lock,
+						  const Eigen::Vector4d& robot_state);
+
 
 	private:
+		/** @brief Stages of the statistics, the features are added after them */
+		enum Stage {FRAME_STAGE, DESERIALIZE_STAGE, TF_STAGE, PRUNING_STAGE,
+			SURFACE_STAGE, TERRAIN_DATA_STAGE, PLANE_FIT_STAGE, COSTS_STAGE,
+			MSG_BUILD_STAGE, OBSTACLE_MSG_STAGE, FEATURE_STAGE};
+
+		/** @brief Counters of the statistics */
+		enum Counter {FRAMES_COUNTER, TF_FAILURES_COUNTER, COLUMNS_COUNTER,
+			PROCESSED_CELLS_COUNTER, RECOMPUTED_CELLS_COUNTER, MAP_SIZE_COUNTER,
+			EVICTED_TILES_COUNTER, LOADED_TILES_COUNTER, SKIPPED_FRAMES_COUNTER};
+
+		/**
+		 * @brief Gets the signature of a octomap, i.e. a hash of its
+		 * serialized data
+		 * @param const octomap_msgs::Octomap& Octomap message
+		 */
+		double getSignature(const octomap_msgs::Octomap& msg) const;
+
+		/**
+		 * @brief Builds the terrain map message
+		 * @return Returns false if there isn't any subscriber
+		 */
+		bool buildTerrainMap();
+
+		/**
+		 * @brief Builds the cost layers message
+		 * @return Returns false if there isn't any subscriber
+		 */
+		bool buildCostLayers();
+
+		/**
+		 * @brief Extracts the foothold candidates and builds their message
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 * @return Returns false if there isn't any subscriber
+		 */
+		bool buildFootholds(const Eigen::Vector4d& robot_state);
+
+		/**
+		 * @brief Builds the obstacle map messages
+		 * @return Returns false if the obstacle map isn't computed
+		 */
+		bool buildObstacleMap();
+
+		/**
+		 * @brief Loads a snapshot file in the terrain map
+		 * @param const std::string& Name of the file
+		 * @return Returns the number of cells, or -1 if it couldn't be loaded
+		 */
+		int loadSnapshotFile(const std::string& filename);
+
+		/**
+		 * @brief Adds an input source, i.e. it's subscribed to its topics and
+		 * it starts its thread
+		 * @param const std::string& Name of the source
+		 * @param const std::string& Type of the source (pointcloud, octree or depth)
+		 * @param const std::string& Topic of the point clouds or depth images
+		 * @param const std::string& Topic of the camera info (depth images)
+		 * @param const TerrainMappingConfig& Configuration of the binning
+		 * @return Returns false if the source is malformed
+		 */
+		bool addInputSource(const std::string& name,
+							const std::string& type,
+							const std::string& topic,
+							const std::string& camera_info_topic,
+							const TerrainMappingConfig& config);
+
+		/** @brief Sets the bounds of the height grid of a source frame */
+		void setGridBounds(HeightGrid& grid, double& min_z, double& max_z,
+						   const Eigen::Vector4d& robot_state);
+
+		/**
+		 * @brief Merges the last frame of a source in the terrain map, and
+		 * publishes the map. It's called from the thread of the source
+		 * @param InputSource& Input source
+		 */
+		void mergeSource(InputSource& source);
+
+		/** @brief Declares the stages and counters of the statistics */
+		void initStatistics();
+
+		/**
+		 * @brief Records the profile of the last terrain map computation
+		 * @param double Start time of the computation
+		 */
+		void recordProfile(double start_time);
+
 		/** @brief ROS node handle */
 		ros::NodeHandle node_;
 
@@ -81,21 +259,85 @@ class TerrainMapServer
 		/** @brief Terrain map publisher */
 		ros::Publisher map_pub_;
 
+		/** @brief Obstacle map and delta publisher */
+		terrain_server::ObstacleMapPublisher obstacle_pub_;
+
 		/** @brief Octomap subscriber */
 		message_filters::Subscriber<octomap_msgs::Octomap>* octomap_sub_;
 
 		/** @brief TF and octomap subscriber */
 		tf::MessageFilter<octomap_msgs::Octomap>* tf_octomap_sub_;
 
+		/** @brief Camera info subscriber of the sensor frustum */
+		ros::Subscriber camera_info_sub_;
+
+		/** @brief Camera info and intrinsics of the sensor */
+		sensor_msgs::CameraInfo camera_info_;
+		terrain_server::CameraIntrinsics intrinsics_;
+
+		/** @brief Indicates if the columns are restricted to the sensor
+		 * frustum, and if it was received the camera info */
+		bool is_frustum_;
+		bool is_camera_info_;
+
+		/** @brief Depth range of the sensor frustum */
+		double frustum_min_depth_, frustum_max_depth_;
+
+		/** @brief Planned path subscriber, and width and horizon of its corridor */
+		ros::Subscriber path_sub_;
+		double corridor_width_, corridor_horizon_;
+
+		/** @brief Scheduler of the octomap frames */
+		terrain_server::UpdateScheduler scheduler_;
+
+		/** @brief Input sources (point clouds or depth images) */
+		std::vector<terrain_server::InputSource*> sources_;
+
+		/** @brief Mutex of the terrain map, i.e. the frames of the sources and
+		 * the services are serialized */
+		std::mutex map_mutex_;
+
+		/** @brief Mutex of the messages, i.e. a frame is sent while the next
+		 * one is computed, and its messages are reused after sending them */
+		std::mutex publish_mutex_;
+
 		/** @brief Reset service */
 		ros::ServiceServer reset_srv_;
 
 		/** @bief Get the terrain data service */
 		ros::ServiceServer terrain_data_srv_;
 
+		/** @brief Region query service of the cost pyramid */
+		ros::ServiceServer region_srv_;
+
 		/** @brief Terrain map message */
 		terrain_server::TerrainMap map_msg_;
 
+		/** @brief Terrain map chunk publisher and message */
+		ros::Publisher chunk_pub_;
+		terrain_server::TerrainMapChunk chunk_msg_;
+
+		/** @brief Number of chunks published since the last end of frame */
+		uint32_t num_sent_chunks_;
+
+		/** @brief Subscriber of the re-send requests of the chunks */
+		ros::Subscriber resend_sub_;
+
+		/** @brief Foothold candidates publisher, extractor and message */
+		ros::Publisher footholds_pub_;
+		terrain_server::FootholdExtractor foothold_extractor_;
+		std::vector<terrain_server::Foothold> candidates_;
+		terrain_server::FootholdCandidates footholds_msg_;
+
+		/** @brief Cost layers publisher */
+		ros::Publisher layers_pub_;
+
+		/** @brief Cost layers message */
+		terrain_server::TerrainCostLayers layers_msg_;
+
+		/** @brief Set feature weights service */
+		ros::ServiceServer weights_srv_;
+
 		/** @brief TF listener */
 		tf::TransformListener tf_listener_;
 
@@ -105,6 +347,32 @@ class TerrainMapServer
 		/** @brief World frame */
 		std::string world_frame_;
 
+		/** @brief Input of the terrain map, i.e. octomap, pointcloud, octree,
+		 * depth or sources */
+		std::string input_;
+
+		/** @brief Latency histograms of the stages and counters */
+		terrain_server::Statistics statistics_;
+
+		/** @brief Periodic publisher of the statistics */
+		terrain_server::StatisticsPublisher statistics_pub_;
+
+		/** @brief Ring buffer of the stage events */
+		terrain_server::TraceRecorder trace_;
+
+		/** @brief Dump trace service */
+		ros::ServiceServer trace_srv_;
+
+		/** @brief Save and load snapshot services */
+		ros::ServiceServer save_snapshot_srv_;
+		ros::ServiceServer load_snapshot_srv_;
+
+		/** @brief Default file of the snapshots */
+		std::string snapshot_filename_;
+
+		/** @brief Number of received frames */
+		std::atomic<uint64_t> num_frames_;
+
 		/** @brief Indicates if it was computed an initial terrain map */
 		bool initial_map_;
 };
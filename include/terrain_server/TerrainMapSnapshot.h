@@ -0,0 +1,133 @@
+#ifndef TERRAIN_SERVER__TERRAIN_MAP_SNAPSHOT__H
+#define TERRAIN_SERVER__TERRAIN_MAP_SNAPSHOT__H
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace terrain_server
+{
+
+class TerrainMapping;
+
+/** @brief Version of the layout of the snapshots */
+const uint32_t SNAPSHOT_VERSION = 1;
+
+/**
+ * @brief Header of a snapshot file. The layout is flat and little endian:
+ * header, layers (names and weights), cells and the cost layers (one array
+ * of num_cells doubles per layer). The offsets are multiple of 8 bytes, so
+ * the sections can be used in place from the mapped file
+ */
+struct SnapshotHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t cell_size;
+	uint32_t num_layers;
+	uint64_t num_cells;
+	uint64_t layers_offset;
+	uint64_t cells_offset;
+	uint64_t costs_offset;
+	uint64_t file_size;
+	double plane_size;
+	double height_size;
+	double origin[3];
+	double stamp;
+	char frame_id[64];
+};
+
+/** @brief Feature of a cost layer of the snapshot */
+struct SnapshotLayer
+{
+	char name[48];
+	double weight;
+};
+
+/** @brief Cell of the snapshot, i.e. a cell of the terrain map */
+struct SnapshotCell
+{
+	uint64_t vertex;
+	uint16_t key_x;
+	uint16_t key_y;
+	uint16_t key_z;
+	uint16_t padding;
+	double x;
+	double y;
+	double height;
+	double cost;
+	double normal[3];
+};
+
+
+/**
+ * @class TerrainMapSnapshot
+ * @brief Snapshot of the terrain map (heights, costs, normals, cost layers,
+ * resolution and origin) in a versioned flat binary file. The file is
+ * mapped in memory (read only) and its sections are used in place, i.e.
+ * there isn't parsing. The origin is the minimum corner of the map
+ */
+class TerrainMapSnapshot
+{
+	public:
+		/** @brief Constructor function */
+		TerrainMapSnapshot();
+
+		/** @brief Destructor function */
+		~TerrainMapSnapshot();
+
+		/**
+		 * @brief Writes a snapshot of the terrain map. It's written in a
+		 * temporary file that is renamed, so a reader never maps a partial
+		 * snapshot
+		 * @param const std::string& Name of the file
+		 * @param const TerrainMapping& Terrain map
+		 * @param const std::string& Frame of the terrain map
+		 * @param double Time of the snapshot
+		 * @return Returns the number of cells, or -1 if it couldn't be written
+		 */
+		static int write(const std::string& filename,
+						 const TerrainMapping& terrain_map,
+						 const std::string& frame_id,
+						 double stamp);
+
+		/**
+		 * @brief Maps a snapshot file in memory and validates its layout
+		 * @param const std::string& Name of the file
+		 * @return Returns false if the file couldn't be mapped or it isn't a
+		 * valid snapshot
+		 */
+		bool open(const std::string& filename);
+
+		/** @brief Unmaps the snapshot file */
+		void close();
+
+		/** @brief Indicates if a snapshot is mapped */
+		bool isOpen() const;
+
+		/** @brief Gets the header of the snapshot */
+		const SnapshotHeader& getHeader() const;
+
+		/** @brief Gets the features of the cost layers */
+		const SnapshotLayer* getLayers() const;
+
+		/** @brief Gets the cells */
+		const SnapshotCell* getCells() const;
+
+		/** @brief Gets the costs (without weight) of a layer of the cells */
+		const double* getCosts(unsigned int layer) const;
+
+
+	private:
+		/** @brief Memory of the mapped file */
+		void* data_;
+
+		/** @brief Size of the mapped file */
+		size_t size_;
+};
+
+} //@namespace terrain_server
+
+#endif
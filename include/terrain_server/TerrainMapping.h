@@ -4,26 +4,80 @@
 #include <dwl/environment/TerrainMap.h>
 #include <dwl/environment/Feature.h>
 #include <dwl/utils/utils.h>
+#include <dwl/utils/EnvironmentRepresentation.h>
 
 #include <octomap/octomap.h>
+#include <terrain_server/Timer.h>
+#include <terrain_server/CostLayers.h>
+#include <terrain_server/CostPyramid.h>
+#include <terrain_server/HeightBinner.h>
+#include <terrain_server/DepthImageBinner.h>
+#include <terrain_server/SensorFrustum.h>
+#include <terrain_server/TerrainMapSnapshot.h>
+#include <terrain_server/TileStore.h>
+#include <terrain_server/feature/FeaturePipeline.h>
+
+#include <functional>
+#include <memory>
 
 
 namespace terrain_server
 {
 
+/**
+ * @brief Durations (in seconds) of the stages and counters of the last
+ * terrain map computation. The plane fitting duration is accumulated over
+ * the cells, and together with the costs duration, they are part of the
+ * terrain data stage. The durations per feature are only measured if the
+ * features aren't fused. The binning of a point cloud is part of the
+ * surface stage.
+ * The processed cells are the heightmap cells visited in the terrain data
+ * stage, and num_cells are the ones that were recomputed
+ */
+struct TerrainMappingProfile
+{
+	TerrainMappingProfile() : pruning(0.), surface(0.), terrain_data(0.),
+			plane_fit(0.), costs(0.), num_columns(0), num_processed(0), num_cells(0),
+			map_size(0), num_evicted_tiles(0), num_loaded_tiles(0) {}
+
+	double pruning;
+	double surface;
+	double terrain_data;
+	double plane_fit;
+	double costs;
+	std::vector<double> features;
+	unsigned int num_columns;
+	unsigned int num_processed;
+	unsigned int num_cells;
+	unsigned int map_size;
+	unsigned int num_evicted_tiles;
+	unsigned int num_loaded_tiles;
+};
+
 /**
  * @class TerrainMapping
- * @brief Abstract class for building the terrain map
+ * @brief Class for building the terrain map. It doesn't depend on ROS, so
+ * it can be linked (terrain_server_mapping library) in the process of the
+ * state estimator or controller. The model of the terrain is given as an
+ * octree or a set of points, together with the pose of the robot
  */
 class TerrainMapping : public dwl::environment::TerrainMap
 {
 	public:
+		/** @brief Handler of a computed chunk of the map, given its id */
+		typedef std::function<void(uint32_t)> ChunkHandler;
+
 		/** @brief Constructor function */
 		TerrainMapping();
 
 		/** @brief Destructor function */
 		~TerrainMapping();
 
+		/** @brief The mapping owns its features, octrees, pipeline and tile
+		 * store, so it isn't copyable */
+		TerrainMapping(const TerrainMapping&) = delete;
+		TerrainMapping& operator=(const TerrainMapping&) = delete;
+
 		/**
 		 * @brief Adds a feature of the terrain map
 		 * @param Feature* the pointer of the feature to add
@@ -45,6 +99,31 @@ class TerrainMapping : public dwl::environment::TerrainMap
 		void compute(octomap::OcTree* model,
 					 const Eigen::Vector4d& robot_state);
 
+		/**
+		 * @brief Computes the terrain map according the pose of the robot. The
+		 * height resolution of the map is the resolution of the octree
+		 * @param octomap::OcTree* The model of the environment
+		 * @param const Eigen::Vector3d& The position of the robot
+		 * @param const Eigen::Quaterniond& The orientation of the robot
+		 */
+		void compute(octomap::OcTree* model,
+					 const Eigen::Vector3d& position,
+					 const Eigen::Quaterniond& orientation);
+
+		/**
+		 * @brief Computes the terrain map from a set of points (e.g. a point
+		 * cloud in the world frame) according the pose of the robot. The
+		 * points are inserted in an internal octree that is reused between calls
+		 * @param const std::vector<Eigen::Vector3d>& Points of the environment
+		 * @param double Resolution of the internal octree
+		 * @param const Eigen::Vector3d& The position of the robot
+		 * @param const Eigen::Quaterniond& The orientation of the robot
+		 */
+		void compute(const std::vector<Eigen::Vector3d>& points,
+					 double resolution,
+					 const Eigen::Vector3d& position,
+					 const Eigen::Quaterniond& orientation);
+
 		/**
 		 * @brief Computes the terrain data given the voxel map
 		 * and the key of the topmost cell of a certain position of the grid
@@ -55,6 +134,182 @@ class TerrainMapping : public dwl::environment::TerrainMap
 		void computeTerrainData(octomap::OcTree* octomap,
 								const octomap::OcTreeKey& heightmap_key);
 
+		/**
+		 * @brief Integrates a point cloud (world frame) in an internal octree
+		 * that is kept between calls, and updates the terrain map of the
+		 * changed columns, i.e. the terrain map is computed incrementally. The
+		 * integration is limited to the bounding box of the search areas, and
+		 * the octree is pruned outside the interest region
+		 * @param const std::vector<Eigen::Vector3f>& Points in the world frame
+		 * (they have to be finite)
+		 * @param const Eigen::Vector3d& Origin of the sensor in the world frame
+		 * @param const Eigen::Vector3d& The position of the robot
+		 * @param const Eigen::Quaterniond& The orientation of the robot
+		 */
+		void integratePointCloud(const std::vector<Eigen::Vector3f>& points,
+								 const Eigen::Vector3d& sensor_origin,
+								 const Eigen::Vector3d& position,
+								 const Eigen::Quaterniond& orientation);
+
+		/**
+		 * @brief Sets the internal octree of the integrated point clouds
+		 * @param double Resolution of the octree
+		 * @param double Maximum range of the rays (a negative value doesn't
+		 * limit them)
+		 */
+		void setOctreeIntegration(double resolution, double max_range);
+
+		/**
+		 * @brief Sets the frustum of the sensor, i.e. the octree columns
+		 * that don't intersect it aren't scanned, and the cells outside it
+		 * keep their cached terrain data. It's kept until it's cleared
+		 * @param const SensorFrustum& Frustum of the sensor in the world frame
+		 */
+		void setSensorFrustum(const SensorFrustum& frustum);
+
+		/** @brief Removes the sensor frustum, i.e. all the columns are scanned */
+		void clearSensorFrustum();
+
+		/**
+		 * @brief Sets the planned path (e.g. a footstep plan) of the robot.
+		 * The cells of a corridor along the path are computed every frame
+		 * before the search areas (the surface, terrain data and costs), even
+		 * outside them, so their costs are cached when the planner queries
+		 * them. The corridor starts from the
+		 * closest waypoint to the robot, and it should be inside the interest
+		 * region, otherwise its cells are removed every frame
+		 * @param const std::vector<Eigen::Vector2d>& Waypoints in the world frame
+		 * @param double Width of the corridor
+		 * @param double Length of the corridor ahead of the robot
+		 */
+		void setCorridor(const std::vector<Eigen::Vector2d>& path,
+						 double width,
+						 double horizon);
+
+		/** @brief Removes the planned path */
+		void clearCorridor();
+
+		/** @brief Gets the columns of the corridor of the last frame, ordered
+		 * along the path */
+		const std::vector<dwl::Vertex>& getCorridor() const;
+
+		/**
+		 * @brief Sets the handler of the chunks of the map. The recomputed
+		 * cells of a frame are grouped in square chunks of cells, and the
+		 * chunks are computed nearest to the robot first (after the chunks of
+		 * the corridor of the planned path). The handler is
+		 * called as soon as the costs of a chunk are computed, so the map
+		 * can be published progressively (see getChunkCells)
+		 * @param const ChunkHandler& Handler called with the id of the chunk
+		 * @param unsigned int Number of cells of the side of a chunk
+		 */
+		void setChunkHandler(const ChunkHandler& handler,
+							 unsigned int chunk_size);
+
+		/** @brief Removes the chunk handler, i.e. the costs are computed
+		 * once per frame */
+		void clearChunkHandler();
+
+		/**
+		 * @brief Gets the cells of the map that belong to a chunk
+		 * @param std::vector<dwl::TerrainCell>& Cells of the chunk
+		 * @param uint32_t Id of the chunk
+		 */
+		void getChunkCells(std::vector<dwl::TerrainCell>& cells,
+						   uint32_t id) const;
+
+		/**
+		 * @brief Gets the chunks that have cells in the map
+		 * @param std::vector<uint32_t>& Ids of the chunks
+		 */
+		void getChunkIds(std::vector<uint32_t>& ids) const;
+
+		/**
+		 * @brief Computes the terrain map from a height grid, i.e. a 2.5D
+		 * heightmap in the world frame. The observed cells inside the search
+		 * areas update the heightmap, and their planes are fitted to the
+		 * neighboring cells of the heightmap instead of the octree voxels
+		 * @param const HeightGrid& Height grid
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 */
+		void compute(const HeightGrid& grid,
+					 const Eigen::Vector4d& robot_state);
+
+		/**
+		 * @brief Computes the terrain map from a point cloud (world frame)
+		 * without building an octree, i.e. the points inside the search areas
+		 * are binned in a height grid with the resolution of the map. The
+		 * height resolution of the map is the same than the plane one
+		 * @param const std::vector<Eigen::Vector3f>& Points in the world frame
+		 * (they have to be finite)
+		 * @param const Eigen::Vector3d& The position of the robot
+		 * @param const Eigen::Quaterniond& The orientation of the robot
+		 */
+		void computeFromPointCloud(const std::vector<Eigen::Vector3f>& points,
+								   const Eigen::Vector3d& position,
+								   const Eigen::Quaterniond& orientation);
+
+		/**
+		 * @brief Computes the terrain map from an organised depth image
+		 * without building a point cloud, i.e. the pixels inside the search
+		 * areas are binned in a height grid with the resolution of the map in
+		 * a single pass. The normals of the cells are estimated from the
+		 * adjacent pixels instead of fitting planes
+		 * @param const DepthImage& Depth image
+		 * @param const CameraIntrinsics& Intrinsics of the camera
+		 * @param const Eigen::Affine3d& Pose of the camera (optical frame) in
+		 * the world frame
+		 * @param const Eigen::Vector3d& The position of the robot
+		 * @param const Eigen::Quaterniond& The orientation of the robot
+		 */
+		void computeFromDepthImage(const DepthImage& image,
+								   const CameraIntrinsics& intrinsics,
+								   const Eigen::Affine3d& camera_pose,
+								   const Eigen::Vector3d& position,
+								   const Eigen::Quaterniond& orientation);
+
+		/**
+		 * @brief Sets the valid pixels of the binned depth images
+		 * @param double Minimum depth
+		 * @param double Maximum depth
+		 * @param double Maximum relative depth jump between the adjacent
+		 * pixels of a normal
+		 */
+		void setDepthBinning(double min_depth,
+							 double max_depth,
+							 double max_jump);
+
+		/**
+		 * @brief Sets the bounds of a height grid, i.e. the bounding box of
+		 * the search areas around the robot aligned to the cells of the map.
+		 * It also sets the height resolution of the map (the plane one)
+		 * @param HeightGrid& Height grid
+		 * @param double& Minimum height of the search areas
+		 * @param double& Maximum height of the search areas
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 */
+		void setHeightGridBounds(HeightGrid& grid,
+								 double& min_z, double& max_z,
+								 const Eigen::Vector4d& robot_state);
+
+		/**
+		 * @brief Sets the height of the cells of the binned point clouds
+		 * @param bool Indicates if the height is a percentile of the points of
+		 * the cell, otherwise it's the maximum
+		 * @param double Percentile in [0,1]
+		 * @param unsigned int Number of threads (zero uses the hardware concurrency)
+		 */
+		void setHeightBinning(bool is_percentile,
+							  double percentile,
+							  unsigned int num_threads);
+
+		/**
+		 * @brief Computes the terrain data of a cell of the heightmap, i.e.
+		 * the plane is fitted to its neighboring cells of the heightmap
+		 * @param dwl::Vertex Vertex of the cell
+		 */
+		void computeTerrainData(dwl::Vertex vertex_id);
+
 		/**
 		 * @brief Removes terrain values outside the interest region
 		 * @param const Eigen::Vector3d& State of the robot, i.e. 3D position
@@ -99,8 +354,279 @@ class TerrainMapping : public dwl::environment::TerrainMap
 								int left_neighbors, int right_neighbors,
 								int bottom_neighbors, int top_neighbors);
 
+		/**
+		 * @brief Sets the height band of the obstacle map. The obstacle map is
+		 * computed in the same traversal of the search areas used for the
+		 * terrain map, i.e. both maps share the column data of every frame
+		 * @param double Minimum height w.r.t. the robot position
+		 * @param double Maximum height w.r.t. the robot position
+		 */
+		void setObstacleArea(double min_z, double max_z);
+
+		/**
+		 * @brief Sets a tile store, i.e. the map is split in square tiles, and
+		 * the tiles that leave the interest region are evicted to the store
+		 * instead of being removed. They are paged in asynchronously when the
+		 * robot approaches them. It has to be set after adding the features
+		 * @param const std::string& Name of the file of the store
+		 * @param unsigned int Number of cells of the side of a tile
+		 * @param unsigned int Maximum number of stored tiles
+		 * @return Returns false if the store couldn't be created
+		 */
+		bool setTileStore(const std::string& filename,
+						  unsigned int tile_size,
+						  unsigned int max_tiles);
+
+		/**
+		 * @brief Sets if the features can be computed with a fused pipeline,
+		 * i.e. a single pass with statically dispatched kernels. It's used
+		 * for the common combinations of built-in features, otherwise the
+		 * features are called through their virtual interface
+		 * @param bool Indicates if the fused pipeline is allowed
+		 */
+		void setFusedFeatures(bool fused);
+
+		/** @brief Indicates if the features are computed with a fused pipeline */
+		bool isFusedFeatures();
+
+		/**
+		 * @brief Sets the weight of a feature. The costs of the map are
+		 * updated by applyFeatureWeights
+		 * @param const std::string& Name of the feature
+		 * @param double Weight of the feature
+		 * @return Returns false if there isn't the feature
+		 */
+		bool setFeatureWeight(const std::string& feature_name, double weight);
+
+		/**
+		 * @brief Updates the cost of the cells of the map with the current
+		 * weights, i.e. the cost layers are re-summed without recomputing
+		 * the features
+		 */
+		void applyFeatureWeights();
+
+		/** @brief Gets the weight of a feature */
+		double getFeatureWeight(unsigned int index) const;
+
+		/** @brief Gets the cost of each feature of the cells of the map */
+		const CostLayers& getCostLayers() const;
+
+		/**
+		 * @brief Enables the cost pyramid, i.e. the min/max pyramid of the
+		 * costs and heights of the map. It's updated with the cells of every
+		 * frame, and it answers the region queries (e.g. the best foothold in
+		 * a disc) without visiting all the cells of the region
+		 * @param bool Indicates if the pyramid is maintained
+		 */
+		void setCostPyramid(bool enable);
+
+		/** @brief Gets the cost pyramid of the map (see setCostPyramid) */
+		const CostPyramid& getCostPyramid() const;
+
+		/** @brief Gets the number of features */
+		unsigned int getNumFeatures() const;
+
+		/** @brief Gets the name of a feature */
+		std::string getFeatureName(unsigned int index) const;
+
+		/** @brief Gets the profile of the last terrain map computation */
+		const TerrainMappingProfile& getProfile() const;
+
+		/**
+		 * @brief Loads the cells of a snapshot, i.e. it replaces the terrain
+		 * map. The cost layers are loaded if they have the same features, and
+		 * they are re-summed with the current weights
+		 * @param const TerrainMapSnapshot& Mapped snapshot
+		 * @return Returns false if the snapshot has a different resolution
+		 */
+		bool loadSnapshot(const TerrainMapSnapshot& snapshot);
+
+		/** @brief Gets the space discretization of the terrain map */
+		const dwl::environment::SpaceDiscretization& getSpaceDiscretization() const;
+
+		/** @brief Resets the terrain and obstacle maps */
+		void reset();
+
+		/** @brief Indicates if the obstacle map is computed */
+		bool isObstacleMap() const;
+
+		/** @brief Gets the obstacle map computed from the search areas */
+		const std::map<dwl::Vertex, dwl::Cell>& getObstacleMap() const;
+
 
 	private:
+		/**
+		 * @brief Starts a frame, i.e. it adds the default search area if
+		 * there isn't one, resets the profile and prunes the map
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 */
+		void prepareFrame(const Eigen::Vector4d& robot_state);
+
+		/** @brief Adds a default search area if there isn't one */
+		void addDefaultSearchArea();
+
+		/**
+		 * @brief Gets the columns of the corridor of the planned path ahead
+		 * of the robot
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 */
+		void updateCorridor(const Eigen::Vector4d& robot_state);
+
+		/**
+		 * @brief Updates the heightmap and obstacle map of a column of the octree
+		 * @param octomap::OcTree* The model of the environment
+		 * @param double Position of the column along the x-axis
+		 * @param double Position of the column along the y-axis
+		 * @param double Bottom of the column
+		 * @param double Top of the column
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 * @param double Margin of the sensor frustum
+		 * @return Returns false if the column is out of the octree bounds
+		 */
+		bool scanColumn(octomap::OcTree* octomap,
+						double x, double y,
+						double min_z, double max_z,
+						const Eigen::Vector4d& robot_state,
+						double margin);
+
+		/**
+		 * @brief Updates the heightmap of a set of columns, and recomputes the
+		 * terrain data of their cells and neighboring cells
+		 * @param octomap::OcTree* The model of the environment
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 * @param const std::set<dwl::Vertex>& Vertices of the columns
+		 */
+		void computeColumns(octomap::OcTree* octomap,
+							const Eigen::Vector4d& robot_state,
+							const std::set<dwl::Vertex>& columns);
+
+		/**
+		 * @brief Removes the voxels of the integrated octree outside the
+		 * interest region. It's done when the robot moves a fraction of the
+		 * interest region since the last pruning
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 */
+		void pruneIntegratedOcTree(const Eigen::Vector4d& robot_state);
+
+		/**
+		 * @brief Adds the columns that entered the search areas, the corridor
+		 * or the interest region since the last integration. Their cells
+		 * could be pruned from the map while their voxels didn't change, so
+		 * the change detection of the octree doesn't give them
+		 * @param std::set<dwl::Vertex>& Vertices of the columns
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 */
+		void addEnteredColumns(std::set<dwl::Vertex>& columns,
+							   const Eigen::Vector4d& robot_state);
+
+		/**
+		 * @brief Indicates if a column is searched in a frame, i.e. it's
+		 * inside the search areas (or the corridor) and the interest region
+		 * @param const Eigen::Vector2d& Coordinate of the column
+		 * @param dwl::Vertex Vertex id of the column
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 * @param const std::set<dwl::Vertex>& Columns of the corridor
+		 */
+		bool isSearchedColumn(const Eigen::Vector2d& coord,
+							  dwl::Vertex vertex_id,
+							  const Eigen::Vector4d& robot_state,
+							  const std::set<dwl::Vertex>& corridor) const;
+
+		/** @brief Sets the terrain information used by the features */
+		void setTerrainInformation();
+
+		/**
+		 * @brief Fits the plane of a cell and adds its terrain information to
+		 * the samples of the frame
+		 * @param const std::vector<Eigen::Vector3f>& Position of the cell
+		 * followed by the position of its neighbors
+		 * @param bool Indicates if there are neighbors
+		 */
+		void addTerrainSample(const std::vector<Eigen::Vector3f>& neighbors_position,
+							  bool is_there_neighboring);
+
+		/**
+		 * @brief Updates the heightmap given the topmost occupied cell
+		 * of a certain column
+		 * @param const Eigen::Vector3d& Position of the topmost occupied cell
+		 */
+		void updateHeightMapCell(const Eigen::Vector3d& cell_position);
+
+		/** @brief Computes the costs of the cells added in the frame */
+		void computeCosts();
+
+		/** @brief Builds the cost pyramid from the cells of the map if it's
+		 * enabled */
+		void buildCostPyramid();
+
+		/** @brief Removes a cell from the cost pyramid if it's enabled */
+		void removePyramidCell(dwl::Vertex vertex_id);
+
+		/**
+		 * @brief Removes a cell from the map, i.e. its terrain data, height,
+		 * cost layers and pyramid cell. Its chunk is handed over in the
+		 * frame even if none of its cells is recomputed
+		 * @param dwl::Vertex Vertex id of the cell
+		 */
+		void removeTerrainCell(dwl::Vertex vertex_id);
+
+		/**
+		 * @brief Computes the terrain data and costs of the cells of the
+		 * frame, the cells of the corridor first. If there is a chunk handler,
+		 * they are computed chunk by chunk, the chunks of the corridor first
+		 * and then nearest to the robot first. The chunks whose cells were
+		 * removed or paged in are also handed over
+		 * @param const std::vector<dwl::Vertex>& Cells of the frame
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 * @param const std::function<void(unsigned int)>& Computes the
+		 * terrain data of the i-th cell
+		 */
+		void computeTerrainChunks(const std::vector<dwl::Vertex>& vertices,
+								  const Eigen::Vector4d& robot_state,
+								  const std::function<void(unsigned int)>& compute_cell);
+
+		/** @brief Removes the feature pipeline, i.e. it's created again with
+		 * the current features and weights */
+		void resetFeaturePipeline();
+
+		/**
+		 * @brief Evicts the tiles that left the interest region, requests
+		 * the stored tiles that are inside it, and merges the tiles paged in
+		 * @param const Eigen::Vector3d& State of the robot, i.e. 3D position
+		 * and yaw orientation
+		 */
+		void updateTiles(const Eigen::Vector3d& robot_state);
+
+		/**
+		 * @brief Adds the cells of a tile that aren't in the map
+		 * @param const Tile& Tile paged in
+		 */
+		void mergeTile(const Tile& tile);
+
+		/** @brief Gets the tile of a key given the number of cells of the
+		 * side of the tiles */
+		uint32_t getTileId(const dwl::Key& key, unsigned int tile_size) const;
+
+		/** @brief Gets the centre of a tile */
+		Eigen::Vector2d getTileCentre(uint32_t id, unsigned int tile_size) const;
+
+		/**
+		 * @brief Indicates if a point is inside the interest region
+		 * @param const Eigen::Vector2d& Point
+		 * @param const Eigen::Vector3d& State of the robot, i.e. 3D position
+		 * and yaw orientation
+		 * @param double Margin added to the radii of the region
+		 */
+		bool isInsideInterestRegion(const Eigen::Vector2d& point,
+									const Eigen::Vector3d& robot_state,
+									double margin = 0.) const;
+
+		/**
+		 * @brief Adds an occupied cell to the obstacle map
+		 * @param const Eigen::Vector3d& Position of the occupied cell
+		 */
+		void addCellToObstacleMap(const Eigen::Vector3d& cell_position);
+
 		/** @brief Vector of pointers to the Feature class */
 		std::vector<dwl::environment::Feature*> features_;
 
@@ -128,6 +654,90 @@ class TerrainMapping : public dwl::environment::TerrainMap
 
 		/** @brief Depth of the octomap */
 		int depth_;
+
+		/** @brief Obstacle map, i.e. occupied cells inside the obstacle band */
+		std::map<dwl::Vertex, dwl::Cell> obstacle_map_;
+
+		/** @brief Height band of the obstacle map */
+		double obstacle_min_z_, obstacle_max_z_;
+
+		/** @brief Indicates if it was set an obstacle area */
+		bool is_obstacle_area_;
+
+		/** @brief Profile of the last terrain map computation */
+		TerrainMappingProfile profile_;
+
+		/** @brief Octree of the points given to the point-based computation */
+		std::unique_ptr<octomap::OcTree> point_octree_;
+
+		/** @brief Octree of the integrated point clouds, its resolution and
+		 * maximum range of the rays */
+		std::unique_ptr<octomap::OcTree> integrated_octree_;
+		double integration_resolution_, integration_max_range_;
+		octomap::Pointcloud integration_cloud_;
+
+		/** @brief Frustum of the sensor of the frame */
+		SensorFrustum frustum_;
+
+		/** @brief Planned path, and width and horizon of its corridor */
+		std::vector<Eigen::Vector2d> corridor_path_;
+		double corridor_width_, corridor_horizon_;
+
+		/** @brief Columns of the corridor (ordered along the path), their
+		 * bounding box and height band (w.r.t. the robot) */
+		std::vector<dwl::Vertex> corridor_columns_;
+		std::set<dwl::Vertex> corridor_set_;
+		Eigen::Vector2d corridor_min_, corridor_max_;
+		double corridor_min_z_, corridor_max_z_;
+
+		/** @brief Robot position of the last pruning of the integrated octree */
+		Eigen::Vector2d pruning_position_;
+
+		/** @brief Robot state and corridor of the last integration, and
+		 * indicates if there is one */
+		Eigen::Vector4d integration_state_;
+		std::set<dwl::Vertex> integration_corridor_;
+		bool is_integration_state_;
+
+		/** @brief Binners of the point clouds and depth images, and their
+		 * height grid */
+		HeightBinner height_binner_;
+		DepthImageBinner depth_binner_;
+		HeightGrid height_grid_;
+
+		/** @brief Terrain information and cost of the cells of the frame */
+		std::vector<feature::TerrainSample> samples_;
+		std::vector<double> costs_;
+		std::vector<double> feature_costs_;
+
+		/** @brief Cost of each feature of the cells of the map */
+		CostLayers cost_layers_;
+
+		/** @brief Feature pipeline, i.e. fused or virtual */
+		std::unique_ptr<feature::FeaturePipeline> pipeline_;
+
+		/** @brief Indicates if the fused pipeline is allowed */
+		bool is_fused_pipeline_;
+
+		/** @brief Store of the evicted tiles */
+		std::unique_ptr<TileStore> tile_store_;
+
+		/** @brief Number of cells of the side of a tile */
+		unsigned int tile_size_;
+
+		/** @brief Handler of the computed chunks and number of cells of the
+		 * side of a chunk */
+		ChunkHandler chunk_handler_;
+		unsigned int chunk_size_;
+
+		/** @brief Chunks whose cells were removed or paged in since the last
+		 * computed frame */
+		std::set<uint32_t> dirty_chunks_;
+
+		/** @brief Pyramid of the costs and heights of the map, and indicates if
+		 * it's maintained */
+		CostPyramid pyramid_;
+		bool is_pyramid_;
 };
 
 } //@namespace terrain_server
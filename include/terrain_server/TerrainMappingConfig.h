@@ -0,0 +1,113 @@
+#ifndef TERRAIN_SERVER__TERRAIN_MAPPING_CONFIG__H
+#define TERRAIN_SERVER__TERRAIN_MAPPING_CONFIG__H
+
+#include <terrain_server/TerrainMapping.h>
+#include <string>
+#include <vector>
+
+
+namespace terrain_server
+{
+
+/**
+ * @class TerrainMappingConfig
+ * @brief Class for describing the configuration of the terrain mapping,
+ * i.e. search areas, interest region, tiles, obstacle band, binning of
+ * point clouds and depth images, and features. It can be
+ * loaded from a terrain_map.yaml file without a ROS master
+ */
+class TerrainMappingConfig
+{
+	public:
+		/** @brief Constructor function */
+		TerrainMappingConfig();
+
+		/** @brief Destructor function */
+		~TerrainMappingConfig();
+
+		/**
+		 * @brief Loads the configuration from a YAML file
+		 * @param const std::string& Name of the YAML file
+		 * @param const std::string& Namespace of the terrain map
+		 */
+		bool loadFromYaml(const std::string& filename,
+						  const std::string& ns = "terrain_map");
+
+		/**
+		 * @brief Sets up the terrain mapping, i.e. it adds the search areas
+		 * and features
+		 * @param TerrainMapping& Terrain mapping
+		 */
+		void apply(TerrainMapping& mapping) const;
+
+		/** @brief Search areas */
+		std::vector<dwl::SearchArea> search_areas;
+
+		/** @brief Interest region */
+		double interest_radius_x;
+		double interest_radius_y;
+
+		/** @brief Tile store of the tiles outside the interest region */
+		bool enable_tiles;
+		int tile_size;
+		int max_tiles;
+		std::string tile_filename;
+
+		/** @brief Height of the cells of the binned point clouds, i.e. "max"
+		 * or "percentile", and number of threads of the binning */
+		std::string height_binning;
+		double height_percentile;
+		int binning_threads;
+
+		/** @brief Valid depths of the binned depth images, and maximum relative
+		 * depth jump of their normals */
+		double min_depth;
+		double max_depth;
+		double max_depth_jump;
+
+		/** @brief Resolution and maximum range of the octree of the integrated
+		 * point clouds */
+		double octree_resolution;
+		double octree_max_range;
+
+		/** @brief Thresholds of the frames skipped by the server, i.e. robot
+		 * translation and yaw, relative change of the input, and maximum
+		 * period between updates */
+		double update_min_translation;
+		double update_min_yaw;
+		double update_min_change;
+		double update_max_period;
+
+		/** @brief Indicates if the cost pyramid of the region queries is
+		 * maintained */
+		bool enable_pyramid;
+
+		/** @brief Obstacle band */
+		bool enable_obstacle;
+		double obstacle_min_z;
+		double obstacle_max_z;
+
+		/** @brief Slope feature */
+		bool enable_slope;
+		double slope_weight;
+
+		/** @brief Height deviation feature */
+		bool enable_height_deviation;
+		double height_deviation_weight;
+		double flat_height_deviation;
+		double max_height_deviation;
+		double min_allowed_height;
+		double height_deviation_size;
+		double height_deviation_resolution;
+
+		/** @brief Curvature feature */
+		bool enable_curvature;
+		double curvature_weight;
+
+		/** @brief Indicates if the features can be fused in a single pass */
+		bool fused_features;
+};
+
+} //@namespace terrain_server
+
+#endif
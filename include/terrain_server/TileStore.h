@@ -0,0 +1,157 @@
+#ifndef TERRAIN_SERVER__TILE_STORE__H
+#define TERRAIN_SERVER__TILE_STORE__H
+
+#include <terrain_server/TerrainMapSnapshot.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+
+namespace terrain_server
+{
+
+/**
+ * @brief Tile of the terrain map, i.e. the cells of a square of keys. The
+ * costs of the cell i and layer n is costs[n * cells.size() + i], and they
+ * are empty if the tile doesn't have cost layers
+ */
+struct Tile
+{
+	Tile() : id(0) {}
+
+	uint32_t id;
+	std::vector<SnapshotCell> cells;
+	std::vector<double> costs;
+};
+
+
+/**
+ * @class TileStore
+ * @brief Store of the tiles evicted from the terrain map. Every tile has a
+ * fixed-size slot in a memory-mapped file, which is reserved (sparse) when
+ * the store is created, so the memory of the process is bounded by the tiles
+ * that are paged in. The tiles are paged in by a worker thread, i.e. the
+ * disk reads don't block the terrain mapping, which merges the loaded tiles
+ * in the next frame. The store is recreated in every run
+ */
+class TileStore
+{
+	public:
+		/** @brief Constructor function */
+		TileStore();
+
+		/** @brief Destructor function */
+		~TileStore();
+
+		/**
+		 * @brief Creates the store file and starts the worker thread
+		 * @param const std::string& Name of the file
+		 * @param unsigned int Maximum number of cells of a tile
+		 * @param unsigned int Number of cost layers
+		 * @param unsigned int Maximum number of stored tiles
+		 * @return Returns false if the file couldn't be created or mapped
+		 */
+		bool init(const std::string& filename,
+				  unsigned int max_cells,
+				  unsigned int num_layers,
+				  unsigned int max_tiles);
+
+		/**
+		 * @brief Writes a tile in its slot. The cells of a tile that is already
+		 * stored are merged, i.e. the cells of the new tile are kept
+		 * @param const Tile& Tile
+		 * @return Returns false if the store is full or the tile is too big
+		 */
+		bool writeTile(const Tile& tile);
+
+		/**
+		 * @brief Requests the paging in of a tile, i.e. it's read by the
+		 * worker thread and returned by getLoadedTiles
+		 * @param uint32_t Id of the tile
+		 */
+		void requestTile(uint32_t id);
+
+		/**
+		 * @brief Gets the tiles paged in since the last call
+		 * @param std::vector<Tile>& Loaded tiles
+		 */
+		void getLoadedTiles(std::vector<Tile>& tiles);
+
+		/**
+		 * @brief Gets the stored tiles that aren't requested
+		 * @param std::vector<uint32_t>& Ids of the tiles
+		 */
+		void getStoredTiles(std::vector<uint32_t>& ids);
+
+		/** @brief Removes all the tiles */
+		void clear();
+
+		/** @brief Gets the number of stored tiles */
+		unsigned int getNumStoredTiles();
+
+		/** @brief Gets the number of cost layers */
+		unsigned int getNumLayers() const;
+
+
+	private:
+		/** @brief Header of a slot */
+		struct SlotHeader
+		{
+			uint32_t id;
+			uint32_t num_cells;
+			uint32_t num_layers;
+			uint32_t padding;
+		};
+
+		/** @brief Pages in the requested tiles */
+		void run();
+
+		/**
+		 * @brief Reads the tile of a slot (the mutex has to be locked)
+		 * @param Tile& Tile
+		 * @param unsigned int Slot of the tile
+		 */
+		void readSlot(Tile& tile, unsigned int slot) const;
+
+		/** @brief Gets the memory of a slot */
+		char* getSlot(unsigned int slot) const;
+
+		/** @brief Memory of the mapped file */
+		char* data_;
+
+		/** @brief Size of the mapped file and of a slot */
+		size_t size_, slot_size_;
+
+		/** @brief Maximum number of cells of a tile, and number of layers */
+		unsigned int max_cells_, num_layers_;
+
+		/** @brief Slots of the stored tiles */
+		std::map<uint32_t, unsigned int> index_;
+
+		/** @brief Free slots */
+		std::vector<unsigned int> free_slots_;
+
+		/** @brief Requested tiles */
+		std::deque<uint32_t> requests_;
+		std::set<uint32_t> pending_;
+
+		/** @brief Tiles paged in */
+		std::vector<Tile> loaded_;
+
+		/** @brief Worker thread that pages in the tiles */
+		std::thread worker_;
+		std::mutex mutex_;
+		std::condition_variable condition_;
+		bool stop_;
+};
+
+} //@namespace terrain_server
+
+#endif
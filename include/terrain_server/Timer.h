@@ -0,0 +1,20 @@
+#ifndef TERRAIN_SERVER__TIMER__H
+#define TERRAIN_SERVER__TIMER__H
+
+#include <time.h>
+
+
+namespace terrain_server
+{
+
+/** @brief Gets the time (in seconds) of the monotonic clock */
+inline double getMonotonicTime()
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + 1e-9 * time.tv_nsec;
+}
+
+} //@namespace terrain_server
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef TERRAIN_SERVER__TRACE_RECORDER__H
+#define TERRAIN_SERVER__TRACE_RECORDER__H
+
+#include <terrain_server/Timer.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+namespace terrain_server
+{
+
+/**
+ * @brief Event of the trace. The name has to be a string literal (or a
+ * string that lives as long as the recorder), so recording an event
+ * doesn't allocate memory
+ */
+struct TraceEvent
+{
+	TraceEvent() : name(NULL), phase('X'), thread(0), frame(0),
+			start(0.), duration(0.) {}
+
+	const char* name;
+	char phase;
+	uint32_t thread;
+	uint64_t frame;
+	double start;
+	double duration;
+};
+
+
+/**
+ * @class TraceRecorder
+ * @brief Records the events of the stages in a preallocated ring buffer,
+ * and writes them as a Chrome trace (JSON) that can be opened with
+ * chrome://tracing or Perfetto. The writers reserve a slot with an atomic
+ * increment and publish it with a sequence number, so the hot path has no
+ * locks. The oldest events are overwritten once the buffer is full, and
+ * the slots that are being written while dumping are skipped
+ */
+class TraceRecorder
+{
+	public:
+		/** @brief Constructor function */
+		TraceRecorder();
+
+		/** @brief Destructor function */
+		~TraceRecorder();
+
+		/**
+		 * @brief Allocates the ring buffer and enables the recording
+		 * @param unsigned int Capacity, it's rounded up to a power of two
+		 * @param const std::string& Default file of the dumps
+		 */
+		void init(unsigned int capacity,
+				  const std::string& filename = std::string());
+
+		/** @brief Indicates if the recording is enabled */
+		bool isEnabled() const;
+
+		/**
+		 * @brief Records a complete event, i.e. a stage with its duration
+		 * @param const char* Name of the event
+		 * @param double Start time (monotonic clock) in seconds
+		 * @param double Duration in seconds
+		 * @param uint64_t Frame of the event
+		 */
+		void addEvent(const char* name, double start, double duration,
+					  uint64_t frame = 0);
+
+		/**
+		 * @brief Records an instant event, e.g. a sensor arrival
+		 * @param const char* Name of the event
+		 * @param uint64_t Frame of the event
+		 */
+		void addInstant(const char* name, uint64_t frame = 0);
+
+		/**
+		 * @brief Writes the recorded events as a Chrome trace
+		 * @param const std::string& Name of the file
+		 * @return Number of written events, or -1 if the file can't be opened
+		 */
+		int dump(const std::string& filename) const;
+
+		/**
+		 * @brief Handles a dump request, i.e. it writes the recorded events
+		 * in the requested file (or the default one) and fills the response
+		 * @param const Request& Request with the name of the file
+		 * @param Response& Response with the file, success and number of
+		 * written events
+		 */
+		template<typename Request, typename Response>
+		bool handleDump(const Request& req, Response& res) const
+		{
+			res.filename = req.filename.empty() ? filename_ : req.filename;
+			int num_events = dump(res.filename);
+			res.success = num_events >= 0;
+			res.num_events = res.success ? num_events : 0;
+
+			return true;
+		}
+
+		/** @brief Gets the identifier of the calling thread */
+		static uint32_t getThreadId();
+
+
+	private:
+		/** @brief Writes an event in the next slot of the ring buffer */
+		void write(const TraceEvent& event);
+
+		/** @brief Ring buffer of events */
+		std::vector<TraceEvent> events_;
+
+		/** @brief Sequence number of every slot, i.e. the index of its last
+		 * event plus one, or zero while it's written */
+		std::vector<std::atomic<uint64_t> > sequences_;
+
+		/** @brief Index of the next event */
+		std::atomic<uint64_t> next_;
+
+		/** @brief Mask of the slot indexes (capacity - 1) */
+		uint64_t mask_;
+
+		/** @brief Indicates if the recording is enabled */
+		bool enabled_;
+
+		/** @brief Default file of the dumps */
+		std::string filename_;
+};
+
+
+/**
+ * @class ScopedTrace
+ * @brief Records a complete event between its construction and destruction
+ */
+class ScopedTrace
+{
+	public:
+		/** @brief Constructor function */
+		ScopedTrace(TraceRecorder& recorder, const char* name, uint64_t frame = 0) :
+				recorder_(recorder), name_(name), frame_(frame),
+				start_time_(recorder.isEnabled() ? getMonotonicTime() : 0.) {}
+
+		/** @brief Destructor function */
+		~ScopedTrace()
+		{
+			if (recorder_.isEnabled())
+				recorder_.addEvent(name_, start_time_,
+								   getMonotonicTime() - start_time_, frame_);
+		}
+
+
+	private:
+		/** @brief Recorder of the event */
+		TraceRecorder& recorder_;
+
+		/** @brief Name and frame of the event */
+		const char* name_;
+		uint64_t frame_;
+
+		/** @brief Start time of the scope */
+		double start_time_;
+};
+
+} //@namespace terrain_server
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef TERRAIN_SERVER__UPDATE_SCHEDULER__H
+#define TERRAIN_SERVER__UPDATE_SCHEDULER__H
+
+#include <Eigen/Dense>
+
+#include <atomic>
+
+
+namespace terrain_server
+{
+
+/**
+ * @class UpdateScheduler
+ * @brief Decides if a frame updates the terrain map given the motion of the
+ * robot since the last update. A frame is skipped if the translation and
+ * yaw changes of the robot are below their thresholds and the input doesn't
+ * report a significant change, i.e. the relative change of its signature
+ * (e.g. a hash of the octomap or the mean depth of the image) is below
+ * its threshold. The map is still updated at a minimum rate, so the frames
+ * are thinned out when the robot stands still, and they aren't skipped
+ * under motion. The thresholds are zero by default, i.e. no frame is skipped
+ */
+class UpdateScheduler
+{
+	public:
+		/** @brief Constructor function */
+		UpdateScheduler();
+
+		/** @brief Destructor function */
+		~UpdateScheduler();
+
+		/**
+		 * @brief Sets the thresholds of the skipped frames
+		 * @param double Minimum translation of the robot (in metres)
+		 * @param double Minimum yaw change of the robot (in radians)
+		 * @param double Minimum relative change of the input signature
+		 * @param double Maximum period between updates (in seconds), a
+		 * non-positive value doesn't limit it
+		 */
+		void setThresholds(double min_translation,
+						   double min_yaw,
+						   double min_change,
+						   double max_period);
+
+		/**
+		 * @brief Indicates if a frame updates the map. If it does, the frame
+		 * becomes the reference of the next decisions
+		 * @param const Eigen::Vector4d& The position of the robot and the yaw angle
+		 * @param double Signature of the input
+		 * @param double Time of the frame (in seconds)
+		 */
+		bool isUpdateRequired(const Eigen::Vector4d& robot_state,
+							  double signature,
+							  double time);
+
+		/** @brief Forces the update of the next frame (e.g. after a reset).
+		 * It can be called from any thread */
+		void reset();
+
+
+	private:
+		/** @brief Thresholds of the skipped frames */
+		double min_translation_, min_yaw_, min_change_, max_period_;
+
+		/** @brief Robot state, input signature and time of the last update */
+		Eigen::Vector4d last_state_;
+		double last_signature_;
+		double last_time_;
+
+		/** @brief Indicates if the next frame has to update the map */
+		std::atomic<bool> is_forced_;
+};
+
+} //@namespace terrain_server
+
+#endif
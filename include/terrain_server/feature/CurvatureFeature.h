@@ -2,6 +2,7 @@
 #define TERRAIN_SERVER__FEATURE__CURVATURE_FEATURE__H
 
 #include <dwl/environment/Feature.h>
+#include <terrain_server/feature/FeatureKernels.h>
 
 
 namespace terrain_server
@@ -31,12 +32,12 @@ class CurvatureFeature : public dwl::environment::Feature
 		void computeCost(double& cost_value,
 						 const dwl::Terrain& terrain_info);
 
-	private:
-		/** @brief Threshold that specify the positive condition */
-		double positive_threshold_;
+		/** @brief Gets the cost kernel with the parameters and weight */
+		CurvatureKernel getKernel();
 
-		/** @brief Threshold that indicates a very (bad) condition */
-		double negative_threshold_;
+	private:
+		/** @brief Cost kernel, i.e. positive and negative thresholds */
+		CurvatureKernel kernel_;
 };
 
 } //@namespace feature
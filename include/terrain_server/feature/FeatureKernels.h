@@ -0,0 +1,112 @@
+#ifndef TERRAIN_SERVER__FEATURE__FEATURE_KERNELS__H
+#define TERRAIN_SERVER__FEATURE__FEATURE_KERNELS__H
+
+#include <dwl/environment/SpaceDiscretization.h>
+#include <dwl/utils/EnvironmentRepresentation.h>
+
+#include <math.h>
+#include <limits>
+
+
+namespace terrain_server
+{
+
+namespace feature
+{
+
+/**
+ * @brief Cost kernels of the features. They contain the parameters of a
+ * feature and compute its cost without virtual calls, so they can be
+ * inlined in the fused feature pipeline. The virtual features compute
+ * their cost with the same kernels. The prepare function is called once
+ * per frame, before computing the costs of the cells
+ */
+struct SlopeKernel
+{
+	SlopeKernel() : flat_threshold(1.0 * (M_PI / 180.0)),
+			steep_threshold(70.0 * (M_PI / 180.0)), max_cost(0.), weight(1.) {}
+
+	void prepare(const dwl::Terrain& terrain_info) {}
+
+	inline double computeCost(const dwl::Terrain& terrain_info) const
+	{
+		double slope = fabs(acos((double) terrain_info.surface_normal(2)));
+
+		if (slope < flat_threshold)
+			return 0.;
+		else if (slope < steep_threshold) {
+			double cost_value =
+					-log(1 - (slope - flat_threshold) / (steep_threshold - flat_threshold));
+			if (max_cost < cost_value)
+				cost_value = max_cost;
+			return cost_value;
+		} else
+			return max_cost;
+	}
+
+	double flat_threshold;
+	double steep_threshold;
+	double max_cost;
+	double weight;
+};
+
+
+struct CurvatureKernel
+{
+	CurvatureKernel() : positive_threshold(6.0), negative_threshold(-6.0),
+			max_cost(0.), weight(1.) {}
+
+	void prepare(const dwl::Terrain& terrain_info) {}
+
+	inline double computeCost(const dwl::Terrain& terrain_info) const
+	{
+		double curvature = terrain_info.curvature;
+
+		// The worse condition
+		if (curvature * 10000 > 9)
+			return max_cost;
+
+		if (curvature > positive_threshold)
+			return 0.;
+		else if (curvature < negative_threshold)
+			return max_cost;
+		else
+			return max_cost - log((curvature - negative_threshold)
+								  / (positive_threshold - negative_threshold));
+	}
+
+	double positive_threshold;
+	double negative_threshold;
+	double max_cost;
+	double weight;
+};
+
+
+class HeightDeviationKernel
+{
+	public:
+		HeightDeviationKernel();
+
+		/** @brief Sets the resolution of the height map of the frame */
+		void prepare(const dwl::Terrain& terrain_info);
+
+		/** @brief Computes the cost given the height map of the neighboring area */
+		double computeCost(const dwl::Terrain& terrain_info);
+
+		double flat_height_deviation;
+		double max_height_deviation;
+		double min_allowed_height;
+		double min_x, max_x, min_y, max_y, resolution;
+		double max_cost;
+		double weight;
+
+
+	private:
+		/** @brief Conversion routines of the height map */
+		dwl::environment::SpaceDiscretization space_discretization_;
+};
+
+} //@namespace feature
+} //@namespace terrain_server
+
+#endif
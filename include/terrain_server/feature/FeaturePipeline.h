@@ -0,0 +1,191 @@
+#ifndef TERRAIN_SERVER__FEATURE__FEATURE_PIPELINE__H
+#define TERRAIN_SERVER__FEATURE__FEATURE_PIPELINE__H
+
+#include <dwl/environment/Feature.h>
+#include <dwl/utils/EnvironmentRepresentation.h>
+#include <terrain_server/feature/FeatureKernels.h>
+
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+
+namespace terrain_server
+{
+
+namespace feature
+{
+
+/** @brief Terrain information of a cell, i.e. the result of the plane fitting */
+struct TerrainSample
+{
+	Eigen::Vector3d position;
+	Eigen::Vector3d surface_normal;
+	double curvature;
+	double height;
+};
+
+
+/**
+ * @class FeaturePipeline
+ * @brief Abstract class for computing the feature costs and their weighted
+ * sum of a set of cells, i.e. there is one virtual call per frame instead of
+ * one per cell and feature
+ */
+class FeaturePipeline
+{
+	public:
+		/** @brief Destructor function */
+		virtual ~FeaturePipeline() {}
+
+		/**
+		 * @brief Computes the cost of each feature and the total cost of the cells
+		 * @param std::vector<double>& Total cost of the cells
+		 * @param std::vector<double>& Cost of the features (without weight) of
+		 * the cells, i.e. the cost of the feature n of the cell i is
+		 * feature_costs[i * num_features + n]
+		 * @param const std::vector<TerrainSample>& Terrain information of the cells
+		 * @param dwl::Terrain& Terrain information of the frame, i.e. height
+		 * map, resolution and minimum height. The cell information is overwritten
+		 * @param std::vector<double>* Durations of the features (it's only
+		 * filled if the features are computed separately)
+		 */
+		virtual void computeCosts(std::vector<double>& costs,
+								  std::vector<double>& feature_costs,
+								  const std::vector<TerrainSample>& samples,
+								  dwl::Terrain& terrain_info,
+								  std::vector<double>* feature_times) = 0;
+
+		/** @brief Indicates if the features are fused in a single pass */
+		virtual bool isFused() const = 0;
+};
+
+
+/**
+ * @class FusedFeaturePipeline
+ * @brief Computes the features with their kernels in a single pass over the
+ * cells. The kernels are statically dispatched, so they are inlined in the
+ * loop, and the per-frame setup (e.g. resolution of the height map) is done
+ * once. The weighted sum is accumulated in the order of the kernels, i.e.
+ * as the virtual features
+ */
+template<typename... Kernels>
+class FusedFeaturePipeline : public FeaturePipeline
+{
+	public:
+		/** @brief Constructor function */
+		FusedFeaturePipeline(const Kernels&... kernels) : kernels_(kernels...) {}
+
+		/** @brief Destructor function */
+		~FusedFeaturePipeline() {}
+
+		void computeCosts(std::vector<double>& costs,
+						  std::vector<double>& feature_costs,
+						  const std::vector<TerrainSample>& samples,
+						  dwl::Terrain& terrain_info,
+						  std::vector<double>* feature_times)
+		{
+			prepare<0>(terrain_info);
+
+			unsigned int num_samples = samples.size();
+			unsigned int num_features = sizeof...(Kernels);
+			costs.resize(num_samples);
+			feature_costs.resize(num_samples * num_features);
+			for (unsigned int i = 0; i < num_samples; i++) {
+				const TerrainSample& sample = samples[i];
+				terrain_info.position = sample.position;
+				terrain_info.surface_normal = sample.surface_normal;
+				terrain_info.curvature = sample.curvature;
+
+				double total_cost = 0;
+				accumulate<0>(total_cost, &feature_costs[i * num_features], terrain_info);
+				costs[i] = total_cost;
+			}
+		}
+
+		bool isFused() const
+		{
+			return true;
+		}
+
+
+	private:
+		template<unsigned int I>
+		typename std::enable_if<(I < sizeof...(Kernels))>::type
+		prepare(const dwl::Terrain& terrain_info)
+		{
+			std::get<I>(kernels_).prepare(terrain_info);
+			prepare<I + 1>(terrain_info);
+		}
+
+		template<unsigned int I>
+		typename std::enable_if<(I == sizeof...(Kernels))>::type
+		prepare(const dwl::Terrain& terrain_info) {}
+
+		template<unsigned int I>
+		inline typename std::enable_if<(I < sizeof...(Kernels))>::type
+		accumulate(double& total_cost, double* feature_costs,
+				   const dwl::Terrain& terrain_info)
+		{
+			double cost = std::get<I>(kernels_).computeCost(terrain_info);
+			feature_costs[I] = cost;
+			total_cost += std::get<I>(kernels_).weight * cost;
+			accumulate<I + 1>(total_cost, feature_costs, terrain_info);
+		}
+
+		template<unsigned int I>
+		inline typename std::enable_if<(I == sizeof...(Kernels))>::type
+		accumulate(double& total_cost, double* feature_costs,
+				   const dwl::Terrain& terrain_info) {}
+
+		/** @brief Kernels of the features */
+		std::tuple<Kernels...> kernels_;
+};
+
+
+/**
+ * @class VirtualFeaturePipeline
+ * @brief Computes the features through their virtual interface, i.e. it
+ * supports custom features. Every feature is computed over all the cells
+ * before the next one, so their durations are measured per frame
+ */
+class VirtualFeaturePipeline : public FeaturePipeline
+{
+	public:
+		/** @brief Constructor function */
+		VirtualFeaturePipeline(const std::vector<dwl::environment::Feature*>& features);
+
+		/** @brief Destructor function */
+		~VirtualFeaturePipeline();
+
+		void computeCosts(std::vector<double>& costs,
+						  std::vector<double>& feature_costs,
+						  const std::vector<TerrainSample>& samples,
+						  dwl::Terrain& terrain_info,
+						  std::vector<double>* feature_times);
+
+		bool isFused() const;
+
+
+	private:
+		/** @brief Features (they aren't owned by the pipeline) */
+		std::vector<dwl::environment::Feature*> features_;
+};
+
+
+/**
+ * @brief Creates the feature pipeline of a set of features. The common
+ * combinations of the built-in features (height deviation; slope and
+ * height deviation; slope, height deviation and curvature) are fused,
+ * otherwise the virtual pipeline is used
+ * @param const std::vector<dwl::environment::Feature*>& Features
+ * @param bool Indicates if the fused pipelines are allowed
+ * @return Feature pipeline (owned by the caller)
+ */
+FeaturePipeline* createFeaturePipeline(const std::vector<dwl::environment::Feature*>& features,
+									   bool allow_fused = true);
+
+} //@namespace feature
+} //@namespace terrain_server
+
+#endif
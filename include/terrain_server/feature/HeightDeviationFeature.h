@@ -2,6 +2,7 @@
 #define TERRAIN_SERVER__FEATURE__HEIGHT_DEVIATION_FEATURE__H
 
 #include <dwl/environment/Feature.h>
+#include <terrain_server/feature/FeatureKernels.h>
 
 
 namespace terrain_server
@@ -32,16 +33,17 @@ class HeightDeviationFeature : public dwl::environment::Feature
 		void computeCost(double& cost_value,
 						 const dwl::Terrain& terrain_info);
 
+		/** @brief Gets the cost kernel with the parameters and weight */
+		HeightDeviationKernel getKernel();
 
-	private:
-		/** @brief Flat height deviation */
-		double flat_height_deviation_;
 
-		/** @brief Maximum height deviation */
-		double max_height_deviation_;
+	private:
+		/** @brief Sets the neighboring area and maximum cost of the kernel */
+		void updateKernel();
 
-		/** @brief Minimum allowed height */
-		double min_allowed_height_;
+		/** @brief Cost kernel, i.e. flat and maximum height deviation, and
+		 * minimum allowed height */
+		HeightDeviationKernel kernel_;
 };
 
 } //@namespace feature
@@ -2,6 +2,7 @@
 #define TERRAIN_SERVER__FEATURE__SLOPE_FEATURE__H
 
 #include <dwl/environment/Feature.h>
+#include <terrain_server/feature/FeatureKernels.h>
 
 
 namespace terrain_server
@@ -31,12 +32,12 @@ class SlopeFeature : public dwl::environment::Feature
 		void computeCost(double& cost_value,
 						 const dwl::Terrain& terrain_info);
 
-	private:
-		/** @brief Threshold that specify the flat condition */
-		double flat_threshold_;
+		/** @brief Gets the cost kernel with the parameters and weight */
+		SlopeKernel getKernel();
 
-		/** @brief Threshold that indicates a very (bad) steep condition */
-		double steep_threshold_;
+	private:
+		/** @brief Cost kernel, i.e. flat and steep thresholds */
+		SlopeKernel kernel_;
 };
 
 
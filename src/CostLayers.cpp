@@ -0,0 +1,137 @@
+#include <terrain_server/CostLayers.h>
+#include <algorithm>
+
+
+namespace terrain_server
+{
+
+CostLayers::CostLayers()
+{
+
+}
+
+
+CostLayers::~CostLayers()
+{
+
+}
+
+
+void CostLayers::reset(unsigned int num_layers)
+{
+	clear();
+	layers_.assign(num_layers, std::vector<double>());
+}
+
+
+void CostLayers::clear()
+{
+	slots_.clear();
+	free_slots_.clear();
+	for (unsigned int n = 0; n < layers_.size(); n++)
+		layers_[n].clear();
+	total_costs_.clear();
+}
+
+
+void CostLayers::setCosts(dwl::Vertex vertex, const double* costs)
+{
+	unsigned int slot;
+	std::map<dwl::Vertex, unsigned int>::iterator slot_it = slots_.find(vertex);
+	if (slot_it != slots_.end())
+		slot = slot_it->second;
+	else {
+		// Reusing the slot of a removed cell, otherwise the layers grow
+		if (!free_slots_.empty()) {
+			slot = free_slots_.back();
+			free_slots_.pop_back();
+		} else {
+			slot = total_costs_.size();
+			total_costs_.push_back(0.);
+			for (unsigned int n = 0; n < layers_.size(); n++)
+				layers_[n].push_back(0.);
+		}
+		slots_[vertex] = slot;
+	}
+
+	for (unsigned int n = 0; n < layers_.size(); n++)
+		layers_[n][slot] = costs[n];
+}
+
+
+void CostLayers::removeCell(dwl::Vertex vertex)
+{
+	std::map<dwl::Vertex, unsigned int>::iterator slot_it = slots_.find(vertex);
+	if (slot_it != slots_.end()) {
+		free_slots_.push_back(slot_it->second);
+		slots_.erase(slot_it);
+	}
+}
+
+
+bool CostLayers::getCosts(std::vector<double>& costs, dwl::Vertex vertex) const
+{
+	std::map<dwl::Vertex, unsigned int>::const_iterator slot_it = slots_.find(vertex);
+	if (slot_it == slots_.end())
+		return false;
+
+	costs.resize(layers_.size());
+	for (unsigned int n = 0; n < layers_.size(); n++)
+		costs[n] = layers_[n][slot_it->second];
+
+	return true;
+}
+
+
+bool CostLayers::computeTotalCosts(const std::vector<double>& weights)
+{
+	if (weights.size() != layers_.size())
+		return false;
+
+	// Summing layer by layer over contiguous arrays, so the inner loop is
+	// vectorized. The free slots are also summed, it's cheaper than skipping
+	// them
+	unsigned int num_slots = total_costs_.size();
+	std::fill(total_costs_.begin(), total_costs_.end(), 0.);
+	double* total_costs = total_costs_.data();
+	for (unsigned int n = 0; n < layers_.size(); n++) {
+		const double weight = weights[n];
+		const double* layer = layers_[n].data();
+		for (unsigned int s = 0; s < num_slots; s++)
+			total_costs[s] += weight * layer[s];
+	}
+
+	return true;
+}
+
+
+double CostLayers::getTotalCost(unsigned int slot) const
+{
+	return total_costs_[slot];
+}
+
+
+double CostLayers::getCost(unsigned int layer, unsigned int slot) const
+{
+	return layers_[layer][slot];
+}
+
+
+const std::map<dwl::Vertex, unsigned int>& CostLayers::getSlots() const
+{
+	return slots_;
+}
+
+
+unsigned int CostLayers::getNumLayers() const
+{
+	return layers_.size();
+}
+
+
+unsigned int CostLayers::size() const
+{
+	return slots_.size();
+}
+
+} //@namespace terrain_server
@@ -0,0 +1,368 @@
+#include <terrain_server/CostPyramid.h>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+
+namespace terrain_server
+{
+
+/** @brief Number of levels, i.e. the top level has a single node */
+static const unsigned int NUM_LEVELS = 17;
+
+
+CostPyramid::CostPyramid() : levels_(NUM_LEVELS)
+{
+
+}
+
+
+CostPyramid::~CostPyramid()
+{
+
+}
+
+
+void CostPyramid::setResolution(double resolution)
+{
+	space_discretization_.setEnvironmentResolution(resolution, true);
+}
+
+
+void CostPyramid::setCell(const dwl::TerrainCell& cell)
+{
+	Node& node = levels_[0][getNodeId(cell.key.x, cell.key.y, 0)];
+	node.min_cost = node.max_cost = cell.cost;
+	node.min_height = node.max_height = cell.height;
+	updateParents(cell.key);
+}
+
+
+void CostPyramid::removeCell(const dwl::Key& key)
+{
+	if (levels_[0].erase(getNodeId(key.x, key.y, 0)) > 0)
+		updateParents(key);
+}
+
+
+void CostPyramid::build(const std::vector<dwl::TerrainCell>& cells)
+{
+	clear();
+	for (unsigned int i = 0; i < cells.size(); i++) {
+		Node& node = levels_[0][getNodeId(cells[i].key.x, cells[i].key.y, 0)];
+		node.min_cost = node.max_cost = cells[i].cost;
+		node.min_height = node.max_height = cells[i].height;
+	}
+
+	// Merging the nodes of a level into their parents
+	for (unsigned int level = 1; level < NUM_LEVELS; level++) {
+		NodeMap& parents = levels_[level];
+		const NodeMap& children = levels_[level - 1];
+		parents.reserve(children.size() / 2);
+		for (NodeMap::const_iterator child_it = children.begin();
+				child_it != children.end(); child_it++) {
+			uint32_t id = getNodeId(child_it->first >> 16, child_it->first & 0xFFFF, 1);
+			NodeMap::iterator parent_it = parents.find(id);
+			if (parent_it == parents.end())
+				parents.insert(std::make_pair(id, child_it->second));
+			else
+				mergeNode(parent_it->second, child_it->second);
+		}
+	}
+}
+
+
+void CostPyramid::clear()
+{
+	for (unsigned int level = 0; level < NUM_LEVELS; level++)
+		levels_[level].clear();
+}
+
+
+bool CostPyramid::getMinCost(double& cost,
+							 Eigen::Vector2d& position,
+							 const Eigen::Vector2d& min,
+							 const Eigen::Vector2d& max) const
+{
+	Region region;
+	if (!getBoxRegion(region, min, max))
+		return false;
+
+	cost = std::numeric_limits<double>::max();
+	uint32_t id = 0;
+	searchMinCost(cost, id, region, NUM_LEVELS - 1, 0);
+	if (cost == std::numeric_limits<double>::max())
+		return false;
+
+	getPosition(position, id);
+	return true;
+}
+
+
+bool CostPyramid::getMinCostInDisc(double& cost,
+								   Eigen::Vector2d& position,
+								   const Eigen::Vector2d& centre,
+								   double radius) const
+{
+	// Getting the centre of the disc in key units, i.e. with the offset
+	// inside its cell
+	unsigned short key_x, key_y;
+	if (!space_discretization_.coordToKey(key_x, centre(0), true) ||
+			!space_discretization_.coordToKey(key_y, centre(1), true))
+		return false;
+
+	Eigen::Vector2d cell_centre;
+	space_discretization_.keyToCoord(cell_centre(0), key_x, true);
+	space_discretization_.keyToCoord(cell_centre(1), key_y, true);
+	double resolution = space_discretization_.getEnvironmentResolution(true);
+
+	Region region;
+	region.is_disc = true;
+	region.centre_x = key_x + (centre(0) - cell_centre(0)) / resolution;
+	region.centre_y = key_y + (centre(1) - cell_centre(1)) / resolution;
+	region.radius = radius / resolution;
+
+	cost = std::numeric_limits<double>::max();
+	uint32_t id = 0;
+	searchMinCost(cost, id, region, NUM_LEVELS - 1, 0);
+	if (cost == std::numeric_limits<double>::max())
+		return false;
+
+	getPosition(position, id);
+	return true;
+}
+
+
+bool CostPyramid::getMaxCost(double& cost,
+							 const Eigen::Vector2d& min,
+							 const Eigen::Vector2d& max) const
+{
+	Region region;
+	if (!getBoxRegion(region, min, max))
+		return false;
+
+	cost = -std::numeric_limits<double>::max();
+	searchMaxCost(cost, region, NUM_LEVELS - 1, 0);
+
+	return cost != -std::numeric_limits<double>::max();
+}
+
+
+bool CostPyramid::getHeightRange(double& min_height,
+								 double& max_height,
+								 const Eigen::Vector2d& min,
+								 const Eigen::Vector2d& max) const
+{
+	Region region;
+	if (!getBoxRegion(region, min, max))
+		return false;
+
+	min_height = std::numeric_limits<double>::max();
+	max_height = -std::numeric_limits<double>::max();
+	searchHeightRange(min_height, max_height, region, NUM_LEVELS - 1, 0);
+
+	return min_height <= max_height;
+}
+
+
+unsigned int CostPyramid::size() const
+{
+	return levels_[0].size();
+}
+
+
+bool CostPyramid::Region::overlaps(unsigned int level, uint32_t id) const
+{
+	double node_min_x = (id >> 16) << level;
+	double node_min_y = (id & 0xFFFF) << level;
+	double node_max_x = node_min_x + (1 << level) - 1;
+	double node_max_y = node_min_y + (1 << level) - 1;
+	if (!is_disc)
+		return node_max_x >= min_x && node_min_x <= max_x &&
+				node_max_y >= min_y && node_min_y <= max_y;
+
+	// Distance from the centre to the closest point of the node
+	double dx = std::max(0., std::max(node_min_x - centre_x, centre_x - node_max_x));
+	double dy = std::max(0., std::max(node_min_y - centre_y, centre_y - node_max_y));
+	return dx * dx + dy * dy <= radius * radius;
+}
+
+
+bool CostPyramid::Region::contains(unsigned int level, uint32_t id) const
+{
+	double node_min_x = (id >> 16) << level;
+	double node_min_y = (id & 0xFFFF) << level;
+	double node_max_x = node_min_x + (1 << level) - 1;
+	double node_max_y = node_min_y + (1 << level) - 1;
+	if (!is_disc)
+		return node_min_x >= min_x && node_max_x <= max_x &&
+				node_min_y >= min_y && node_max_y <= max_y;
+
+	// Distance from the centre to the farthest corner of the node
+	double dx = std::max(fabs(node_min_x - centre_x), fabs(node_max_x - centre_x));
+	double dy = std::max(fabs(node_min_y - centre_y), fabs(node_max_y - centre_y));
+	return dx * dx + dy * dy <= radius * radius;
+}
+
+
+uint32_t CostPyramid::getNodeId(unsigned int key_x, unsigned int key_y,
+								unsigned int level)
+{
+	return ((uint32_t) (key_x >> level) << 16) | (uint32_t) (key_y >> level);
+}
+
+
+void CostPyramid::mergeNode(Node& node, const Node& child)
+{
+	node.min_cost = std::min(node.min_cost, child.min_cost);
+	node.max_cost = std::max(node.max_cost, child.max_cost);
+	node.min_height = std::min(node.min_height, child.min_height);
+	node.max_height = std::max(node.max_height, child.max_height);
+}
+
+
+void CostPyramid::updateParents(const dwl::Key& key)
+{
+	for (unsigned int level = 1; level < NUM_LEVELS; level++) {
+		// Merging the four children of the node
+		uint32_t x = (key.x >> level) << 1;
+		uint32_t y = (key.y >> level) << 1;
+		const NodeMap& children = levels_[level - 1];
+		Node node;
+		bool is_node = false;
+		for (uint32_t dx = 0; dx < 2; dx++) {
+			for (uint32_t dy = 0; dy < 2; dy++) {
+				NodeMap::const_iterator child_it = children.find(((x + dx) << 16) | (y + dy));
+				if (child_it == children.end())
+					continue;
+
+				if (!is_node) {
+					node = child_it->second;
+					is_node = true;
+				} else
+					mergeNode(node, child_it->second);
+			}
+		}
+
+		uint32_t id = getNodeId(key.x, key.y, level);
+		if (is_node)
+			levels_[level][id] = node;
+		else
+			levels_[level].erase(id);
+	}
+}
+
+
+bool CostPyramid::getBoxRegion(Region& region,
+							   const Eigen::Vector2d& min,
+							   const Eigen::Vector2d& max) const
+{
+	unsigned short min_x, min_y, max_x, max_y;
+	if (!space_discretization_.coordToKey(min_x, min(0), true) ||
+			!space_discretization_.coordToKey(min_y, min(1), true) ||
+			!space_discretization_.coordToKey(max_x, max(0), true) ||
+			!space_discretization_.coordToKey(max_y, max(1), true))
+		return false;
+
+	region.is_disc = false;
+	region.min_x = min_x;
+	region.min_y = min_y;
+	region.max_x = max_x;
+	region.max_y = max_y;
+	return true;
+}
+
+
+void CostPyramid::searchMinCost(double& cost, uint32_t& id, const Region& region,
+								unsigned int level, uint32_t node_id) const
+{
+	// Pruning the nodes that can't improve the cost
+	NodeMap::const_iterator node_it = levels_[level].find(node_id);
+	if (node_it == levels_[level].end() || node_it->second.min_cost >= cost ||
+			!region.overlaps(level, node_id))
+		return;
+
+	if (level == 0) {
+		cost = node_it->second.min_cost;
+		id = node_id;
+		return;
+	}
+
+	// Visiting the children with the lowest cost first
+	std::pair<double, uint32_t> children[4];
+	unsigned int num_children = 0;
+	uint32_t x = (node_id >> 16) << 1;
+	uint32_t y = (node_id & 0xFFFF) << 1;
+	for (uint32_t dx = 0; dx < 2; dx++) {
+		for (uint32_t dy = 0; dy < 2; dy++) {
+			uint32_t child_id = ((x + dx) << 16) | (y + dy);
+			NodeMap::const_iterator child_it = levels_[level - 1].find(child_id);
+			if (child_it != levels_[level - 1].end())
+				children[num_children++] = std::make_pair(child_it->second.min_cost, child_id);
+		}
+	}
+	std::sort(children, children + num_children);
+	for (unsigned int c = 0; c < num_children; c++)
+		searchMinCost(cost, id, region, level - 1, children[c].second);
+}
+
+
+void CostPyramid::searchMaxCost(double& cost, const Region& region,
+								unsigned int level, uint32_t node_id) const
+{
+	NodeMap::const_iterator node_it = levels_[level].find(node_id);
+	if (node_it == levels_[level].end() || node_it->second.max_cost <= cost ||
+			!region.overlaps(level, node_id))
+		return;
+
+	// The bound of a node inside the region is the one of its cells
+	if (level == 0 || region.contains(level, node_id)) {
+		cost = node_it->second.max_cost;
+		return;
+	}
+
+	uint32_t x = (node_id >> 16) << 1;
+	uint32_t y = (node_id & 0xFFFF) << 1;
+	for (uint32_t dx = 0; dx < 2; dx++) {
+		for (uint32_t dy = 0; dy < 2; dy++)
+			searchMaxCost(cost, region, level - 1, ((x + dx) << 16) | (y + dy));
+	}
+}
+
+
+void CostPyramid::searchHeightRange(double& min_height, double& max_height,
+									const Region& region,
+									unsigned int level, uint32_t node_id) const
+{
+	NodeMap::const_iterator node_it = levels_[level].find(node_id);
+	if (node_it == levels_[level].end() ||
+			(node_it->second.min_height >= min_height &&
+					node_it->second.max_height <= max_height) ||
+			!region.overlaps(level, node_id))
+		return;
+
+	// The bounds of a node inside the region are the ones of its cells
+	if (level == 0 || region.contains(level, node_id)) {
+		min_height = std::min(min_height, node_it->second.min_height);
+		max_height = std::max(max_height, node_it->second.max_height);
+		return;
+	}
+
+	uint32_t x = (node_id >> 16) << 1;
+	uint32_t y = (node_id & 0xFFFF) << 1;
+	for (uint32_t dx = 0; dx < 2; dx++) {
+		for (uint32_t dy = 0; dy < 2; dy++)
+			searchHeightRange(min_height, max_height, region, level - 1,
+							  ((x + dx) << 16) | (y + dy));
+	}
+}
+
+
+void CostPyramid::getPosition(Eigen::Vector2d& position, uint32_t id) const
+{
+	space_discretization_.keyToCoord(position(0), id >> 16, true);
+	space_discretization_.keyToCoord(position(1), id & 0xFFFF, true);
+}
+
+} //@namespace terrain_server
@@ -43,6 +43,14 @@ DefaultFlatTerrain::DefaultFlatTerrain(ros::NodeHandle node) : node_(node),
 					rectangles_[k].resolution,
 					rectangles_[k].resolution);
 	}
+
+	// Building the scene once, since it doesn't change
+	node_.param("world_frame", world_frame_, world_frame_);
+	scene_.setPosition(position_);
+	for (int k = 0; k < n_rectangles_; k++)
+		scene_.addRectangle(rectangles_[k]);
+	readPrimitives();
+	buildCloud();
 }
 
 
@@ -54,34 +62,87 @@ DefaultFlatTerrain::~DefaultFlatTerrain()
 
 void DefaultFlatTerrain::setFlatTerrain()
 {
-	PointCloud pcl_msg;
-	pcl_msg.header.frame_id = world_frame_;
+	cloud_msg_.header.stamp = ros::Time::now();
+	flat_terrain_pub_.publish(cloud_msg_);
+}
 
-	for (int k = 0; k < n_rectangles_; k++) {
-		for (double xi = 0; xi < rectangles_[k].length / 2;
-				xi += rectangles_[k].resolution) {
-			for (int sx = -1; sx <= 1; sx += 2) {
-				for (double yi = 0; yi < rectangles_[k].width / 2;
-						yi += rectangles_[k].resolution) {
-					for (int sy = -1; sy <= 1; sy += 2) {
-						double x = sx * xi * cos(rectangles_[k].yaw) -
-								sy * yi * sin(rectangles_[k].yaw) +
-								rectangles_[k].center_x + position_(dwl::rbd::X);
-						double y = sx * xi * sin(rectangles_[k].yaw) +
-								sy * yi * cos(rectangles_[k].yaw) +
-								rectangles_[k].center_y + position_(dwl::rbd::Y);
-
-						pcl_msg.push_back(pcl::PointXYZ(x, y, rectangles_[k].height + position_(dwl::rbd::Z)));
-					}
-				}
-			}
-		}
+
+void DefaultFlatTerrain::readPrimitives()
+{
+	XmlRpc::XmlRpcValue primitive_names;
+	if (!node_.getParam("primitives", primitive_names))
+		return;
+
+	if (primitive_names.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+		ROS_ERROR("Malformed primitives specification.");
+		return;
 	}
 
-	sensor_msgs::PointCloud2 cloud;
-	pcl::toROSMsg(pcl_msg, cloud);
+	for (int i = 0; i < primitive_names.size(); i++) {
+		std::string ns_name = (std::string) primitive_names[i];
+		std::string type;
+		double x, y, yaw, resolution, height, width, length;
+		int seed;
+		node_.param(ns_name + "/type", type, std::string(""));
+		node_.param(ns_name + "/center_x", x, 0.);
+		node_.param(ns_name + "/center_y", y, 0.);
+		node_.param(ns_name + "/yaw", yaw, 0.);
+		node_.param(ns_name + "/resolution", resolution, 0.01);
+		node_.param(ns_name + "/height", height, 0.);
+		node_.param(ns_name + "/width", width, 1.);
+		node_.param(ns_name + "/length", length, 1.);
+		node_.param(ns_name + "/seed", seed, 0);
+
+		if (type == "stairs") {
+			int num_steps;
+			double step_height, step_length;
+			node_.param(ns_name + "/steps", num_steps, 3);
+			node_.param(ns_name + "/step_height", step_height, 0.14);
+			node_.param(ns_name + "/step_length", step_length, 0.3);
+			scene_.addStairs(x, y, yaw, num_steps, step_height, step_length,
+							 width, resolution);
+		} else if (type == "gap") {
+			double gap_length;
+			node_.param(ns_name + "/gap_length", gap_length, 0.15);
+			scene_.addGap(x, y, yaw, gap_length, length, width, height, resolution);
+		} else if (type == "stepping_stones") {
+			int rows, cols;
+			double stone_size, spacing, height_noise;
+			node_.param(ns_name + "/rows", rows, 3);
+			node_.param(ns_name + "/cols", cols, 2);
+			node_.param(ns_name + "/stone_size", stone_size, 0.2);
+			node_.param(ns_name + "/spacing", spacing, 0.3);
+			node_.param(ns_name + "/height_noise", height_noise, 0.);
+			scene_.addSteppingStones(x, y, yaw, rows, cols, stone_size, spacing,
+									 height, height_noise, resolution, seed);
+		} else if (type == "slope") {
+			double angle;
+			node_.param(ns_name + "/angle", angle, 0.);
+			scene_.addSlope(x, y, yaw, length, width, height, angle, resolution);
+		} else if (type == "rough") {
+			double amplitude, wavelength;
+			node_.param(ns_name + "/amplitude", amplitude, 0.02);
+			node_.param(ns_name + "/wavelength", wavelength, 0.2);
+			scene_.addRoughTerrain(x, y, length, width, height, amplitude,
+								   wavelength, resolution, seed);
+		} else
+			ROS_ERROR("Unknown type of the %s primitive.", ns_name.c_str());
+	}
+}
+
+
+void DefaultFlatTerrain::buildCloud()
+{
+	const std::vector<Eigen::Vector3d>& points = scene_.getPoints();
 
-	flat_terrain_pub_.publish(cloud);
+	PointCloud pcl_msg;
+	pcl_msg.header.frame_id = world_frame_;
+	pcl_msg.reserve(points.size());
+	for (unsigned int i = 0; i < points.size(); i++)
+		pcl_msg.push_back(pcl::PointXYZ(points[i](0), points[i](1), points[i](2)));
+
+	pcl::toROSMsg(pcl_msg, cloud_msg_);
+	ROS_INFO("Built a terrain cloud with %u points", (unsigned int) points.size());
 }
 
 } //@namespace terrain_server
@@ -97,8 +158,11 @@ int main(int argc, char **argv)
 
 	ros::spinOnce();
 
+	double rate;
+	node.param("rate", rate, 100.);
+
 	try {
-		ros::Rate loop_rate(100);
+		ros::Rate loop_rate(rate);
 		while(ros::ok()) {
 			default_flat_terrain.setFlatTerrain();
 			ros::spinOnce();
@@ -0,0 +1,207 @@
+#include <terrain_server/DepthImageBinner.h>
+#include <dwl/utils/utils.h>
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+#include <math.h>
+
+
+namespace terrain_server
+{
+
+DepthImageBinner::DepthImageBinner() : max_jump_(0.05), min_depth_(0.1), max_depth_(10.),
+		rotation_(Eigen::Matrix3f::Identity()), translation_(Eigen::Vector3f::Zero())
+{
+
+}
+
+
+DepthImageBinner::~DepthImageBinner()
+{
+
+}
+
+
+void DepthImageBinner::setMaxDepthJump(double max_jump)
+{
+	max_jump_ = max_jump;
+}
+
+
+void DepthImageBinner::setDepthRange(double min_depth, double max_depth)
+{
+	min_depth_ = min_depth;
+	max_depth_ = max_depth;
+}
+
+
+void DepthImageBinner::compute(HeightGrid& grid,
+							   const DepthImage& image,
+							   const CameraIntrinsics& intrinsics,
+							   const Eigen::Affine3d& camera_pose,
+							   float min_z, float max_z)
+{
+	unsigned int num_cells = grid.width * grid.height;
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	grid.heights.assign(num_cells, nan);
+	grid.normals.clear();
+	grid.curvatures.clear();
+	if (num_cells == 0 || image.width < 2 || image.height < 2 || !image.data ||
+			intrinsics.fx == 0. || intrinsics.fy == 0.)
+		return;
+
+	// Precomputing the ray directions of the columns and rows
+	unsigned int width = image.width;
+	ray_x_.resize(width);
+	for (unsigned int u = 0; u < width; u++)
+		ray_x_[u] = (u - intrinsics.cx) / intrinsics.fx;
+	ray_y_.resize(image.height);
+	for (unsigned int v = 0; v < image.height; v++)
+		ray_y_[v] = (v - intrinsics.cy) / intrinsics.fy;
+
+	rotation_ = camera_pose.linear().cast<float>();
+	translation_ = camera_pose.translation().cast<float>();
+	depths_.resize(2 * width);
+	rows_[0].resize(3 * width);
+	rows_[1].resize(3 * width);
+	normal_sums_.assign(num_cells, Eigen::Vector3f::Zero());
+	normal_counts_.assign(num_cells, 0);
+	point_sums_.assign(num_cells, Eigen::Vector3d::Zero());
+	moment_sums_.assign(num_cells, Eigen::Matrix3d::Zero());
+	point_counts_.assign(num_cells, 0);
+
+	const float origin_x = grid.origin_x;
+	const float origin_y = grid.origin_y;
+	const float inv_resolution = 1. / grid.resolution;
+	const int grid_width = grid.width;
+	const int grid_height = grid.height;
+
+	// Streaming the rows, i.e. only the current and next rows are kept for
+	// estimating the normals
+	backProjectRow(image, 0, rows_[0].data());
+	for (unsigned int v = 0; v < image.height; v++) {
+		const float* row = rows_[v % 2].data();
+		const float* next_row = rows_[(v + 1) % 2].data();
+		const float* depth = depths_.data() + (v % 2) * width;
+		const float* next_depth = depths_.data() + ((v + 1) % 2) * width;
+		bool is_next_row = v + 1 < image.height;
+		if (is_next_row)
+			backProjectRow(image, v + 1, rows_[(v + 1) % 2].data());
+
+		const float* x = row;
+		const float* y = row + width;
+		const float* z = row + 2 * width;
+		for (unsigned int u = 0; u < width; u++) {
+			if (std::isnan(z[u]))
+				continue;
+
+			int ix = (int) floorf((x[u] - origin_x) * inv_resolution);
+			int iy = (int) floorf((y[u] - origin_y) * inv_resolution);
+			if (ix < 0 || ix >= grid_width || iy < 0 || iy >= grid_height ||
+					z[u] < min_z || z[u] > max_z)
+				continue;
+
+			int id = iy * grid_width + ix;
+			if (!(grid.heights[id] >= z[u]))
+				grid.heights[id] = z[u];
+
+			// Accumulating the moments of the points of the cell for its plane
+			// fit
+			Eigen::Vector3d point(x[u], y[u], z[u]);
+			point_sums_[id] += point;
+			moment_sums_[id].noalias() += point * point.transpose();
+			point_counts_[id]++;
+
+			// Estimating the normal from the adjacent pixels of the row and
+			// column, which have to be on the same surface
+			if (!is_next_row || u + 1 == width)
+				continue;
+
+			float jump = max_jump_ * depth[u];
+			if (!(fabsf(depth[u + 1] - depth[u]) <= jump) ||
+					!(fabsf(next_depth[u] - depth[u]) <= jump))
+				continue;
+
+			Eigen::Vector3f du(x[u + 1] - x[u], y[u + 1] - y[u], z[u + 1] - z[u]);
+			Eigen::Vector3f dv(next_row[u] - x[u],
+							   next_row[width + u] - y[u],
+							   next_row[2 * width + u] - z[u]);
+			Eigen::Vector3f normal = du.cross(dv);
+			float norm = normal.norm();
+			if (norm == 0.)
+				continue;
+
+			normal /= (normal(2) < 0. ? -norm : norm);
+			normal_sums_[id] += normal;
+			normal_counts_[id]++;
+		}
+	}
+
+	// Averaging the normals of the cells. The curvature is the one of the
+	// plane fit of the points of the cell (as the plane fit of the terrain
+	// data), i.e. the cells with less than three points don't have it
+	grid.normals.assign(num_cells, Eigen::Vector3f::Constant(nan));
+	grid.curvatures.assign(num_cells, nan);
+	for (unsigned int c = 0; c < num_cells; c++) {
+		if (normal_counts_[c] == 0)
+			continue;
+
+		grid.normals[c] = normal_sums_[c].normalized();
+		if (point_counts_[c] < 3)
+			continue;
+
+		Eigen::Vector3d mean = point_sums_[c] / point_counts_[c];
+		Eigen::Matrix3d covariance = moment_sums_[c] / point_counts_[c] -
+				mean * mean.transpose();
+		Eigen::Vector3d fit_normal;
+		double curvature;
+		dwl::math::solvePlaneParameters(fit_normal, curvature, covariance);
+		grid.curvatures[c] = curvature;
+	}
+}
+
+
+void DepthImageBinner::backProjectRow(const DepthImage& image,
+									  unsigned int row,
+									  float* points)
+{
+	unsigned int width = image.width;
+	float* depth = depths_.data() + (row % 2) * width;
+	const uint8_t* data = image.data + row * image.step;
+
+	// Converting the depths to metres, the invalid ones are NaN
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	if (image.encoding == DepthImage::UINT16) {
+		const uint16_t* raw = (const uint16_t*) data;
+		for (unsigned int u = 0; u < width; u++)
+			depth[u] = raw[u] * 0.001f;
+	} else
+		memcpy(depth, data, width * sizeof(float));
+
+	const float min_depth = min_depth_, max_depth = max_depth_;
+	for (unsigned int u = 0; u < width; u++) {
+		float d = depth[u];
+		depth[u] = (d >= min_depth && d <= max_depth) ? d : nan;
+	}
+
+	// Back-projecting and transforming the row. The loop doesn't have
+	// branches, so it's vectorized
+	const float ray_y = ray_y_[row];
+	const float* ray_x = ray_x_.data();
+	const Eigen::Matrix3f& r = rotation_;
+	const Eigen::Vector3f& t = translation_;
+	float* x = points;
+	float* y = points + width;
+	float* z = points + 2 * width;
+	for (unsigned int u = 0; u < width; u++) {
+		float d = depth[u];
+		float xc = ray_x[u] * d;
+		float yc = ray_y * d;
+		x[u] = r(0,0) * xc + r(0,1) * yc + r(0,2) * d + t(0);
+		y[u] = r(1,0) * xc + r(1,1) * yc + r(1,2) * d + t(1);
+		z[u] = r(2,0) * xc + r(2,1) * yc + r(2,2) * d + t(2);
+	}
+}
+
+} //@namespace terrain_server
@@ -0,0 +1,205 @@
+#include <terrain_server/FootholdExtractor.h>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+
+namespace terrain_server
+{
+
+FootholdExtractor::FootholdExtractor() : max_cost_(0.5), min_normal_z_(0.9),
+		clearance_(0.04), suppression_radius_(0.1), max_candidates_(32)
+{
+
+}
+
+
+FootholdExtractor::~FootholdExtractor()
+{
+
+}
+
+
+void FootholdExtractor::addRegion(double min_x, double max_x,
+								  double min_y, double max_y)
+{
+	FootholdRegion region;
+	region.min_x = min_x;
+	region.max_x = max_x;
+	region.min_y = min_y;
+	region.max_y = max_y;
+	regions_.push_back(region);
+}
+
+
+void FootholdExtractor::clearRegions()
+{
+	regions_.clear();
+}
+
+
+void FootholdExtractor::setThresholds(double max_cost,
+									  double min_normal_z,
+									  double clearance)
+{
+	max_cost_ = max_cost;
+	min_normal_z_ = min_normal_z;
+	clearance_ = std::max(clearance, 0.);
+}
+
+
+void FootholdExtractor::setSuppression(double radius,
+									   unsigned int max_candidates)
+{
+	suppression_radius_ = std::max(radius, 0.);
+	max_candidates_ = max_candidates;
+}
+
+
+void FootholdExtractor::compute(std::vector<Foothold>& candidates,
+								const dwl::TerrainDataMap& terrain_map,
+								const dwl::environment::SpaceDiscretization& discretization,
+								const Eigen::Vector4d& robot_state)
+{
+	candidates.clear();
+	for (unsigned int n = 0; n < regions_.size(); n++)
+		computeRegion(candidates, terrain_map, discretization, robot_state, n);
+}
+
+
+unsigned int FootholdExtractor::getNumRegions() const
+{
+	return regions_.size();
+}
+
+
+void FootholdExtractor::computeRegion(std::vector<Foothold>& candidates,
+									  const dwl::TerrainDataMap& terrain_map,
+									  const dwl::environment::SpaceDiscretization& discretization,
+									  const Eigen::Vector4d& robot_state,
+									  unsigned int region)
+{
+	const FootholdRegion& area = regions_[region];
+	double resolution = discretization.getEnvironmentResolution(true);
+	int clearance = (int) ceil(clearance_ / resolution - 1e-6);
+	int radius = (int) ceil(suppression_radius_ / resolution - 1e-6);
+
+	// Getting the bounding box of the region in the world frame, padded with
+	// the clearance
+	double cos_yaw = cos(robot_state(3));
+	double sin_yaw = sin(robot_state(3));
+	double corners_x[4] = {area.min_x, area.max_x, area.max_x, area.min_x};
+	double corners_y[4] = {area.min_y, area.min_y, area.max_y, area.max_y};
+	Eigen::Vector2d min = Eigen::Vector2d::Constant(std::numeric_limits<double>::max());
+	Eigen::Vector2d max = -min;
+	for (unsigned int c = 0; c < 4; c++) {
+		Eigen::Vector2d corner(robot_state(0) + corners_x[c] * cos_yaw - corners_y[c] * sin_yaw,
+							   robot_state(1) + corners_x[c] * sin_yaw + corners_y[c] * cos_yaw);
+		min = min.cwiseMin(corner);
+		max = max.cwiseMax(corner);
+	}
+	min -= Eigen::Vector2d::Constant(clearance * resolution);
+	max += Eigen::Vector2d::Constant(clearance * resolution);
+
+	unsigned short min_x, min_y, max_x, max_y;
+	if (!discretization.coordToKey(min_x, min(0), true) ||
+			!discretization.coordToKey(min_y, min(1), true) ||
+			!discretization.coordToKey(max_x, max(0), true) ||
+			!discretization.coordToKey(max_y, max(1), true))
+		return;
+	int width = max_x - min_x + 1;
+	int height = max_y - min_y + 1;
+
+	// Filling the grid of the region, and the summed-area table of the
+	// non-acceptable cells
+	cells_.assign(width * height, NULL);
+	edge_counts_.assign((width + 1) * (height + 1), 0);
+	for (int j = 0; j < height; j++) {
+		for (int i = 0; i < width; i++) {
+			dwl::Key key;
+			key.x = min_x + i;
+			key.y = min_y + j;
+			dwl::Vertex vertex_id;
+			discretization.keyToVertex(vertex_id, key, true);
+			dwl::TerrainDataMap::const_iterator cell_it = terrain_map.find(vertex_id);
+			const dwl::TerrainCell* cell = NULL;
+			if (cell_it != terrain_map.end())
+				cell = &cell_it->second;
+			cells_[j * width + i] = cell;
+
+			bool is_edge = !cell || cell->cost > max_cost_ ||
+					fabs(cell->normal(2)) < min_normal_z_;
+			edge_counts_[(j + 1) * (width + 1) + i + 1] = is_edge +
+					edge_counts_[j * (width + 1) + i + 1] +
+					edge_counts_[(j + 1) * (width + 1) + i] -
+					edge_counts_[j * (width + 1) + i];
+		}
+	}
+
+	// Getting the cells inside the region whose clearance window is
+	// acceptable, i.e. the cell too
+	ranking_.clear();
+	for (int j = clearance; j < height - clearance; j++) {
+		for (int i = clearance; i < width - clearance; i++) {
+			const dwl::TerrainCell* cell = cells_[j * width + i];
+			if (!cell)
+				continue;
+
+			unsigned int i0 = i - clearance, i1 = i + clearance + 1;
+			unsigned int j0 = j - clearance, j1 = j + clearance + 1;
+			unsigned int num_edges = edge_counts_[j1 * (width + 1) + i1] -
+					edge_counts_[j0 * (width + 1) + i1] -
+					edge_counts_[j1 * (width + 1) + i0] +
+					edge_counts_[j0 * (width + 1) + i0];
+			if (num_edges > 0)
+				continue;
+
+			// Getting the position w.r.t. the robot (without the yaw rotation)
+			double x, y;
+			discretization.keyToCoord(x, cell->key.x, true);
+			discretization.keyToCoord(y, cell->key.y, true);
+			double xc = x - robot_state(0);
+			double yc = y - robot_state(1);
+			double xr = xc * cos_yaw + yc * sin_yaw;
+			double yr = -xc * sin_yaw + yc * cos_yaw;
+			if (xr >= area.min_x && xr <= area.max_x &&
+					yr >= area.min_y && yr <= area.max_y)
+				ranking_.push_back(std::make_pair(cell->cost, j * width + i));
+		}
+	}
+	std::sort(ranking_.begin(), ranking_.end());
+
+	// Non-maximum suppression, i.e. the best candidate suppresses the ones
+	// within the suppression radius
+	is_suppressed_.assign(width * height, false);
+	unsigned int num_candidates = 0;
+	for (unsigned int r = 0; r < ranking_.size() && num_candidates < max_candidates_; r++) {
+		unsigned int index = ranking_[r].second;
+		if (is_suppressed_[index])
+			continue;
+
+		const dwl::TerrainCell* cell = cells_[index];
+		Foothold candidate;
+		discretization.keyToCoord(candidate.position(0), cell->key.x, true);
+		discretization.keyToCoord(candidate.position(1), cell->key.y, true);
+		candidate.position(2) = cell->height;
+		candidate.normal = cell->normal;
+		candidate.cost = cell->cost;
+		candidate.region = region;
+		candidates.push_back(candidate);
+		num_candidates++;
+
+		int i = index % width, j = index / width;
+		for (int dj = -radius; dj <= radius; dj++) {
+			for (int di = -radius; di <= radius; di++) {
+				if (di * di + dj * dj > radius * radius ||
+						i + di < 0 || i + di >= width || j + dj < 0 || j + dj >= height)
+					continue;
+				is_suppressed_[(j + dj) * width + i + di] = true;
+			}
+		}
+	}
+}
+
+} //@namespace terrain_server
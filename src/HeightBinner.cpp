@@ -0,0 +1,252 @@
+#include <terrain_server/HeightBinner.h>
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+
+namespace terrain_server
+{
+
+/** @brief Minimum number of points of a thread, i.e. smaller clouds aren't split */
+static const unsigned int MIN_POINTS_PER_THREAD = 16384;
+
+
+HeightBinner::HeightBinner() : is_percentile_(false), percentile_(1.),
+		num_threads_(std::max(1u, std::thread::hardware_concurrency())),
+		task_(NULL), task_size_(0), task_chunk_(0), task_threads_(0),
+		task_sequence_(0), num_pending_(0), stop_(false)
+{
+
+}
+
+
+HeightBinner::~HeightBinner()
+{
+	stopWorkers();
+}
+
+
+void HeightBinner::setPercentile(bool is_percentile, double percentile)
+{
+	is_percentile_ = is_percentile;
+	percentile_ = std::min(1., std::max(0., percentile));
+}
+
+
+void HeightBinner::setNumThreads(unsigned int num_threads)
+{
+	if (num_threads == 0)
+		num_threads = std::thread::hardware_concurrency();
+
+	// The workers are started again by the next binning that needs them
+	num_threads_ = std::max(1u, num_threads);
+	if (workers_.size() + 1 > num_threads_)
+		stopWorkers();
+}
+
+
+void HeightBinner::compute(HeightGrid& grid,
+						   const std::vector<Eigen::Vector3f>& points,
+						   float min_z, float max_z)
+{
+	unsigned int num_cells = grid.width * grid.height;
+	unsigned int num_points = points.size();
+	grid.heights.assign(num_cells, std::numeric_limits<float>::quiet_NaN());
+	grid.normals.clear();
+	grid.curvatures.clear();
+	if (num_cells == 0 || num_points == 0)
+		return;
+
+	unsigned int num_threads =
+			std::max(1u, std::min(num_threads_, num_points / MIN_POINTS_PER_THREAD));
+
+	// Computing the cell of every point. The loop doesn't have branches, so
+	// it's vectorized
+	cell_ids_.resize(num_points);
+	const float origin_x = grid.origin_x;
+	const float origin_y = grid.origin_y;
+	const float inv_resolution = 1. / grid.resolution;
+	const int width = grid.width;
+	const int height = grid.height;
+	parallelFor(num_points, num_threads,
+			[&](unsigned int thread, unsigned int begin, unsigned int end) {
+		const Eigen::Vector3f* point = points.data();
+		int32_t* cell_ids = cell_ids_.data();
+		for (unsigned int i = begin; i < end; i++) {
+			int ix = (int) floorf((point[i](0) - origin_x) * inv_resolution);
+			int iy = (int) floorf((point[i](1) - origin_y) * inv_resolution);
+			float z = point[i](2);
+			bool is_inside = ix >= 0 && ix < width && iy >= 0 && iy < height &&
+					z >= min_z && z <= max_z;
+			cell_ids[i] = is_inside ? iy * width + ix : -1;
+		}
+	});
+
+	if (!is_percentile_) {
+		// Computing the maximum height per thread, and reducing them
+		thread_heights_.resize(num_threads);
+		parallelFor(num_points, num_threads,
+				[&](unsigned int thread, unsigned int begin, unsigned int end) {
+			std::vector<float>& heights = thread_heights_[thread];
+			heights.assign(num_cells, -std::numeric_limits<float>::infinity());
+			for (unsigned int i = begin; i < end; i++) {
+				int32_t id = cell_ids_[i];
+				if (id >= 0)
+					heights[id] = std::max(heights[id], points[i](2));
+			}
+		});
+
+		parallelFor(num_cells, num_threads,
+				[&](unsigned int thread, unsigned int begin, unsigned int end) {
+			for (unsigned int c = begin; c < end; c++) {
+				float max_height = thread_heights_[0][c];
+				for (unsigned int t = 1; t < thread_heights_.size(); t++)
+					max_height = std::max(max_height, thread_heights_[t][c]);
+
+				if (max_height != -std::numeric_limits<float>::infinity())
+					grid.heights[c] = max_height;
+			}
+		});
+	} else {
+		// Counting the points of every cell per thread
+		thread_counts_.resize(num_threads);
+		parallelFor(num_points, num_threads,
+				[&](unsigned int thread, unsigned int begin, unsigned int end) {
+			std::vector<uint32_t>& counts = thread_counts_[thread];
+			counts.assign(num_cells, 0);
+			for (unsigned int i = begin; i < end; i++) {
+				int32_t id = cell_ids_[i];
+				if (id >= 0)
+					counts[id]++;
+			}
+		});
+
+		// Computing the offsets of the cells, and the offsets of every thread
+		// inside them (they are stored in the counts)
+		cell_offsets_.resize(num_cells + 1);
+		uint32_t offset = 0;
+		for (unsigned int c = 0; c < num_cells; c++) {
+			cell_offsets_[c] = offset;
+			for (unsigned int t = 0; t < num_threads; t++) {
+				uint32_t count = thread_counts_[t][c];
+				thread_counts_[t][c] = offset;
+				offset += count;
+			}
+		}
+		cell_offsets_[num_cells] = offset;
+
+		// Sorting the heights by cell
+		sorted_heights_.resize(offset);
+		parallelFor(num_points, num_threads,
+				[&](unsigned int thread, unsigned int begin, unsigned int end) {
+			std::vector<uint32_t>& offsets = thread_counts_[thread];
+			for (unsigned int i = begin; i < end; i++) {
+				int32_t id = cell_ids_[i];
+				if (id >= 0)
+					sorted_heights_[offsets[id]++] = points[i](2);
+			}
+		});
+
+		// Selecting the percentile of every cell
+		parallelFor(num_cells, num_threads,
+				[&](unsigned int thread, unsigned int begin, unsigned int end) {
+			for (unsigned int c = begin; c < end; c++) {
+				uint32_t num_cell_points = cell_offsets_[c + 1] - cell_offsets_[c];
+				if (num_cell_points == 0)
+					continue;
+
+				float* first = sorted_heights_.data() + cell_offsets_[c];
+				float* nth = first + (uint32_t) floor(percentile_ * (num_cell_points - 1) + 0.5);
+				std::nth_element(first, nth, first + num_cell_points);
+				grid.heights[c] = *nth;
+			}
+		});
+	}
+}
+
+
+void HeightBinner::parallelFor(unsigned int size, unsigned int num_threads,
+							   const std::function<void(unsigned int, unsigned int,
+														unsigned int)>& function)
+{
+	unsigned int chunk = (size + num_threads - 1) / num_threads;
+	if (num_threads > 1) {
+		// Starting the workers on the first task that needs them, and
+		// handing the task to them
+		startWorkers(num_threads);
+		std::lock_guard<std::mutex> lock(mutex_);
+		task_ = &function;
+		task_size_ = size;
+		task_chunk_ = chunk;
+		task_threads_ = num_threads;
+		num_pending_ = num_threads - 1;
+		task_sequence_++;
+	}
+	task_condition_.notify_all();
+
+	function(0, 0, std::min(size, chunk));
+
+	// Waiting for the chunks of the workers
+	if (num_threads > 1) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		done_condition_.wait(lock, [this] { return num_pending_ == 0; });
+		task_ = NULL;
+	}
+}
+
+
+void HeightBinner::startWorkers(unsigned int num_threads)
+{
+	if (workers_.size() + 1 >= num_threads)
+		return;
+
+	if (workers_.empty()) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = false;
+	}
+	for (unsigned int t = workers_.size() + 1; t < num_threads; t++)
+		workers_.push_back(std::thread(&HeightBinner::runWorker, this, t, task_sequence_));
+}
+
+
+void HeightBinner::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	task_condition_.notify_all();
+	for (unsigned int t = 0; t < workers_.size(); t++)
+		workers_[t].join();
+	workers_.clear();
+}
+
+
+void HeightBinner::runWorker(unsigned int thread, uint64_t sequence)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true) {
+		task_condition_.wait(lock, [&] { return stop_ || task_sequence_ != sequence; });
+		if (stop_)
+			return;
+
+		// Running the chunk of the worker, the tasks with less threads don't
+		// use it
+		sequence = task_sequence_;
+		if (thread >= task_threads_)
+			continue;
+
+		const std::function<void(unsigned int, unsigned int, unsigned int)>& function = *task_;
+		unsigned int begin = std::min(task_size_, thread * task_chunk_);
+		unsigned int end = std::min(task_size_, begin + task_chunk_);
+		lock.unlock();
+		function(thread, begin, end);
+		lock.lock();
+
+		if (--num_pending_ == 0)
+			done_condition_.notify_one();
+	}
+}
+
+} //@namespace terrain_server
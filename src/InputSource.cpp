@@ -0,0 +1,392 @@
+#include <terrain_server/InputSource.h>
+#include <terrain_server/Timer.h>
+#include <dwl/utils/Orientation.h>
+
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <sensor_msgs/image_encodings.h>
+#include <tf_conversions/tf_eigen.h>
+
+
+namespace terrain_server
+{
+
+InputSource::InputSource() : type_(POINTCLOUD), spinner_(NULL), cloud_sub_(NULL),
+		tf_cloud_sub_(NULL), depth_sub_(NULL), tf_depth_sub_(NULL), tf_listener_(NULL),
+		is_camera_info_(false), sensor_origin_(Eigen::Vector3d::Zero()),
+		robot_state_(Eigen::Vector4d::Zero()), robot_position_(Eigen::Vector3d::Zero()),
+		robot_orientation_(Eigen::Quaterniond::Identity()), frame_time_(0.),
+		tf_duration_(0.), conversion_duration_(0.), is_tf_failure_(false),
+		is_skipped_(false)
+{
+
+}
+
+
+InputSource::~InputSource()
+{
+	// Stopping the thread before removing the subscribers
+	if (spinner_) {
+		spinner_->stop();
+		delete spinner_;
+		spinner_ = NULL;
+	}
+
+	if (tf_cloud_sub_) {
+		delete tf_cloud_sub_;
+		tf_cloud_sub_ = NULL;
+	}
+
+	if (cloud_sub_) {
+		delete cloud_sub_;
+		cloud_sub_ = NULL;
+	}
+
+	if (tf_depth_sub_) {
+		delete tf_depth_sub_;
+		tf_depth_sub_ = NULL;
+	}
+
+	if (depth_sub_) {
+		delete depth_sub_;
+		depth_sub_ = NULL;
+	}
+}
+
+
+void InputSource::init(ros::NodeHandle node,
+					   const std::string& name,
+					   Type type,
+					   const std::string& topic,
+					   const std::string& camera_info_topic,
+					   tf::TransformListener& tf_listener,
+					   const std::string& world_frame,
+					   const std::string& base_frame,
+					   const TerrainMappingConfig& config,
+					   BoundsHandler bounds_handler,
+					   MergeHandler merge_handler)
+{
+	name_ = name;
+	type_ = type;
+	tf_listener_ = &tf_listener;
+	world_frame_ = world_frame;
+	base_frame_ = base_frame;
+	bounds_handler_ = bounds_handler;
+	merge_handler_ = merge_handler;
+
+	// Setting the binning
+	height_binner_.setPercentile(config.height_binning == "percentile",
+								 config.height_percentile);
+	height_binner_.setNumThreads(std::max(0, config.binning_threads));
+	depth_binner_.setDepthRange(config.min_depth, config.max_depth);
+	depth_binner_.setMaxDepthJump(config.max_depth_jump);
+	scheduler_.setThresholds(config.update_min_translation, config.update_min_yaw,
+							 config.update_min_change, config.update_max_period);
+
+	// The callbacks of the source are called from its own queue and thread
+	node_ = node;
+	node_.setCallbackQueue(&queue_);
+	if (type_ == DEPTH) {
+		camera_info_sub_ = node_.subscribe(camera_info_topic, 1,
+										   &InputSource::cameraInfoCallback, this);
+		depth_sub_ =
+				new message_filters::Subscriber<sensor_msgs::Image>(node_, topic, 5);
+		tf_depth_sub_ =
+				new tf::MessageFilter<sensor_msgs::Image>(
+						*depth_sub_, tf_listener, world_frame_, 5, node_);
+		tf_depth_sub_->registerCallback(
+				boost::bind(&InputSource::depthImageCallback, this, _1));
+	} else {
+		cloud_sub_ =
+				new message_filters::Subscriber<sensor_msgs::PointCloud2>(node_, topic, 5);
+		tf_cloud_sub_ =
+				new tf::MessageFilter<sensor_msgs::PointCloud2>(
+						*cloud_sub_, tf_listener, world_frame_, 5, node_);
+		tf_cloud_sub_->registerCallback(
+				boost::bind(&InputSource::pointCloudCallback, this, _1));
+	}
+
+	spinner_ = new ros::AsyncSpinner(1, &queue_);
+	spinner_->start();
+}
+
+
+const std::string& InputSource::getName() const
+{
+	return name_;
+}
+
+
+InputSource::Type InputSource::getType() const
+{
+	return type_;
+}
+
+
+const HeightGrid& InputSource::getGrid() const
+{
+	return grid_;
+}
+
+
+const std::vector<Eigen::Vector3f>& InputSource::getPoints() const
+{
+	return points_;
+}
+
+
+const Eigen::Vector3d& InputSource::getSensorOrigin() const
+{
+	return sensor_origin_;
+}
+
+
+const Eigen::Vector4d& InputSource::getRobotState() const
+{
+	return robot_state_;
+}
+
+
+const Eigen::Vector3d& InputSource::getRobotPosition() const
+{
+	return robot_position_;
+}
+
+
+const Eigen::Quaterniond& InputSource::getRobotOrientation() const
+{
+	return robot_orientation_;
+}
+
+
+double InputSource::getFrameTime() const
+{
+	return frame_time_;
+}
+
+
+double InputSource::getTfDuration() const
+{
+	return tf_duration_;
+}
+
+
+double InputSource::getConversionDuration() const
+{
+	return conversion_duration_;
+}
+
+
+bool InputSource::isTfFailure() const
+{
+	return is_tf_failure_;
+}
+
+
+bool InputSource::isSkipped() const
+{
+	return is_skipped_;
+}
+
+
+void InputSource::resetScheduler()
+{
+	scheduler_.reset();
+}
+
+
+void InputSource::pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& msg)
+{
+	frame_time_ = getMonotonicTime();
+	Eigen::Affine3d sensor_pose;
+	is_skipped_ = false;
+	if (!lookupPoses(msg->header, sensor_pose)) {
+		merge_handler_(*this);
+		return;
+	}
+
+	// Skipping the frame before its transformation and binning
+	if (!scheduler_.isUpdateRequired(robot_state_, getSignature(*msg), frame_time_)) {
+		is_skipped_ = true;
+		merge_handler_(*this);
+		return;
+	}
+
+	// Transforming the finite points to the world frame
+	double stage_time = getMonotonicTime();
+	Eigen::Matrix3f rotation = sensor_pose.linear().cast<float>();
+	Eigen::Vector3f translation = sensor_pose.translation().cast<float>();
+	points_.clear();
+	points_.reserve(msg->width * msg->height);
+	sensor_msgs::PointCloud2ConstIterator<float> iter_x(*msg, "x");
+	sensor_msgs::PointCloud2ConstIterator<float> iter_y(*msg, "y");
+	sensor_msgs::PointCloud2ConstIterator<float> iter_z(*msg, "z");
+	for (; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z) {
+		if (std::isfinite(*iter_x) && std::isfinite(*iter_y) && std::isfinite(*iter_z))
+			points_.push_back(rotation * Eigen::Vector3f(*iter_x, *iter_y, *iter_z) +
+							  translation);
+	}
+
+	// Binning the points, the integrated ones are merged as points
+	if (type_ == POINTCLOUD) {
+		double min_z, max_z;
+		bounds_handler_(grid_, min_z, max_z, robot_state_);
+		height_binner_.compute(grid_, points_, min_z, max_z);
+	}
+	conversion_duration_ = getMonotonicTime() - stage_time;
+
+	merge_handler_(*this);
+}
+
+
+void InputSource::depthImageCallback(const sensor_msgs::Image::ConstPtr& msg)
+{
+	if (!is_camera_info_) {
+		ROS_WARN_THROTTLE(1., "There isn't camera info of the %s source", name_.c_str());
+		return;
+	}
+
+	// Getting the layout of the depth image, the rows aren't copied
+	DepthImage image;
+	if (msg->encoding == sensor_msgs::image_encodings::TYPE_16UC1 ||
+			msg->encoding == sensor_msgs::image_encodings::MONO16)
+		image.encoding = DepthImage::UINT16;
+	else if (msg->encoding == sensor_msgs::image_encodings::TYPE_32FC1)
+		image.encoding = DepthImage::FLOAT32;
+	else {
+		ROS_WARN_THROTTLE(1., "Unsupported %s encoding of the %s source",
+						  msg->encoding.c_str(), name_.c_str());
+		return;
+	}
+	image.data = msg->data.data();
+	image.width = msg->width;
+	image.height = msg->height;
+	image.step = msg->step;
+
+	frame_time_ = getMonotonicTime();
+	Eigen::Affine3d camera_pose;
+	is_skipped_ = false;
+	if (!lookupPoses(msg->header, camera_pose)) {
+		merge_handler_(*this);
+		return;
+	}
+
+	// Skipping the frame before its binning
+	if (!scheduler_.isUpdateRequired(robot_state_, getSignature(image), frame_time_)) {
+		is_skipped_ = true;
+		merge_handler_(*this);
+		return;
+	}
+
+	// Binning the pixels in a single pass
+	double stage_time = getMonotonicTime();
+	double min_z, max_z;
+	bounds_handler_(grid_, min_z, max_z, robot_state_);
+	depth_binner_.compute(grid_, image, intrinsics_, camera_pose, min_z, max_z);
+	conversion_duration_ = getMonotonicTime() - stage_time;
+
+	merge_handler_(*this);
+}
+
+
+void InputSource::cameraInfoCallback(const sensor_msgs::CameraInfo::ConstPtr& msg)
+{
+	// The intrinsics of the rectified image
+	intrinsics_.fx = msg->P[0];
+	intrinsics_.fy = msg->P[5];
+	intrinsics_.cx = msg->P[2];
+	intrinsics_.cy = msg->P[6];
+	if (intrinsics_.fx == 0. || intrinsics_.fy == 0.) {
+		intrinsics_.fx = msg->K[0];
+		intrinsics_.fy = msg->K[4];
+		intrinsics_.cx = msg->K[2];
+		intrinsics_.cy = msg->K[5];
+	}
+	is_camera_info_ = true;
+}
+
+
+bool InputSource::lookupPoses(const std_msgs::Header& header,
+							  Eigen::Affine3d& sensor_pose)
+{
+	// Getting the transformations of the sensor and robot frames
+	tf::StampedTransform sensor_transform, tf_transform;
+	try {
+		tf_listener_->lookupTransform(world_frame_,
+									  header.frame_id,
+									  header.stamp,
+									  sensor_transform);
+		tf_listener_->lookupTransform(world_frame_,
+									  base_frame_,
+									  header.stamp,
+									  tf_transform);
+	} catch (tf::TransformException& ex) {
+		ROS_ERROR_STREAM("Transform error of the " << name_ << " source: " << ex.what()
+						 << ", quitting callback");
+		is_tf_failure_ = true;
+		return false;
+	}
+	is_tf_failure_ = false;
+	tf_duration_ = getMonotonicTime() - frame_time_;
+
+	tf::transformTFToEigen(sensor_transform, sensor_pose);
+	sensor_origin_ = sensor_pose.translation();
+
+	// Getting the robot pose
+	robot_position_ = Eigen::Vector3d(tf_transform.getOrigin()[0],
+									  tf_transform.getOrigin()[1],
+									  tf_transform.getOrigin()[2]);
+	tf::Quaternion q = tf_transform.getRotation();
+	robot_orientation_ = Eigen::Quaterniond(q.getW(), q.getX(), q.getY(), q.getZ());
+	robot_state_.head(3) = robot_position_;
+	robot_state_(3) = dwl::math::getYaw(dwl::math::getRPY(robot_orientation_));
+
+	return true;
+}
+
+
+double InputSource::getSignature(const sensor_msgs::PointCloud2& cloud) const
+{
+	// Sampling about a thousand points
+	unsigned int num_points = cloud.width * cloud.height;
+	unsigned int stride = std::max(1u, num_points / 1024);
+	double sum = 0.;
+	unsigned int num_samples = 0;
+	sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
+	sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
+	sensor_msgs::PointCloud2ConstIterator<float> iter_z(cloud, "z");
+	for (unsigned int i = 0; i < num_points; i += stride) {
+		float x = *(iter_x + i), y = *(iter_y + i), z = *(iter_z + i);
+		if (std::isfinite(x) && std::isfinite(y) && std::isfinite(z)) {
+			sum += sqrt(x * x + y * y + z * z);
+			num_samples++;
+		}
+	}
+
+	return num_samples > 0 ? sum / num_samples : 0.;
+}
+
+
+double InputSource::getSignature(const DepthImage& image) const
+{
+	// Sampling about a thousand pixels
+	unsigned int num_pixels = image.width * image.height;
+	unsigned int stride = std::max(1u, num_pixels / 1024);
+	double sum = 0.;
+	unsigned int num_samples = 0;
+	for (unsigned int i = 0; i < num_pixels; i += stride) {
+		const uint8_t* pixel = image.data + (i / image.width) * image.step;
+		float depth;
+		if (image.encoding == DepthImage::UINT16)
+			depth = ((const uint16_t*) pixel)[i % image.width] * 0.001f;
+		else
+			depth = ((const float*) pixel)[i % image.width];
+		if (std::isfinite(depth) && depth > 0.) {
+			sum += depth;
+			num_samples++;
+		}
+	}
+
+	return num_samples > 0 ? sum / num_samples : 0.;
+}
+
+} //@namespace terrain_server
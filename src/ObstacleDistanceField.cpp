@@ -0,0 +1,289 @@
+#include <terrain_server/ObstacleDistanceField.h>
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+
+namespace terrain_server
+{
+
+ObstacleDistanceField::ObstacleDistanceField() : origin_x_(0), origin_y_(0),
+		width_(0), height_(0), max_distance_(0), max_sq_distance_(0), frame_(0)
+{
+
+}
+
+
+ObstacleDistanceField::~ObstacleDistanceField()
+{
+
+}
+
+
+void ObstacleDistanceField::setSize(unsigned int width,
+									unsigned int height,
+									unsigned int max_distance)
+{
+	width_ = width;
+	height_ = height;
+	max_distance_ = max_distance;
+	max_sq_distance_ = max_distance * max_distance;
+
+	unsigned int num_cells = width_ * height_;
+	sq_distance_.resize(num_cells);
+	obstacle_.resize(num_cells);
+	occupied_.resize(num_cells);
+	to_raise_.resize(num_cells);
+	state_.resize(num_cells);
+	seen_.resize(num_cells);
+	clear();
+}
+
+
+bool ObstacleDistanceField::setOrigin(int origin_x, int origin_y)
+{
+	if (origin_x == origin_x_ && origin_y == origin_y_)
+		return false;
+
+	origin_x_ = origin_x;
+	origin_y_ = origin_y;
+	clear();
+
+	return true;
+}
+
+
+void ObstacleDistanceField::setObstacleMap(const std::map<dwl::Vertex, dwl::Cell>& obstacle_map)
+{
+	frame_++;
+
+	// Adding the new obstacles inside the window
+	for (std::map<dwl::Vertex, dwl::Cell>::const_iterator cell_iter = obstacle_map.begin();
+			cell_iter != obstacle_map.end();
+			cell_iter++)
+	{
+		int key_x = cell_iter->second.key.x;
+		int key_y = cell_iter->second.key.y;
+		if (isInside(key_x, key_y)) {
+			unsigned int idx = (key_y - origin_y_) * width_ + (key_x - origin_x_);
+			seen_[idx] = frame_;
+			setObstacle(key_x, key_y);
+		}
+	}
+
+	// Removing the obstacles that weren't seen in this frame. Note that the
+	// list of obstacles is compacted in the same pass
+	unsigned int num_obstacles = 0;
+	for (unsigned int i = 0; i < obstacles_.size(); i++) {
+		unsigned int idx = obstacles_[i];
+		if (!occupied_[idx])
+			continue;
+
+		if (seen_[idx] != frame_) {
+			removeObstacle(origin_x_ + idx % width_, origin_y_ + idx / width_);
+		} else
+			obstacles_[num_obstacles++] = idx;
+	}
+	obstacles_.resize(num_obstacles);
+
+	update();
+}
+
+
+void ObstacleDistanceField::setObstacle(int key_x, int key_y)
+{
+	if (!isInside(key_x, key_y))
+		return;
+
+	unsigned int idx = (key_y - origin_y_) * width_ + (key_x - origin_x_);
+	if (occupied_[idx])
+		return;
+
+	occupied_[idx] = 1;
+	obstacle_[idx] = idx;
+	sq_distance_[idx] = 0;
+	to_raise_[idx] = 0;
+	obstacles_.push_back(idx);
+	push(0, idx);
+}
+
+
+void ObstacleDistanceField::removeObstacle(int key_x, int key_y)
+{
+	if (!isInside(key_x, key_y))
+		return;
+
+	unsigned int idx = (key_y - origin_y_) * width_ + (key_x - origin_x_);
+	if (!occupied_[idx])
+		return;
+
+	occupied_[idx] = 0;
+	obstacle_[idx] = -1;
+	sq_distance_[idx] = std::numeric_limits<int>::max();
+	to_raise_[idx] = 1;
+	push(0, idx);
+}
+
+
+void ObstacleDistanceField::update()
+{
+	while (!open_.empty()) {
+		unsigned int idx = open_.top().second;
+		open_.pop();
+
+		// Skipping duplicated elements of the queue
+		if (state_[idx] == Processed)
+			continue;
+		state_[idx] = Processed;
+
+		if (to_raise_[idx])
+			raise(idx);
+		else if (obstacle_[idx] != -1 && occupied_[obstacle_[idx]])
+			lower(idx);
+	}
+}
+
+
+void ObstacleDistanceField::clear()
+{
+	std::fill(sq_distance_.begin(), sq_distance_.end(), std::numeric_limits<int>::max());
+	std::fill(obstacle_.begin(), obstacle_.end(), -1);
+	std::fill(occupied_.begin(), occupied_.end(), 0);
+	std::fill(to_raise_.begin(), to_raise_.end(), 0);
+	std::fill(state_.begin(), state_.end(), (unsigned char) NotQueued);
+	obstacles_.clear();
+	open_ = std::priority_queue<QueueElement, std::vector<QueueElement>,
+								std::greater<QueueElement> >();
+}
+
+
+double ObstacleDistanceField::getDistance(int key_x, int key_y) const
+{
+	if (!isInside(key_x, key_y))
+		return max_distance_;
+
+	int sq_distance = sq_distance_[(key_y - origin_y_) * width_ + (key_x - origin_x_)];
+	if (sq_distance > max_sq_distance_)
+		return max_distance_;
+
+	return sqrt((double) sq_distance);
+}
+
+
+bool ObstacleDistanceField::isInside(int key_x, int key_y) const
+{
+	return key_x >= origin_x_ && key_x < origin_x_ + (int) width_ &&
+			key_y >= origin_y_ && key_y < origin_y_ + (int) height_;
+}
+
+
+int ObstacleDistanceField::getOriginX() const
+{
+	return origin_x_;
+}
+
+
+int ObstacleDistanceField::getOriginY() const
+{
+	return origin_y_;
+}
+
+
+unsigned int ObstacleDistanceField::getWidth() const
+{
+	return width_;
+}
+
+
+unsigned int ObstacleDistanceField::getHeight() const
+{
+	return height_;
+}
+
+
+unsigned int ObstacleDistanceField::getMaxDistance() const
+{
+	return max_distance_;
+}
+
+
+void ObstacleDistanceField::push(int sq_distance, unsigned int idx)
+{
+	open_.push(QueueElement(sq_distance, idx));
+	state_[idx] = Queued;
+}
+
+
+void ObstacleDistanceField::lower(unsigned int idx)
+{
+	int x = idx % width_;
+	int y = idx / width_;
+	for (int dy = -1; dy <= 1; dy++) {
+		for (int dx = -1; dx <= 1; dx++) {
+			int nx = x + dx, ny = y + dy;
+			if ((dx == 0 && dy == 0) ||
+					nx < 0 || ny < 0 || nx >= (int) width_ || ny >= (int) height_)
+				continue;
+
+			unsigned int n = ny * width_ + nx;
+			if (to_raise_[n])
+				continue;
+
+			// Propagating the nearest obstacle up to the maximum distance
+			int sq_distance = getSquaredDistance(obstacle_[idx], n);
+			if (sq_distance > max_sq_distance_)
+				continue;
+
+			bool overwrite = sq_distance < sq_distance_[n];
+			if (!overwrite && sq_distance == sq_distance_[n])
+				overwrite = obstacle_[n] == -1 || !occupied_[obstacle_[n]];
+
+			if (overwrite) {
+				sq_distance_[n] = sq_distance;
+				obstacle_[n] = obstacle_[idx];
+				push(sq_distance, n);
+			}
+		}
+	}
+}
+
+
+void ObstacleDistanceField::raise(unsigned int idx)
+{
+	int x = idx % width_;
+	int y = idx / width_;
+	for (int dy = -1; dy <= 1; dy++) {
+		for (int dx = -1; dx <= 1; dx++) {
+			int nx = x + dx, ny = y + dy;
+			if ((dx == 0 && dy == 0) ||
+					nx < 0 || ny < 0 || nx >= (int) width_ || ny >= (int) height_)
+				continue;
+
+			unsigned int n = ny * width_ + nx;
+			if (obstacle_[n] == -1 || to_raise_[n])
+				continue;
+
+			if (!occupied_[obstacle_[n]]) {
+				// The nearest obstacle was removed, so it's invalidated
+				push(sq_distance_[n], n);
+				to_raise_[n] = 1;
+				obstacle_[n] = -1;
+				sq_distance_[n] = std::numeric_limits<int>::max();
+			} else if (state_[n] != Queued) {
+				// The cell is a valid source for lowering the raised region
+				push(sq_distance_[n], n);
+			}
+		}
+	}
+	to_raise_[idx] = 0;
+}
+
+
+int ObstacleDistanceField::getSquaredDistance(unsigned int idx1, unsigned int idx2) const
+{
+	int dx = (int) (idx1 % width_) - (int) (idx2 % width_);
+	int dy = (int) (idx1 / width_) - (int) (idx2 / width_);
+	return dx * dx + dy * dy;
+}
+
+} //@namespace terrain_server
@@ -0,0 +1,172 @@
+#include <terrain_server/ObstacleMapPublisher.h>
+
+
+namespace terrain_server
+{
+
+ObstacleMapPublisher::ObstacleMapPublisher() : sequence_(0),
+		publish_delta_(false), full_delta_(true), is_map_pending_(false),
+		is_delta_ready_(false), is_map_ready_(false)
+{
+
+}
+
+
+ObstacleMapPublisher::~ObstacleMapPublisher()
+{
+
+}
+
+
+void ObstacleMapPublisher::init(ros::NodeHandle node,
+								const std::string& frame_id,
+								bool publish_delta)
+{
+	// The obstacle map is latched because it's only published when it changes
+	map_pub_ = node.advertise<terrain_server::ObstacleMap>("obstacle_map", 1, true);
+	map_msg_.header.frame_id = frame_id;
+
+	publish_delta_ = publish_delta;
+	if (publish_delta_) {
+		delta_pub_ =
+				node.advertise<terrain_server::ObstacleMapDelta>("obstacle_map_delta", 10);
+		delta_msg_.header.frame_id = frame_id;
+	}
+}
+
+
+void ObstacleMapPublisher::publish(const std::map<dwl::Vertex, dwl::Cell>& obstacle_map,
+								   double plane_size,
+								   double height_size)
+{
+	update(obstacle_map, plane_size, height_size);
+	publish();
+}
+
+
+void ObstacleMapPublisher::update(const std::map<dwl::Vertex, dwl::Cell>& obstacle_map,
+								  double plane_size,
+								  double height_size)
+{
+	// Building the changes of the obstacle map
+	ros::Time stamp = ros::Time::now();
+	if (computeDelta(obstacle_map)) {
+		if (publish_delta_) {
+			delta_msg_.header.stamp = stamp;
+			delta_msg_.sequence = sequence_++;
+			delta_msg_.plane_size = plane_size;
+			delta_msg_.height_size = height_size;
+			is_delta_ready_ = true;
+		}
+
+		is_map_pending_ = true;
+	}
+
+	// Building the obstacle map if it wasn't published yet and there is at
+	// least one subscriber
+	if (is_map_pending_ && map_pub_.getNumSubscribers() > 0) {
+		map_msg_.header.stamp = stamp;
+		map_msg_.plane_size = plane_size;
+		map_msg_.height_size = height_size;
+
+		// Converting the vertexes into a cell message. Note that the
+		// capacity of the cell buffer is kept between publications
+		map_msg_.cell.resize(last_cells_.size());
+		unsigned int i = 0;
+		for (std::map<dwl::Vertex, dwl::Cell>::const_iterator cell_it = last_cells_.begin();
+				cell_it != last_cells_.end(); cell_it++)
+			toCellMsg(map_msg_.cell[i++], cell_it->second);
+
+		is_map_ready_ = true;
+		is_map_pending_ = false;
+	}
+}
+
+
+void ObstacleMapPublisher::publish()
+{
+	if (is_delta_ready_)
+		delta_pub_.publish(delta_msg_);
+
+	if (is_map_ready_)
+		map_pub_.publish(map_msg_);
+
+	is_delta_ready_ = false;
+	is_map_ready_ = false;
+}
+
+
+void ObstacleMapPublisher::reset()
+{
+	// The messages of the map before the reset aren't published
+	last_cells_.clear();
+	full_delta_ = true;
+	is_map_pending_ = false;
+	is_delta_ready_ = false;
+	is_map_ready_ = false;
+}
+
+
+void ObstacleMapPublisher::toCellMsg(terrain_server::Cell& cell_msg,
+									 const dwl::Cell& cell)
+{
+	cell_msg.key_x = cell.key.x;
+	cell_msg.key_y = cell.key.y;
+	cell_msg.key_z = cell.key.z;
+}
+
+
+bool ObstacleMapPublisher::computeDelta(const std::map<dwl::Vertex, dwl::Cell>& obstacle_map)
+{
+	delta_msg_.full = full_delta_;
+	delta_msg_.added.clear();
+	delta_msg_.removed.clear();
+
+	// Merging the sorted vertexes of the new and last obstacle maps. The last
+	// published cells are updated in place, i.e. only the changed cells are
+	// inserted or removed
+	bool changed = full_delta_;
+	std::map<dwl::Vertex, dwl::Cell>::const_iterator new_it = obstacle_map.begin();
+	std::map<dwl::Vertex, dwl::Cell>::iterator last_it = last_cells_.begin();
+	terrain_server::Cell cell_msg;
+	while (new_it != obstacle_map.end() || last_it != last_cells_.end()) {
+		if (last_it == last_cells_.end() ||
+				(new_it != obstacle_map.end() && new_it->first < last_it->first)) {
+			changed = true;
+			if (publish_delta_) {
+				toCellMsg(cell_msg, new_it->second);
+				delta_msg_.added.push_back(cell_msg);
+			}
+			last_cells_.insert(last_it, *new_it);
+			++new_it;
+		} else if (new_it == obstacle_map.end() || last_it->first < new_it->first) {
+			changed = true;
+			if (publish_delta_) {
+				toCellMsg(cell_msg, last_it->second);
+				delta_msg_.removed.push_back(cell_msg);
+			}
+			last_cells_.erase(last_it++);
+		} else {
+			// The same vertex with a different height is replaced
+			if (new_it->second.key.z != last_it->second.key.z) {
+				changed = true;
+				if (publish_delta_) {
+					toCellMsg(cell_msg, last_it->second);
+					delta_msg_.removed.push_back(cell_msg);
+					toCellMsg(cell_msg, new_it->second);
+					delta_msg_.added.push_back(cell_msg);
+				}
+				last_it->second = new_it->second;
+			}
+			++new_it;
+			++last_it;
+		}
+	}
+
+	if (changed)
+		full_delta_ = false;
+
+	return changed;
+}
+
+} //@namespace terrain_server
@@ -4,18 +4,18 @@
 namespace terrain_server
 {
 
-ObstacleMapServer::ObstacleMapServer() : base_frame_("base_link"), world_frame_("world"), new_information_(false)
+ObstacleMapServer::ObstacleMapServer() : obstacle_discretization_(0.08, 0.08, M_PI / 200),
+		distance_field_size_(5.), max_obstacle_distance_(1.), is_distance_field_(false),
+		occupancy_grid_size_(5.), occupancy_min_z_(-0.5), occupancy_layers_(8),
+		occupancy_layer_height_(0.1), is_occupancy_grid_(false),
+		num_frames_(0),
+		base_frame_("base_link"), world_frame_("world")
 {
 	// Declaring the subscriber to octomap and tf messages
 	octomap_sub_ = new message_filters::Subscriber<octomap_msgs::Octomap> (node_, "octomap_binary", 5);
 	tf_octomap_sub_ = new tf::MessageFilter<octomap_msgs::Octomap> (*octomap_sub_, tf_listener_, world_frame_, 5);
 	tf_octomap_sub_->registerCallback(boost::bind(&ObstacleMapServer::octomapCallback, this, _1));
 
-	// Declaring the publisher of reward map
-	obstacle_pub_ = node_.advertise<terrain_server::ObstacleMap>("obstacle_map", 1);
-
-	obstacle_map_msg_.header.frame_id = world_frame_;
-
 	reset_srv_ = node_.advertiseService("obstacle_map/reset", &ObstacleMapServer::reset, this);
 }
 
@@ -26,6 +26,11 @@ bool ObstacleMapServer::init()
 	node_.param("base_frame", base_frame_, base_frame_);
 	node_.param("world_frame", world_frame_, world_frame_);
 
+	// Declaring the publisher of obstacle map, and optionally its delta stream
+	bool publish_delta = false;
+	node_.param("obstacle_map/publish_delta", publish_delta, publish_delta);
+	obstacle_pub_.init(node_, world_frame_, publish_delta);
+
 	// Getting the names of search areas
 	XmlRpc::XmlRpcValue area_names;
 	if (!node_.getParam("obstacle_map/search_areas", area_names)) {
@@ -58,10 +63,87 @@ bool ObstacleMapServer::init()
 	node_.getParam("reward_map/interest_region/radius_y", radius_y);
 	obstacle_map_.setInterestRegion(radius_x, radius_y);
 
+	// Getting the distance field properties, i.e. the size of its window
+	// around the robot and the maximum distance
+	node_.param("obstacle_map/distance_field/enable", is_distance_field_, is_distance_field_);
+	if (is_distance_field_) {
+		node_.param("obstacle_map/distance_field/size",
+					distance_field_size_, distance_field_size_);
+		node_.param("obstacle_map/distance_field/max_distance",
+					max_obstacle_distance_, max_obstacle_distance_);
+
+		distance_msg_.header.frame_id = world_frame_;
+		distance_pub_ =
+				node_.advertise<terrain_server::DistanceField>("obstacle_map/distance_field", 1);
+		distance_srv_ =
+				node_.advertiseService("obstacle_map/distance",
+									   &ObstacleMapServer::getDistance, this);
+	}
+
+	// Getting the bit-packed occupancy grid properties, i.e. the size of its
+	// window around the robot, and its height layers
+	node_.param("obstacle_map/occupancy_grid/enable", is_occupancy_grid_, is_occupancy_grid_);
+	if (is_occupancy_grid_) {
+		node_.param("obstacle_map/occupancy_grid/size",
+					occupancy_grid_size_, occupancy_grid_size_);
+		node_.param("obstacle_map/occupancy_grid/min_z",
+					occupancy_min_z_, occupancy_min_z_);
+		node_.param("obstacle_map/occupancy_grid/layers",
+					occupancy_layers_, occupancy_layers_);
+		node_.param("obstacle_map/occupancy_grid/layer_height",
+					occupancy_layer_height_, occupancy_layer_height_);
+
+		occupancy_msg_.header.frame_id = world_frame_;
+		occupancy_pub_ =
+				node_.advertise<terrain_server::PackedObstacleMap>("obstacle_map/packed", 1);
+		collision_srv_ =
+				node_.advertiseService("obstacle_map/footprint_collision",
+									   &ObstacleMapServer::checkFootprintCollision, this);
+	}
+
+	// Declaring the periodic publisher of the statistics
+	double statistics_period = 1.;
+	node_.param("obstacle_map/statistics/period", statistics_period, statistics_period);
+	initStatistics();
+	statistics_pub_.init(ros::NodeHandle("~"), "obstacle_map_server",
+						 &statistics_, statistics_period);
+
+	// Enabling the recording of the stage events, they are dumped as a
+	// Chrome trace by the dump_trace service
+	bool enable_trace = false;
+	node_.param("obstacle_map/trace/enable", enable_trace, enable_trace);
+	if (enable_trace) {
+		int trace_capacity = 65536;
+		std::string trace_filename = "/tmp/obstacle_map_server_trace.json";
+		node_.param("obstacle_map/trace/capacity", trace_capacity, trace_capacity);
+		node_.param("obstacle_map/trace/filename", trace_filename, trace_filename);
+		trace_.init(trace_capacity, trace_filename);
+		trace_srv_ =
+				node_.advertiseService("obstacle_map/dump_trace",
+									   &ObstacleMapServer::dumpTrace, this);
+	}
+
 	return true;
 }
 
 
+void ObstacleMapServer::initStatistics()
+{
+	// The order of the stages and counters has to match their enumerations
+	statistics_.addStage("frame");
+	statistics_.addStage("deserialize");
+	statistics_.addStage("tf_lookup");
+	statistics_.addStage("obstacle_map");
+	statistics_.addStage("msg_build");
+	statistics_.addStage("distance_field");
+	statistics_.addStage("occupancy_grid");
+
+	statistics_.addCounter("frames");
+	statistics_.addCounter("tf_failures");
+	statistics_.addCounter("map_size");
+}
+
+
 ObstacleMapServer::~ObstacleMapServer()
 {
 	if (tf_octomap_sub_){
@@ -78,6 +160,10 @@ ObstacleMapServer::~ObstacleMapServer()
 
 void ObstacleMapServer::octomapCallback(const octomap_msgs::Octomap::ConstPtr& msg)
 {
+	double frame_time = getMonotonicTime();
+	num_frames_++;
+	trace_.addInstant("octomap_arrival", num_frames_);
+
 	// Creating a octree
 	octomap::OcTree* octomap = NULL;
 	octomap::AbstractOcTree* tree = octomap_msgs::msgToMap(*msg);
@@ -85,11 +171,16 @@ void ObstacleMapServer::octomapCallback(const octomap_msgs::Octomap::ConstPtr& m
 	if (tree) {
 		octomap = dynamic_cast<octomap::OcTree*>(tree);
 	}
+	double stage_time = getMonotonicTime();
+	statistics_.record(DESERIALIZE_STAGE, stage_time - frame_time);
+	trace_.addEvent("deserialize", frame_time, stage_time - frame_time, num_frames_);
 
 	if (!octomap) {
 		ROS_WARN("Failed to create octree structure");
+		delete tree;
 		return;
 	}
+	boost::shared_ptr<octomap::OcTree> octomap_ptr(octomap);
 
 	// Getting the transformation between the world to robot frame
 	tf::StampedTransform tf_transform;
@@ -97,8 +188,11 @@ void ObstacleMapServer::octomapCallback(const octomap_msgs::Octomap::ConstPtr& m
 		tf_listener_.lookupTransform(world_frame_, base_frame_, msg->header.stamp, tf_transform);
 	} catch (tf::TransformException& ex) {
 		ROS_ERROR_STREAM("Transform error of sensor data: " << ex.what() << ", quitting callback");
+		statistics_.incrementCounter(TF_FAILURES_COUNTER);
 		return;
 	}
+	statistics_.record(TF_STAGE, getMonotonicTime() - stage_time);
+	trace_.addEvent("tf_lookup", stage_time, getMonotonicTime() - stage_time, num_frames_);
 
 	// Getting the robot state (3D position and yaw angle)
 	Eigen::Vector4d robot_position = Eigen::Vector4d::Zero();
@@ -111,21 +205,50 @@ void ObstacleMapServer::octomapCallback(const octomap_msgs::Octomap::ConstPtr& m
 	double yaw = dwl::math::getYaw(dwl::math::getRPY(Eigen::Quaterniond(q.getW(), q.getX(), q.getY(), q.getZ())));
 	robot_position(3) = yaw;
 
-	// Computing the reward map
-	timespec start_rt, end_rt;
-	clock_gettime(CLOCK_REALTIME, &start_rt);
-	obstacle_map_.compute(octomap, robot_position);
-	clock_gettime(CLOCK_REALTIME, &end_rt);
-	double duration = (end_rt.tv_sec - start_rt.tv_sec) + 1e-9*(end_rt.tv_nsec - start_rt.tv_nsec);
-	ROS_INFO("The duration of computation of optimization problem is %f seg.", duration);
+	// Computing the obstacle map
+	{
+		ScopedTimer timer(statistics_.getStage(OBSTACLE_MAP_STAGE));
+		ScopedTrace trace(trace_, "obstacle_map", num_frames_);
+		obstacle_map_.compute(octomap, robot_position);
+	}
+	statistics_.setCounter(MAP_SIZE_COUNTER, obstacle_map_.getObstacleMap().size());
+
+	// Publishing the obstacle map once it's computed
+	publishObstacleMap();
+
+	// Updating the resolution of the obstacle layers
+	obstacle_discretization_.setEnvironmentResolution(obstacle_map_.getResolution(true), true);
+	obstacle_discretization_.setEnvironmentResolution(obstacle_map_.getResolution(false), false);
+
+	// Updating the distance field with the changes of the obstacle map
+	if (is_distance_field_) {
+		ScopedTimer timer(statistics_.getStage(DISTANCE_FIELD_STAGE));
+		ScopedTrace trace(trace_, "distance_field", num_frames_);
+		updateDistanceField(robot_position);
+		publishDistanceField();
+	}
+
+	// Updating the bit-packed occupancy grid
+	if (is_occupancy_grid_) {
+		ScopedTimer timer(statistics_.getStage(OCCUPANCY_GRID_STAGE));
+		ScopedTrace trace(trace_, "occupancy_grid", num_frames_);
+		updateOccupancyGrid(robot_position);
+		publishOccupancyGrid();
+	}
 
-	new_information_ = true;
+	statistics_.record(FRAME_STAGE, getMonotonicTime() - frame_time);
+	trace_.addEvent("frame", frame_time, getMonotonicTime() - frame_time, num_frames_);
+	statistics_.incrementCounter(FRAMES_COUNTER);
+	ROS_DEBUG("The duration of computation of obstacle map is %f seg.",
+			  getMonotonicTime() - frame_time);
 }
 
 
 bool ObstacleMapServer::reset(std_srvs::Empty::Request& req, std_srvs::Empty::Response& resp)
 {
 	obstacle_map_.reset();
+	obstacle_pub_.reset();
+	distance_field_.clear();
 
 	ROS_INFO("Reset obstacle map");
 
@@ -135,41 +258,201 @@ bool ObstacleMapServer::reset(std_srvs::Empty::Request& req, std_srvs::Empty::Re
 
 void ObstacleMapServer::publishObstacleMap()
 {
-	if (new_information_) {
-		// Publishing the reward map if there is at least one subscriber
-		if (obstacle_pub_.getNumSubscribers() > 0) {
-			obstacle_map_msg_.header.stamp = ros::Time::now();
-
-			std::map<dwl::Vertex, dwl::Cell> obstacle_gridmap;
-			obstacle_gridmap = obstacle_map_.getObstacleMap();
-
-			terrain_server::Cell cell;
-			obstacle_map_msg_.plane_size = obstacle_map_.getResolution(true);
-			obstacle_map_msg_.height_size = obstacle_map_.getResolution(false);
-
-			// Converting the vertexs into a cell message
-			for (std::map<dwl::Vertex, dwl::Cell>::iterator vertex_iter = obstacle_gridmap.begin();
-					vertex_iter != obstacle_gridmap.end();
-					vertex_iter++)
-			{
-				dwl::Cell obstacle_cell = vertex_iter->second;
-
-				cell.key_x = obstacle_cell.key.x;
-				cell.key_y = obstacle_cell.key.y;
-				cell.key_z = obstacle_cell.key.z;
-				obstacle_map_msg_.cell.push_back(cell);
-			}
+	ScopedTimer timer(statistics_.getStage(MSG_BUILD_STAGE));
+	ScopedTrace trace(trace_, "msg_build", num_frames_);
+	const std::map<dwl::Vertex, dwl::Cell>& obstacle_gridmap =
+			obstacle_map_.getObstacleMap();
+	obstacle_pub_.publish(obstacle_gridmap,
+						  obstacle_map_.getResolution(true),
+						  obstacle_map_.getResolution(false));
+}
+
 
+void ObstacleMapServer::updateDistanceField(const Eigen::Vector4d& robot_state)
+{
+	// Setting up the window of the distance field given the resolution of
+	// the obstacle map
+	double resolution = obstacle_discretization_.getEnvironmentResolution(true);
+	unsigned int size = ceil(distance_field_size_ / resolution);
+	if (distance_field_.getWidth() != size) {
+		unsigned int max_distance = ceil(max_obstacle_distance_ / resolution);
+		distance_field_.setSize(size, size, max_distance);
+	}
 
-			obstacle_pub_.publish(obstacle_map_msg_);
+	// Moving the window when the robot is far from its centre. In this case
+	// the distance field is recomputed for all the obstacles of the window
+	unsigned short int key_x, key_y;
+	obstacle_discretization_.coordToKey(key_x, robot_state(0), true);
+	obstacle_discretization_.coordToKey(key_y, robot_state(1), true);
+	int center_x = distance_field_.getOriginX() + distance_field_.getWidth() / 2;
+	int center_y = distance_field_.getOriginY() + distance_field_.getHeight() / 2;
+	if (abs((int) key_x - center_x) > (int) distance_field_.getWidth() / 4 ||
+			abs((int) key_y - center_y) > (int) distance_field_.getHeight() / 4) {
+		distance_field_.setOrigin((int) key_x - distance_field_.getWidth() / 2,
+								  (int) key_y - distance_field_.getHeight() / 2);
+	}
+
+	// Updating incrementally the distance field
+	const std::map<dwl::Vertex, dwl::Cell>& obstacle_gridmap =
+			obstacle_map_.getObstacleMap();
+	distance_field_.setObstacleMap(obstacle_gridmap);
+}
 
-			// Deleting old information
-			obstacle_map_msg_.cell.clear();
-			new_information_ = false;
+
+void ObstacleMapServer::publishDistanceField()
+{
+	// Publishing the distance field if there is at least one subscriber
+	if (distance_pub_.getNumSubscribers() > 0) {
+		double resolution = obstacle_discretization_.getEnvironmentResolution(true);
+		unsigned int width = distance_field_.getWidth();
+		unsigned int height = distance_field_.getHeight();
+
+		distance_msg_.header.stamp = ros::Time::now();
+		distance_msg_.origin_key_x = distance_field_.getOriginX();
+		distance_msg_.origin_key_y = distance_field_.getOriginY();
+		distance_msg_.width = width;
+		distance_msg_.height = height;
+		distance_msg_.plane_size = resolution;
+		distance_msg_.max_distance = distance_field_.getMaxDistance() * resolution;
+
+		// Converting the distances to metres (row-major order)
+		distance_msg_.distance.resize(width * height);
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				distance_msg_.distance[y * width + x] =
+						resolution * distance_field_.getDistance(distance_field_.getOriginX() + x,
+																 distance_field_.getOriginY() + y);
+			}
 		}
+
+		distance_pub_.publish(distance_msg_);
 	}
 }
 
+
+double ObstacleMapServer::getObstacleDistance(const Eigen::Vector2d& position)
+{
+	unsigned short int key_x, key_y;
+	obstacle_discretization_.coordToKey(key_x, position(0), true);
+	obstacle_discretization_.coordToKey(key_y, position(1), true);
+
+	return obstacle_discretization_.getEnvironmentResolution(true) *
+			distance_field_.getDistance(key_x, key_y);
+}
+
+
+bool ObstacleMapServer::getDistance(terrain_server::ObstacleDistance::Request& req,
+									terrain_server::ObstacleDistance::Response& res)
+{
+	if (!is_distance_field_)
+		return false;
+
+	ScopedTrace trace(trace_, "distance_query", num_frames_);
+	res.distance = getObstacleDistance(Eigen::Vector2d(req.position.x, req.position.y));
+
+	return true;
+}
+
+
+void ObstacleMapServer::updateOccupancyGrid(const Eigen::Vector4d& robot_state)
+{
+	// Setting up the grid given the resolution of the obstacle map
+	double resolution = obstacle_discretization_.getEnvironmentResolution(true);
+	unsigned int size = ceil(occupancy_grid_size_ / resolution);
+	if (occupancy_grid_.getWidth() != size)
+		occupancy_grid_.setSize(size, size, occupancy_layers_,
+								resolution, occupancy_layer_height_);
+	else
+		occupancy_grid_.clear();
+
+	// Getting the keys of the origin of the positions. The keys are
+	// converted to the centre of the cells as (key - key_origin + 0.5) * size
+	unsigned short int key_xy0, key_z0;
+	obstacle_discretization_.coordToKey(key_xy0, 0., true);
+	obstacle_discretization_.coordToKey(key_z0, 0., false);
+	double height_size = obstacle_discretization_.getEnvironmentResolution(false);
+
+	// Aligning the grid with the cells of the obstacle map (centred on the robot)
+	double half_size = 0.5 * size * resolution;
+	occupancy_grid_.setOrigin(floor((robot_state(0) - half_size) / resolution) * resolution,
+							  floor((robot_state(1) - half_size) / resolution) * resolution,
+							  robot_state(2) + occupancy_min_z_);
+
+	// Setting the occupied cells
+	const std::map<dwl::Vertex, dwl::Cell>& obstacle_gridmap =
+			obstacle_map_.getObstacleMap();
+	for (std::map<dwl::Vertex, dwl::Cell>::const_iterator cell_iter = obstacle_gridmap.begin();
+			cell_iter != obstacle_gridmap.end();
+			cell_iter++)
+	{
+		const dwl::Key& key = cell_iter->second.key;
+		Eigen::Vector3d position;
+		position(0) = ((int) key.x - (int) key_xy0 + 0.5) * resolution;
+		position(1) = ((int) key.y - (int) key_xy0 + 0.5) * resolution;
+		position(2) = ((int) key.z - (int) key_z0 + 0.5) * height_size;
+		occupancy_grid_.setOccupied(position);
+	}
+}
+
+
+void ObstacleMapServer::publishOccupancyGrid()
+{
+	// Publishing the occupancy grid if there is at least one subscriber
+	if (occupancy_pub_.getNumSubscribers() > 0) {
+		occupancy_msg_.header.stamp = ros::Time::now();
+		occupancy_msg_.origin_x = occupancy_grid_.getOrigin()(0);
+		occupancy_msg_.origin_y = occupancy_grid_.getOrigin()(1);
+		occupancy_msg_.origin_z = occupancy_grid_.getOrigin()(2);
+		occupancy_msg_.plane_size = occupancy_grid_.getResolution();
+		occupancy_msg_.layer_height = occupancy_grid_.getLayerHeight();
+		occupancy_msg_.width = occupancy_grid_.getWidth();
+		occupancy_msg_.height = occupancy_grid_.getHeight();
+		occupancy_msg_.layers = occupancy_grid_.getNumLayers();
+		occupancy_msg_.words_per_row = occupancy_grid_.getWordsPerRow();
+		occupancy_msg_.data = occupancy_grid_.getData();
+
+		occupancy_pub_.publish(occupancy_msg_);
+	}
+}
+
+
+const terrain_server::OccupancyBitGrid& ObstacleMapServer::getOccupancyGrid() const
+{
+	return occupancy_grid_;
+}
+
+
+bool ObstacleMapServer::checkFootprintCollision(terrain_server::FootprintCollision::Request& req,
+												terrain_server::FootprintCollision::Response& res)
+{
+	if (!is_occupancy_grid_)
+		return false;
+
+	ScopedTrace trace(trace_, "footprint_collision_query", num_frames_);
+	terrain_server::Footprint footprint;
+	footprint.min_z = req.min_z;
+	footprint.max_z = req.max_z;
+	footprint.polygon.resize(req.footprint.size());
+	for (unsigned int i = 0; i < req.footprint.size(); i++)
+		footprint.polygon[i] = Eigen::Vector2d(req.footprint[i].x, req.footprint[i].y);
+
+	std::vector<Eigen::Vector3d> poses(req.poses.size());
+	for (unsigned int i = 0; i < req.poses.size(); i++)
+		poses[i] = Eigen::Vector3d(req.poses[i].x, req.poses[i].y, req.poses[i].theta);
+
+	std::vector<bool> collisions;
+	res.num_collisions = occupancy_grid_.checkCollisions(collisions, poses, footprint);
+	res.collision.assign(collisions.begin(), collisions.end());
+
+	return true;
+}
+
+bool ObstacleMapServer::dumpTrace(terrain_server::DumpTrace::Request& req,
+								  terrain_server::DumpTrace::Response& res)
+{
+	return trace_.handleDump(req, res);
+}
+
 } //@namespace terrain_server
 
 
@@ -181,19 +464,8 @@ int main(int argc, char **argv)
 	if (!obstacle_server.init())
 			return -1;
 
-	ros::spinOnce();
-
-	try {
-		ros::Rate loop_rate(100);
-		while(ros::ok()) {
-			obstacle_server.publishObstacleMap();
-			ros::spinOnce();
-			loop_rate.sleep();
-		}
-	} catch(std::runtime_error& e) {
-		ROS_ERROR("obstacle_map_server exception: %s", e.what());
-		return -1;
-	}
+	// The obstacle map is published once it's computed
+	ros::spin();
 
 	return 0;
 }
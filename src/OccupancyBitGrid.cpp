@@ -0,0 +1,279 @@
+#include <terrain_server/OccupancyBitGrid.h>
+#include <algorithm>
+#include <math.h>
+
+
+namespace terrain_server
+{
+
+Footprint Footprint::rectangle(double length, double width,
+							   double min_z, double max_z)
+{
+	Footprint footprint;
+	footprint.polygon.push_back(Eigen::Vector2d(length / 2, width / 2));
+	footprint.polygon.push_back(Eigen::Vector2d(-length / 2, width / 2));
+	footprint.polygon.push_back(Eigen::Vector2d(-length / 2, -width / 2));
+	footprint.polygon.push_back(Eigen::Vector2d(length / 2, -width / 2));
+	footprint.min_z = min_z;
+	footprint.max_z = max_z;
+
+	return footprint;
+}
+
+
+OccupancyBitGrid::OccupancyBitGrid() : origin_(Eigen::Vector3d::Zero()),
+		width_(0), height_(0), num_layers_(0), words_per_row_(0),
+		resolution_(1.), layer_height_(1.)
+{
+
+}
+
+
+OccupancyBitGrid::~OccupancyBitGrid()
+{
+
+}
+
+
+void OccupancyBitGrid::setSize(unsigned int width,
+							   unsigned int height,
+							   unsigned int num_layers,
+							   double resolution,
+							   double layer_height)
+{
+	width_ = width;
+	height_ = height;
+	num_layers_ = num_layers;
+	words_per_row_ = (width + 63) / 64;
+	resolution_ = resolution;
+	layer_height_ = layer_height;
+	data_.assign(num_layers_ * height_ * words_per_row_, 0);
+}
+
+
+void OccupancyBitGrid::setOrigin(double x, double y, double z)
+{
+	origin_ = Eigen::Vector3d(x, y, z);
+}
+
+
+void OccupancyBitGrid::clear()
+{
+	std::fill(data_.begin(), data_.end(), 0);
+}
+
+
+void OccupancyBitGrid::setOccupied(const Eigen::Vector3d& position)
+{
+	int x = floor((position(0) - origin_(0)) / resolution_);
+	int y = floor((position(1) - origin_(1)) / resolution_);
+	int l = floor((position(2) - origin_(2)) / layer_height_);
+	if (x < 0 || y < 0 || l < 0 ||
+			x >= (int) width_ || y >= (int) height_ || l >= (int) num_layers_)
+		return;
+
+	data_[(l * height_ + y) * words_per_row_ + (x >> 6)] |= (uint64_t) 1 << (x & 63);
+}
+
+
+bool OccupancyBitGrid::isOccupied(const Eigen::Vector3d& position) const
+{
+	int x = floor((position(0) - origin_(0)) / resolution_);
+	int y = floor((position(1) - origin_(1)) / resolution_);
+	int l = floor((position(2) - origin_(2)) / layer_height_);
+	if (x < 0 || y < 0 || l < 0 ||
+			x >= (int) width_ || y >= (int) height_ || l >= (int) num_layers_)
+		return false;
+
+	return (data_[(l * height_ + y) * words_per_row_ + (x >> 6)] >> (x & 63)) & 1;
+}
+
+
+bool OccupancyBitGrid::isColliding(const Eigen::Vector3d& pose,
+								   const Footprint& footprint) const
+{
+	std::vector<uint64_t> rows;
+	if (!mergeLayers(rows, footprint.min_z, footprint.max_z))
+		return false;
+
+	return isColliding(rows, pose, footprint);
+}
+
+
+unsigned int OccupancyBitGrid::checkCollisions(std::vector<bool>& collisions,
+											   const std::vector<Eigen::Vector3d>& poses,
+											   const Footprint& footprint) const
+{
+	collisions.assign(poses.size(), false);
+
+	// Merging once the layers for all the poses
+	std::vector<uint64_t> rows;
+	if (!mergeLayers(rows, footprint.min_z, footprint.max_z))
+		return 0;
+
+	unsigned int num_collisions = 0;
+	for (unsigned int i = 0; i < poses.size(); i++) {
+		if (isColliding(rows, poses[i], footprint)) {
+			collisions[i] = true;
+			num_collisions++;
+		}
+	}
+
+	return num_collisions;
+}
+
+
+const std::vector<uint64_t>& OccupancyBitGrid::getData() const
+{
+	return data_;
+}
+
+
+const Eigen::Vector3d& OccupancyBitGrid::getOrigin() const
+{
+	return origin_;
+}
+
+
+unsigned int OccupancyBitGrid::getWidth() const
+{
+	return width_;
+}
+
+
+unsigned int OccupancyBitGrid::getHeight() const
+{
+	return height_;
+}
+
+
+unsigned int OccupancyBitGrid::getNumLayers() const
+{
+	return num_layers_;
+}
+
+
+unsigned int OccupancyBitGrid::getWordsPerRow() const
+{
+	return words_per_row_;
+}
+
+
+double OccupancyBitGrid::getResolution() const
+{
+	return resolution_;
+}
+
+
+double OccupancyBitGrid::getLayerHeight() const
+{
+	return layer_height_;
+}
+
+
+bool OccupancyBitGrid::mergeLayers(std::vector<uint64_t>& rows,
+								   double min_z, double max_z) const
+{
+	// Computing the layers that overlap the height range
+	double min_layer = std::max(0., floor((min_z - origin_(2)) / layer_height_));
+	double max_layer = std::min((double) num_layers_ - 1,
+								floor((max_z - origin_(2)) / layer_height_));
+	if (max_layer < min_layer)
+		return false;
+
+	unsigned int layer_size = height_ * words_per_row_;
+	rows.assign(data_.begin() + (int) min_layer * layer_size,
+				data_.begin() + ((int) min_layer + 1) * layer_size);
+	for (int l = (int) min_layer + 1; l <= (int) max_layer; l++) {
+		const uint64_t* layer = &data_[l * layer_size];
+		for (unsigned int i = 0; i < layer_size; i++)
+			rows[i] |= layer[i];
+	}
+
+	return true;
+}
+
+
+bool OccupancyBitGrid::isColliding(const std::vector<uint64_t>& rows,
+								   const Eigen::Vector3d& pose,
+								   const Footprint& footprint) const
+{
+	// Transforming the polygon to the grid frame (in cell units)
+	unsigned int num_vertices = footprint.polygon.size();
+	if (num_vertices == 0)
+		return false;
+
+	double c = cos(pose(2)), s = sin(pose(2));
+	std::vector<Eigen::Vector2d> vertices(num_vertices);
+	double min_y = std::numeric_limits<double>::max();
+	double max_y = -std::numeric_limits<double>::max();
+	for (unsigned int i = 0; i < num_vertices; i++) {
+		const Eigen::Vector2d& p = footprint.polygon[i];
+		vertices[i](0) = (c * p(0) - s * p(1) + pose(0) - origin_(0)) / resolution_;
+		vertices[i](1) = (s * p(0) + c * p(1) + pose(1) - origin_(1)) / resolution_;
+		min_y = std::min(min_y, vertices[i](1));
+		max_y = std::max(max_y, vertices[i](1));
+	}
+
+	// Testing the span of every row band covered by the polygon. The span
+	// is the x-extent of the edges clipped to the band (conservative for
+	// non-convex polygons)
+	int first_row = std::max(0, (int) floor(min_y));
+	int last_row = std::min((int) height_ - 1, (int) floor(max_y));
+	for (int r = first_row; r <= last_row; r++) {
+		double band_min = r, band_max = r + 1;
+		double min_x = std::numeric_limits<double>::max();
+		double max_x = -std::numeric_limits<double>::max();
+		for (unsigned int i = 0; i < num_vertices; i++) {
+			const Eigen::Vector2d& p = vertices[i];
+			const Eigen::Vector2d& q = vertices[(i + 1) % num_vertices];
+			double y0 = std::min(p(1), q(1)), y1 = std::max(p(1), q(1));
+			if (y1 < band_min || y0 > band_max)
+				continue;
+
+			if (p(1) == q(1)) {
+				min_x = std::min(min_x, std::min(p(0), q(0)));
+				max_x = std::max(max_x, std::max(p(0), q(0)));
+			} else {
+				// Clipping the edge to the row band
+				double ta = (std::max(y0, band_min) - p(1)) / (q(1) - p(1));
+				double tb = (std::min(y1, band_max) - p(1)) / (q(1) - p(1));
+				double xa = p(0) + ta * (q(0) - p(0));
+				double xb = p(0) + tb * (q(0) - p(0));
+				min_x = std::min(min_x, std::min(xa, xb));
+				max_x = std::max(max_x, std::max(xa, xb));
+			}
+		}
+
+		if (max_x < 0 || min_x >= width_)
+			continue;
+
+		int span_min = std::max(0, (int) floor(min_x));
+		int span_max = std::min((int) width_ - 1, (int) floor(max_x));
+		if (testSpan(&rows[r * words_per_row_], span_min, span_max))
+			return true;
+	}
+
+	return false;
+}
+
+
+bool OccupancyBitGrid::testSpan(const uint64_t* row, int min_x, int max_x) const
+{
+	int first_word = min_x >> 6, last_word = max_x >> 6;
+	uint64_t first_mask = ~(uint64_t) 0 << (min_x & 63);
+	uint64_t last_mask = ~(uint64_t) 0 >> (63 - (max_x & 63));
+	if (first_word == last_word)
+		return row[first_word] & first_mask & last_mask;
+
+	if (row[first_word] & first_mask)
+		return true;
+	for (int w = first_word + 1; w < last_word; w++) {
+		if (row[w])
+			return true;
+	}
+
+	return row[last_word] & last_mask;
+}
+
+} //@namespace terrain_server
@@ -0,0 +1,247 @@
+#include <terrain_server/SceneGenerator.h>
+#include <math.h>
+#include <algorithm>
+#include <random>
+
+
+namespace terrain_server
+{
+
+/** @brief Height function of a flat patch */
+struct FlatHeight
+{
+	FlatHeight(double height) : height(height) {}
+	double operator()(double, double) const { return height; }
+	double height;
+};
+
+
+/** @brief Height function of an inclined patch */
+struct SlopeHeight
+{
+	SlopeHeight(double height, double angle) : height(height), tan_angle(tan(angle)) {}
+	double operator()(double x, double) const { return height + x * tan_angle; }
+	double height;
+	double tan_angle;
+};
+
+
+/** @brief Height function of a bilinear interpolation of a random lattice */
+struct LatticeHeight
+{
+	LatticeHeight(double length, double width, double height, double amplitude,
+				  double wavelength, unsigned int seed) : min_x(-length / 2),
+				  min_y(-width / 2), height(height), wavelength(wavelength)
+	{
+		cols = ceil(length / wavelength) + 2;
+		rows = ceil(width / wavelength) + 2;
+		std::mt19937 generator(seed);
+		std::uniform_real_distribution<double> distribution(-amplitude, amplitude);
+		lattice.resize(rows * cols);
+		for (unsigned int i = 0; i < lattice.size(); i++)
+			lattice[i] = distribution(generator);
+	}
+
+	double operator()(double x, double y) const
+	{
+		double u = (x - min_x) / wavelength, v = (y - min_y) / wavelength;
+		int i = std::min((int) u, cols - 2), j = std::min((int) v, rows - 2);
+		double du = u - i, dv = v - j;
+		return height +
+				(1 - dv) * ((1 - du) * lattice[j * cols + i] + du * lattice[j * cols + i + 1]) +
+				dv * ((1 - du) * lattice[(j + 1) * cols + i] + du * lattice[(j + 1) * cols + i + 1]);
+	}
+
+	double min_x, min_y;
+	double height;
+	double wavelength;
+	int rows, cols;
+	std::vector<double> lattice;
+};
+
+
+SceneGenerator::SceneGenerator() : position_(Eigen::Vector3d::Zero())
+{
+
+}
+
+
+SceneGenerator::~SceneGenerator()
+{
+
+}
+
+
+void SceneGenerator::setPosition(const Eigen::Vector3d& position)
+{
+	position_ = position;
+}
+
+
+void SceneGenerator::clear()
+{
+	points_.clear();
+}
+
+
+void SceneGenerator::addRectangle(const Rectangle& rectangle)
+{
+	if (rectangle.resolution <= 0.)
+		return;
+
+	// The points are symmetric w.r.t. the centre of the rectangle
+	for (double xi = 0; xi < rectangle.length / 2; xi += rectangle.resolution) {
+		for (int sx = -1; sx <= 1; sx += 2) {
+			if (xi == 0 && sx == 1)
+				continue;
+
+			for (double yi = 0; yi < rectangle.width / 2; yi += rectangle.resolution) {
+				for (int sy = -1; sy <= 1; sy += 2) {
+					if (yi == 0 && sy == 1)
+						continue;
+
+					addLocalPoint(rectangle.center_x, rectangle.center_y, rectangle.yaw,
+								  sx * xi, sy * yi, rectangle.height);
+				}
+			}
+		}
+	}
+}
+
+
+void SceneGenerator::addStairs(double x, double y, double yaw,
+							   int num_steps, double step_height,
+							   double step_length, double width,
+							   double resolution)
+{
+	if (resolution <= 0.)
+		return;
+
+	for (int i = 0; i < num_steps; i++) {
+		// Adding the tread of the step
+		double tread_x = (i + 0.5) * step_length;
+		addPatch(x + tread_x * cos(yaw), y + tread_x * sin(yaw), yaw,
+				 step_length, width, resolution,
+				 FlatHeight((i + 1) * step_height));
+
+		// Adding the riser of the step
+		for (double z = i * step_height; z < (i + 1) * step_height; z += resolution) {
+			for (double yi = -width / 2; yi <= width / 2; yi += resolution)
+				addLocalPoint(x, y, yaw, i * step_length, yi, z);
+		}
+	}
+}
+
+
+void SceneGenerator::addGap(double x, double y, double yaw,
+							double gap_length, double platform_length,
+							double width, double height,
+							double resolution)
+{
+	double offset = (gap_length + platform_length) / 2;
+	for (int s = -1; s <= 1; s += 2) {
+		addPatch(x + s * offset * cos(yaw), y + s * offset * sin(yaw), yaw,
+				 platform_length, width, resolution, FlatHeight(height));
+	}
+}
+
+
+void SceneGenerator::addSteppingStones(double x, double y, double yaw,
+									   int rows, int cols,
+									   double stone_size, double spacing,
+									   double height, double height_noise,
+									   double resolution, unsigned int seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<double> distribution(-height_noise, height_noise);
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < cols; j++) {
+			double local_x = (i - 0.5 * (rows - 1)) * spacing;
+			double local_y = (j - 0.5 * (cols - 1)) * spacing;
+			double stone_height = height;
+			if (height_noise > 0.)
+				stone_height += distribution(generator);
+
+			addPatch(x + local_x * cos(yaw) - local_y * sin(yaw),
+					 y + local_x * sin(yaw) + local_y * cos(yaw), yaw,
+					 stone_size, stone_size, resolution, FlatHeight(stone_height));
+		}
+	}
+}
+
+
+void SceneGenerator::addSlope(double x, double y, double yaw,
+							  double length, double width,
+							  double height, double angle,
+							  double resolution)
+{
+	addPatch(x, y, yaw, length, width, resolution, SlopeHeight(height, angle));
+}
+
+
+void SceneGenerator::addRoughTerrain(double x, double y,
+									 double length, double width,
+									 double height, double amplitude,
+									 double wavelength, double resolution,
+									 unsigned int seed)
+{
+	if (wavelength <= 0.)
+		return;
+
+	addPatch(x, y, 0., length, width, resolution,
+			 LatticeHeight(length, width, height, amplitude, wavelength, seed));
+}
+
+
+const std::vector<Eigen::Vector3d>& SceneGenerator::getPoints() const
+{
+	return points_;
+}
+
+
+void SceneGenerator::getOcTree(octomap::OcTree& octree) const
+{
+	for (unsigned int i = 0; i < points_.size(); i++) {
+		octree.updateNode(octomap::point3d(points_[i](0), points_[i](1), points_[i](2)),
+						  true, true);
+	}
+	octree.updateInnerOccupancy();
+}
+
+
+template<typename HeightFunction>
+void SceneGenerator::addPatch(double x, double y, double yaw,
+							  double length, double width,
+							  double resolution,
+							  const HeightFunction& height)
+{
+	if (resolution <= 0.)
+		return;
+
+	int num_x = floor(length / resolution);
+	int num_y = floor(width / resolution);
+
+	// Growing the points geometrically, i.e. a scene of many patches isn't
+	// copied on every patch
+	std::size_t num_points = points_.size() + (num_x + 1) * (num_y + 1);
+	if (num_points > points_.capacity())
+		points_.reserve(std::max(num_points, 2 * points_.capacity()));
+	for (int i = 0; i <= num_x; i++) {
+		double local_x = -length / 2 + i * resolution;
+		for (int j = 0; j <= num_y; j++) {
+			double local_y = -width / 2 + j * resolution;
+			addLocalPoint(x, y, yaw, local_x, local_y, height(local_x, local_y));
+		}
+	}
+}
+
+
+void SceneGenerator::addLocalPoint(double x, double y, double yaw,
+								   double local_x, double local_y, double z)
+{
+	points_.push_back(Eigen::Vector3d(local_x * cos(yaw) - local_y * sin(yaw) + x,
+									  local_x * sin(yaw) + local_y * cos(yaw) + y,
+									  z) + position_);
+}
+
+} //@namespace terrain_server
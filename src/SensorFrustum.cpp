@@ -0,0 +1,112 @@
+#include <terrain_server/SensorFrustum.h>
+
+#include <algorithm>
+
+
+namespace terrain_server
+{
+
+SensorFrustum::SensorFrustum() : is_set_(false)
+{
+
+}
+
+
+SensorFrustum::~SensorFrustum()
+{
+
+}
+
+
+bool SensorFrustum::set(const CameraIntrinsics& intrinsics,
+						unsigned int width, unsigned int height,
+						const Eigen::Affine3d& sensor_pose,
+						double min_depth, double max_depth)
+{
+	is_set_ = false;
+	if (intrinsics.fx == 0. || intrinsics.fy == 0. || width == 0 || height == 0 ||
+			max_depth <= min_depth)
+		return false;
+
+	// Getting the rays of the corners of the image (optical frame)
+	double u[4] = {0., (double) width, (double) width, 0.};
+	double v[4] = {0., 0., (double) height, (double) height};
+	Eigen::Vector3d rays[4];
+	Eigen::Vector3d centre = Eigen::Vector3d::Zero();
+	for (unsigned int c = 0; c < 4; c++) {
+		rays[c] = Eigen::Vector3d((u[c] - intrinsics.cx) / intrinsics.fx,
+								  (v[c] - intrinsics.cy) / intrinsics.fy,
+								  1.);
+		centre += rays[c];
+	}
+
+	// The side planes contain the origin of the sensor and two adjacent
+	// corner rays, and their normals point to the centre of the image
+	const Eigen::Matrix3d& rotation = sensor_pose.linear();
+	const Eigen::Vector3d& origin = sensor_pose.translation();
+	for (unsigned int c = 0; c < 4; c++) {
+		Eigen::Vector3d normal = rays[c].cross(rays[(c + 1) % 4]).normalized();
+		if (normal.dot(centre) < 0.)
+			normal = -normal;
+		normals_[c] = rotation * normal;
+		offsets_[c] = -normals_[c].dot(origin);
+	}
+
+	// Near and far planes
+	Eigen::Vector3d axis = rotation.col(2);
+	normals_[4] = axis;
+	offsets_[4] = -axis.dot(origin) - min_depth;
+	normals_[5] = -axis;
+	offsets_[5] = axis.dot(origin) + max_depth;
+
+	is_set_ = true;
+	return true;
+}
+
+
+void SensorFrustum::clear()
+{
+	is_set_ = false;
+}
+
+
+bool SensorFrustum::isSet() const
+{
+	return is_set_;
+}
+
+
+bool SensorFrustum::isColumnVisible(double x, double y,
+									double min_z, double max_z,
+									double margin) const
+{
+	if (!is_set_)
+		return true;
+
+	// Clipping the segment of the column with the planes, i.e. the column
+	// is visible if a part of it is inside all of them
+	double length = max_z - min_z;
+	double t_min = 0., t_max = 1.;
+	for (unsigned int p = 0; p < 6; p++) {
+		const Eigen::Vector3d& normal = normals_[p];
+		double distance = normal(0) * x + normal(1) * y + normal(2) * min_z +
+				offsets_[p] + margin;
+		double rate = normal(2) * length;
+		if (rate == 0.) {
+			if (distance < 0.)
+				return false;
+		} else {
+			double t = -distance / rate;
+			if (rate > 0.)
+				t_min = std::max(t_min, t);
+			else
+				t_max = std::min(t_max, t);
+			if (t_min > t_max)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+} //@namespace terrain_server
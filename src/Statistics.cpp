@@ -0,0 +1,226 @@
+#include <terrain_server/Statistics.h>
+#include <math.h>
+
+
+namespace terrain_server
+{
+
+double HistogramSnapshot::getPercentile(double p) const
+{
+	if (count == 0)
+		return 0.;
+
+	// Returning the middle of the bucket that contains the percentile
+	uint64_t rank = (uint64_t) ceil(p * count);
+	if (rank == 0)
+		rank = 1;
+	uint64_t accumulated = 0;
+	for (unsigned int i = 0; i < buckets.size(); i++) {
+		accumulated += buckets[i];
+		if (accumulated >= rank) {
+			uint64_t lower = LatencyHistogram::getBucketLowerBound(i);
+			uint64_t upper = LatencyHistogram::getBucketLowerBound(i + 1);
+			return 0.5e-9 * (lower + upper);
+		}
+	}
+
+	return getMax();
+}
+
+
+double HistogramSnapshot::getMean() const
+{
+	if (count == 0)
+		return 0.;
+
+	return 1e-9 * sum / count;
+}
+
+
+double HistogramSnapshot::getMax() const
+{
+	for (int i = buckets.size() - 1; i >= 0; i--) {
+		if (buckets[i] > 0)
+			return 1e-9 * LatencyHistogram::getBucketLowerBound(i + 1);
+	}
+
+	return 0.;
+}
+
+
+HistogramSnapshot HistogramSnapshot::operator-(const HistogramSnapshot& previous) const
+{
+	HistogramSnapshot difference = *this;
+	if (previous.buckets.size() != buckets.size())
+		return difference;
+
+	for (unsigned int i = 0; i < buckets.size(); i++)
+		difference.buckets[i] -= previous.buckets[i];
+	difference.count -= previous.count;
+	difference.sum -= previous.sum;
+
+	return difference;
+}
+
+
+LatencyHistogram::LatencyHistogram() : count_(0), sum_(0)
+{
+	for (unsigned int i = 0; i < NUM_BUCKETS; i++)
+		buckets_[i].store(0, std::memory_order_relaxed);
+}
+
+
+LatencyHistogram::~LatencyHistogram()
+{
+
+}
+
+
+void LatencyHistogram::record(double duration)
+{
+	uint64_t nanoseconds = duration > 0. ? (uint64_t) (1e9 * duration) : 0;
+	buckets_[getBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+	sum_.fetch_add(nanoseconds, std::memory_order_relaxed);
+	count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void LatencyHistogram::getSnapshot(HistogramSnapshot& snapshot) const
+{
+	// The buckets are read without stopping the writers, so the count is
+	// computed from them to get a consistent snapshot
+	snapshot.buckets.resize(NUM_BUCKETS);
+	snapshot.count = 0;
+	for (unsigned int i = 0; i < NUM_BUCKETS; i++) {
+		snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+		snapshot.count += snapshot.buckets[i];
+	}
+	snapshot.sum = sum_.load(std::memory_order_relaxed);
+}
+
+
+uint64_t LatencyHistogram::getCount() const
+{
+	return count_.load(std::memory_order_relaxed);
+}
+
+
+unsigned int LatencyHistogram::getBucket(uint64_t nanoseconds)
+{
+	// The first 8 buckets are linear, after that the bucket is given by the
+	// most significant bit and the three following bits
+	if (nanoseconds < 8)
+		return nanoseconds;
+
+	unsigned int msb = 63 - __builtin_clzll(nanoseconds);
+	unsigned int sub_bucket = (nanoseconds >> (msb - 3)) & 7;
+	unsigned int bucket = (msb - 2) * 8 + sub_bucket;
+	if (bucket >= NUM_BUCKETS)
+		return NUM_BUCKETS - 1;
+
+	return bucket;
+}
+
+
+uint64_t LatencyHistogram::getBucketLowerBound(unsigned int bucket)
+{
+	if (bucket < 8)
+		return bucket;
+
+	unsigned int msb = bucket / 8 + 2;
+	uint64_t sub_bucket = bucket % 8;
+	return (8 + sub_bucket) << (msb - 3);
+}
+
+
+Statistics::Statistics()
+{
+
+}
+
+
+Statistics::~Statistics()
+{
+
+}
+
+
+unsigned int Statistics::addStage(const std::string& name)
+{
+	stage_names_.push_back(name);
+	stages_.push_back(std::unique_ptr<LatencyHistogram>(new LatencyHistogram()));
+
+	return stages_.size() - 1;
+}
+
+
+unsigned int Statistics::addCounter(const std::string& name)
+{
+	counter_names_.push_back(name);
+	counters_.push_back(
+			std::unique_ptr<std::atomic<uint64_t> >(new std::atomic<uint64_t>(0)));
+
+	return counters_.size() - 1;
+}
+
+
+LatencyHistogram& Statistics::getStage(unsigned int stage)
+{
+	return *stages_[stage];
+}
+
+
+const LatencyHistogram& Statistics::getStage(unsigned int stage) const
+{
+	return *stages_[stage];
+}
+
+
+void Statistics::record(unsigned int stage, double duration)
+{
+	stages_[stage]->record(duration);
+}
+
+
+void Statistics::setCounter(unsigned int counter, uint64_t value)
+{
+	counters_[counter]->store(value, std::memory_order_relaxed);
+}
+
+
+void Statistics::incrementCounter(unsigned int counter, uint64_t value)
+{
+	counters_[counter]->fetch_add(value, std::memory_order_relaxed);
+}
+
+
+uint64_t Statistics::getCounter(unsigned int counter) const
+{
+	return counters_[counter]->load(std::memory_order_relaxed);
+}
+
+
+unsigned int Statistics::getNumStages() const
+{
+	return stages_.size();
+}
+
+
+unsigned int Statistics::getNumCounters() const
+{
+	return counters_.size();
+}
+
+
+const std::string& Statistics::getStageName(unsigned int stage) const
+{
+	return stage_names_[stage];
+}
+
+
+const std::string& Statistics::getCounterName(unsigned int counter) const
+{
+	return counter_names_[counter];
+}
+
+} //@namespace terrain_server
@@ -0,0 +1,92 @@
+#include <terrain_server/StatisticsPublisher.h>
+#include <sstream>
+
+
+namespace terrain_server
+{
+
+StatisticsPublisher::StatisticsPublisher() : statistics_(NULL), last_time_(0.)
+{
+
+}
+
+
+StatisticsPublisher::~StatisticsPublisher()
+{
+
+}
+
+
+void StatisticsPublisher::init(ros::NodeHandle node,
+							   const std::string& name,
+							   const Statistics* statistics,
+							   double period)
+{
+	statistics_ = statistics;
+	if (period <= 0.)
+		return;
+
+	statistics_msg_.status.resize(1);
+	statistics_msg_.status[0].name = name;
+	statistics_msg_.status[0].hardware_id = name;
+	statistics_msg_.status[0].level = diagnostic_msgs::DiagnosticStatus::OK;
+
+	last_snapshots_.resize(statistics_->getNumStages());
+	last_time_ = getMonotonicTime();
+
+	statistics_pub_ = node.advertise<diagnostic_msgs::DiagnosticArray>("statistics", 1);
+	timer_ = node.createTimer(ros::Duration(period), &StatisticsPublisher::publish, this);
+}
+
+
+void StatisticsPublisher::publish(const ros::TimerEvent& event)
+{
+	double current_time = getMonotonicTime();
+	double period = current_time - last_time_;
+	last_time_ = current_time;
+
+	diagnostic_msgs::DiagnosticStatus& status = statistics_msg_.status[0];
+	status.values.clear();
+
+	// Adding the latency percentiles (in ms) and the rate of every stage
+	// over the last period
+	unsigned int num_frames = 0;
+	HistogramSnapshot snapshot;
+	for (unsigned int i = 0; i < statistics_->getNumStages(); i++) {
+		statistics_->getStage(i).getSnapshot(snapshot);
+		HistogramSnapshot window = snapshot - last_snapshots_[i];
+		last_snapshots_[i] = snapshot;
+		if (i == 0)
+			num_frames = window.count;
+
+		const std::string& stage = statistics_->getStageName(i);
+		addValue(stage + "/p50_ms", 1e3 * window.getPercentile(0.5));
+		addValue(stage + "/p90_ms", 1e3 * window.getPercentile(0.9));
+		addValue(stage + "/p99_ms", 1e3 * window.getPercentile(0.99));
+		addValue(stage + "/max_ms", 1e3 * window.getMax());
+		addValue(stage + "/mean_ms", 1e3 * window.getMean());
+		addValue(stage + "/rate_hz", window.count / period);
+	}
+
+	// Adding the counters
+	for (unsigned int i = 0; i < statistics_->getNumCounters(); i++)
+		addValue(statistics_->getCounterName(i), statistics_->getCounter(i));
+
+	status.message = num_frames > 0 ? "Running" : "No frames in the last period";
+	statistics_msg_.header.stamp = ros::Time::now();
+	statistics_pub_.publish(statistics_msg_);
+}
+
+
+void StatisticsPublisher::addValue(const std::string& key, double value)
+{
+	std::ostringstream stream;
+	stream << value;
+
+	diagnostic_msgs::KeyValue key_value;
+	key_value.key = key;
+	key_value.value = stream.str();
+	statistics_msg_.status[0].values.push_back(key_value);
+}
+
+} //@namespace terrain_server
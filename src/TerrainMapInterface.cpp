@@ -1,18 +1,20 @@
 #include <terrain_server/TerrainMapInterface.h>
 
+#include <algorithm>
+
 
 namespace terrain_server
 {
 
-TerrainMapInterface::TerrainMapInterface() : new_msg_(false),
-		is_terrain_data_(false)
+TerrainMapInterface::TerrainMapInterface() : num_received_chunks_(0), is_pyramid_(false),
+		is_streaming_(false), new_msg_(false), is_terrain_data_(false)
 {
 	ros::NodeHandle node;
 	terrain_clt_ =
 			node.serviceClient<terrain_server::TerrainData>("/terrain_map/data");
 	reset_clt_ =
 			node.serviceClient<std_srvs::Empty>("/terrain_map/reset");
-	terrain_map_.reset(new dwl::environment::TerrainMap());
+	terrain_map_.reset(new ChunkTerrainMap());
 }
 
 
@@ -22,15 +24,26 @@ TerrainMapInterface::~TerrainMapInterface()
 }
 
 
-void TerrainMapInterface::init(ros::NodeHandle node)
+void TerrainMapInterface::init(ros::NodeHandle node, bool streaming)
 {
-	sub_ = node.subscribe<terrain_server::TerrainMap> ("/terrain_map", 1,
-			&TerrainMapInterface::callback, this, ros::TransportHints().tcpNoDelay());
+	is_streaming_ = streaming;
+	if (is_streaming_) {
+		sub_ = node.subscribe<terrain_server::TerrainMapChunk> ("/terrain_map_chunks", 64,
+				&TerrainMapInterface::chunkCallback, this, ros::TransportHints().tcpNoDelay());
+		resend_pub_ = node.advertise<std_msgs::Empty>("/terrain_map/resend_chunks", 1);
+	} else
+		sub_ = node.subscribe<terrain_server::TerrainMap> ("/terrain_map", 1,
+				&TerrainMapInterface::callback, this, ros::TransportHints().tcpNoDelay());
 }
 
 
 void TerrainMapInterface::updateTerrainMap()
 {
+	if (is_streaming_) {
+		updateTerrainChunks();
+		return;
+	}
+
 	// Checks if there is a new terrain map message
 	if (new_msg_) {
 		// Setting the terrain map to be updated
@@ -42,27 +55,15 @@ void TerrainMapInterface::updateTerrainMap()
 		terrain_data_.data.resize(num_cells);
 
 		// Setting up the terrain resolution
-		terrain_data_.plane_size = map_msg_.plane_size;
-		terrain_data_.height_size = map_msg_.height_size;
+		setResolution(map_msg_.plane_size, map_msg_.height_size);
 
 		// Converting the messages to dwl::TerrainMap format
-		dwl::TerrainCell cell;
-		for (unsigned int i = 0; i < num_cells; i++) {
-			// Filling the terrain values per every cell
-			cell.key.x = map_msg_.cell[i].key_x;
-			cell.key.y = map_msg_.cell[i].key_y;
-			cell.key.z = map_msg_.cell[i].key_z;
-			cell.cost = map_msg_.cell[i].cost;
-			cell.normal =
-					Eigen::Vector3d(map_msg_.cell[i].normal.x,
-									map_msg_.cell[i].normal.y,
-									map_msg_.cell[i].normal.z);
-
-			// Adding the terrain cell to the queue
-			terrain_data_.data[i] = cell;
-		}
+		for (unsigned int i = 0; i < num_cells; i++)
+			toTerrainCell(terrain_data_.data[i], map_msg_.cell[i]);
 
 		terrain_map_->setTerrainMap(terrain_data_);
+		if (is_pyramid_)
+			pyramid_.build(terrain_data_.data);
 
 		// We have an initial map
 		if (!is_terrain_data_)
@@ -71,6 +72,78 @@ void TerrainMapInterface::updateTerrainMap()
 }
 
 
+void TerrainMapInterface::updateTerrainChunks()
+{
+	// Getting the received chunks without blocking the caller
+	std::vector<terrain_server::TerrainMapChunkConstPtr> chunks;
+	if (!new_msg_ || !chunk_mutex_.try_lock())
+		return;
+	chunks.swap(chunk_queue_);
+	new_msg_ = false;
+	chunk_mutex_.unlock();
+
+	// Replacing the cells of the received chunks, and removing the chunks
+	// that left the map at the end of the frames. Note that only these
+	// chunks are applied to the terrain map
+	for (unsigned int n = 0; n < chunks.size(); n++) {
+		const terrain_server::TerrainMapChunk& chunk = *chunks[n];
+		setResolution(chunk.plane_size, chunk.height_size);
+		if (chunk.end_of_frame) {
+			std::map<uint32_t, std::vector<dwl::TerrainCell> >::iterator chunk_it =
+					chunks_.begin();
+			while (chunk_it != chunks_.end()) {
+				if (!std::binary_search(chunk.chunks.begin(), chunk.chunks.end(),
+										chunk_it->first)) {
+					removeChunkCells(chunk_it->second);
+					chunks_.erase(chunk_it++);
+				} else
+					++chunk_it;
+			}
+		} else {
+			std::vector<dwl::TerrainCell>& cells = chunks_[chunk.chunk_id];
+			removeChunkCells(cells);
+			cells.resize(chunk.cell.size());
+			for (unsigned int i = 0; i < chunk.cell.size(); i++)
+				toTerrainCell(cells[i], chunk.cell[i]);
+			addChunkCells(cells);
+		}
+	}
+
+	// We have an initial map
+	if (!is_terrain_data_ && !chunks_.empty())
+		is_terrain_data_ = true;
+}
+
+
+void TerrainMapInterface::assembleTerrainData()
+{
+	terrain_data_.data.clear();
+	for (std::map<uint32_t, std::vector<dwl::TerrainCell> >::iterator chunk_it =
+			chunks_.begin(); chunk_it != chunks_.end(); chunk_it++)
+		terrain_data_.data.insert(terrain_data_.data.end(),
+								  chunk_it->second.begin(), chunk_it->second.end());
+}
+
+
+void TerrainMapInterface::setCostPyramid(bool enable)
+{
+	is_pyramid_ = enable;
+	if (is_pyramid_) {
+		if (is_streaming_)
+			assembleTerrainData();
+		pyramid_.build(terrain_data_.data);
+	}
+	else
+		pyramid_.clear();
+}
+
+
+const CostPyramid& TerrainMapInterface::getCostPyramid() const
+{
+	return pyramid_;
+}
+
+
 bool TerrainMapInterface::resetTerrainMap()
 {
 	std_srvs::Empty srv;
@@ -87,6 +160,8 @@ bool TerrainMapInterface::getTerrainMap(dwl::TerrainData& map)
 {
 	updateTerrainMap();
 	if (is_terrain_data_) {
+		if (is_streaming_)
+			assembleTerrainData();
 		map = terrain_data_;
 		return true;
 	} else
@@ -188,6 +263,76 @@ const Eigen::Vector3d& TerrainMapInterface::getTerrainNormal(const Eigen::Vector
 }
 
 
+void TerrainMapInterface::toTerrainCell(dwl::TerrainCell& cell,
+										const terrain_server::TerrainCell& msg) const
+{
+	cell.key.x = msg.key_x;
+	cell.key.y = msg.key_y;
+	cell.key.z = msg.key_z;
+	cell.cost = msg.cost;
+	space_discretization_.keyToCoord(cell.height, msg.key_z, false);
+	cell.normal = Eigen::Vector3d(msg.normal.x, msg.normal.y, msg.normal.z);
+}
+
+
+void TerrainMapInterface::setResolution(double plane_size, double height_size)
+{
+	terrain_data_.plane_size = plane_size;
+	terrain_data_.height_size = height_size;
+	space_discretization_.setEnvironmentResolution(plane_size, true);
+	space_discretization_.setEnvironmentResolution(height_size, false);
+	pyramid_.setResolution(plane_size);
+}
+
+
+void TerrainMapInterface::addChunkCells(const std::vector<dwl::TerrainCell>& cells)
+{
+	terrain_map_->setMapResolution(terrain_data_.plane_size, terrain_data_.height_size);
+	for (unsigned int i = 0; i < cells.size(); i++) {
+		terrain_map_->addCell(cells[i]);
+		if (is_pyramid_)
+			pyramid_.setCell(cells[i]);
+	}
+}
+
+
+void TerrainMapInterface::removeChunkCells(const std::vector<dwl::TerrainCell>& cells)
+{
+	for (unsigned int i = 0; i < cells.size(); i++) {
+		terrain_map_->removeCell(cells[i]);
+		if (is_pyramid_)
+			pyramid_.removeCell(cells[i].key);
+	}
+}
+
+
+void TerrainMapInterface::ChunkTerrainMap::setMapResolution(double plane_size,
+															double height_size)
+{
+	dwl::environment::TerrainMap::setResolution(plane_size, true);
+	dwl::environment::TerrainMap::setResolution(height_size, false);
+}
+
+
+void TerrainMapInterface::ChunkTerrainMap::addCell(const dwl::TerrainCell& cell)
+{
+	dwl::Vertex vertex_id;
+	space_discretization_.keyToVertex(vertex_id, cell.key, true);
+	addCellToTerrainMap(cell);
+	addCellToTerrainHeightMap(vertex_id, cell.height);
+	terrain_information_ = true;
+}
+
+
+void TerrainMapInterface::ChunkTerrainMap::removeCell(const dwl::TerrainCell& cell)
+{
+	dwl::Vertex vertex_id;
+	space_discretization_.keyToVertex(vertex_id, cell.key, true);
+	removeCellToTerrainMap(vertex_id);
+	removeCellToTerrainHeightMap(vertex_id);
+}
+
+
 void TerrainMapInterface::callback(const terrain_server::TerrainMapConstPtr& msg)
 {
 	// the writeFromNonRT can be used in RT, if you have the guarantee that
@@ -198,4 +343,41 @@ void TerrainMapInterface::callback(const terrain_server::TerrainMapConstPtr& msg
 	new_msg_ = true;
 }
 
+
+void TerrainMapInterface::chunkCallback(const terrain_server::TerrainMapChunkConstPtr& msg)
+{
+	// Detecting the lost chunks, i.e. the chunks that were dropped by the
+	// queues. The counts differ if chunks (or the previous end of frame)
+	// were lost, and the listed chunks have to be received once
+	if (msg->end_of_frame) {
+		bool is_gap = num_received_chunks_ != msg->num_chunks;
+		std::set<uint32_t> received_chunks;
+		for (unsigned int i = 0; i < msg->chunks.size(); i++) {
+			if (received_chunks_.count(msg->chunks[i]) > 0)
+				received_chunks.insert(msg->chunks[i]);
+			else
+				is_gap = true;
+		}
+		received_chunks_.swap(received_chunks);
+		num_received_chunks_ = 0;
+
+		// Requesting a full re-send of the chunks, they arrive with the next
+		// end of frame
+		if (is_gap) {
+			ROS_WARN("Lost chunks of the terrain map (frame %u), requesting a full re-send",
+					 msg->sequence);
+			resend_pub_.publish(std_msgs::Empty());
+		}
+	} else {
+		received_chunks_.insert(msg->chunk_id);
+		num_received_chunks_++;
+	}
+
+	// The chunks are queued since several of them arrive between updates
+	std::lock_guard<std::mutex> lock(chunk_mutex_);
+	chunk_queue_.push_back(msg);
+
+	new_msg_ = true;
+}
+
 } //@namespace terrain_server
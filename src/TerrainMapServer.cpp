@@ -1,4 +1,9 @@
 #include <terrain_server/TerrainMapServer.h>
+#include <tf_conversions/tf_eigen.h>
+
+#include <algorithm>
+#include <functional>
+#include <string.h>
 
 
 namespace terrain_server
@@ -6,8 +11,12 @@ namespace terrain_server
 
 TerrainMapServer::TerrainMapServer(ros::NodeHandle node) : private_node_(node),
 		terrain_discretization_(0.04, 0.04, M_PI / 200),
-		octomap_sub_(NULL),	tf_octomap_sub_(NULL), base_frame_("base_link"),
-		world_frame_("world"), initial_map_(false)
+		octomap_sub_(NULL),	tf_octomap_sub_(NULL), is_frustum_(false), is_camera_info_(false),
+		frustum_min_depth_(0.1), frustum_max_depth_(10.), corridor_width_(0.4),
+		corridor_horizon_(2.), num_sent_chunks_(0), base_frame_("base_link"),
+		world_frame_("world"), input_("octomap"),
+		snapshot_filename_("/tmp/terrain_map_snapshot.bin"),
+		num_frames_(0), initial_map_(false)
 {
 
 }
@@ -15,6 +24,11 @@ TerrainMapServer::TerrainMapServer(ros::NodeHandle node) : private_node_(node),
 
 TerrainMapServer::~TerrainMapServer()
 {
+	// The threads of the sources are stopped before the map
+	for (unsigned int i = 0; i < sources_.size(); i++)
+		delete sources_[i];
+	sources_.clear();
+
 	if (tf_octomap_sub_) {
 		delete tf_octomap_sub_;
 		tf_octomap_sub_ = NULL;
@@ -30,6 +44,7 @@ TerrainMapServer::~TerrainMapServer()
 bool TerrainMapServer::init()
 {
 	// Getting the names of search areas
+	terrain_server::TerrainMappingConfig config;
 	XmlRpc::XmlRpcValue area_names;
 	if (!private_node_.getParam("search_areas", area_names)) {
 		ROS_ERROR("No search areas given in the namespace: %s.",
@@ -41,131 +56,367 @@ bool TerrainMapServer::init()
 			return false;
 		}
 
-		double min_x, max_x, min_y, max_y, min_z, max_z, resolution;
+		dwl::SearchArea area;
 		for (int i = 0; i < area_names.size(); i++) {
-			private_node_.getParam((std::string) area_names[i] + "/min_x", min_x);
-			private_node_.getParam((std::string) area_names[i] + "/max_x", max_x);
-			private_node_.getParam((std::string) area_names[i] + "/min_y", min_y);
-			private_node_.getParam((std::string) area_names[i] + "/max_y", max_y);
-			private_node_.getParam((std::string) area_names[i] + "/min_z", min_z);
-			private_node_.getParam((std::string) area_names[i] + "/max_z", max_z);
-			private_node_.getParam((std::string) area_names[i] + "/resolution", resolution);
+			private_node_.getParam((std::string) area_names[i] + "/min_x", area.min_x);
+			private_node_.getParam((std::string) area_names[i] + "/max_x", area.max_x);
+			private_node_.getParam((std::string) area_names[i] + "/min_y", area.min_y);
+			private_node_.getParam((std::string) area_names[i] + "/max_y", area.max_y);
+			private_node_.getParam((std::string) area_names[i] + "/min_z", area.min_z);
+			private_node_.getParam((std::string) area_names[i] + "/max_z", area.max_z);
+			private_node_.getParam((std::string) area_names[i] + "/resolution", area.resolution);
 
 			// Adding the search areas
-			terrain_map_.addSearchArea(min_x, max_x, min_y, max_y, min_z, max_z, resolution);
+			config.search_areas.push_back(area);
 		}
 	}
 
 	// Getting the interest region, i.e. the information outside this region will be deleted
-	double radius_x = 1, radius_y = 1;
-	private_node_.getParam("interest_region/radius_x", radius_x);
-	private_node_.getParam("interest_region/radius_y", radius_y);
-	terrain_map_.setInterestRegion(radius_x, radius_y);
+	private_node_.getParam("interest_region/radius_x", config.interest_radius_x);
+	private_node_.getParam("interest_region/radius_y", config.interest_radius_y);
+
+	// Getting the tile store, i.e. the tiles outside the interest region are
+	// evicted to it instead of being removed
+	private_node_.getParam("tiles/enable", config.enable_tiles);
+	private_node_.getParam("tiles/size", config.tile_size);
+	private_node_.getParam("tiles/max_tiles", config.max_tiles);
+	private_node_.getParam("tiles/filename", config.tile_filename);
 
 	// Getting the feature information
-	bool enable_slope, enable_height_dev, enable_curvature;
-	double weight;
-	double default_weight = 1;
-	private_node_.getParam("features/slope/enable", enable_slope);
-	private_node_.getParam("features/height_deviation/enable", enable_height_dev);
-	private_node_.getParam("features/curvature/enable", enable_curvature);
-
-	// Adding the slope feature if it's enable
-	if (enable_slope) {
-		// Setting the weight feature
-		private_node_.param("features/slope/weight", weight, default_weight);
-		dwl::environment::Feature* slope_ptr = new terrain_server::feature::SlopeFeature();
-		slope_ptr->setWeight(weight);
-
-		// Adding the feature
-		terrain_map_.addFeature(slope_ptr);
-	}
-
-	// Adding the height deviation feature if it's enable
-	if (enable_height_dev) {
-		// Setting the weight feature
-		private_node_.param("features/height_deviation/weight",
-							weight,	default_weight);
-		double flat_height_deviation, max_height_deviation, min_allowed_height;
-		private_node_.param("features/height_deviation/flat_height_deviation",
-							flat_height_deviation, 0.01);
-		private_node_.param("features/height_deviation/max_height_deviation",
-							 max_height_deviation, 0.3);
-		private_node_.param("features/height_deviation/min_allowed_height",
-							 min_allowed_height, -std::numeric_limits<double>::max());
-		dwl::environment::Feature* height_dev_ptr =
-				new terrain_server::feature::HeightDeviationFeature(flat_height_deviation,
-																	max_height_deviation,
-																	min_allowed_height);
-		height_dev_ptr->setWeight(weight);
-
-		// Setting the neighboring area
-		double size, resolution;
-		private_node_.param("features/height_deviation/neighboring_area/square_size",
-							size, 0.1);
-		private_node_.param("features/height_deviation/neighboring_area/resolution",
-							resolution, 0.04);
-		height_dev_ptr->setNeighboringArea(-size, size, -size, size, resolution);
-
-		// Adding the feature
-		terrain_map_.addFeature(height_dev_ptr);
-	}
-
-	// Adding the curvature feature if it's enable
-	if (enable_curvature) {
-		// Setting the weight feature
-		private_node_.param("features/curvature/weight", weight, default_weight);
-		dwl::environment::Feature* curvature_ptr = new terrain_server::feature::CurvatureFeature();
-		curvature_ptr->setWeight(weight);
-
-		// Adding the feature
-		terrain_map_.addFeature(curvature_ptr);
-	}
+	private_node_.getParam("features/slope/enable", config.enable_slope);
+	private_node_.getParam("features/slope/weight", config.slope_weight);
+	private_node_.getParam("features/height_deviation/enable", config.enable_height_deviation);
+	private_node_.getParam("features/height_deviation/weight", config.height_deviation_weight);
+	private_node_.getParam("features/height_deviation/flat_height_deviation",
+						   config.flat_height_deviation);
+	private_node_.getParam("features/height_deviation/max_height_deviation",
+						   config.max_height_deviation);
+	private_node_.getParam("features/height_deviation/min_allowed_height",
+						   config.min_allowed_height);
+	private_node_.getParam("features/height_deviation/neighboring_area/square_size",
+						   config.height_deviation_size);
+	private_node_.getParam("features/height_deviation/neighboring_area/resolution",
+						   config.height_deviation_resolution);
+	private_node_.getParam("features/curvature/enable", config.enable_curvature);
+	private_node_.getParam("features/curvature/weight", config.curvature_weight);
+	private_node_.getParam("features/fused", config.fused_features);
+
+	// Getting the height binning of the point clouds
+	private_node_.getParam("pointcloud/height", config.height_binning);
+	private_node_.getParam("pointcloud/percentile", config.height_percentile);
+	private_node_.getParam("pointcloud/threads", config.binning_threads);
+	private_node_.getParam("depth/min_depth", config.min_depth);
+	private_node_.getParam("depth/max_depth", config.max_depth);
+	private_node_.getParam("depth/max_jump", config.max_depth_jump);
+	private_node_.getParam("octree/resolution", config.octree_resolution);
+	private_node_.getParam("octree/max_range", config.octree_max_range);
+
+	// Getting the obstacle band, i.e. the obstacle map is computed in the
+	// same traversal of the search areas
+	private_node_.getParam("obstacle_map/enable", config.enable_obstacle);
+	private_node_.getParam("obstacle_map/min_z", config.obstacle_min_z);
+	private_node_.getParam("obstacle_map/max_z", config.obstacle_max_z);
+
+	// Getting the cost pyramid of the region queries
+	private_node_.getParam("pyramid/enable", config.enable_pyramid);
+
+	// Setting up the terrain mapping, i.e. search areas and features
+	config.apply(terrain_map_);
 
 	// Getting the base and world frame
 	private_node_.param("base_frame", base_frame_, base_frame_);
 	private_node_.param("world_frame", world_frame_, world_frame_);
 	map_msg_.header.frame_id = world_frame_;
+	layers_msg_.header.frame_id = world_frame_;
+	chunk_msg_.header.frame_id = world_frame_;
+	footholds_msg_.header.frame_id = world_frame_;
+
+	// Getting the thresholds of the skipped frames, i.e. the frames are
+	// thinned out when the robot doesn't move and the input doesn't change
+	private_node_.getParam("update/min_translation", config.update_min_translation);
+	private_node_.getParam("update/min_yaw", config.update_min_yaw);
+	private_node_.getParam("update/min_change", config.update_min_change);
+	private_node_.getParam("update/max_period", config.update_max_period);
+	scheduler_.setThresholds(config.update_min_translation, config.update_min_yaw,
+							 config.update_min_change, config.update_max_period);
+
+	// Declaring the input sources (point cloud, octree or depth image), or
+	// the subscriber to the octomap and tf messages. Every source has its own
+	// TF filter and thread, and the frames are merged in the map. The point
+	// clouds and depth images are binned directly in the heightmap, or the
+	// point clouds are integrated in the octree of the terrain mapping
+	// (octree), i.e. they don't need an octomap server
+	XmlRpc::XmlRpcValue source_names;
+	if (private_node_.getParam("sources", source_names)) {
+		if (source_names.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+			ROS_ERROR("Malformed input source specification.");
+			return false;
+		}
+
+		for (int i = 0; i < source_names.size(); i++) {
+			std::string name = (std::string) source_names[i];
+			std::string type = "pointcloud", topic, camera_info_topic;
+			private_node_.getParam(name + "/type", type);
+			private_node_.getParam(name + "/topic", topic);
+			private_node_.getParam(name + "/camera_info", camera_info_topic);
+			if (!addInputSource(name, type, topic, camera_info_topic, config))
+				return false;
+		}
+		input_ = "sources";
+	} else {
+		private_node_.param("input", input_, input_);
+		if (input_ == "pointcloud" || input_ == "octree") {
+			std::string cloud_topic = "points";
+			private_node_.param("pointcloud/topic", cloud_topic, cloud_topic);
+			addInputSource(input_, input_, cloud_topic, "", config);
+		} else if (input_ == "depth") {
+			std::string depth_topic = "depth/image_raw";
+			std::string camera_info_topic = "depth/camera_info";
+			private_node_.param("depth/topic", depth_topic, depth_topic);
+			private_node_.param("depth/camera_info", camera_info_topic, camera_info_topic);
+			addInputSource(input_, input_, depth_topic, camera_info_topic, config);
+		} else {
+			if (input_ != "octomap") {
+				ROS_WARN("Unknown %s input, using the octomap", input_.c_str());
+				input_ = "octomap";
+			}
+
+			octomap_sub_ =
+					new message_filters::Subscriber<octomap_msgs::Octomap>(
+							node_, "octomap_binary", 5);
+			tf_octomap_sub_ =
+					new tf::MessageFilter<octomap_msgs::Octomap>(
+							*octomap_sub_, tf_listener_, world_frame_, 5);
+			tf_octomap_sub_->registerCallback(
+					boost::bind(&TerrainMapServer::octomapCallback, this, _1));
+
+			// Restricting the columns of the octomap to the frustum of the
+			// sensor, which is given by its camera info and TF
+			private_node_.param("frustum/enable", is_frustum_, is_frustum_);
+			if (is_frustum_) {
+				std::string camera_info_topic = "depth/camera_info";
+				private_node_.param("frustum/camera_info", camera_info_topic, camera_info_topic);
+				private_node_.param("frustum/min_depth", frustum_min_depth_, frustum_min_depth_);
+				private_node_.param("frustum/max_depth", frustum_max_depth_, frustum_max_depth_);
+				camera_info_sub_ = node_.subscribe(camera_info_topic, 1,
+												   &TerrainMapServer::cameraInfoCallback, this);
+			}
+		}
+	}
 
-	// Declaring the subscriber to octomap and tf messages
-	octomap_sub_ =
-			new message_filters::Subscriber<octomap_msgs::Octomap>(
-					node_, "octomap_binary", 5);
-	tf_octomap_sub_ =
-			new tf::MessageFilter<octomap_msgs::Octomap>(
-					*octomap_sub_, tf_listener_, world_frame_, 5);
-	tf_octomap_sub_->registerCallback(
-			boost::bind(&TerrainMapServer::octomapCallback, this, _1));
+	// Subscribing to the planned path, i.e. the cells of its corridor are
+	// computed ahead of the robot
+	bool enable_prefetch = false;
+	private_node_.param("prefetch/enable", enable_prefetch, enable_prefetch);
+	if (enable_prefetch) {
+		std::string path_topic = "planned_path";
+		private_node_.param("prefetch/topic", path_topic, path_topic);
+		private_node_.param("prefetch/width", corridor_width_, corridor_width_);
+		private_node_.param("prefetch/horizon", corridor_horizon_, corridor_horizon_);
+		path_sub_ = node_.subscribe(path_topic, 1, &TerrainMapServer::pathCallback, this);
+	}
 
 	// Declaring the publisher of terrain map
 	map_pub_ = node_.advertise<terrain_server::TerrainMap>("terrain_map", 1);
 
+	// Declaring the publisher of the map chunks, i.e. the chunks are
+	// published nearest to the robot first while the frame is computed
+	bool enable_streaming = false;
+	private_node_.param("streaming/enable", enable_streaming, enable_streaming);
+	if (enable_streaming) {
+		int chunk_size = 16;
+		private_node_.param("streaming/chunk_size", chunk_size, chunk_size);
+		chunk_pub_ = node_.advertise<terrain_server::TerrainMapChunk>("terrain_map_chunks", 64);
+		terrain_map_.setChunkHandler(std::bind(&TerrainMapServer::publishTerrainChunk, this,
+											   std::placeholders::_1),
+									 std::max(chunk_size, 1));
+		resend_sub_ = private_node_.subscribe("resend_chunks", 1,
+											  &TerrainMapServer::resendCallback, this);
+	}
+
+	// Declaring the publisher of the foothold candidates of the regions, they
+	// are extracted every frame
+	bool enable_footholds = false;
+	private_node_.param("footholds/enable", enable_footholds, enable_footholds);
+	XmlRpc::XmlRpcValue region_names;
+	if (enable_footholds && private_node_.getParam("footholds/regions", region_names)) {
+		if (region_names.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+			ROS_ERROR("Malformed foothold region specification.");
+			return false;
+		}
+
+		for (int i = 0; i < region_names.size(); i++) {
+			std::string name = "footholds/" + (std::string) region_names[i];
+			double min_x = 0., max_x = 0., min_y = 0., max_y = 0.;
+			private_node_.getParam(name + "/min_x", min_x);
+			private_node_.getParam(name + "/max_x", max_x);
+			private_node_.getParam(name + "/min_y", min_y);
+			private_node_.getParam(name + "/max_y", max_y);
+			foothold_extractor_.addRegion(min_x, max_x, min_y, max_y);
+		}
+
+		double max_cost = 0.5, min_normal_z = 0.9, clearance = 0.04;
+		double suppression_radius = 0.1;
+		int max_candidates = 32;
+		private_node_.param("footholds/max_cost", max_cost, max_cost);
+		private_node_.param("footholds/min_normal_z", min_normal_z, min_normal_z);
+		private_node_.param("footholds/clearance", clearance, clearance);
+		private_node_.param("footholds/suppression_radius", suppression_radius,
+							suppression_radius);
+		private_node_.param("footholds/max_candidates", max_candidates, max_candidates);
+		foothold_extractor_.setThresholds(max_cost, min_normal_z, clearance);
+		foothold_extractor_.setSuppression(suppression_radius, std::max(max_candidates, 0));
+		footholds_pub_ =
+				node_.advertise<terrain_server::FootholdCandidates>("foothold_candidates", 1);
+	}
+
+	// Declaring the publisher of the cost of each feature if it's required
+	bool publish_layers = false;
+	private_node_.param("features/publish_layers", publish_layers, publish_layers);
+	if (publish_layers)
+		layers_pub_ = node_.advertise<terrain_server::TerrainCostLayers>("terrain_cost_layers", 1);
+
+	// Declaring the publisher of obstacle map, and optionally its delta stream
+	if (terrain_map_.isObstacleMap()) {
+		bool publish_delta = false;
+		private_node_.param("obstacle_map/publish_delta", publish_delta, publish_delta);
+		obstacle_pub_.init(node_, world_frame_, publish_delta);
+	}
+
 	reset_srv_ = private_node_.advertiseService("reset", &TerrainMapServer::reset, this);
 	terrain_data_srv_ =
 			private_node_.advertiseService("data", &TerrainMapServer::getTerrainData, this);
+	weights_srv_ =
+			private_node_.advertiseService("set_feature_weights",
+										   &TerrainMapServer::setFeatureWeights, this);
+	if (config.enable_pyramid)
+		region_srv_ =
+				private_node_.advertiseService("region_query", &TerrainMapServer::queryRegion, this);
+
+	// Loading a snapshot of the terrain map, i.e. there is a map before the
+	// first octomap (e.g. after restarting the process)
+	std::string snapshot_load;
+	private_node_.param("snapshot/filename", snapshot_filename_, snapshot_filename_);
+	private_node_.param("snapshot/load", snapshot_load, snapshot_load);
+	if (!snapshot_load.empty()) {
+		std::lock_guard<std::mutex> lock(map_mutex_);
+		loadSnapshotFile(snapshot_load);
+	}
+	save_snapshot_srv_ =
+			private_node_.advertiseService("save_snapshot", &TerrainMapServer::saveSnapshot, this);
+	load_snapshot_srv_ =
+			private_node_.advertiseService("load_snapshot", &TerrainMapServer::loadSnapshot, this);
+
+	// Declaring the periodic publisher of the statistics
+	double statistics_period = 1.;
+	private_node_.param("statistics/period", statistics_period, statistics_period);
+	initStatistics();
+	statistics_pub_.init(private_node_, "terrain_map_server", &statistics_, statistics_period);
+
+	// Enabling the recording of the stage events, they are dumped as a
+	// Chrome trace by the dump_trace service
+	bool enable_trace = false;
+	private_node_.param("trace/enable", enable_trace, enable_trace);
+	if (enable_trace) {
+		int trace_capacity = 65536;
+		std::string trace_filename = "/tmp/terrain_map_server_trace.json";
+		private_node_.param("trace/capacity", trace_capacity, trace_capacity);
+		private_node_.param("trace/filename", trace_filename, trace_filename);
+		trace_.init(trace_capacity, trace_filename);
+		trace_srv_ =
+				private_node_.advertiseService("dump_trace", &TerrainMapServer::dumpTrace, this);
+	}
 
 
 	return true;
 }
 
 
-void TerrainMapServer::octomapCallback(const octomap_msgs::Octomap::ConstPtr& msg)
+void TerrainMapServer::initStatistics()
 {
-	// Creating a octree
-	octomap::OcTree* octomap = NULL;
-	octomap::AbstractOcTree* tree = octomap_msgs::msgToMap(*msg);
+	// The order of the stages and counters has to match their enumerations
+	statistics_.addStage("frame");
+	statistics_.addStage("deserialize");
+	statistics_.addStage("tf_lookup");
+	statistics_.addStage("pruning");
+	statistics_.addStage("surface");
+	statistics_.addStage("terrain_data");
+	statistics_.addStage("plane_fit");
+	statistics_.addStage("costs");
+	statistics_.addStage("msg_build");
+	statistics_.addStage("obstacle_msg");
+	for (unsigned int i = 0; i < terrain_map_.getNumFeatures(); i++)
+		statistics_.addStage("feature/" + terrain_map_.getFeatureName(i));
 
-	if (tree) {
-		octomap = dynamic_cast<octomap::OcTree*>(tree);
+	statistics_.addCounter("frames");
+	statistics_.addCounter("tf_failures");
+	statistics_.addCounter("columns");
+	statistics_.addCounter("cells_processed");
+	statistics_.addCounter("cells_recomputed");
+	statistics_.addCounter("map_size");
+	statistics_.addCounter("tiles_evicted");
+	statistics_.addCounter("tiles_loaded");
+	statistics_.addCounter("skipped_frames");
+}
+
+
+void TerrainMapServer::recordProfile(double start_time)
+{
+	const TerrainMappingProfile& profile = terrain_map_.getProfile();
+	if (trace_.isEnabled()) {
+		// The stages of the terrain mapping are consecutive
+		trace_.addEvent("pruning", start_time, profile.pruning, num_frames_);
+		start_time += profile.pruning;
+		trace_.addEvent("surface", start_time, profile.surface, num_frames_);
+		start_time += profile.surface;
+		trace_.addEvent("terrain_data", start_time, profile.terrain_data, num_frames_);
 	}
 
-	if (!octomap) {
-		ROS_WARN("Failed to create octree structure");
-		return;
+	statistics_.record(PRUNING_STAGE, profile.pruning);
+	statistics_.record(SURFACE_STAGE, profile.surface);
+	statistics_.record(TERRAIN_DATA_STAGE, profile.terrain_data);
+	statistics_.record(PLANE_FIT_STAGE, profile.plane_fit);
+	statistics_.record(COSTS_STAGE, profile.costs);
+	for (unsigned int i = 0; i < profile.features.size(); i++) {
+		if (FEATURE_STAGE + i < statistics_.getNumStages())
+			statistics_.record(FEATURE_STAGE + i, profile.features[i]);
 	}
 
-	// Setting the resolution of the gridmap
-	terrain_map_.setResolution(octomap->getResolution(), false);
+	statistics_.incrementCounter(COLUMNS_COUNTER, profile.num_columns);
+	statistics_.incrementCounter(PROCESSED_CELLS_COUNTER, profile.num_processed);
+	statistics_.incrementCounter(RECOMPUTED_CELLS_COUNTER, profile.num_cells);
+	statistics_.setCounter(MAP_SIZE_COUNTER, profile.map_size);
+	statistics_.incrementCounter(EVICTED_TILES_COUNTER, profile.num_evicted_tiles);
+	statistics_.incrementCounter(LOADED_TILES_COUNTER, profile.num_loaded_tiles);
+}
+
+
+double TerrainMapServer::getSignature(const octomap_msgs::Octomap& msg) const
+{
+	// Hashing the data 8 bytes at a time (FNV-1a), it's cheaper than the
+	// deserialization of the octomap
+	const uint64_t prime = 1099511628211ULL;
+	uint64_t hash = 14695981039346656037ULL ^ msg.data.size();
+	const int8_t* data = msg.data.data();
+	unsigned int size = msg.data.size();
+	unsigned int i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(uint64_t));
+		hash = (hash ^ word) * prime;
+	}
+	for (; i < size; i++)
+		hash = (hash ^ (uint8_t) data[i]) * prime;
+
+	return (double) hash;
+}
+
+
+void TerrainMapServer::octomapCallback(const octomap_msgs::Octomap::ConstPtr& msg)
+{
+	double frame_time = getMonotonicTime();
+	num_frames_++;
+	trace_.addInstant("octomap_arrival", num_frames_);
 
 	// Getting the transformation between the world to robot frame
 	tf::StampedTransform tf_transform;
@@ -176,42 +427,247 @@ void TerrainMapServer::octomapCallback(const octomap_msgs::Octomap::ConstPtr& ms
 									 tf_transform);
 	} catch (tf::TransformException& ex) {
 		ROS_ERROR_STREAM("Transform error of sensor data: " << ex.what() << ", quitting callback");
+		statistics_.incrementCounter(TF_FAILURES_COUNTER);
 		return;
 	}
+	double stage_time = getMonotonicTime();
+	statistics_.record(TF_STAGE, stage_time - frame_time);
+	trace_.addEvent("tf_lookup", frame_time, stage_time - frame_time, num_frames_);
 
-	// Getting the robot state (3D position and yaw angle)
-	Eigen::Vector4d robot_position = Eigen::Vector4d::Zero();
-	robot_position(0) = tf_transform.getOrigin()[0];
-	robot_position(1) = tf_transform.getOrigin()[1];
-	robot_position(2) = tf_transform.getOrigin()[2];
-
-	// Computing the yaw angle
+	// Getting the robot pose
+	Eigen::Vector3d robot_position(tf_transform.getOrigin()[0],
+								   tf_transform.getOrigin()[1],
+								   tf_transform.getOrigin()[2]);
 	tf::Quaternion q = tf_transform.getRotation();
-	double yaw =
-			dwl::math::getYaw(dwl::math::getRPY(Eigen::Quaterniond(q.getW(),
-																   q.getX(),
-																   q.getY(),
-																   q.getZ())));
-	robot_position(3) = yaw;
+	Eigen::Quaterniond robot_orientation(q.getW(), q.getX(), q.getY(), q.getZ());
+
+	// Skipping the frame if the robot didn't move and the octomap didn't
+	// change its data, i.e. it isn't deserialized
+	Eigen::Vector4d robot_state;
+	robot_state.head(3) = robot_position;
+	robot_state(3) = dwl::math::getYaw(dwl::math::getRPY(robot_orientation));
+	if (!scheduler_.isUpdateRequired(robot_state, getSignature(*msg), frame_time)) {
+		statistics_.incrementCounter(SKIPPED_FRAMES_COUNTER);
+		return;
+	}
+
+	// Creating a octree
+	octomap::OcTree* octomap = NULL;
+	octomap::AbstractOcTree* tree = octomap_msgs::msgToMap(*msg);
+
+	if (tree) {
+		octomap = dynamic_cast<octomap::OcTree*>(tree);
+	}
+	statistics_.record(DESERIALIZE_STAGE, getMonotonicTime() - stage_time);
+	trace_.addEvent("deserialize", stage_time, getMonotonicTime() - stage_time, num_frames_);
+
+	if (!octomap) {
+		ROS_WARN("Failed to create octree structure");
+		delete tree;
+		return;
+	}
+	boost::shared_ptr<octomap::OcTree> octomap_ptr(octomap);
+
+	// Getting the frustum of the sensor, all the columns are scanned if
+	// there isn't its camera info or transformation
+	terrain_server::SensorFrustum frustum;
+	if (is_frustum_ && is_camera_info_) {
+		tf::StampedTransform sensor_transform;
+		try {
+			tf_listener_.lookupTransform(world_frame_,
+										 camera_info_.header.frame_id,
+										 msg->header.stamp,
+										 sensor_transform);
+			Eigen::Affine3d sensor_pose;
+			tf::transformTFToEigen(sensor_transform, sensor_pose);
+			frustum.set(intrinsics_, camera_info_.width, camera_info_.height, sensor_pose,
+						frustum_min_depth_, frustum_max_depth_);
+		} catch (tf::TransformException& ex) {
+			ROS_WARN_STREAM_THROTTLE(1., "Transform error of the sensor frustum: " << ex.what());
+		}
+	}
 
 	// Computing the terrain map
-	timespec start_rt, end_rt;
-	clock_gettime(CLOCK_REALTIME, &start_rt);
-	terrain_map_.compute(octomap, robot_position);
+	std::unique_lock<std::mutex> lock(map_mutex_);
+	terrain_map_.setSensorFrustum(frustum);
+	stage_time = getMonotonicTime();
+	terrain_map_.compute(octomap, robot_position, robot_orientation);
+	initial_map_ = true;
+	recordProfile(stage_time);
+
+	publishFrame(lock, robot_state);
+
+	statistics_.record(FRAME_STAGE, getMonotonicTime() - frame_time);
+	trace_.addEvent("frame", frame_time, getMonotonicTime() - frame_time, num_frames_);
+	statistics_.incrementCounter(FRAMES_COUNTER);
+	ROS_DEBUG("The duration of computation of terrain map is %f seg.",
+			  getMonotonicTime() - frame_time);
+}
+
+
+void TerrainMapServer::cameraInfoCallback(const sensor_msgs::CameraInfo::ConstPtr& msg)
+{
+	// The intrinsics of the rectified image
+	camera_info_ = *msg;
+	intrinsics_.fx = msg->P[0];
+	intrinsics_.fy = msg->P[5];
+	intrinsics_.cx = msg->P[2];
+	intrinsics_.cy = msg->P[6];
+	if (intrinsics_.fx == 0. || intrinsics_.fy == 0.) {
+		intrinsics_.fx = msg->K[0];
+		intrinsics_.fy = msg->K[4];
+		intrinsics_.cx = msg->K[2];
+		intrinsics_.cy = msg->K[5];
+	}
+	is_camera_info_ = true;
+}
+
+
+void TerrainMapServer::pathCallback(const nav_msgs::Path::ConstPtr& msg)
+{
+	if (msg->poses.empty()) {
+		std::lock_guard<std::mutex> lock(map_mutex_);
+		terrain_map_.clearCorridor();
+		return;
+	}
+
+	// Transforming the waypoints to the world frame
+	std::vector<Eigen::Vector2d> path(msg->poses.size());
+	for (unsigned int i = 0; i < msg->poses.size(); i++) {
+		const std_msgs::Header& header =
+				msg->poses[i].header.frame_id.empty() ? msg->header : msg->poses[i].header;
+		tf::Stamped<tf::Point> point(tf::Point(msg->poses[i].pose.position.x,
+											   msg->poses[i].pose.position.y,
+											   msg->poses[i].pose.position.z),
+									 ros::Time(0), header.frame_id);
+		try {
+			tf_listener_.transformPoint(world_frame_, point, point);
+		} catch (tf::TransformException& ex) {
+			ROS_ERROR_STREAM("Transform error of the planned path: " << ex.what());
+			return;
+		}
+		path[i] = Eigen::Vector2d(point.x(), point.y());
+	}
+
+	std::lock_guard<std::mutex> lock(map_mutex_);
+	terrain_map_.setCorridor(path, corridor_width_, corridor_horizon_);
+}
+
+
+void TerrainMapServer::resendCallback(const std_msgs::Empty::ConstPtr& msg)
+{
+	// Publishing all the chunks, followed by the end of the frame
+	std::lock_guard<std::mutex> lock(map_mutex_);
+	publishTerrainChunks(true);
+}
+
+
+bool TerrainMapServer::addInputSource(const std::string& name,
+									  const std::string& type,
+									  const std::string& topic,
+									  const std::string& camera_info_topic,
+									  const TerrainMappingConfig& config)
+{
+	InputSource::Type source_type;
+	if (type == "pointcloud")
+		source_type = InputSource::POINTCLOUD;
+	else if (type == "octree")
+		source_type = InputSource::OCTREE;
+	else if (type == "depth")
+		source_type = InputSource::DEPTH;
+	else {
+		ROS_ERROR("Unknown %s type of the %s source.", type.c_str(), name.c_str());
+		return false;
+	}
+
+	if (topic.empty()) {
+		ROS_ERROR("There isn't topic of the %s source.", name.c_str());
+		return false;
+	}
+
+	InputSource* source = new InputSource();
+	sources_.push_back(source);
+	source->init(node_, name, source_type, topic, camera_info_topic,
+				 tf_listener_, world_frame_, base_frame_, config,
+				 boost::bind(&TerrainMapServer::setGridBounds, this, _1, _2, _3, _4),
+				 boost::bind(&TerrainMapServer::mergeSource, this, _1));
+	ROS_INFO("Adding the %s input source (%s)", name.c_str(), topic.c_str());
+
+	return true;
+}
+
+
+void TerrainMapServer::setGridBounds(HeightGrid& grid, double& min_z, double& max_z,
+									 const Eigen::Vector4d& robot_state)
+{
+	std::lock_guard<std::mutex> lock(map_mutex_);
+	terrain_map_.setHeightGridBounds(grid, min_z, max_z, robot_state);
+}
+
+
+void TerrainMapServer::mergeSource(InputSource& source)
+{
+	// The frames of the sources are merged one at a time, the conversion and
+	// binning of them run in their own threads. The map is unlocked before
+	// sending the messages of the frame, so the next frame is merged while
+	// they are sent
+	std::unique_lock<std::mutex> lock(map_mutex_);
+	double frame_time = source.getFrameTime();
+	num_frames_++;
+	trace_.addInstant("source_arrival", num_frames_);
+	if (source.isTfFailure()) {
+		statistics_.incrementCounter(TF_FAILURES_COUNTER);
+		return;
+	} else if (source.isSkipped()) {
+		statistics_.incrementCounter(SKIPPED_FRAMES_COUNTER);
+		return;
+	}
+
+	// The conversion takes the place of the octomap deserialization
+	statistics_.record(TF_STAGE, source.getTfDuration());
+	trace_.addEvent("tf_lookup", frame_time, source.getTfDuration(), num_frames_);
+	statistics_.record(DESERIALIZE_STAGE, source.getConversionDuration());
+	trace_.addEvent("deserialize", frame_time + source.getTfDuration(),
+					source.getConversionDuration(), num_frames_);
+
+	// Computing the terrain map, i.e. the height grid is merged or the
+	// points are integrated in the octree
+	double stage_time = getMonotonicTime();
+	if (source.getType() == InputSource::OCTREE)
+		terrain_map_.integratePointCloud(source.getPoints(), source.getSensorOrigin(),
+										 source.getRobotPosition(),
+										 source.getRobotOrientation());
+	else
+		terrain_map_.compute(source.getGrid(), source.getRobotState());
 	initial_map_ = true;
-	publishTerrainMap();
-	clock_gettime(CLOCK_REALTIME, &end_rt);
-	double duration =
-			(end_rt.tv_sec - start_rt.tv_sec) + 1e-9*(end_rt.tv_nsec - start_rt.tv_nsec);
-	ROS_INFO("The duration of computation of terrain map is %f seg.", duration);
+	recordProfile(stage_time);
+
+	publishFrame(lock, source.getRobotState());
+
+	statistics_.record(FRAME_STAGE, getMonotonicTime() - frame_time);
+	trace_.addEvent("frame", frame_time, getMonotonicTime() - frame_time, num_frames_);
+	statistics_.incrementCounter(FRAMES_COUNTER);
+	ROS_DEBUG("The duration of computation of terrain map (%s) is %f seg.",
+			  source.getName().c_str(), getMonotonicTime() - frame_time);
 }
 
 
 bool TerrainMapServer::reset(std_srvs::Empty::Request& req,
 							std_srvs::Empty::Response& resp)
 {
-	initial_map_ = false;
-	terrain_map_.reset();
+	{
+		std::lock_guard<std::mutex> lock(map_mutex_);
+		initial_map_ = false;
+		terrain_map_.reset();
+		obstacle_pub_.reset();
+		scheduler_.reset();
+		for (unsigned int i = 0; i < sources_.size(); i++)
+			sources_[i]->resetScheduler();
+	}
+	if (input_ != "octomap") {
+		ROS_INFO("Reset terrain map");
+		return true;
+	}
 
 	ros::ServiceClient client = 
 		private_node_.serviceClient<std_srvs::Empty>("/octomap_server/reset");
@@ -229,6 +685,8 @@ bool TerrainMapServer::reset(std_srvs::Empty::Request& req,
 bool TerrainMapServer::getTerrainData(terrain_server::TerrainData::Request& req,
 									  terrain_server::TerrainData::Response& res)
 {
+	ScopedTrace trace(trace_, "terrain_data_query", num_frames_);
+	std::lock_guard<std::mutex> lock(map_mutex_);
 	if (initial_map_) {
 		Eigen::Vector2d position(req.position.x, req.position.y);
 		dwl::TerrainCell cell = terrain_map_.getTerrainData(position);
@@ -246,10 +704,162 @@ bool TerrainMapServer::getTerrainData(terrain_server::TerrainData::Request& req,
 }
 
 
+bool TerrainMapServer::queryRegion(terrain_server::RegionQuery::Request& req,
+								   terrain_server::RegionQuery::Response& res)
+{
+	ScopedTrace trace(trace_, "region_query", num_frames_);
+	std::lock_guard<std::mutex> lock(map_mutex_);
+	const terrain_server::CostPyramid& pyramid = terrain_map_.getCostPyramid();
+	Eigen::Vector2d position;
+	if (req.radius > 0.) {
+		res.success = pyramid.getMinCostInDisc(res.min_cost, position,
+											   Eigen::Vector2d(req.centre.x, req.centre.y),
+											   req.radius);
+	} else {
+		Eigen::Vector2d min(req.min.x, req.min.y);
+		Eigen::Vector2d max(req.max.x, req.max.y);
+		res.success = pyramid.getMinCost(res.min_cost, position, min, max) &&
+				pyramid.getMaxCost(res.max_cost, min, max) &&
+				pyramid.getHeightRange(res.min_height, res.max_height, min, max);
+	}
+
+	if (res.success) {
+		res.position.x = position(dwl::rbd::X);
+		res.position.y = position(dwl::rbd::Y);
+	}
+
+	return true;
+}
+
+
+bool TerrainMapServer::setFeatureWeights(terrain_server::SetFeatureWeights::Request& req,
+										 terrain_server::SetFeatureWeights::Response& res)
+{
+	if (req.feature.size() != req.weight.size()) {
+		ROS_ERROR("The number of features and weights are different");
+		res.success = false;
+		return true;
+	}
+
+	std::lock_guard<std::mutex> lock(map_mutex_);
+	res.success = true;
+	for (unsigned int i = 0; i < req.feature.size(); i++)
+		res.success &= terrain_map_.setFeatureWeight(req.feature[i], req.weight[i]);
+
+	// Re-summing the cost of the map with the new weights
+	double start_time = getMonotonicTime();
+	terrain_map_.applyFeatureWeights();
+	ROS_INFO("The cost of the terrain map was updated in %f seg.",
+			 getMonotonicTime() - start_time);
+
+	// Returning the current weights of the features
+	for (unsigned int i = 0; i < terrain_map_.getNumFeatures(); i++) {
+		res.feature.push_back(terrain_map_.getFeatureName(i));
+		res.weight.push_back(terrain_map_.getFeatureWeight(i));
+	}
+
+	if (initial_map_) {
+		publishTerrainMap();
+		publishTerrainChunks(true);
+		publishCostLayers();
+	}
+
+	return true;
+}
+
+
+bool TerrainMapServer::saveSnapshot(terrain_server::Snapshot::Request& req,
+									terrain_server::Snapshot::Response& res)
+{
+	ScopedTrace trace(trace_, "save_snapshot", num_frames_);
+	std::lock_guard<std::mutex> lock(map_mutex_);
+	res.filename = req.filename.empty() ? snapshot_filename_ : req.filename;
+	int num_cells = terrain_server::TerrainMapSnapshot::write(res.filename, terrain_map_,
+															  world_frame_,
+															  ros::Time::now().toSec());
+	res.success = num_cells >= 0;
+	res.num_cells = res.success ? num_cells : 0;
+	if (res.success)
+		ROS_INFO("Saved a snapshot of %i cells in %s", num_cells, res.filename.c_str());
+	else
+		ROS_ERROR("Could not write the snapshot in %s", res.filename.c_str());
+
+	return true;
+}
+
+
+bool TerrainMapServer::loadSnapshot(terrain_server::Snapshot::Request& req,
+									terrain_server::Snapshot::Response& res)
+{
+	ScopedTrace trace(trace_, "load_snapshot", num_frames_);
+	std::lock_guard<std::mutex> lock(map_mutex_);
+	res.filename = req.filename.empty() ? snapshot_filename_ : req.filename;
+	int num_cells = loadSnapshotFile(res.filename);
+	res.success = num_cells >= 0;
+	res.num_cells = res.success ? num_cells : 0;
+
+	if (res.success) {
+		publishTerrainMap();
+		publishTerrainChunks(true);
+		publishCostLayers();
+	}
+
+	return true;
+}
+
+
+int TerrainMapServer::loadSnapshotFile(const std::string& filename)
+{
+	terrain_server::TerrainMapSnapshot snapshot;
+	if (!snapshot.open(filename)) {
+		ROS_ERROR("Could not open the snapshot %s", filename.c_str());
+		return -1;
+	}
+
+	const terrain_server::SnapshotHeader& header = snapshot.getHeader();
+	std::string frame_id(header.frame_id, strnlen(header.frame_id, sizeof(header.frame_id)));
+	if (frame_id != world_frame_) {
+		ROS_ERROR("Could not load the snapshot %s because it's in the %s frame",
+				  filename.c_str(), frame_id.c_str());
+		return -1;
+	}
+
+	if (!terrain_map_.loadSnapshot(snapshot)) {
+		ROS_ERROR("Could not load the snapshot %s", filename.c_str());
+		return -1;
+	}
+
+	initial_map_ = header.num_cells > 0;
+	ROS_INFO("Loaded a snapshot of %lu cells from %s", (unsigned long) header.num_cells,
+			 filename.c_str());
+
+	return header.num_cells;
+}
+
+
+bool TerrainMapServer::dumpTrace(terrain_server::DumpTrace::Request& req,
+								 terrain_server::DumpTrace::Response& res)
+{
+	return trace_.handleDump(req, res);
+}
+
+
 void TerrainMapServer::publishTerrainMap()
 {
-	// Publishing the terrain map if there is at least one subscriber
+	std::lock_guard<std::mutex> lock(publish_mutex_);
+	if (buildTerrainMap()) {
+		map_pub_.publish(map_msg_);
+		map_msg_.cell.clear();
+	}
+}
+
+
+bool TerrainMapServer::buildTerrainMap()
+{
+	// Building the terrain map if there is at least one subscriber
 	if (map_pub_.getNumSubscribers() > 0) {
+		ScopedTimer timer(statistics_.getStage(MSG_BUILD_STAGE));
+		ScopedTrace trace(trace_, "msg_build", num_frames_);
 		map_msg_.header.stamp = ros::Time::now();
 
 		dwl::TerrainDataMap terrain_gridmap = terrain_map_.getTerrainDataMap();
@@ -283,11 +893,210 @@ void TerrainMapServer::publishTerrainMap()
 			idx++;
 		}
 
-		map_pub_.publish(map_msg_);
+		return true;
+	}
+
+	return false;
+}
+
+
+void TerrainMapServer::publishTerrainChunk(uint32_t id)
+{
+	// Publishing the chunk if there is at least one subscriber
+	if (chunk_pub_ && chunk_pub_.getNumSubscribers() > 0) {
+		chunk_msg_.header.stamp = ros::Time::now();
+		chunk_msg_.sequence = num_frames_;
+		chunk_msg_.chunk_id = id;
+		chunk_msg_.end_of_frame = false;
+		chunk_msg_.chunks.clear();
+		chunk_msg_.plane_size = terrain_map_.getResolution(true);
+		chunk_msg_.height_size = terrain_map_.getResolution(false);
+
+		// Converting the cells of the chunk
+		std::vector<dwl::TerrainCell> cells;
+		terrain_map_.getChunkCells(cells, id);
+		chunk_msg_.cell.resize(cells.size());
+		for (unsigned int i = 0; i < cells.size(); i++) {
+			terrain_server::TerrainCell& cell = chunk_msg_.cell[i];
+			cell.key_x = cells[i].key.x;
+			cell.key_y = cells[i].key.y;
+			cell.key_z = cells[i].key.z;
+			cell.cost = cells[i].cost;
+			cell.normal.x = cells[i].normal(dwl::rbd::X);
+			cell.normal.y = cells[i].normal(dwl::rbd::Y);
+			cell.normal.z = cells[i].normal(dwl::rbd::Z);
+		}
+
+		chunk_pub_.publish(chunk_msg_);
+		chunk_msg_.cell.clear();
+		num_sent_chunks_++;
+	}
+}
+
+
+void TerrainMapServer::publishTerrainChunks(bool all_chunks)
+{
+	if (!chunk_pub_ || chunk_pub_.getNumSubscribers() == 0)
+		return;
+
+	std::vector<uint32_t> ids;
+	terrain_map_.getChunkIds(ids);
+	if (all_chunks) {
+		for (unsigned int i = 0; i < ids.size(); i++)
+			publishTerrainChunk(ids[i]);
+	}
+
+	// The end of the frame lists the chunks of the map, so the removed
+	// chunks are dropped by the subscribers
+	chunk_msg_.header.stamp = ros::Time::now();
+	chunk_msg_.sequence = num_frames_;
+	chunk_msg_.chunk_id = 0;
+	chunk_msg_.end_of_frame = true;
+	chunk_msg_.chunks = ids;
+	chunk_msg_.num_chunks = num_sent_chunks_;
+	chunk_msg_.cell.clear();
+	chunk_pub_.publish(chunk_msg_);
+	num_sent_chunks_ = 0;
+}
+
+
+void TerrainMapServer::publishCostLayers()
+{
+	std::lock_guard<std::mutex> lock(publish_mutex_);
+	if (buildCostLayers())
+		layers_pub_.publish(layers_msg_);
+}
+
+
+bool TerrainMapServer::buildCostLayers()
+{
+	// Building the cost layers if there is at least one subscriber
+	if (layers_pub_ && layers_pub_.getNumSubscribers() > 0) {
+		layers_msg_.header.stamp = ros::Time::now();
+		layers_msg_.plane_size = terrain_map_.getResolution(true);
+		layers_msg_.height_size = terrain_map_.getResolution(false);
+
+		unsigned int num_features = terrain_map_.getNumFeatures();
+		layers_msg_.feature.resize(num_features);
+		layers_msg_.weight.resize(num_features);
+		for (unsigned int n = 0; n < num_features; n++) {
+			layers_msg_.feature[n] = terrain_map_.getFeatureName(n);
+			layers_msg_.weight[n] = terrain_map_.getFeatureWeight(n);
+		}
+
+		// Converting the slots into cells. The keys are taken from the
+		// terrain map, both are ordered by vertex
+		const terrain_server::CostLayers& layers = terrain_map_.getCostLayers();
+		const std::map<dwl::Vertex, unsigned int>& slots = layers.getSlots();
+		const dwl::TerrainDataMap& terrain_gridmap = terrain_map_.getTerrainDataMap();
+		std::vector<unsigned int> cell_slots;
+		cell_slots.reserve(slots.size());
+		layers_msg_.cell.clear();
+
+		terrain_server::Cell cell;
+		dwl::TerrainDataMap::const_iterator cell_it = terrain_gridmap.begin();
+		for (std::map<dwl::Vertex, unsigned int>::const_iterator slot_it = slots.begin();
+				slot_it != slots.end(); slot_it++)
+		{
+			while (cell_it != terrain_gridmap.end() && cell_it->first < slot_it->first)
+				cell_it++;
+
+			if (cell_it != terrain_gridmap.end() && cell_it->first == slot_it->first) {
+				cell.key_x = cell_it->second.key.x;
+				cell.key_y = cell_it->second.key.y;
+				cell.key_z = cell_it->second.key.z;
+				layers_msg_.cell.push_back(cell);
+				cell_slots.push_back(slot_it->second);
+			}
+		}
+
+		// Converting the costs layer by layer
+		unsigned int num_cells = cell_slots.size();
+		layers_msg_.cost.resize(layers.getNumLayers() * num_cells);
+		for (unsigned int n = 0; n < layers.getNumLayers(); n++) {
+			for (unsigned int i = 0; i < num_cells; i++)
+				layers_msg_.cost[n * num_cells + i] = layers.getCost(n, cell_slots[i]);
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+
+bool TerrainMapServer::buildFootholds(const Eigen::Vector4d& robot_state)
+{
+	// Extracting the candidates if there is at least one subscriber
+	if (footholds_pub_ && footholds_pub_.getNumSubscribers() > 0) {
+		ScopedTrace trace(trace_, "footholds", num_frames_);
+		foothold_extractor_.compute(candidates_, terrain_map_.getTerrainDataMap(),
+									terrain_map_.getSpaceDiscretization(), robot_state);
+
+		footholds_msg_.header.stamp = ros::Time::now();
+		footholds_msg_.candidate.resize(candidates_.size());
+		for (unsigned int i = 0; i < candidates_.size(); i++) {
+			const terrain_server::Foothold& foothold = candidates_[i];
+			terrain_server::FootholdCandidate& candidate = footholds_msg_.candidate[i];
+			candidate.position.x = foothold.position(dwl::rbd::X);
+			candidate.position.y = foothold.position(dwl::rbd::Y);
+			candidate.position.z = foothold.position(dwl::rbd::Z);
+			candidate.normal.x = foothold.normal(dwl::rbd::X);
+			candidate.normal.y = foothold.normal(dwl::rbd::Y);
+			candidate.normal.z = foothold.normal(dwl::rbd::Z);
+			candidate.cost = foothold.cost;
+			candidate.region = foothold.region;
+		}
+
+		return true;
+	}
 
-		// Deleting old information
+	return false;
+}
+
+
+bool TerrainMapServer::buildObstacleMap()
+{
+	if (terrain_map_.isObstacleMap()) {
+		ScopedTimer timer(statistics_.getStage(OBSTACLE_MSG_STAGE));
+		ScopedTrace trace(trace_, "obstacle_msg", num_frames_);
+		obstacle_pub_.update(terrain_map_.getObstacleMap(),
+							 terrain_map_.getResolution(true),
+							 terrain_map_.getResolution(false));
+		return true;
+	}
+
+	return false;
+}
+
+
+void TerrainMapServer::publishFrame(std::unique_lock<std::mutex>& map_lock,
+									const Eigen::Vector4d& robot_state)
+{
+	// The end of the frame is sent with the map locked, so it follows the
+	// chunks of the frame
+	publishTerrainChunks(false);
+
+	// Building the messages of the frame. The previous frame has to be sent
+	// before reusing its messages
+	std::lock_guard<std::mutex> publish_lock(publish_mutex_);
+	bool is_map = buildTerrainMap();
+	bool is_layers = buildCostLayers();
+	bool is_obstacle = buildObstacleMap();
+	bool is_footholds = buildFootholds(robot_state);
+	map_lock.unlock();
+
+	// Sending the messages without the map
+	if (is_map) {
+		map_pub_.publish(map_msg_);
 		map_msg_.cell.clear();
 	}
+	if (is_layers)
+		layers_pub_.publish(layers_msg_);
+	if (is_obstacle)
+		obstacle_pub_.publish();
+	if (is_footholds)
+		footholds_pub_.publish(footholds_msg_);
 }
 
 } //@namespace terrain_server
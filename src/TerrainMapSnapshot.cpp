@@ -0,0 +1,251 @@
+#include <terrain_server/TerrainMapSnapshot.h>
+#include <terrain_server/TerrainMapping.h>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+namespace terrain_server
+{
+
+static const char SNAPSHOT_MAGIC[8] = {'T', 'E', 'R', 'R', 'S', 'N', 'A', 'P'};
+
+static_assert(sizeof(SnapshotHeader) % 8 == 0, "The snapshot header has to be 8-byte aligned");
+static_assert(sizeof(SnapshotLayer) % 8 == 0, "The snapshot layer has to be 8-byte aligned");
+static_assert(sizeof(SnapshotCell) % 8 == 0, "The snapshot cell has to be 8-byte aligned");
+
+
+TerrainMapSnapshot::TerrainMapSnapshot() : data_(NULL), size_(0)
+{
+
+}
+
+
+TerrainMapSnapshot::~TerrainMapSnapshot()
+{
+	close();
+}
+
+
+int TerrainMapSnapshot::write(const std::string& filename,
+							  const TerrainMapping& terrain_map,
+							  const std::string& frame_id,
+							  double stamp)
+{
+	const dwl::TerrainDataMap& terrain_gridmap = terrain_map.getTerrainDataMap();
+	const dwl::environment::SpaceDiscretization& space_discretization =
+			terrain_map.getSpaceDiscretization();
+	const CostLayers& layers = terrain_map.getCostLayers();
+	const std::map<dwl::Vertex, unsigned int>& slots = layers.getSlots();
+
+	// Getting the features of the cost layers. The layers are written if all
+	// the cells have costs
+	uint32_t num_layers = 0;
+	if (layers.getNumLayers() == terrain_map.getNumFeatures() &&
+			slots.size() == terrain_gridmap.size())
+		num_layers = layers.getNumLayers();
+
+	std::vector<SnapshotLayer> snapshot_layers(num_layers);
+	for (unsigned int n = 0; n < num_layers; n++) {
+		memset(&snapshot_layers[n], 0, sizeof(SnapshotLayer));
+		strncpy(snapshot_layers[n].name, terrain_map.getFeatureName(n).c_str(),
+				sizeof(snapshot_layers[n].name) - 1);
+		snapshot_layers[n].weight = terrain_map.getFeatureWeight(n);
+	}
+
+	// Converting the terrain map into cells, and their cost layers
+	uint64_t num_cells = terrain_gridmap.size();
+	std::vector<SnapshotCell> cells(num_cells);
+	std::vector<double> costs(num_layers * num_cells);
+	double min_x = std::numeric_limits<double>::max();
+	double min_y = std::numeric_limits<double>::max();
+	double min_z = std::numeric_limits<double>::max();
+	uint64_t idx = 0;
+	std::map<dwl::Vertex, unsigned int>::const_iterator slot_it = slots.begin();
+	for (dwl::TerrainDataMap::const_iterator cell_it = terrain_gridmap.begin();
+			cell_it != terrain_gridmap.end(); cell_it++)
+	{
+		const dwl::TerrainCell& terrain_cell = cell_it->second;
+		Eigen::Vector2d coord;
+		space_discretization.vertexToCoord(coord, cell_it->first);
+
+		SnapshotCell& cell = cells[idx];
+		cell.vertex = cell_it->first;
+		cell.key_x = terrain_cell.key.x;
+		cell.key_y = terrain_cell.key.y;
+		cell.key_z = terrain_cell.key.z;
+		cell.padding = 0;
+		cell.x = coord(0);
+		cell.y = coord(1);
+		cell.height = terrain_cell.height;
+		cell.cost = terrain_cell.cost;
+		cell.normal[0] = terrain_cell.normal(0);
+		cell.normal[1] = terrain_cell.normal(1);
+		cell.normal[2] = terrain_cell.normal(2);
+
+		min_x = std::min(min_x, cell.x);
+		min_y = std::min(min_y, cell.y);
+		min_z = std::min(min_z, cell.height);
+
+		// The slots and the terrain map are ordered by vertex
+		if (num_layers > 0) {
+			while (slot_it != slots.end() && slot_it->first < cell_it->first)
+				slot_it++;
+			if (slot_it == slots.end() || slot_it->first != cell_it->first)
+				return -1;
+
+			for (unsigned int n = 0; n < num_layers; n++)
+				costs[n * num_cells + idx] = layers.getCost(n, slot_it->second);
+		}
+
+		idx++;
+	}
+
+	// Filling the header
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(SnapshotHeader));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.header_size = sizeof(SnapshotHeader);
+	header.cell_size = sizeof(SnapshotCell);
+	header.num_layers = num_layers;
+	header.num_cells = num_cells;
+	header.layers_offset = sizeof(SnapshotHeader);
+	header.cells_offset = header.layers_offset + num_layers * sizeof(SnapshotLayer);
+	header.costs_offset = header.cells_offset + num_cells * sizeof(SnapshotCell);
+	header.file_size = header.costs_offset + num_layers * num_cells * sizeof(double);
+	header.plane_size = terrain_map.getResolution(true);
+	header.height_size = terrain_map.getResolution(false);
+	header.origin[0] = num_cells > 0 ? min_x : 0.;
+	header.origin[1] = num_cells > 0 ? min_y : 0.;
+	header.origin[2] = num_cells > 0 ? min_z : 0.;
+	header.stamp = stamp;
+	strncpy(header.frame_id, frame_id.c_str(), sizeof(header.frame_id) - 1);
+
+	// Writing the sections in a temporary file
+	std::string tmp_filename = filename + ".tmp";
+	std::ofstream file(tmp_filename.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return -1;
+
+	file.write((const char*) &header, sizeof(SnapshotHeader));
+	if (num_layers > 0)
+		file.write((const char*) snapshot_layers.data(), num_layers * sizeof(SnapshotLayer));
+	if (num_cells > 0)
+		file.write((const char*) cells.data(), num_cells * sizeof(SnapshotCell));
+	if (!costs.empty())
+		file.write((const char*) costs.data(), costs.size() * sizeof(double));
+	file.close();
+
+	if (!file || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		remove(tmp_filename.c_str());
+		return -1;
+	}
+
+	return num_cells;
+}
+
+
+bool TerrainMapSnapshot::open(const std::string& filename)
+{
+	close();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size < (off_t) sizeof(SnapshotHeader)) {
+		::close(fd);
+		return false;
+	}
+
+	// The mapping is kept after closing the file descriptor
+	size_t size = file_stat.st_size;
+	void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	// Validating the layout. The counts are bounded by the file size before
+	// the sizes of the sections are computed, so the products can't wrap
+	const SnapshotHeader* header = (const SnapshotHeader*) data;
+	uint64_t file_size = size;
+	bool valid = memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+			header->version == SNAPSHOT_VERSION &&
+			header->header_size == sizeof(SnapshotHeader) &&
+			header->cell_size == sizeof(SnapshotCell) &&
+			header->file_size == file_size &&
+			header->num_layers <= file_size / sizeof(SnapshotLayer) &&
+			header->num_cells <= file_size / sizeof(SnapshotCell) &&
+			(header->num_layers == 0 ||
+			 header->num_cells <= file_size / (header->num_layers * sizeof(double))) &&
+			header->layers_offset == sizeof(SnapshotHeader) &&
+			header->cells_offset ==
+					header->layers_offset + header->num_layers * sizeof(SnapshotLayer) &&
+			header->costs_offset ==
+					header->cells_offset + header->num_cells * sizeof(SnapshotCell) &&
+			header->file_size ==
+					header->costs_offset + header->num_layers * header->num_cells * sizeof(double);
+	if (!valid) {
+		munmap(data, size);
+		return false;
+	}
+
+	data_ = data;
+	size_ = size;
+
+	return true;
+}
+
+
+void TerrainMapSnapshot::close()
+{
+	if (data_) {
+		munmap(data_, size_);
+		data_ = NULL;
+		size_ = 0;
+	}
+}
+
+
+bool TerrainMapSnapshot::isOpen() const
+{
+	return data_ != NULL;
+}
+
+
+const SnapshotHeader& TerrainMapSnapshot::getHeader() const
+{
+	return *(const SnapshotHeader*) data_;
+}
+
+
+const SnapshotLayer* TerrainMapSnapshot::getLayers() const
+{
+	return (const SnapshotLayer*) ((const char*) data_ + getHeader().layers_offset);
+}
+
+
+const SnapshotCell* TerrainMapSnapshot::getCells() const
+{
+	return (const SnapshotCell*) ((const char*) data_ + getHeader().cells_offset);
+}
+
+
+const double* TerrainMapSnapshot::getCosts(unsigned int layer) const
+{
+	const SnapshotHeader& header = getHeader();
+	return (const double*) ((const char*) data_ + header.costs_offset) +
+			layer * header.num_cells;
+}
+
+} //@namespace terrain_server
@@ -1,4 +1,7 @@
 #include <terrain_server/TerrainMapping.h>
+#include <dwl/utils/Orientation.h>
+#include <string.h>
+#include <algorithm>
 
 
 namespace terrain_server
@@ -8,7 +11,12 @@ TerrainMapping::TerrainMapping() :
 		is_added_feature_(false), is_added_search_area_(false),
 		interest_radius_x_(std::numeric_limits<double>::max()),
 		interest_radius_y_(std::numeric_limits<double>::max()),
-		using_cloud_mean_(false), depth_(16)
+		using_cloud_mean_(false), depth_(16),
+		obstacle_min_z_(0.), obstacle_max_z_(0.), is_obstacle_area_(false),
+		integration_resolution_(0.02),
+		integration_max_range_(-1.), corridor_width_(0.4), corridor_horizon_(2.),
+		corridor_min_z_(0.), corridor_max_z_(0.), is_integration_state_(false),
+		is_fused_pipeline_(true), tile_size_(0), chunk_size_(16), is_pyramid_(false)
 {
 	// Default neighboring area
 	setNeighboringArea(-2, 2, -2, 2, -2, 2);
@@ -33,6 +41,8 @@ void TerrainMapping::addFeature(dwl::environment::Feature* feature)
 	printf(GREEN_ "Adding the %s feature with a weight of %f\n" COLOR_RESET,
 			feature->getName().c_str(), weight);
 	features_.push_back(feature);
+	resetFeaturePipeline();
+	cost_layers_.reset(features_.size());
 	is_added_feature_ = true;
 }
 
@@ -45,6 +55,8 @@ void TerrainMapping::removeFeature(std::string feature_name)
 			printf(GREEN_ "Removing the %s feature\n" COLOR_RESET,
 					features_[i]->getName().c_str());
 			features_.erase(features_.begin() + i);
+			resetFeaturePipeline();
+			cost_layers_.reset(features_.size());
 
 			return;
 		}
@@ -59,24 +71,29 @@ void TerrainMapping::removeFeature(std::string feature_name)
 void TerrainMapping::compute(octomap::OcTree* octomap,
 							 const Eigen::Vector4d& robot_state)
 {
-	if (!is_added_search_area_) {
-		printf(YELLOW_ "Warning: adding a default search area \n" COLOR_RESET);
-		// Adding a default search area
-		addSearchArea(1.5, 4.0, -1.25, 1.25, -0.8, -0.2, 0.04);
+	prepareFrame(robot_state);
+	double stage_time = getMonotonicTime();
 
-		is_added_search_area_ = true;
-	}
+	// Getting the margins of the sensor frustum, i.e. a column is visible if
+	// its cell intersects the frustum, and the terrain data of a cell is
+	// recomputed if one of its neighbors is visible
+	double resolution_xy = space_discretization_.getEnvironmentResolution(true);
+	double column_margin = M_SQRT1_2 * resolution_xy;
+	int neighbors = std::max(std::max(-neighboring_area_.min_x, neighboring_area_.max_x),
+							 std::max(-neighboring_area_.min_y, neighboring_area_.max_y));
+	double neighbor_margin = column_margin + M_SQRT2 * neighbors * resolution_xy;
 
-	if (terrain_information_) {
-		// Removing the points that doesn't belong to the interest area
-		Eigen::Vector3d robot_2dpose; // (x,y,yaw)
-		robot_2dpose(0) = robot_state(0);
-		robot_2dpose(1) = robot_state(1);
-		robot_2dpose(2) = robot_state(3);
-		removeTerrainOutsideInterestRegion(robot_2dpose);
+	// Computing the columns of the corridor of the planned path first, i.e.
+	// they are computed even outside the search areas
+	for (unsigned int i = 0; i < corridor_columns_.size(); i++) {
+		Eigen::Vector2d coord;
+		space_discretization_.vertexToCoord(coord, corridor_columns_[i]);
+		if (!scanColumn(octomap, coord(0), coord(1),
+						corridor_min_z_ + robot_state(2), corridor_max_z_ + robot_state(2),
+						robot_state, column_margin))
+			return;
 	}
 
-
 	// Computing terrain map for several search areas
 	double yaw = robot_state(3);
 	unsigned int area_size = search_areas_.size();
@@ -98,83 +115,32 @@ void TerrainMapping::compute(octomap::OcTree* octomap,
 				double yr = (x - robot_state(0)) * sin(yaw) +
 							(y - robot_state(1)) * cos(yaw) + robot_state(1);
 
-				// Checking if the cell belongs to dimensions of the map,
-				// and also getting the key of this cell
-				double z = search_areas_[n].max_z + robot_state(2);
-				octomap::OcTreeKey init_key;
-				if (!octomap->coordToKeyChecked(xr, yr, z, depth_, init_key)) {
-					printf(RED_ "Cell out of bounds\n" COLOR_RESET);
-
-					return;
+				// Skipping the columns already computed in the corridor
+				if (!corridor_set_.empty()) {
+					dwl::Vertex vertex_id;
+					space_discretization_.coordToVertex(vertex_id, Eigen::Vector2d(xr, yr));
+					if (corridor_set_.count(vertex_id) > 0)
+						continue;
 				}
 
-				// Finding the cell of the surface
-				int r = 0;
-				octomap::OcTreeNode* heightmap_node =
-						octomap->search(init_key, depth_);
-				while (z >= search_areas_[n].min_z + robot_state(2)) {
-					octomap::OcTreeKey heightmap_key;
-					heightmap_key[0] = init_key[0];
-					heightmap_key[1] = init_key[1];
-					heightmap_key[2] = init_key[2] - r;
-
-					heightmap_node = octomap->search(heightmap_key, depth_);
-					octomap::point3d height_point =
-							octomap->keyToCoord(heightmap_key, depth_);
-					z = height_point(2);
-					if (heightmap_node) {
-						// Computation of the heightmap
-						if (octomap->isNodeOccupied(heightmap_node)) {
-							// Getting position of the occupied cell
-							dwl::Key cell_key;
-							Eigen::Vector3d cell_position;
-							cell_position(0) = height_point(0);
-							cell_position(1) = height_point(1);
-							cell_position(2) = height_point(2);
-							space_discretization_.coordToKeyChecked(cell_key,
-																	cell_position);
-
-							dwl::Vertex vertex_id;
-							space_discretization_.keyToVertex(vertex_id, cell_key, true);
-							if (!terrain_information_)
-								addCellToTerrainHeightMap(vertex_id,
-														  (double) cell_position(2));
-							else {
-								bool new_status = true;
-								std::map<dwl::Vertex,double>::iterator height_it =
-										terrain_heightmap_.find(vertex_id);
-								if (height_it != terrain_heightmap_.end()) {
-									// Evaluating if it changed status (height)
-									unsigned short int old_key_z;
-									space_discretization_.coordToKey(old_key_z,
-																	 height_it->second,
-																	 false);
-									if (old_key_z != cell_key.z) {
-										removeCellToTerrainMap(vertex_id);
-										removeCellToTerrainHeightMap(vertex_id);
-									} else
-										new_status = false;
-								}
-
-								if (new_status)
-									addCellToTerrainHeightMap(vertex_id,
-															  (double) cell_position(2));
-							}
-							break;
-						}
-					}
-					r++;
-				}
+				if (!scanColumn(octomap, xr, yr,
+								search_areas_[n].min_z + robot_state(2),
+								search_areas_[n].max_z + robot_state(2),
+								robot_state, column_margin))
+					return;
 			}
 		}
 	}
 
+	profile_.surface = getMonotonicTime() - stage_time;
+	stage_time = getMonotonicTime();
+
 	// Setting the terrain information
-	*terrain_info_.height_map = terrain_heightmap_;
-	terrain_info_.resolution = space_discretization_.getEnvironmentResolution(true);
-	terrain_info_.min_height = min_height_;
+	setTerrainInformation();
 
-	// Computing the terrain map
+	// Getting the cells whose terrain data is recomputed
+	std::vector<dwl::Vertex> vertices;
+	std::vector<octomap::OcTreeKey> keys;
 	for (std::map<dwl::Vertex, double>::iterator terrain_iter = terrain_heightmap_.begin();
 			terrain_iter != terrain_heightmap_.end();
 			terrain_iter++)
@@ -191,9 +157,18 @@ void TerrainMapping::compute(octomap::OcTree* octomap,
 		terrain_point(2) = height;
 		heightmap_key = octomap->coordToKey(terrain_point, depth_);
 
-		if (!terrain_information_)
-			computeTerrainData(octomap, heightmap_key);
-		else {
+		// The cells outside the sensor frustum keep their terrain data
+		if (frustum_.isSet() &&
+				!frustum_.isColumnVisible(xy_coord(0), xy_coord(1), height, height,
+										  neighbor_margin) &&
+				terrain_map_.find(vertex_id) != terrain_map_.end())
+			continue;
+		profile_.num_processed++;
+
+		if (!terrain_information_) {
+			vertices.push_back(vertex_id);
+			keys.push_back(heightmap_key);
+		} else {
 			bool new_status = true;
 			std::map<dwl::Vertex,dwl::TerrainCell>::iterator terrain_it =
 					terrain_map_.find(vertex_id);
@@ -201,22 +176,831 @@ void TerrainMapping::compute(octomap::OcTree* octomap,
 				// Evaluating if it's changed status (height)
 				dwl::TerrainCell terrain_cell = terrain_it->second;
 
-				if (terrain_cell.key.z != heightmap_key[2]) {
-					removeCellToTerrainMap(vertex_id);
-					removeCellToTerrainHeightMap(vertex_id);
-				} else
+				if (terrain_cell.key.z != heightmap_key[2])
+					removeTerrainCell(vertex_id);
+				else
 					new_status = true;//false;
 			}
 
-			if (new_status)
-				computeTerrainData(octomap, heightmap_key);
+			if (new_status) {
+				vertices.push_back(vertex_id);
+				keys.push_back(heightmap_key);
+			}
+		}
+	}
+
+	// Computing the terrain map
+	computeTerrainChunks(vertices, robot_state,
+						 [&](unsigned int i) { computeTerrainData(octomap, keys[i]); });
+	profile_.terrain_data = getMonotonicTime() - stage_time;
+	profile_.map_size = terrain_map_.size();
+
+	terrain_information_ = true;
+}
+
+
+bool TerrainMapping::scanColumn(octomap::OcTree* octomap,
+								double x, double y,
+								double min_z, double max_z,
+								const Eigen::Vector4d& robot_state,
+								double margin)
+{
+	// Checking if the cell belongs to dimensions of the map,
+	// and also getting the key of this cell. Note that the column
+	// also covers the obstacle band when it's computed
+	double top_z = max_z, bottom_z = min_z;
+	if (is_obstacle_area_) {
+		top_z = std::max(max_z, obstacle_max_z_ + robot_state(2));
+		bottom_z = std::min(min_z, obstacle_min_z_ + robot_state(2));
+	}
+
+	// The columns outside the sensor frustum keep their values
+	if (!frustum_.isColumnVisible(x, y, bottom_z, top_z, margin))
+		return true;
+	profile_.num_columns++;
+	octomap::OcTreeKey init_key, max_key;
+	if (!octomap->coordToKeyChecked(x, y, top_z, depth_, init_key) ||
+			!octomap->coordToKeyChecked(x, y, max_z, depth_, max_key)) {
+		printf(RED_ "Cell out of bounds\n" COLOR_RESET);
+
+		return false;
+	}
+
+	// Finding the cell of the surface and the obstacle (if it's
+	// required) in a single pass through the column
+	bool surface_found = false;
+	bool obstacle_found = !is_obstacle_area_;
+	double z = top_z;
+	int r = 0;
+	while (z >= bottom_z && !(surface_found && obstacle_found)) {
+		double entry_z = z;
+		octomap::OcTreeKey heightmap_key;
+		heightmap_key[0] = init_key[0];
+		heightmap_key[1] = init_key[1];
+		heightmap_key[2] = init_key[2] - r;
+
+		octomap::OcTreeNode* heightmap_node =
+				octomap->search(heightmap_key, depth_);
+		octomap::point3d height_point =
+				octomap->keyToCoord(heightmap_key, depth_);
+		z = height_point(2);
+		if (heightmap_node && octomap->isNodeOccupied(heightmap_node)) {
+			// Getting position of the occupied cell
+			Eigen::Vector3d cell_position;
+			cell_position(0) = height_point(0);
+			cell_position(1) = height_point(1);
+			cell_position(2) = height_point(2);
+
+			// Computation of the obstacle map
+			if (!obstacle_found &&
+					z >= obstacle_min_z_ + robot_state(2) &&
+					z <= obstacle_max_z_ + robot_state(2)) {
+				addCellToObstacleMap(cell_position);
+				obstacle_found = true;
+			}
+
+			// Computation of the heightmap
+			if (!surface_found && entry_z >= min_z &&
+					heightmap_key[2] <= max_key[2]) {
+				updateHeightMapCell(cell_position);
+				surface_found = true;
+			}
+		}
+		r++;
+	}
+
+	// Removing the obstacle of this column if there isn't one
+	if (!obstacle_found) {
+		dwl::Vertex vertex_id;
+		space_discretization_.coordToVertex(vertex_id, Eigen::Vector2d(x, y));
+		obstacle_map_.erase(vertex_id);
+	}
+
+	return true;
+}
+
+
+void TerrainMapping::compute(const HeightGrid& grid,
+							 const Eigen::Vector4d& robot_state)
+{
+	prepareFrame(robot_state);
+	double stage_time = getMonotonicTime();
+
+	// Updating the heightmap with the cells of the grid inside the search
+	// areas
+	double yaw = robot_state(3);
+	std::vector<dwl::Vertex> vertices;
+	std::vector<unsigned int> cells;
+	for (unsigned int j = 0; j < grid.height; j++) {
+		for (unsigned int i = 0; i < grid.width; i++) {
+			float height = grid.heights[j * grid.width + i];
+			if (std::isnan(height))
+				continue;
+
+			Eigen::Vector3d cell_position;
+			cell_position(0) = grid.origin_x + (i + 0.5) * grid.resolution;
+			cell_position(1) = grid.origin_y + (j + 0.5) * grid.resolution;
+			cell_position(2) = height;
+			profile_.num_columns++;
+
+			// Getting the position w.r.t. the robot (without the yaw rotation)
+			double xc = cell_position(0) - robot_state(0);
+			double yc = cell_position(1) - robot_state(1);
+			double xr = xc * cos(yaw) + yc * sin(yaw);
+			double yr = -xc * sin(yaw) + yc * cos(yaw);
+			double zr = height - robot_state(2);
+			bool is_inside = false;
+			for (unsigned int n = 0; n < search_areas_.size() && !is_inside; n++) {
+				const dwl::SearchArea& area = search_areas_[n];
+				is_inside = xr >= area.min_x && xr <= area.max_x &&
+						yr >= area.min_y && yr <= area.max_y &&
+						zr >= area.min_z && zr <= area.max_z;
+			}
+
+			// The cells of the corridor of the planned path are also added
+			dwl::Vertex vertex_id;
+			space_discretization_.coordToVertex(vertex_id, cell_position.head<2>());
+			if (!is_inside && !(zr >= corridor_min_z_ && zr <= corridor_max_z_ &&
+					corridor_set_.count(vertex_id) > 0))
+				continue;
+
+			updateHeightMapCell(cell_position);
+
+			vertices.push_back(vertex_id);
+			cells.push_back(j * grid.width + i);
+		}
+	}
+
+	profile_.surface = getMonotonicTime() - stage_time;
+	stage_time = getMonotonicTime();
+
+	// Computing the terrain data of the observed cells from the heightmap.
+	// The normals estimated by the binning are used directly, i.e. only the
+	// cells without them are fitted to their neighbors
+	setTerrainInformation();
+	bool is_normals = grid.normals.size() == grid.heights.size() &&
+			grid.curvatures.size() == grid.heights.size();
+	profile_.num_processed += vertices.size();
+	computeTerrainChunks(vertices, robot_state, [&](unsigned int i) {
+		if (is_normals && !std::isnan(grid.curvatures[cells[i]])) {
+			feature::TerrainSample sample;
+			Eigen::Vector2d coord;
+			space_discretization_.vertexToCoord(coord, vertices[i]);
+			sample.height = grid.heights[cells[i]];
+			sample.position = Eigen::Vector3d(coord(0), coord(1), sample.height);
+			sample.surface_normal = grid.normals[cells[i]].cast<double>();
+			sample.curvature = grid.curvatures[cells[i]];
+			samples_.push_back(sample);
+		} else
+			computeTerrainData(vertices[i]);
+	});
+	profile_.terrain_data = getMonotonicTime() - stage_time;
+	profile_.map_size = terrain_map_.size();
+
+	terrain_information_ = true;
+}
+
+
+void TerrainMapping::computeFromPointCloud(const std::vector<Eigen::Vector3f>& points,
+										   const Eigen::Vector3d& position,
+										   const Eigen::Quaterniond& orientation)
+{
+	// Getting the robot state (3D position and yaw angle)
+	Eigen::Vector4d robot_state;
+	robot_state.head(3) = position;
+	robot_state(3) = dwl::math::getYaw(dwl::math::getRPY(orientation));
+
+	// Binning the points in the height grid
+	double min_z, max_z;
+	setHeightGridBounds(height_grid_, min_z, max_z, robot_state);
+	double stage_time = getMonotonicTime();
+	height_binner_.compute(height_grid_, points, min_z, max_z);
+	double binning_time = getMonotonicTime() - stage_time;
+
+	compute(height_grid_, robot_state);
+	profile_.surface += binning_time;
+}
+
+
+void TerrainMapping::computeFromDepthImage(const DepthImage& image,
+										   const CameraIntrinsics& intrinsics,
+										   const Eigen::Affine3d& camera_pose,
+										   const Eigen::Vector3d& position,
+										   const Eigen::Quaterniond& orientation)
+{
+	// Getting the robot state (3D position and yaw angle)
+	Eigen::Vector4d robot_state;
+	robot_state.head(3) = position;
+	robot_state(3) = dwl::math::getYaw(dwl::math::getRPY(orientation));
+
+	// Binning the pixels in the height grid
+	double min_z, max_z;
+	setHeightGridBounds(height_grid_, min_z, max_z, robot_state);
+	double stage_time = getMonotonicTime();
+	depth_binner_.compute(height_grid_, image, intrinsics, camera_pose, min_z, max_z);
+	double binning_time = getMonotonicTime() - stage_time;
+
+	compute(height_grid_, robot_state);
+	profile_.surface += binning_time;
+}
+
+
+void TerrainMapping::setHeightBinning(bool is_percentile,
+									  double percentile,
+									  unsigned int num_threads)
+{
+	height_binner_.setPercentile(is_percentile, percentile);
+	height_binner_.setNumThreads(num_threads);
+}
+
+
+void TerrainMapping::setDepthBinning(double min_depth,
+									 double max_depth,
+									 double max_jump)
+{
+	depth_binner_.setDepthRange(min_depth, max_depth);
+	depth_binner_.setMaxDepthJump(max_jump);
+}
+
+
+void TerrainMapping::setHeightGridBounds(HeightGrid& grid,
+										 double& min_z, double& max_z,
+										 const Eigen::Vector4d& robot_state)
+{
+	// Setting the resolution of the height
+	addDefaultSearchArea();
+	double resolution = space_discretization_.getEnvironmentResolution(true);
+	setResolution(resolution, false);
+
+	// Getting the bounding box of the search areas around the robot, which
+	// is aligned to the cells of the map
+	double yaw = robot_state(3);
+	double min_x = std::numeric_limits<double>::max(), max_x = -min_x;
+	double min_y = min_x, max_y = -min_x;
+	min_z = min_x;
+	max_z = -min_x;
+	for (unsigned int n = 0; n < search_areas_.size(); n++) {
+		const dwl::SearchArea& area = search_areas_[n];
+		double corners_x[4] = {area.min_x, area.max_x, area.min_x, area.max_x};
+		double corners_y[4] = {area.min_y, area.min_y, area.max_y, area.max_y};
+		for (unsigned int c = 0; c < 4; c++) {
+			double x = corners_x[c] * cos(yaw) - corners_y[c] * sin(yaw) + robot_state(0);
+			double y = corners_x[c] * sin(yaw) + corners_y[c] * cos(yaw) + robot_state(1);
+			min_x = std::min(min_x, x);
+			max_x = std::max(max_x, x);
+			min_y = std::min(min_y, y);
+			max_y = std::max(max_y, y);
+		}
+		min_z = std::min(min_z, area.min_z + robot_state(2));
+		max_z = std::max(max_z, area.max_z + robot_state(2));
+	}
+
+	// Adding the corridor of the planned path
+	updateCorridor(robot_state);
+	if (!corridor_columns_.empty()) {
+		min_x = std::min(min_x, corridor_min_(0));
+		min_y = std::min(min_y, corridor_min_(1));
+		max_x = std::max(max_x, corridor_max_(0));
+		max_y = std::max(max_y, corridor_max_(1));
+	}
+
+	grid.resolution = resolution;
+	grid.origin_x = floor(min_x / resolution) * resolution;
+	grid.origin_y = floor(min_y / resolution) * resolution;
+	grid.width = ceil((max_x - grid.origin_x) / resolution);
+	grid.height = ceil((max_y - grid.origin_y) / resolution);
+}
+
+
+void TerrainMapping::prepareFrame(const Eigen::Vector4d& robot_state)
+{
+	addDefaultSearchArea();
+	updateCorridor(robot_state);
+
+	profile_ = TerrainMappingProfile();
+	double stage_time = getMonotonicTime();
+	if (terrain_information_) {
+		// Removing the points that doesn't belong to the interest area
+		Eigen::Vector3d robot_2dpose; // (x,y,yaw)
+		robot_2dpose(0) = robot_state(0);
+		robot_2dpose(1) = robot_state(1);
+		robot_2dpose(2) = robot_state(3);
+		removeTerrainOutsideInterestRegion(robot_2dpose);
+	}
+	profile_.pruning = getMonotonicTime() - stage_time;
+}
+
+
+void TerrainMapping::addDefaultSearchArea()
+{
+	if (!is_added_search_area_) {
+		printf(YELLOW_ "Warning: adding a default search area \n" COLOR_RESET);
+		// Adding a default search area
+		addSearchArea(1.5, 4.0, -1.25, 1.25, -0.8, -0.2, 0.04);
+
+		is_added_search_area_ = true;
+	}
+}
+
+
+void TerrainMapping::setTerrainInformation()
+{
+	*terrain_info_.height_map = terrain_heightmap_;
+	terrain_info_.resolution = space_discretization_.getEnvironmentResolution(true);
+	terrain_info_.min_height = min_height_;
+}
+
+
+void TerrainMapping::compute(octomap::OcTree* model,
+							 const Eigen::Vector3d& position,
+							 const Eigen::Quaterniond& orientation)
+{
+	// Getting the robot state (3D position and yaw angle)
+	Eigen::Vector4d robot_state;
+	robot_state.head(3) = position;
+	robot_state(3) = dwl::math::getYaw(dwl::math::getRPY(orientation));
+
+	// Setting the resolution of the height
+	setResolution(model->getResolution(), false);
+
+	compute(model, robot_state);
+}
+
+
+void TerrainMapping::compute(const std::vector<Eigen::Vector3d>& points,
+							 double resolution,
+							 const Eigen::Vector3d& position,
+							 const Eigen::Quaterniond& orientation)
+{
+	// Reusing the octree of the points if the resolution doesn't change
+	if (point_octree_ && point_octree_->getResolution() != resolution)
+		point_octree_.reset();
+
+	if (!point_octree_)
+		point_octree_.reset(new octomap::OcTree(resolution));
+	else
+		point_octree_->clear();
+
+	// Inserting the points as occupied cells
+	for (unsigned int i = 0; i < points.size(); i++) {
+		point_octree_->updateNode(octomap::point3d(points[i](0), points[i](1), points[i](2)),
+								  true, true);
+	}
+	point_octree_->updateInnerOccupancy();
+
+	compute(point_octree_.get(), position, orientation);
+}
+
+
+void TerrainMapping::integratePointCloud(const std::vector<Eigen::Vector3f>& points,
+										 const Eigen::Vector3d& sensor_origin,
+										 const Eigen::Vector3d& position,
+										 const Eigen::Quaterniond& orientation)
+{
+	// Getting the robot state (3D position and yaw angle)
+	Eigen::Vector4d robot_state;
+	robot_state.head(3) = position;
+	robot_state(3) = dwl::math::getYaw(dwl::math::getRPY(orientation));
+
+	// Creating the octree, it records the keys changed by the integration
+	if (!integrated_octree_) {
+		integrated_octree_.reset(new octomap::OcTree(integration_resolution_));
+		integrated_octree_->enableChangeDetection(true);
+		pruning_position_ = position.head<2>();
+		is_integration_state_ = false;
+	}
+
+	// Limiting the integration to the bounding box of the search areas
+	double min_z, max_z;
+	setHeightGridBounds(height_grid_, min_z, max_z, robot_state);
+	setResolution(integration_resolution_, false);
+	double start_time = getMonotonicTime();
+	integrated_octree_->setBBXMin(octomap::point3d(height_grid_.origin_x,
+												   height_grid_.origin_y,
+												   min_z));
+	integrated_octree_->setBBXMax(
+			octomap::point3d(height_grid_.origin_x + height_grid_.width * height_grid_.resolution,
+							 height_grid_.origin_y + height_grid_.height * height_grid_.resolution,
+							 max_z));
+	integrated_octree_->useBBXLimit(true);
+
+	// Integrating the points
+	integration_cloud_.clear();
+	integration_cloud_.reserve(points.size());
+	for (unsigned int i = 0; i < points.size(); i++)
+		integration_cloud_.push_back(points[i](0), points[i](1), points[i](2));
+	integrated_octree_->insertPointCloud(integration_cloud_,
+										 octomap::point3d(sensor_origin(0),
+														  sensor_origin(1),
+														  sensor_origin(2)),
+										 integration_max_range_, true);
+	integrated_octree_->updateInnerOccupancy();
+
+	// Getting the columns of the changed keys
+	std::set<dwl::Vertex> columns;
+	for (octomap::OcTree::changed_iterator key_it = integrated_octree_->changedKeysBegin();
+			key_it != integrated_octree_->changedKeysEnd(); key_it++) {
+		octomap::point3d point = integrated_octree_->keyToCoord(key_it->first);
+		dwl::Vertex vertex_id;
+		space_discretization_.coordToVertex(vertex_id, Eigen::Vector2d(point(0), point(1)));
+		columns.insert(vertex_id);
+	}
+	integrated_octree_->resetChangeDetection();
+	addEnteredColumns(columns, robot_state);
+	pruneIntegratedOcTree(robot_state);
+	double integration_time = getMonotonicTime() - start_time;
+
+	computeColumns(integrated_octree_.get(), robot_state, columns);
+	profile_.surface += integration_time;
+}
+
+
+void TerrainMapping::setCorridor(const std::vector<Eigen::Vector2d>& path,
+								 double width,
+								 double horizon)
+{
+	corridor_path_ = path;
+	corridor_width_ = width;
+	corridor_horizon_ = horizon;
+}
+
+
+void TerrainMapping::clearCorridor()
+{
+	corridor_path_.clear();
+	corridor_columns_.clear();
+	corridor_set_.clear();
+}
+
+
+const std::vector<dwl::Vertex>& TerrainMapping::getCorridor() const
+{
+	return corridor_columns_;
+}
+
+
+void TerrainMapping::setChunkHandler(const ChunkHandler& handler,
+									 unsigned int chunk_size)
+{
+	chunk_handler_ = handler;
+	chunk_size_ = std::max(chunk_size, 1u);
+}
+
+
+void TerrainMapping::clearChunkHandler()
+{
+	chunk_handler_ = ChunkHandler();
+}
+
+
+void TerrainMapping::getChunkCells(std::vector<dwl::TerrainCell>& cells,
+								   uint32_t id) const
+{
+	cells.clear();
+	if (!chunk_handler_)
+		return;
+
+	// Looking up the cells of the chunk key by key
+	unsigned int min_x = (id >> 16) * chunk_size_;
+	unsigned int min_y = (id & 0xFFFF) * chunk_size_;
+	for (unsigned int x = min_x; x < min_x + chunk_size_; x++) {
+		for (unsigned int y = min_y; y < min_y + chunk_size_; y++) {
+			dwl::Key key;
+			key.x = x;
+			key.y = y;
+			dwl::Vertex vertex_id;
+			space_discretization_.keyToVertex(vertex_id, key, true);
+			std::map<dwl::Vertex,dwl::TerrainCell>::const_iterator cell_it =
+					terrain_map_.find(vertex_id);
+			if (cell_it != terrain_map_.end())
+				cells.push_back(cell_it->second);
+		}
+	}
+}
+
+
+void TerrainMapping::getChunkIds(std::vector<uint32_t>& ids) const
+{
+	ids.clear();
+	if (!chunk_handler_)
+		return;
+
+	std::set<uint32_t> chunks;
+	for (std::map<dwl::Vertex,dwl::TerrainCell>::const_iterator cell_it = terrain_map_.begin();
+			cell_it != terrain_map_.end(); cell_it++)
+		chunks.insert(getTileId(cell_it->second.key, chunk_size_));
+	ids.assign(chunks.begin(), chunks.end());
+}
+
+
+void TerrainMapping::updateCorridor(const Eigen::Vector4d& robot_state)
+{
+	corridor_columns_.clear();
+	corridor_set_.clear();
+	if (corridor_path_.empty())
+		return;
+
+	// The height band of the corridor covers all the search areas
+	corridor_min_z_ = std::numeric_limits<double>::max();
+	corridor_max_z_ = -corridor_min_z_;
+	for (unsigned int n = 0; n < search_areas_.size(); n++) {
+		corridor_min_z_ = std::min(corridor_min_z_, search_areas_[n].min_z);
+		corridor_max_z_ = std::max(corridor_max_z_, search_areas_[n].max_z);
+	}
+
+	// Finding the closest waypoint to the robot, i.e. the horizon starts
+	// from it
+	Eigen::Vector2d position = robot_state.head<2>();
+	unsigned int first = 0;
+	double min_distance = std::numeric_limits<double>::max();
+	for (unsigned int i = 0; i < corridor_path_.size(); i++) {
+		double distance = (corridor_path_[i] - position).squaredNorm();
+		if (distance < min_distance) {
+			min_distance = distance;
+			first = i;
+		}
+	}
+
+	// Sampling the path ahead, and adding the cells inside the corridor
+	// around every sample. The cells are ordered along the path
+	double resolution = space_discretization_.getEnvironmentResolution(true);
+	double step = 0.5 * resolution;
+	double radius = 0.5 * corridor_width_;
+	int num_cells = ceil(radius / resolution);
+	corridor_min_ = Eigen::Vector2d::Constant(std::numeric_limits<double>::max());
+	corridor_max_ = -corridor_min_;
+	double length = 0.;
+	for (unsigned int i = first; i < corridor_path_.size() && length <= corridor_horizon_; i++) {
+		Eigen::Vector2d segment = i + 1 < corridor_path_.size() ?
+				Eigen::Vector2d(corridor_path_[i + 1] - corridor_path_[i]) :
+				Eigen::Vector2d::Zero();
+		double segment_length = segment.norm();
+		for (double s = 0.; s <= segment_length && length + s <= corridor_horizon_; s += step) {
+			Eigen::Vector2d sample = corridor_path_[i];
+			if (segment_length > 0.)
+				sample += segment * (s / segment_length);
+
+			for (int j = -num_cells; j <= num_cells; j++) {
+				for (int k = -num_cells; k <= num_cells; k++) {
+					Eigen::Vector2d offset(k * resolution, j * resolution);
+					if (offset.norm() > radius)
+						continue;
+
+					dwl::Vertex vertex_id;
+					space_discretization_.coordToVertex(vertex_id, sample + offset);
+					if (corridor_set_.insert(vertex_id).second) {
+						corridor_columns_.push_back(vertex_id);
+						corridor_min_ = corridor_min_.cwiseMin(sample + offset);
+						corridor_max_ = corridor_max_.cwiseMax(sample + offset);
+					}
+				}
+			}
+
+			if (segment_length == 0.)
+				break;
 		}
+		length += segment_length;
 	}
+}
+
+
+void TerrainMapping::setSensorFrustum(const SensorFrustum& frustum)
+{
+	frustum_ = frustum;
+}
+
+
+void TerrainMapping::clearSensorFrustum()
+{
+	frustum_.clear();
+}
+
+
+void TerrainMapping::setOctreeIntegration(double resolution, double max_range)
+{
+	if (integrated_octree_ && integrated_octree_->getResolution() != resolution)
+		integrated_octree_.reset();
+
+	integration_resolution_ = resolution;
+	integration_max_range_ = max_range;
+}
+
+
+void TerrainMapping::computeColumns(octomap::OcTree* octomap,
+									const Eigen::Vector4d& robot_state,
+									const std::set<dwl::Vertex>& columns)
+{
+	prepareFrame(robot_state);
+	double stage_time = getMonotonicTime();
+
+	// Finding the surface of the columns inside the search areas
+	double yaw = robot_state(3);
+	std::set<dwl::Vertex> cells;
+	for (std::set<dwl::Vertex>::const_iterator column_it = columns.begin();
+			column_it != columns.end(); column_it++) {
+		Eigen::Vector2d coord;
+		space_discretization_.vertexToCoord(coord, *column_it);
+		double xc = coord(0) - robot_state(0);
+		double yc = coord(1) - robot_state(1);
+		double xr = xc * cos(yaw) + yc * sin(yaw);
+		double yr = -xc * sin(yaw) + yc * cos(yaw);
+		const dwl::SearchArea* area = NULL;
+		for (unsigned int n = 0; n < search_areas_.size() && !area; n++) {
+			if (xr >= search_areas_[n].min_x && xr <= search_areas_[n].max_x &&
+					yr >= search_areas_[n].min_y && yr <= search_areas_[n].max_y)
+				area = &search_areas_[n];
+		}
+		if (!area && corridor_set_.count(*column_it) == 0)
+			continue;
+		profile_.num_columns++;
+
+		double max_z = (area ? area->max_z : corridor_max_z_) + robot_state(2);
+		double min_z = (area ? area->min_z : corridor_min_z_) + robot_state(2);
+		octomap::OcTreeKey init_key;
+		if (!octomap->coordToKeyChecked(coord(0), coord(1), max_z, depth_, init_key))
+			continue;
+
+		bool surface_found = false;
+		double z = max_z;
+		for (int r = 0; z >= min_z && !surface_found; r++) {
+			octomap::OcTreeKey heightmap_key = init_key;
+			heightmap_key[2] = init_key[2] - r;
+			octomap::OcTreeNode* heightmap_node = octomap->search(heightmap_key, depth_);
+			octomap::point3d height_point = octomap->keyToCoord(heightmap_key, depth_);
+			z = height_point(2);
+			if (heightmap_node && octomap->isNodeOccupied(heightmap_node) && z >= min_z) {
+				updateHeightMapCell(Eigen::Vector3d(height_point(0),
+													height_point(1),
+													height_point(2)));
+				surface_found = true;
+			}
+		}
+
+		// Removing the cell if its surface was cleared
+		if (!surface_found) {
+			removeTerrainCell(*column_it);
+			continue;
+		}
+
+		// Adding the cell and its neighbors, i.e. their planes are affected
+		dwl::Key key;
+		space_discretization_.vertexToKey(key, *column_it, true);
+		for (int j = neighboring_area_.min_y; j < neighboring_area_.max_y + 1; j++) {
+			for (int k = neighboring_area_.min_x; k < neighboring_area_.max_x + 1; k++) {
+				dwl::Key neighbor_key = key;
+				neighbor_key.x += k;
+				neighbor_key.y += j;
+				dwl::Vertex neighbor_id;
+				space_discretization_.keyToVertex(neighbor_id, neighbor_key, true);
+				cells.insert(neighbor_id);
+			}
+		}
+	}
+
+	profile_.surface = getMonotonicTime() - stage_time;
+	stage_time = getMonotonicTime();
+
+	// Computing the terrain data of the affected cells of the heightmap
+	setTerrainInformation();
+	std::vector<dwl::Vertex> vertices;
+	std::vector<octomap::OcTreeKey> keys;
+	for (std::set<dwl::Vertex>::iterator cell_it = cells.begin();
+			cell_it != cells.end(); cell_it++) {
+		std::map<dwl::Vertex,double>::iterator height_it = terrain_heightmap_.find(*cell_it);
+		if (height_it == terrain_heightmap_.end())
+			continue;
+		profile_.num_processed++;
+
+		Eigen::Vector2d coord;
+		space_discretization_.vertexToCoord(coord, *cell_it);
+		vertices.push_back(*cell_it);
+		keys.push_back(octomap->coordToKey(octomap::point3d(coord(0), coord(1),
+															height_it->second),
+										   depth_));
+	}
+	computeTerrainChunks(vertices, robot_state,
+						 [&](unsigned int i) { computeTerrainData(octomap, keys[i]); });
+	profile_.terrain_data = getMonotonicTime() - stage_time;
+	profile_.map_size = terrain_map_.size();
 
 	terrain_information_ = true;
 }
 
 
+void TerrainMapping::pruneIntegratedOcTree(const Eigen::Vector4d& robot_state)
+{
+	double min_radius = std::min(interest_radius_x_, interest_radius_y_);
+	if (min_radius == std::numeric_limits<double>::max() ||
+			(robot_state.head<2>() - pruning_position_).norm() < 0.25 * min_radius)
+		return;
+
+	// The voxels are removed after the traversal of the octree
+	Eigen::Vector3d robot_2dpose(robot_state(0), robot_state(1), robot_state(3));
+	std::vector<std::pair<octomap::OcTreeKey, unsigned int> > keys;
+	for (octomap::OcTree::leaf_iterator leaf_it = integrated_octree_->begin_leafs();
+			leaf_it != integrated_octree_->end_leafs(); ++leaf_it) {
+		if (!isInsideInterestRegion(Eigen::Vector2d(leaf_it.getX(), leaf_it.getY()),
+									robot_2dpose))
+			keys.push_back(std::make_pair(leaf_it.getKey(), leaf_it.getDepth()));
+	}
+
+	for (unsigned int i = 0; i < keys.size(); i++)
+		integrated_octree_->deleteNode(keys[i].first, keys[i].second);
+	pruning_position_ = robot_state.head<2>();
+}
+
+
+void TerrainMapping::addEnteredColumns(std::set<dwl::Vertex>& columns,
+									   const Eigen::Vector4d& robot_state)
+{
+	// Getting the columns of the bounding box of the search areas that
+	// weren't searched in the last integration
+	for (unsigned int j = 0; j < height_grid_.height; j++) {
+		for (unsigned int i = 0; i < height_grid_.width; i++) {
+			Eigen::Vector2d coord(height_grid_.origin_x + (i + 0.5) * height_grid_.resolution,
+								  height_grid_.origin_y + (j + 0.5) * height_grid_.resolution);
+			dwl::Vertex vertex_id;
+			space_discretization_.coordToVertex(vertex_id, coord);
+			if (isSearchedColumn(coord, vertex_id, robot_state, corridor_set_) &&
+					(!is_integration_state_ ||
+					 !isSearchedColumn(coord, vertex_id, integration_state_,
+									   integration_corridor_)))
+				columns.insert(vertex_id);
+		}
+	}
+
+	integration_state_ = robot_state;
+	integration_corridor_ = corridor_set_;
+	is_integration_state_ = true;
+}
+
+
+bool TerrainMapping::isSearchedColumn(const Eigen::Vector2d& coord,
+									  dwl::Vertex vertex_id,
+									  const Eigen::Vector4d& robot_state,
+									  const std::set<dwl::Vertex>& corridor) const
+{
+	Eigen::Vector3d robot_2dpose(robot_state(0), robot_state(1), robot_state(3));
+	if (!isInsideInterestRegion(coord, robot_2dpose))
+		return false;
+
+	double yaw = robot_state(3);
+	double xc = coord(0) - robot_state(0);
+	double yc = coord(1) - robot_state(1);
+	double xr = xc * cos(yaw) + yc * sin(yaw);
+	double yr = -xc * sin(yaw) + yc * cos(yaw);
+	for (unsigned int n = 0; n < search_areas_.size(); n++) {
+		if (xr >= search_areas_[n].min_x && xr <= search_areas_[n].max_x &&
+				yr >= search_areas_[n].min_y && yr <= search_areas_[n].max_y)
+			return true;
+	}
+
+	return corridor.count(vertex_id) > 0;
+}
+
+
+void TerrainMapping::updateHeightMapCell(const Eigen::Vector3d& cell_position)
+{
+	dwl::Key cell_key;
+	space_discretization_.coordToKeyChecked(cell_key, cell_position);
+
+	dwl::Vertex vertex_id;
+	space_discretization_.keyToVertex(vertex_id, cell_key, true);
+	if (!terrain_information_)
+		addCellToTerrainHeightMap(vertex_id, (double) cell_position(2));
+	else {
+		bool new_status = true;
+		std::map<dwl::Vertex,double>::iterator height_it =
+				terrain_heightmap_.find(vertex_id);
+		if (height_it != terrain_heightmap_.end()) {
+			// Evaluating if it changed status (height)
+			unsigned short int old_key_z;
+			space_discretization_.coordToKey(old_key_z,
+											 height_it->second,
+											 false);
+			if (old_key_z != cell_key.z)
+				removeTerrainCell(vertex_id);
+			else
+				new_status = false;
+		}
+
+		if (new_status)
+			addCellToTerrainHeightMap(vertex_id, (double) cell_position(2));
+	}
+}
+
+
+void TerrainMapping::addCellToObstacleMap(const Eigen::Vector3d& cell_position)
+{
+	dwl::Cell cell;
+	space_discretization_.coordToKeyChecked(cell.key, cell_position);
+
+	dwl::Vertex vertex_id;
+	space_discretization_.keyToVertex(vertex_id, cell.key, true);
+	obstacle_map_[vertex_id] = cell;
+}
+
+
 void TerrainMapping::computeTerrainData(octomap::OcTree* octomap,
 										const octomap::OcTreeKey& heightmap_key)
 {
@@ -260,6 +1044,60 @@ void TerrainMapping::computeTerrainData(octomap::OcTree* octomap,
 		}
 	}
 
+	addTerrainSample(neighbors_position, is_there_neighboring);
+}
+
+
+void TerrainMapping::computeTerrainData(dwl::Vertex vertex_id)
+{
+	std::map<dwl::Vertex,double>::const_iterator height_it =
+			terrain_heightmap_.find(vertex_id);
+	if (height_it == terrain_heightmap_.end())
+		return;
+
+	// Adding to the cloud the point of interest
+	std::vector<Eigen::Vector3f> neighbors_position;
+	Eigen::Vector2d coord;
+	space_discretization_.vertexToCoord(coord, vertex_id);
+	neighbors_position.push_back(Eigen::Vector3f(coord(0), coord(1), height_it->second));
+
+	// Iterates over the neighboring cells of the heightmap
+	dwl::Key key;
+	space_discretization_.vertexToKey(key, vertex_id, true);
+	bool is_there_neighboring = false;
+	for (int j = neighboring_area_.min_y; j < neighboring_area_.max_y + 1; j++) {
+		for (int k = neighboring_area_.min_x; k < neighboring_area_.max_x + 1; k++) {
+			if (j == 0 && k == 0)
+				continue;
+
+			dwl::Key neighbor_key = key;
+			neighbor_key.x += k;
+			neighbor_key.y += j;
+			dwl::Vertex neighbor_id;
+			space_discretization_.keyToVertex(neighbor_id, neighbor_key, true);
+
+			std::map<dwl::Vertex,double>::const_iterator neighbor_it =
+					terrain_heightmap_.find(neighbor_id);
+			if (neighbor_it != terrain_heightmap_.end()) {
+				Eigen::Vector2d neighbor_coord;
+				space_discretization_.vertexToCoord(neighbor_coord, neighbor_id);
+				neighbors_position.push_back(Eigen::Vector3f(neighbor_coord(0),
+															 neighbor_coord(1),
+															 neighbor_it->second));
+				is_there_neighboring = true;
+			}
+		}
+	}
+
+	addTerrainSample(neighbors_position, is_there_neighboring);
+}
+
+
+void TerrainMapping::addTerrainSample(const std::vector<Eigen::Vector3f>& neighbors_position,
+									  bool is_there_neighboring)
+{
+	const Eigen::Vector3f& heightmap_position = neighbors_position[0];
+	double stage_time = getMonotonicTime();
 	if (is_there_neighboring) {
 		// Computing terrain info
 		EIGEN_ALIGN16 Eigen::Matrix3d covariance_matrix;
@@ -279,61 +1117,360 @@ void TerrainMapping::computeTerrainData(octomap::OcTree* octomap,
 									    terrain_info_.curvature,
 								   covariance_matrix);
 	}
+	profile_.plane_fit += getMonotonicTime() - stage_time;
 
-	// Computing the cost
-	if (is_added_feature_) {
-		double cost_value, weight, total_cost = 0;
-		unsigned int num_feature = features_.size();
-		for (unsigned int i = 0; i < num_feature; i++) {
-			features_[i]->computeCost(cost_value, terrain_info_);
-			features_[i]->getWeight(weight);
-			total_cost += weight * cost_value;
-		}
+	// Adding the terrain information of the cell, its cost is computed
+	// together with the rest of cells of the frame
+	feature::TerrainSample sample;
+	sample.position = terrain_info_.position;
+	sample.surface_normal = terrain_info_.surface_normal;
+	sample.curvature = terrain_info_.curvature;
+	sample.height = heightmap_position(dwl::rbd::Z);
+	samples_.push_back(sample);
+}
 
-		dwl::TerrainCell cell;
-		setTerrainCell(cell,
-					   total_cost,
-					   (double) heightmap_position(dwl::rbd::Z),
-					   terrain_info_);
-		addCellToTerrainMap(cell);
-	} else {
+
+void TerrainMapping::computeCosts()
+{
+	if (samples_.empty())
+		return;
+
+	if (!is_added_feature_) {
 		printf(YELLOW_ "Could not computed the cost of the features because it"
 				" is necessary to add at least one\n" COLOR_RESET);
+		samples_.clear();
+		return;
+	}
+
+	// Creating the feature pipeline once the features are defined
+	if (!pipeline_)
+		pipeline_.reset(feature::createFeaturePipeline(features_, is_fused_pipeline_));
+
+	double start_time = getMonotonicTime();
+	std::vector<double> feature_times;
+	pipeline_->computeCosts(costs_, feature_costs_, samples_, terrain_info_,
+							&feature_times);
+	profile_.costs += getMonotonicTime() - start_time;
+	profile_.features.resize(feature_times.size(), 0.);
+	for (unsigned int i = 0; i < feature_times.size(); i++)
+		profile_.features[i] += feature_times[i];
+
+	// Adding the cells to the terrain map, and their feature costs to the
+	// cost layers
+	unsigned int num_features = features_.size();
+	for (unsigned int i = 0; i < samples_.size(); i++) {
+		const feature::TerrainSample& sample = samples_[i];
+		terrain_info_.position = sample.position;
+		terrain_info_.surface_normal = sample.surface_normal;
+		terrain_info_.curvature = sample.curvature;
+
+		dwl::TerrainCell cell;
+		setTerrainCell(cell, costs_[i], sample.height, terrain_info_);
+		addCellToTerrainMap(cell);
+		if (is_pyramid_)
+			pyramid_.setCell(cell);
+
+		dwl::Vertex vertex_id;
+		space_discretization_.keyToVertex(vertex_id, cell.key, true);
+		cost_layers_.setCosts(vertex_id, &feature_costs_[i * num_features]);
+	}
+	samples_.clear();
+}
+
+
+void TerrainMapping::computeTerrainChunks(const std::vector<dwl::Vertex>& vertices,
+										  const Eigen::Vector4d& robot_state,
+										  const std::function<void(unsigned int)>& compute_cell)
+{
+	profile_.num_cells += vertices.size();
+	if (!chunk_handler_) {
+		// Computing the cells of the corridor first, i.e. their costs are in
+		// the map before the rest of cells are computed
+		std::vector<unsigned int> cells;
+		if (!corridor_set_.empty()) {
+			cells.reserve(vertices.size());
+			for (unsigned int i = 0; i < vertices.size(); i++) {
+				if (corridor_set_.count(vertices[i]) > 0)
+					compute_cell(i);
+				else
+					cells.push_back(i);
+			}
+			computeCosts();
+		} else {
+			cells.resize(vertices.size());
+			for (unsigned int i = 0; i < vertices.size(); i++)
+				cells[i] = i;
+		}
+
+		for (unsigned int i = 0; i < cells.size(); i++)
+			compute_cell(cells[i]);
+		computeCosts();
+		dirty_chunks_.clear();
+		return;
+	}
+
+	// Grouping the cells by chunk, and getting the chunks of the corridor
+	std::map<uint32_t, std::vector<unsigned int> > chunks;
+	std::set<uint32_t> corridor_chunks;
+	for (unsigned int i = 0; i < vertices.size(); i++) {
+		dwl::Key key;
+		space_discretization_.vertexToKey(key, vertices[i], true);
+		uint32_t id = getTileId(key, chunk_size_);
+		chunks[id].push_back(i);
+		if (corridor_set_.count(vertices[i]) > 0)
+			corridor_chunks.insert(id);
+	}
+
+	// Adding the chunks whose cells were removed or paged in, i.e. they are
+	// handed over even if none of their cells is recomputed
+	for (std::set<uint32_t>::iterator chunk_it = dirty_chunks_.begin();
+			chunk_it != dirty_chunks_.end(); chunk_it++)
+		chunks[*chunk_it];
+	dirty_chunks_.clear();
+
+	// Sorting the chunks by the distance of their centres to the robot, the
+	// chunks of the corridor go first
+	std::vector<std::pair<std::pair<bool, double>, uint32_t> > order;
+	order.reserve(chunks.size());
+	for (std::map<uint32_t, std::vector<unsigned int> >::iterator chunk_it = chunks.begin();
+			chunk_it != chunks.end(); chunk_it++) {
+		Eigen::Vector2d centre = getTileCentre(chunk_it->first, chunk_size_);
+		bool is_corridor = corridor_chunks.count(chunk_it->first) > 0;
+		order.push_back(std::make_pair(std::make_pair(!is_corridor,
+				(centre - robot_state.head<2>()).squaredNorm()), chunk_it->first));
+	}
+	std::sort(order.begin(), order.end());
+
+	// Computing the chunks, and handing them over once their costs are
+	// computed
+	for (unsigned int n = 0; n < order.size(); n++) {
+		const std::vector<unsigned int>& cells = chunks[order[n].second];
+		for (unsigned int i = 0; i < cells.size(); i++)
+			compute_cell(cells[i]);
+		computeCosts();
+		chunk_handler_(order[n].second);
 	}
 }
 
 
 void TerrainMapping::removeTerrainOutsideInterestRegion(const Eigen::Vector3d& robot_state)
 {
-	// Getting the orientation of the body
+	// The tiles outside the interest region are evicted to the tile store
+	// instead of being removed
+	if (tile_store_)
+		updateTiles(robot_state);
+	else {
+		std::map<dwl::Vertex,dwl::TerrainCell>::iterator vertex_iter = terrain_map_.begin();
+		while (vertex_iter != terrain_map_.end()) {
+			dwl::Vertex v = vertex_iter->first;
+			Eigen::Vector2d point;
+			space_discretization_.vertexToCoord(point, v);
+
+			++vertex_iter;
+			if (!isInsideInterestRegion(point, robot_state))
+				removeTerrainCell(v);
+		}
+	}
+
+	// Removing the obstacles that don't belong to the interest area
+	std::map<dwl::Vertex,dwl::Cell>::iterator obstacle_iter = obstacle_map_.begin();
+	while (obstacle_iter != obstacle_map_.end()) {
+		Eigen::Vector2d point;
+		space_discretization_.vertexToCoord(point, obstacle_iter->first);
+
+		if (!isInsideInterestRegion(point, robot_state))
+			obstacle_map_.erase(obstacle_iter++);
+		else
+			++obstacle_iter;
+	}
+}
+
+
+bool TerrainMapping::isInsideInterestRegion(const Eigen::Vector2d& point,
+											const Eigen::Vector3d& robot_state,
+											double margin) const
+{
+	// The region is a half ellipse in front of the robot, and a half circle
+	// behind it
 	double yaw = robot_state(2);
+	double xc = point(0) - robot_state(0);
+	double yc = point(1) - robot_state(1);
+	double radius_x = interest_radius_x_ + margin;
+	double radius_y = interest_radius_y_ + margin;
+	if (xc * cos(yaw) + yc * sin(yaw) >= 0.0) {
+		return pow(xc * cos(yaw) + yc * sin(yaw), 2) / pow(radius_y, 2) +
+				pow(xc * sin(yaw) - yc * cos(yaw), 2) / pow(radius_x, 2) <= 1;
+	} else
+		return pow(xc, 2) + pow(yc, 2) <= pow(radius_x, 2);
+}
+
+
+void TerrainMapping::updateTiles(const Eigen::Vector3d& robot_state)
+{
+	// Merging the tiles paged in since the last frame
+	std::vector<Tile> loaded_tiles;
+	tile_store_->getLoadedTiles(loaded_tiles);
+	for (unsigned int i = 0; i < loaded_tiles.size(); i++)
+		mergeTile(loaded_tiles[i]);
+	profile_.num_loaded_tiles = loaded_tiles.size();
 
+	// Getting the cells of the tiles that left the interest region. There is
+	// a hysteresis between the eviction and the paging in, so a tile in the
+	// border isn't moved back and forth
+	double half_diagonal =
+			tile_size_ * space_discretization_.getEnvironmentResolution(true) / sqrt(2.);
+	std::map<uint32_t, bool> is_evicted;
+	std::map<uint32_t, std::vector<dwl::Vertex> > evicted_cells;
 	for (std::map<dwl::Vertex,dwl::TerrainCell>::iterator vertex_iter = terrain_map_.begin();
-			vertex_iter != terrain_map_.end();
-			vertex_iter++)
+			vertex_iter != terrain_map_.end(); vertex_iter++)
 	{
-		dwl::Vertex v = vertex_iter->first;
-		Eigen::Vector2d point;
-		space_discretization_.vertexToCoord(point, v);
-
-		double xc = point(0) - robot_state(0);
-		double yc = point(1) - robot_state(1);
-		if (xc * cos(yaw) + yc * sin(yaw) >= 0.0) {
-			if (pow(xc * cos(yaw) + yc * sin(yaw), 2) / pow(interest_radius_y_, 2) +
-					pow(xc * sin(yaw) - yc * cos(yaw), 2) / pow(interest_radius_x_, 2) > 1) {
-				terrain_map_.erase(v);
-				terrain_heightmap_.erase(v);
+		uint32_t id = getTileId(vertex_iter->second.key, tile_size_);
+		std::map<uint32_t, bool>::iterator evicted_it = is_evicted.find(id);
+		if (evicted_it == is_evicted.end()) {
+			bool is_outside =
+					!isInsideInterestRegion(getTileCentre(id, tile_size_), robot_state,
+										   2 * half_diagonal);
+			evicted_it = is_evicted.insert(std::make_pair(id, is_outside)).first;
+		}
+
+		if (evicted_it->second)
+			evicted_cells[id].push_back(vertex_iter->first);
+	}
+
+	// Evicting the tiles, i.e. their cells are written in the tile store and
+	// removed from the map
+	bool is_layers = cost_layers_.getNumLayers() == tile_store_->getNumLayers();
+	std::vector<double> costs;
+	for (std::map<uint32_t, std::vector<dwl::Vertex> >::iterator tile_it = evicted_cells.begin();
+			tile_it != evicted_cells.end(); tile_it++)
+	{
+		const std::vector<dwl::Vertex>& vertices = tile_it->second;
+		unsigned int num_cells = vertices.size();
+		Tile tile;
+		tile.id = tile_it->first;
+		tile.cells.resize(num_cells);
+		if (is_layers)
+			tile.costs.resize(cost_layers_.getNumLayers() * num_cells);
+
+		for (unsigned int i = 0; i < num_cells; i++) {
+			const dwl::TerrainCell& terrain_cell = terrain_map_[vertices[i]];
+			Eigen::Vector2d coord;
+			space_discretization_.vertexToCoord(coord, vertices[i]);
+
+			SnapshotCell& cell = tile.cells[i];
+			cell.vertex = vertices[i];
+			cell.key_x = terrain_cell.key.x;
+			cell.key_y = terrain_cell.key.y;
+			cell.key_z = terrain_cell.key.z;
+			cell.padding = 0;
+			cell.x = coord(0);
+			cell.y = coord(1);
+			cell.height = terrain_cell.height;
+			cell.cost = terrain_cell.cost;
+			cell.normal[0] = terrain_cell.normal(0);
+			cell.normal[1] = terrain_cell.normal(1);
+			cell.normal[2] = terrain_cell.normal(2);
+
+			// The tile is stored without layers if a cell doesn't have them
+			if (!tile.costs.empty()) {
+				if (cost_layers_.getCosts(costs, vertices[i])) {
+					for (unsigned int n = 0; n < costs.size(); n++)
+						tile.costs[n * num_cells + i] = costs[n];
+				} else
+					tile.costs.clear();
 			}
-		} else {
-			if (pow(xc, 2) + pow(yc, 2) > pow(interest_radius_x_, 2)) {
-				terrain_map_.erase(v);
-				terrain_heightmap_.erase(v);
+		}
+
+		if (!tile_store_->writeTile(tile))
+			printf(YELLOW_ "Could not store the tile %u, its cells are removed\n"
+					COLOR_RESET, tile.id);
+
+		for (unsigned int i = 0; i < num_cells; i++)
+			removeTerrainCell(vertices[i]);
+		profile_.num_evicted_tiles++;
+	}
+
+	// Requesting the stored tiles that are inside the interest region
+	std::vector<uint32_t> stored_tiles;
+	tile_store_->getStoredTiles(stored_tiles);
+	for (unsigned int i = 0; i < stored_tiles.size(); i++) {
+		if (isInsideInterestRegion(getTileCentre(stored_tiles[i], tile_size_), robot_state,
+								   half_diagonal))
+			tile_store_->requestTile(stored_tiles[i]);
+	}
+}
+
+
+void TerrainMapping::mergeTile(const Tile& tile)
+{
+	// The costs are re-summed with the current weights
+	unsigned int num_layers = 0;
+	std::vector<double> weights(features_.size());
+	if (!tile.costs.empty() && cost_layers_.getNumLayers() == features_.size()) {
+		num_layers = features_.size();
+		for (unsigned int n = 0; n < num_layers; n++)
+			features_[n]->getWeight(weights[n]);
+	}
+
+	unsigned int num_cells = tile.cells.size();
+	std::vector<double> costs(num_layers);
+	for (unsigned int i = 0; i < num_cells; i++) {
+		const SnapshotCell& tile_cell = tile.cells[i];
+		dwl::TerrainCell cell;
+		cell.key.x = tile_cell.key_x;
+		cell.key.y = tile_cell.key_y;
+		cell.key.z = tile_cell.key_z;
+
+		// The cells mapped while the tile was stored are newer
+		dwl::Vertex vertex_id;
+		space_discretization_.keyToVertex(vertex_id, cell.key, true);
+		if (terrain_map_.find(vertex_id) != terrain_map_.end() ||
+				terrain_heightmap_.find(vertex_id) != terrain_heightmap_.end())
+			continue;
+
+		cell.cost = tile_cell.cost;
+		cell.height = tile_cell.height;
+		cell.normal = Eigen::Vector3d(tile_cell.normal[0],
+									  tile_cell.normal[1],
+									  tile_cell.normal[2]);
+		if (num_layers > 0) {
+			cell.cost = 0.;
+			for (unsigned int n = 0; n < num_layers; n++) {
+				costs[n] = tile.costs[n * num_cells + i];
+				cell.cost += weights[n] * costs[n];
 			}
+			cost_layers_.setCosts(vertex_id, costs.data());
 		}
+
+		addCellToTerrainMap(cell);
+		addCellToTerrainHeightMap(vertex_id, tile_cell.height);
+		if (is_pyramid_)
+			pyramid_.setCell(cell);
+		if (chunk_handler_)
+			dirty_chunks_.insert(getTileId(cell.key, chunk_size_));
 	}
 }
 
 
+uint32_t TerrainMapping::getTileId(const dwl::Key& key, unsigned int tile_size) const
+{
+	return ((uint32_t) (key.x / tile_size) << 16) | (uint32_t) (key.y / tile_size);
+}
+
+
+Eigen::Vector2d TerrainMapping::getTileCentre(uint32_t id, unsigned int tile_size) const
+{
+	// Getting the coordinate of the central key of the tile
+	unsigned short key_x = (id >> 16) * tile_size + tile_size / 2;
+	unsigned short key_y = (id & 0xFFFF) * tile_size + tile_size / 2;
+	Eigen::Vector2d centre;
+	space_discretization_.keyToCoord(centre(0), key_x, true);
+	space_discretization_.keyToCoord(centre(1), key_y, true);
+
+	return centre;
+}
+
+
 void TerrainMapping::setInterestRegion(double radius_x,
 									   double radius_y)
 {
@@ -362,6 +1499,7 @@ void TerrainMapping::addSearchArea(double min_x, double max_x,
 			grid_resolution < space_discretization_.getEnvironmentResolution(true)) {
 		space_discretization_.setEnvironmentResolution(grid_resolution, true);
 		space_discretization_.setStateResolution(grid_resolution);
+		pyramid_.setResolution(grid_resolution);
 	}
 
 	is_added_search_area_ = true;
@@ -380,4 +1518,285 @@ void TerrainMapping::setNeighboringArea(int back_neighbors, int front_neighbors,
 	neighboring_area_.max_z = top_neighbors;
 }
 
+
+void TerrainMapping::setObstacleArea(double min_z, double max_z)
+{
+	printf(GREEN_ "Computing the obstacle map between %f and %f\n" COLOR_RESET,
+			min_z, max_z);
+	obstacle_min_z_ = min_z;
+	obstacle_max_z_ = max_z;
+	is_obstacle_area_ = true;
+}
+
+
+void TerrainMapping::reset()
+{
+	dwl::environment::TerrainMap::reset();
+	obstacle_map_.clear();
+	dirty_chunks_.clear();
+	cost_layers_.clear();
+	pyramid_.clear();
+	if (integrated_octree_)
+		integrated_octree_->clear();
+	is_integration_state_ = false;
+	if (tile_store_)
+		tile_store_->clear();
+}
+
+
+bool TerrainMapping::loadSnapshot(const TerrainMapSnapshot& snapshot)
+{
+	if (!snapshot.isOpen())
+		return false;
+
+	const SnapshotHeader& header = snapshot.getHeader();
+	if (fabs(header.plane_size - space_discretization_.getEnvironmentResolution(true)) > 1e-9) {
+		printf(YELLOW_ "Could not load the snapshot because its resolution (%f) is"
+				" different to the resolution of the map (%f)\n" COLOR_RESET,
+				header.plane_size, space_discretization_.getEnvironmentResolution(true));
+		return false;
+	}
+
+	reset();
+	setResolution(header.height_size, false);
+
+	// Loading the cost layers if they have the same features
+	bool is_layers = header.num_layers > 0 && header.num_layers == features_.size();
+	const SnapshotLayer* layers = snapshot.getLayers();
+	for (unsigned int n = 0; is_layers && n < header.num_layers; n++) {
+		std::string name(layers[n].name, strnlen(layers[n].name, sizeof(layers[n].name)));
+		is_layers = name == features_[n]->getName();
+	}
+
+	const SnapshotCell* cells = snapshot.getCells();
+	std::vector<double> costs(header.num_layers);
+	for (uint64_t i = 0; i < header.num_cells; i++) {
+		const SnapshotCell& snapshot_cell = cells[i];
+		dwl::TerrainCell cell;
+		cell.key.x = snapshot_cell.key_x;
+		cell.key.y = snapshot_cell.key_y;
+		cell.key.z = snapshot_cell.key_z;
+		cell.cost = snapshot_cell.cost;
+		cell.height = snapshot_cell.height;
+		cell.normal = Eigen::Vector3d(snapshot_cell.normal[0],
+									  snapshot_cell.normal[1],
+									  snapshot_cell.normal[2]);
+		addCellToTerrainMap(cell);
+
+		dwl::Vertex vertex_id;
+		space_discretization_.keyToVertex(vertex_id, cell.key, true);
+		addCellToTerrainHeightMap(vertex_id, snapshot_cell.height);
+
+		if (is_layers) {
+			for (unsigned int n = 0; n < header.num_layers; n++)
+				costs[n] = snapshot.getCosts(n)[i];
+			cost_layers_.setCosts(vertex_id, costs.data());
+		}
+	}
+
+	if (is_layers)
+		applyFeatureWeights();
+	buildCostPyramid();
+
+	terrain_information_ = header.num_cells > 0;
+
+	return true;
+}
+
+
+const dwl::environment::SpaceDiscretization& TerrainMapping::getSpaceDiscretization() const
+{
+	return space_discretization_;
+}
+
+
+bool TerrainMapping::setTileStore(const std::string& filename,
+								  unsigned int tile_size,
+								  unsigned int max_tiles)
+{
+	tile_store_.reset(new TileStore());
+	if (tile_size == 0 ||
+			!tile_store_->init(filename, tile_size * tile_size, features_.size(), max_tiles)) {
+		printf(RED_ "Could not create the tile store in %s\n" COLOR_RESET, filename.c_str());
+		tile_store_.reset();
+		return false;
+	}
+	tile_size_ = tile_size;
+
+	printf(GREEN_ "Evicting tiles of %ux%u cells to %s\n" COLOR_RESET,
+			tile_size, tile_size, filename.c_str());
+	return true;
+}
+
+
+void TerrainMapping::setFusedFeatures(bool fused)
+{
+	is_fused_pipeline_ = fused;
+	resetFeaturePipeline();
+}
+
+
+bool TerrainMapping::isFusedFeatures()
+{
+	if (!pipeline_)
+		pipeline_.reset(feature::createFeaturePipeline(features_, is_fused_pipeline_));
+
+	return pipeline_->isFused();
+}
+
+
+void TerrainMapping::resetFeaturePipeline()
+{
+	pipeline_.reset();
+}
+
+
+bool TerrainMapping::setFeatureWeight(const std::string& feature_name, double weight)
+{
+	for (unsigned int i = 0; i < features_.size(); i++) {
+		if (feature_name == features_[i]->getName()) {
+			printf(GREEN_ "Setting the weight of the %s feature to %f\n" COLOR_RESET,
+					feature_name.c_str(), weight);
+			features_[i]->setWeight(weight);
+
+			// The fused pipeline has a copy of the weights
+			resetFeaturePipeline();
+			return true;
+		}
+	}
+
+	printf(YELLOW_ "Could not set the weight of the %s feature\n" COLOR_RESET,
+			feature_name.c_str());
+	return false;
+}
+
+
+void TerrainMapping::applyFeatureWeights()
+{
+	std::vector<double> weights(features_.size());
+	for (unsigned int i = 0; i < features_.size(); i++)
+		features_[i]->getWeight(weights[i]);
+
+	if (!cost_layers_.computeTotalCosts(weights))
+		return;
+
+	// Updating the cost of the cells. The slots and the terrain map are
+	// ordered by vertex, so both are traversed together
+	const std::map<dwl::Vertex, unsigned int>& slots = cost_layers_.getSlots();
+	std::map<dwl::Vertex, unsigned int>::const_iterator slot_it = slots.begin();
+	for (std::map<dwl::Vertex,dwl::TerrainCell>::iterator cell_it = terrain_map_.begin();
+			cell_it != terrain_map_.end() && slot_it != slots.end();
+			cell_it++)
+	{
+		while (slot_it != slots.end() && slot_it->first < cell_it->first)
+			slot_it++;
+
+		if (slot_it != slots.end() && slot_it->first == cell_it->first)
+			cell_it->second.cost = cost_layers_.getTotalCost(slot_it->second);
+	}
+	buildCostPyramid();
+}
+
+
+double TerrainMapping::getFeatureWeight(unsigned int index) const
+{
+	double weight;
+	features_[index]->getWeight(weight);
+
+	return weight;
+}
+
+
+const CostLayers& TerrainMapping::getCostLayers() const
+{
+	return cost_layers_;
+}
+
+
+void TerrainMapping::setCostPyramid(bool enable)
+{
+	is_pyramid_ = enable;
+	pyramid_.setResolution(space_discretization_.getEnvironmentResolution(true));
+	if (is_pyramid_)
+		buildCostPyramid();
+	else
+		pyramid_.clear();
+}
+
+
+const CostPyramid& TerrainMapping::getCostPyramid() const
+{
+	return pyramid_;
+}
+
+
+void TerrainMapping::buildCostPyramid()
+{
+	if (!is_pyramid_)
+		return;
+
+	std::vector<dwl::TerrainCell> cells;
+	cells.reserve(terrain_map_.size());
+	for (std::map<dwl::Vertex,dwl::TerrainCell>::const_iterator cell_it = terrain_map_.begin();
+			cell_it != terrain_map_.end(); cell_it++)
+		cells.push_back(cell_it->second);
+	pyramid_.build(cells);
+}
+
+
+void TerrainMapping::removePyramidCell(dwl::Vertex vertex_id)
+{
+	if (!is_pyramid_)
+		return;
+
+	dwl::Key key;
+	space_discretization_.vertexToKey(key, vertex_id, true);
+	pyramid_.removeCell(key);
+}
+
+
+void TerrainMapping::removeTerrainCell(dwl::Vertex vertex_id)
+{
+	std::map<dwl::Vertex,dwl::TerrainCell>::iterator cell_it =
+			terrain_map_.find(vertex_id);
+	if (cell_it != terrain_map_.end()) {
+		if (chunk_handler_)
+			dirty_chunks_.insert(getTileId(cell_it->second.key, chunk_size_));
+		terrain_map_.erase(cell_it);
+	}
+	terrain_heightmap_.erase(vertex_id);
+	cost_layers_.removeCell(vertex_id);
+	removePyramidCell(vertex_id);
+}
+
+
+unsigned int TerrainMapping::getNumFeatures() const
+{
+	return features_.size();
+}
+
+
+std::string TerrainMapping::getFeatureName(unsigned int index) const
+{
+	return features_[index]->getName();
+}
+
+
+const TerrainMappingProfile& TerrainMapping::getProfile() const
+{
+	return profile_;
+}
+
+
+bool TerrainMapping::isObstacleMap() const
+{
+	return is_obstacle_area_;
+}
+
+
+const std::map<dwl::Vertex, dwl::Cell>& TerrainMapping::getObstacleMap() const
+{
+	return obstacle_map_;
+}
+
 } //@namepace terrain_server
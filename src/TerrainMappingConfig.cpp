@@ -0,0 +1,241 @@
+#include <terrain_server/TerrainMappingConfig.h>
+#include <terrain_server/feature/SlopeFeature.h>
+#include <terrain_server/feature/HeightDeviationFeature.h>
+#include <terrain_server/feature/CurvatureFeature.h>
+#include <yaml-cpp/yaml.h>
+
+
+namespace terrain_server
+{
+
+TerrainMappingConfig::TerrainMappingConfig() : interest_radius_x(1.),
+		interest_radius_y(1.), enable_tiles(false), tile_size(64), max_tiles(1024),
+		tile_filename("/tmp/terrain_map_tiles.bin"), height_binning("max"),
+		height_percentile(0.95), binning_threads(0), min_depth(0.1), max_depth(10.),
+		max_depth_jump(0.05), octree_resolution(0.02), octree_max_range(5.),
+		update_min_translation(0.), update_min_yaw(0.), update_min_change(0.),
+		update_max_period(1.), enable_pyramid(false), enable_obstacle(false),
+		obstacle_min_z(-0.2), obstacle_max_z(0.2), enable_slope(false), slope_weight(1.),
+		enable_height_deviation(false), height_deviation_weight(1.),
+		flat_height_deviation(0.01), max_height_deviation(0.3),
+		min_allowed_height(-std::numeric_limits<double>::max()),
+		height_deviation_size(0.1), height_deviation_resolution(0.04),
+		enable_curvature(false), curvature_weight(1.), fused_features(true)
+{
+
+}
+
+
+TerrainMappingConfig::~TerrainMappingConfig()
+{
+
+}
+
+
+/** @brief Reads a value of a YAML node if it's defined */
+template<typename T>
+static void readValue(T& value, const YAML::Node& node, const std::string& name)
+{
+	if (node[name])
+		value = node[name].as<T>();
+}
+
+
+bool TerrainMappingConfig::loadFromYaml(const std::string& filename,
+										const std::string& ns)
+{
+	YAML::Node root;
+	try {
+		root = YAML::LoadFile(filename);
+	} catch (YAML::Exception& e) {
+		printf(RED_ "Could not load %s: %s\n" COLOR_RESET, filename.c_str(), e.what());
+		return false;
+	}
+
+	YAML::Node config = root[ns];
+	if (!config) {
+		printf(RED_ "There is not the %s namespace in %s\n" COLOR_RESET,
+				ns.c_str(), filename.c_str());
+		return false;
+	}
+
+	try {
+		// Getting the search areas
+		search_areas.clear();
+		YAML::Node area_names = config["search_areas"];
+		for (unsigned int i = 0; area_names && i < area_names.size(); i++) {
+			YAML::Node area = config[area_names[i].as<std::string>()];
+			if (!area) {
+				printf(RED_ "Malformed search area specification\n" COLOR_RESET);
+				return false;
+			}
+
+			dwl::SearchArea search_area;
+			search_area.min_x = area["min_x"].as<double>();
+			search_area.max_x = area["max_x"].as<double>();
+			search_area.min_y = area["min_y"].as<double>();
+			search_area.max_y = area["max_y"].as<double>();
+			search_area.min_z = area["min_z"].as<double>();
+			search_area.max_z = area["max_z"].as<double>();
+			search_area.resolution = area["resolution"].as<double>();
+			search_areas.push_back(search_area);
+		}
+
+		// Getting the interest region
+		if (config["interest_region"]) {
+			readValue(interest_radius_x, config["interest_region"], "radius_x");
+			readValue(interest_radius_y, config["interest_region"], "radius_y");
+		}
+
+		// Getting the tile store
+		if (config["tiles"]) {
+			readValue(enable_tiles, config["tiles"], "enable");
+			readValue(tile_size, config["tiles"], "size");
+			readValue(max_tiles, config["tiles"], "max_tiles");
+			readValue(tile_filename, config["tiles"], "filename");
+		}
+
+		// Getting the height binning of the point clouds
+		if (config["pointcloud"]) {
+			readValue(height_binning, config["pointcloud"], "height");
+			readValue(height_percentile, config["pointcloud"], "percentile");
+			readValue(binning_threads, config["pointcloud"], "threads");
+		}
+
+		// Getting the binning of the depth images
+		if (config["depth"]) {
+			readValue(min_depth, config["depth"], "min_depth");
+			readValue(max_depth, config["depth"], "max_depth");
+			readValue(max_depth_jump, config["depth"], "max_jump");
+		}
+
+		// Getting the octree of the integrated point clouds
+		if (config["octree"]) {
+			readValue(octree_resolution, config["octree"], "resolution");
+			readValue(octree_max_range, config["octree"], "max_range");
+		}
+
+		// Getting the thresholds of the skipped frames
+		if (config["update"]) {
+			readValue(update_min_translation, config["update"], "min_translation");
+			readValue(update_min_yaw, config["update"], "min_yaw");
+			readValue(update_min_change, config["update"], "min_change");
+			readValue(update_max_period, config["update"], "max_period");
+		}
+
+		// Getting the cost pyramid
+		if (config["pyramid"])
+			readValue(enable_pyramid, config["pyramid"], "enable");
+
+		// Getting the obstacle band
+		if (config["obstacle_map"]) {
+			readValue(enable_obstacle, config["obstacle_map"], "enable");
+			readValue(obstacle_min_z, config["obstacle_map"], "min_z");
+			readValue(obstacle_max_z, config["obstacle_map"], "max_z");
+		}
+
+		// Getting the feature information
+		YAML::Node features = config["features"];
+		if (features) {
+			readValue(fused_features, features, "fused");
+			if (features["slope"]) {
+				readValue(enable_slope, features["slope"], "enable");
+				readValue(slope_weight, features["slope"], "weight");
+			}
+
+			YAML::Node height_dev = features["height_deviation"];
+			if (height_dev) {
+				readValue(enable_height_deviation, height_dev, "enable");
+				readValue(height_deviation_weight, height_dev, "weight");
+				readValue(flat_height_deviation, height_dev, "flat_height_deviation");
+				readValue(max_height_deviation, height_dev, "max_height_deviation");
+				readValue(min_allowed_height, height_dev, "min_allowed_height");
+				if (height_dev["neighboring_area"]) {
+					readValue(height_deviation_size,
+							  height_dev["neighboring_area"], "square_size");
+					readValue(height_deviation_resolution,
+							  height_dev["neighboring_area"], "resolution");
+				}
+			}
+
+			if (features["curvature"]) {
+				readValue(enable_curvature, features["curvature"], "enable");
+				readValue(curvature_weight, features["curvature"], "weight");
+			}
+		}
+	} catch (YAML::Exception& e) {
+		printf(RED_ "Malformed terrain map specification: %s\n" COLOR_RESET, e.what());
+		return false;
+	}
+
+	return true;
+}
+
+
+void TerrainMappingConfig::apply(TerrainMapping& mapping) const
+{
+	// Adding the search areas
+	for (unsigned int i = 0; i < search_areas.size(); i++) {
+		const dwl::SearchArea& area = search_areas[i];
+		mapping.addSearchArea(area.min_x, area.max_x,
+							  area.min_y, area.max_y,
+							  area.min_z, area.max_z,
+							  area.resolution);
+	}
+
+	// Setting the interest region, i.e. the information outside this region
+	// will be deleted
+	mapping.setInterestRegion(interest_radius_x, interest_radius_y);
+
+	// Setting the height binning of the point clouds
+	if (height_binning != "max" && height_binning != "percentile")
+		printf(YELLOW_ "Unknown %s height binning, using the maximum\n" COLOR_RESET,
+				height_binning.c_str());
+	mapping.setHeightBinning(height_binning == "percentile", height_percentile,
+							 std::max(0, binning_threads));
+	mapping.setDepthBinning(min_depth, max_depth, max_depth_jump);
+	mapping.setOctreeIntegration(octree_resolution, octree_max_range);
+
+	// Setting the obstacle band
+	if (enable_obstacle)
+		mapping.setObstacleArea(obstacle_min_z, obstacle_max_z);
+
+	// Adding the slope feature if it's enable
+	if (enable_slope) {
+		dwl::environment::Feature* slope_ptr = new terrain_server::feature::SlopeFeature();
+		slope_ptr->setWeight(slope_weight);
+		mapping.addFeature(slope_ptr);
+	}
+
+	// Adding the height deviation feature if it's enable
+	if (enable_height_deviation) {
+		dwl::environment::Feature* height_dev_ptr =
+				new terrain_server::feature::HeightDeviationFeature(flat_height_deviation,
+																	max_height_deviation,
+																	min_allowed_height);
+		height_dev_ptr->setWeight(height_deviation_weight);
+		height_dev_ptr->setNeighboringArea(-height_deviation_size, height_deviation_size,
+										   -height_deviation_size, height_deviation_size,
+										   height_deviation_resolution);
+		mapping.addFeature(height_dev_ptr);
+	}
+
+	// Adding the curvature feature if it's enable
+	if (enable_curvature) {
+		dwl::environment::Feature* curvature_ptr = new terrain_server::feature::CurvatureFeature();
+		curvature_ptr->setWeight(curvature_weight);
+		mapping.addFeature(curvature_ptr);
+	}
+
+	// Setting if the features can be computed in a single fused pass
+	mapping.setFusedFeatures(fused_features);
+
+	// Setting the tile store, it needs the number of features
+	if (enable_tiles)
+		mapping.setTileStore(tile_filename, tile_size, max_tiles);
+
+	// Setting the cost pyramid of the region queries
+	mapping.setCostPyramid(enable_pyramid);
+}
+
+} //@namespace terrain_server
@@ -0,0 +1,285 @@
+#include <terrain_server/TileStore.h>
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+namespace terrain_server
+{
+
+TileStore::TileStore() : data_(NULL), size_(0), slot_size_(0), max_cells_(0),
+		num_layers_(0), stop_(false)
+{
+
+}
+
+
+TileStore::~TileStore()
+{
+	if (worker_.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		condition_.notify_all();
+		worker_.join();
+	}
+
+	if (data_)
+		munmap(data_, size_);
+}
+
+
+bool TileStore::init(const std::string& filename,
+					 unsigned int max_cells,
+					 unsigned int num_layers,
+					 unsigned int max_tiles)
+{
+	if (data_ || max_cells == 0 || max_tiles == 0)
+		return false;
+
+	max_cells_ = max_cells;
+	num_layers_ = num_layers;
+	slot_size_ = sizeof(SlotHeader) + max_cells * sizeof(SnapshotCell) +
+			num_layers * max_cells * sizeof(double);
+	size_ = slot_size_ * max_tiles;
+
+	// Reserving the slots in a sparse file, i.e. the disk is used by the
+	// written tiles
+	int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+
+	if (ftruncate(fd, size_) != 0) {
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+	data_ = (char*) data;
+
+	for (unsigned int i = max_tiles; i > 0; i--)
+		free_slots_.push_back(i - 1);
+
+	worker_ = std::thread(&TileStore::run, this);
+
+	return true;
+}
+
+
+bool TileStore::writeTile(const Tile& tile)
+{
+	bool is_layers = num_layers_ > 0 &&
+			tile.costs.size() == num_layers_ * tile.cells.size();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!data_)
+		return false;
+
+	// Merging the stored cells that aren't in the tile
+	Tile merged_tile;
+	const Tile* new_tile = &tile;
+	std::map<uint32_t, unsigned int>::iterator index_it = index_.find(tile.id);
+	if (index_it != index_.end()) {
+		Tile stored_tile;
+		readSlot(stored_tile, index_it->second);
+
+		std::set<uint64_t> vertices;
+		for (unsigned int i = 0; i < tile.cells.size(); i++)
+			vertices.insert(tile.cells[i].vertex);
+
+		merged_tile.id = tile.id;
+		merged_tile.cells = tile.cells;
+		std::vector<unsigned int> stored_cells;
+		for (unsigned int i = 0; i < stored_tile.cells.size(); i++) {
+			if (vertices.find(stored_tile.cells[i].vertex) == vertices.end()) {
+				merged_tile.cells.push_back(stored_tile.cells[i]);
+				stored_cells.push_back(i);
+			}
+		}
+
+		// Merging the cost layers if both tiles have them
+		is_layers = is_layers && !stored_tile.costs.empty();
+		if (is_layers) {
+			unsigned int num_cells = merged_tile.cells.size();
+			merged_tile.costs.resize(num_layers_ * num_cells);
+			for (unsigned int n = 0; n < num_layers_; n++) {
+				for (unsigned int i = 0; i < tile.cells.size(); i++)
+					merged_tile.costs[n * num_cells + i] =
+							tile.costs[n * tile.cells.size() + i];
+				for (unsigned int i = 0; i < stored_cells.size(); i++)
+					merged_tile.costs[n * num_cells + tile.cells.size() + i] =
+							stored_tile.costs[n * stored_tile.cells.size() + stored_cells[i]];
+			}
+		}
+
+		new_tile = &merged_tile;
+	}
+
+	if (new_tile->cells.size() > max_cells_)
+		return false;
+
+	// Getting the slot of the tile
+	unsigned int slot;
+	if (index_it != index_.end())
+		slot = index_it->second;
+	else {
+		if (free_slots_.empty())
+			return false;
+
+		slot = free_slots_.back();
+		free_slots_.pop_back();
+		index_[tile.id] = slot;
+	}
+
+	// Writing the cells and the cost layers
+	char* slot_data = getSlot(slot);
+	SlotHeader header;
+	header.id = new_tile->id;
+	header.num_cells = new_tile->cells.size();
+	header.num_layers = is_layers ? num_layers_ : 0;
+	header.padding = 0;
+	memcpy(slot_data, &header, sizeof(SlotHeader));
+	memcpy(slot_data + sizeof(SlotHeader), new_tile->cells.data(),
+		   header.num_cells * sizeof(SnapshotCell));
+	for (unsigned int n = 0; n < header.num_layers; n++) {
+		memcpy(slot_data + sizeof(SlotHeader) + max_cells_ * sizeof(SnapshotCell) +
+			   n * max_cells_ * sizeof(double),
+			   new_tile->costs.data() + n * header.num_cells,
+			   header.num_cells * sizeof(double));
+	}
+
+	return true;
+}
+
+
+void TileStore::requestTile(uint32_t id)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (index_.find(id) == index_.end() || !pending_.insert(id).second)
+			return;
+
+		requests_.push_back(id);
+	}
+	condition_.notify_one();
+}
+
+
+void TileStore::getLoadedTiles(std::vector<Tile>& tiles)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	tiles.swap(loaded_);
+	loaded_.clear();
+}
+
+
+void TileStore::getStoredTiles(std::vector<uint32_t>& ids)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	ids.clear();
+	for (std::map<uint32_t, unsigned int>::iterator index_it = index_.begin();
+			index_it != index_.end(); index_it++) {
+		if (pending_.find(index_it->first) == pending_.end())
+			ids.push_back(index_it->first);
+	}
+}
+
+
+void TileStore::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (std::map<uint32_t, unsigned int>::iterator index_it = index_.begin();
+			index_it != index_.end(); index_it++)
+		free_slots_.push_back(index_it->second);
+	index_.clear();
+	requests_.clear();
+	pending_.clear();
+	loaded_.clear();
+}
+
+
+unsigned int TileStore::getNumStoredTiles()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return index_.size();
+}
+
+
+unsigned int TileStore::getNumLayers() const
+{
+	return num_layers_;
+}
+
+
+void TileStore::run()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true) {
+		condition_.wait(lock, [this] { return stop_ || !requests_.empty(); });
+		if (stop_)
+			return;
+
+		uint32_t id = requests_.front();
+		requests_.pop_front();
+		std::map<uint32_t, unsigned int>::iterator index_it = index_.find(id);
+		if (index_it == index_.end()) {
+			pending_.erase(id);
+			continue;
+		}
+
+		// Paging in the slot without blocking the terrain mapping. The slot
+		// can be rewritten meanwhile, so the tile is copied after locking again
+		char* slot_data = getSlot(index_it->second);
+		lock.unlock();
+		madvise(slot_data, slot_size_, MADV_WILLNEED);
+		volatile char touch = 0;
+		for (size_t offset = 0; offset < slot_size_; offset += 4096)
+			touch += slot_data[offset];
+		lock.lock();
+
+		// The tile is moved to the terrain map, so its slot is released
+		index_it = index_.find(id);
+		pending_.erase(id);
+		if (index_it == index_.end())
+			continue;
+
+		loaded_.push_back(Tile());
+		readSlot(loaded_.back(), index_it->second);
+		free_slots_.push_back(index_it->second);
+		index_.erase(index_it);
+	}
+}
+
+
+void TileStore::readSlot(Tile& tile, unsigned int slot) const
+{
+	const char* slot_data = getSlot(slot);
+	SlotHeader header;
+	memcpy(&header, slot_data, sizeof(SlotHeader));
+
+	tile.id = header.id;
+	tile.cells.resize(header.num_cells);
+	memcpy(tile.cells.data(), slot_data + sizeof(SlotHeader),
+		   header.num_cells * sizeof(SnapshotCell));
+	tile.costs.resize(header.num_layers * header.num_cells);
+	for (unsigned int n = 0; n < header.num_layers; n++) {
+		memcpy(tile.costs.data() + n * header.num_cells,
+			   slot_data + sizeof(SlotHeader) + max_cells_ * sizeof(SnapshotCell) +
+			   n * max_cells_ * sizeof(double),
+			   header.num_cells * sizeof(double));
+	}
+}
+
+
+char* TileStore::getSlot(unsigned int slot) const
+{
+	return data_ + slot * slot_size_;
+}
+
+} //@namespace terrain_server
@@ -0,0 +1,158 @@
+#include <terrain_server/TraceRecorder.h>
+#include <dwl/utils/utils.h>
+
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+
+namespace terrain_server
+{
+
+TraceRecorder::TraceRecorder() : next_(0), mask_(0), enabled_(false)
+{
+
+}
+
+
+TraceRecorder::~TraceRecorder()
+{
+
+}
+
+
+void TraceRecorder::init(unsigned int capacity,
+						 const std::string& filename)
+{
+	filename_ = filename;
+
+	// Rounding up the capacity to a power of two, so the slot is computed
+	// with a mask
+	uint64_t size = 1;
+	while (size < capacity)
+		size <<= 1;
+
+	events_.assign(size, TraceEvent());
+	std::vector<std::atomic<uint64_t> > sequences(size);
+	sequences_.swap(sequences);
+	for (uint64_t i = 0; i < size; i++)
+		sequences_[i].store(0, std::memory_order_relaxed);
+	next_.store(0, std::memory_order_relaxed);
+	mask_ = size - 1;
+	enabled_ = true;
+}
+
+
+bool TraceRecorder::isEnabled() const
+{
+	return enabled_;
+}
+
+
+void TraceRecorder::addEvent(const char* name, double start, double duration,
+							 uint64_t frame)
+{
+	if (!enabled_)
+		return;
+
+	TraceEvent event;
+	event.name = name;
+	event.phase = 'X';
+	event.thread = getThreadId();
+	event.frame = frame;
+	event.start = start;
+	event.duration = duration;
+	write(event);
+}
+
+
+void TraceRecorder::addInstant(const char* name, uint64_t frame)
+{
+	if (!enabled_)
+		return;
+
+	TraceEvent event;
+	event.name = name;
+	event.phase = 'i';
+	event.thread = getThreadId();
+	event.frame = frame;
+	event.start = getMonotonicTime();
+	write(event);
+}
+
+
+void TraceRecorder::write(const TraceEvent& event)
+{
+	// Reserving the slot, and marking it as being written until the event
+	// is copied
+	uint64_t index = next_.fetch_add(1, std::memory_order_relaxed);
+	uint64_t slot = index & mask_;
+	sequences_[slot].store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	events_[slot] = event;
+	sequences_[slot].store(index + 1, std::memory_order_release);
+}
+
+
+int TraceRecorder::dump(const std::string& filename) const
+{
+	std::ofstream file(filename.c_str());
+	if (!file.is_open()) {
+		printf(RED_ "Could not write the trace in %s\n" COLOR_RESET, filename.c_str());
+		return -1;
+	}
+
+	// Copying the valid events from the oldest one, i.e. the slots with a
+	// sequence number that doesn't change while they are copied
+	std::vector<TraceEvent> events;
+	uint64_t last = next_.load(std::memory_order_acquire);
+	uint64_t first = last > events_.size() ? last - events_.size() : 0;
+	events.reserve(last - first);
+	for (uint64_t index = first; index < last; index++) {
+		uint64_t slot = index & mask_;
+		if (sequences_[slot].load(std::memory_order_acquire) != index + 1)
+			continue;
+
+		TraceEvent event = events_[slot];
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequences_[slot].load(std::memory_order_relaxed) == index + 1)
+			events.push_back(event);
+	}
+
+	// Writing the events in the Chrome trace format (timestamps in
+	// microseconds w.r.t. the oldest event)
+	double origin = events.empty() ? 0. : events[0].start;
+	for (unsigned int i = 0; i < events.size(); i++)
+		origin = std::min(origin, events[i].start);
+
+	int pid = getpid();
+	file.precision(3);
+	file << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (unsigned int i = 0; i < events.size(); i++) {
+		const TraceEvent& event = events[i];
+		if (i > 0)
+			file << ",";
+		file << "\n{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase
+				<< "\",\"pid\":" << pid << ",\"tid\":" << event.thread
+				<< ",\"ts\":" << 1e6 * (event.start - origin);
+		if (event.phase == 'X')
+			file << ",\"dur\":" << 1e6 * event.duration;
+		else
+			file << ",\"s\":\"t\"";
+		file << ",\"args\":{\"frame\":" << event.frame << "}}";
+	}
+	file << "\n]}\n";
+
+	return events.size();
+}
+
+
+uint32_t TraceRecorder::getThreadId()
+{
+	static thread_local uint32_t thread_id = syscall(SYS_gettid);
+	return thread_id;
+}
+
+} //@namespace terrain_server
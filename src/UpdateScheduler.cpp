@@ -0,0 +1,67 @@
+#include <terrain_server/UpdateScheduler.h>
+
+#include <algorithm>
+#include <math.h>
+
+
+namespace terrain_server
+{
+
+UpdateScheduler::UpdateScheduler() : min_translation_(0.), min_yaw_(0.), min_change_(0.),
+		max_period_(1.), last_state_(Eigen::Vector4d::Zero()), last_signature_(0.),
+		last_time_(0.), is_forced_(true)
+{
+
+}
+
+
+UpdateScheduler::~UpdateScheduler()
+{
+
+}
+
+
+void UpdateScheduler::setThresholds(double min_translation,
+									double min_yaw,
+									double min_change,
+									double max_period)
+{
+	min_translation_ = min_translation;
+	min_yaw_ = min_yaw;
+	min_change_ = min_change;
+	max_period_ = max_period;
+}
+
+
+bool UpdateScheduler::isUpdateRequired(const Eigen::Vector4d& robot_state,
+									   double signature,
+									   double time)
+{
+	if (!is_forced_.exchange(false)) {
+		// Getting the motion of the robot and the change of the input since
+		// the last update
+		double translation = (robot_state.head<3>() - last_state_.head<3>()).norm();
+		double yaw = fabs(atan2(sin(robot_state(3) - last_state_(3)),
+								cos(robot_state(3) - last_state_(3))));
+		double change = fabs(signature - last_signature_) /
+				std::max(fabs(last_signature_), 1e-9);
+		bool is_period = max_period_ <= 0. || time - last_time_ < max_period_;
+		if (translation < min_translation_ && yaw < min_yaw_ &&
+				change < min_change_ && is_period)
+			return false;
+	}
+
+	last_state_ = robot_state;
+	last_signature_ = signature;
+	last_time_ = time;
+
+	return true;
+}
+
+
+void UpdateScheduler::reset()
+{
+	is_forced_ = true;
+}
+
+} //@namespace terrain_server
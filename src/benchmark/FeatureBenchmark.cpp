@@ -0,0 +1,220 @@
+#include <terrain_server/feature/SlopeFeature.h>
+#include <terrain_server/feature/HeightDeviationFeature.h>
+#include <terrain_server/feature/CurvatureFeature.h>
+#include <terrain_server/Timer.h>
+#include <dwl/environment/SpaceDiscretization.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+
+namespace terrain_server
+{
+
+/**
+ * @class FeatureBenchmark
+ * @brief Class for measuring the cost computation of the features in
+ * isolation over synthetic height grids. It sweeps the resolution, the
+ * neighboring area, the hole density and the size of the grid, and it
+ * reports the time per cell
+ */
+class FeatureBenchmark
+{
+	public:
+		/** @brief Constructor function */
+		FeatureBenchmark() : min_time_(0.2), seed_(0) {}
+
+		/** @brief Destructor function */
+		~FeatureBenchmark() {}
+
+		/** @brief Sets the minimum measuring time per case */
+		void setMinTime(double min_time) { min_time_ = min_time; }
+
+		/** @brief Runs the sweeps and prints the report */
+		void run();
+
+
+	private:
+		/** @brief Synthetic height grid */
+		struct HeightGrid
+		{
+			dwl::Terrain terrain;
+			std::vector<Eigen::Vector3d> positions;
+			std::vector<Eigen::Vector3d> normals;
+			std::vector<double> curvatures;
+		};
+
+		/**
+		 * @brief Builds a rough height grid with random holes
+		 * @param HeightGrid& Height grid
+		 * @param unsigned int Number of cells per side
+		 * @param double Resolution of the grid
+		 * @param double Density of the holes (i.e. cells without height)
+		 */
+		void buildGrid(HeightGrid& grid, unsigned int size,
+					   double resolution, double hole_density);
+
+		/**
+		 * @brief Measures the time per cell (in ns) of a feature
+		 * @param dwl::environment::Feature& Feature
+		 * @param HeightGrid& Height grid
+		 * @param bool Indicates if the cells are visited in random order
+		 */
+		double measure(dwl::environment::Feature& feature,
+					   HeightGrid& grid, bool random_order);
+
+		/** @brief Prints a row of the report */
+		void print(const std::string& feature, double resolution,
+				   double neighboring_size, double hole_density,
+				   unsigned int size, bool random_order, double ns_per_cell);
+
+		/** @brief Minimum measuring time per case */
+		double min_time_;
+
+		/** @brief Seed of the synthetic grids */
+		unsigned int seed_;
+};
+
+
+void FeatureBenchmark::run()
+{
+	const double resolutions[] = {0.01, 0.02, 0.04};
+	const double neighboring_sizes[] = {0.04, 0.08, 0.12, 0.16};
+	const double hole_densities[] = {0., 0.1, 0.3};
+	const unsigned int sizes[] = {32, 128, 512};
+
+	printf("%-18s %8s %8s %8s %8s %8s %12s\n", "feature", "res [m]",
+			"area [m]", "holes", "grid", "order", "ns/cell");
+
+	terrain_server::feature::SlopeFeature slope;
+	terrain_server::feature::CurvatureFeature curvature;
+	for (unsigned int r = 0; r < 3; r++) {
+		for (unsigned int h = 0; h < 3; h++) {
+			// Scaling w.r.t. the size of the grid, and the visiting order of
+			// the cells (cache-miss sensitivity of the height map lookups)
+			for (unsigned int s = 0; s < 3; s++) {
+				HeightGrid grid;
+				buildGrid(grid, sizes[s], resolutions[r], hole_densities[h]);
+				for (int order = 0; order < 2; order++) {
+					if (h == 0) {
+						print("slope", resolutions[r], 0., hole_densities[h], sizes[s],
+							  order, measure(slope, grid, order));
+						print("curvature", resolutions[r], 0., hole_densities[h], sizes[s],
+							  order, measure(curvature, grid, order));
+					}
+
+					for (unsigned int n = 0; n < 4; n++) {
+						if (neighboring_sizes[n] < resolutions[r])
+							continue;
+
+						terrain_server::feature::HeightDeviationFeature height_dev(0.01, 0.3);
+						height_dev.setNeighboringArea(-neighboring_sizes[n], neighboring_sizes[n],
+													  -neighboring_sizes[n], neighboring_sizes[n],
+													  resolutions[r]);
+						print("height deviation", resolutions[r], neighboring_sizes[n],
+							  hole_densities[h], sizes[s], order,
+							  measure(height_dev, grid, order));
+					}
+				}
+			}
+		}
+	}
+}
+
+
+void FeatureBenchmark::buildGrid(HeightGrid& grid, unsigned int size,
+								 double resolution, double hole_density)
+{
+	dwl::environment::SpaceDiscretization space_discretization(resolution, resolution, M_PI / 200);
+	space_discretization.setEnvironmentResolution(resolution, true);
+	space_discretization.setStateResolution(resolution);
+
+	std::mt19937 generator(seed_++);
+	std::uniform_real_distribution<double> distribution(0., 1.);
+
+	grid.terrain.height_map.reset(new std::map<dwl::Vertex, double>);
+	grid.terrain.resolution = resolution;
+	grid.terrain.min_height = -0.1;
+	for (unsigned int i = 0; i < size; i++) {
+		for (unsigned int j = 0; j < size; j++) {
+			Eigen::Vector2d coord((i + 0.5) * resolution, (j + 0.5) * resolution);
+			double height = 0.05 * sin(4 * coord(0)) * cos(3 * coord(1));
+
+			// Adding the cell if it isn't a hole
+			if (distribution(generator) >= hole_density) {
+				dwl::Vertex vertex;
+				space_discretization.coordToVertex(vertex, coord);
+				(*grid.terrain.height_map)[vertex] = height;
+			}
+
+			grid.positions.push_back(Eigen::Vector3d(coord(0), coord(1), height));
+			Eigen::Vector3d normal(-0.2 * cos(4 * coord(0)) * cos(3 * coord(1)),
+								   0.15 * sin(4 * coord(0)) * sin(3 * coord(1)), 1.);
+			grid.normals.push_back(normal.normalized());
+			grid.curvatures.push_back(1e-4 * distribution(generator));
+		}
+	}
+}
+
+
+double FeatureBenchmark::measure(dwl::environment::Feature& feature,
+								 HeightGrid& grid, bool random_order)
+{
+	std::vector<unsigned int> order(grid.positions.size());
+	for (unsigned int i = 0; i < order.size(); i++)
+		order[i] = i;
+	if (random_order) {
+		std::mt19937 generator(seed_);
+		std::shuffle(order.begin(), order.end(), generator);
+	}
+
+	// Repeating the passes over the grid until the minimum time is reached
+	double cost, checksum = 0.;
+	unsigned long num_cells = 0;
+	double start_time = getMonotonicTime(), duration = 0.;
+	while (duration < min_time_) {
+		for (unsigned int k = 0; k < order.size(); k++) {
+			unsigned int i = order[k];
+			grid.terrain.position = grid.positions[i];
+			grid.terrain.surface_normal = grid.normals[i];
+			grid.terrain.curvature = grid.curvatures[i];
+			feature.computeCost(cost, grid.terrain);
+			checksum += cost;
+		}
+		num_cells += order.size();
+		duration = getMonotonicTime() - start_time;
+	}
+
+	// Avoiding that the compiler removes the cost computation
+	if (checksum != checksum)
+		printf("nan cost\n");
+
+	return 1e9 * duration / num_cells;
+}
+
+
+void FeatureBenchmark::print(const std::string& feature, double resolution,
+							 double neighboring_size, double hole_density,
+							 unsigned int size, bool random_order, double ns_per_cell)
+{
+	printf("%-18s %8.2f %8.2f %8.2f %8u %8s %12.1f\n", feature.c_str(), resolution,
+			neighboring_size, hole_density, size, random_order ? "random" : "linear",
+			ns_per_cell);
+}
+
+} //@namespace terrain_server
+
+
+
+int main(int argc, char **argv)
+{
+	terrain_server::FeatureBenchmark benchmark;
+	if (argc > 1)
+		benchmark.setMinTime(atof(argv[1]));
+
+	benchmark.run();
+
+	return 0;
+}
@@ -0,0 +1,299 @@
+#include <terrain_server/TerrainMapping.h>
+#include <terrain_server/TerrainMappingConfig.h>
+#include <terrain_server/Timer.h>
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace terrain_server
+{
+
+/**
+ * @brief Recorded frame, i.e. the serialized octomap and the robot state
+ * (3D position and yaw angle)
+ */
+struct RecordedFrame
+{
+	std::string name;
+	std::string octomap_data;
+	Eigen::Vector4d robot_state;
+};
+
+
+/**
+ * @class TerrainMappingBenchmark
+ * @brief Class for replaying recorded octomaps and robot poses through the
+ * terrain mapping without a ROS master. It reports latency percentiles per
+ * stage, throughput and peak memory
+ */
+class TerrainMappingBenchmark
+{
+	public:
+		/** @brief Constructor function */
+		TerrainMappingBenchmark() : num_warmup_(1), num_repeats_(1) {}
+
+		/** @brief Destructor function */
+		~TerrainMappingBenchmark() {}
+
+		/**
+		 * @brief Loads the recorded frames. Every line of the frames file
+		 * defines the octomap file (.bt or .ot, relative to the frames file)
+		 * and the robot state, i.e. "octomap_file x y z yaw"
+		 * @param const std::string& Name of the frames file
+		 */
+		bool loadFrames(const std::string& filename);
+
+		/** @brief Sets the number of warm-up frames and repetitions */
+		void setRepetitions(unsigned int num_warmup, unsigned int num_repeats);
+
+		/** @brief Sets the file where the per-frame latencies are written */
+		void setOutputFile(const std::string& filename);
+
+		/**
+		 * @brief Replays the recorded frames and prints the report
+		 * @param const TerrainMappingConfig& Configuration of the terrain mapping
+		 */
+		void run(const TerrainMappingConfig& config);
+
+
+	private:
+		/** @brief Latencies (in seconds) of a stage */
+		struct Stage
+		{
+			std::string name;
+			std::vector<double> samples;
+		};
+
+		/** @brief Prints the percentiles of a stage */
+		void printStage(Stage& stage) const;
+
+		/** @brief Recorded frames */
+		std::vector<RecordedFrame> frames_;
+
+		/** @brief Number of warm-up frames and repetitions of the dataset */
+		unsigned int num_warmup_, num_repeats_;
+
+		/** @brief File of the per-frame latencies */
+		std::string output_file_;
+};
+
+
+bool TerrainMappingBenchmark::loadFrames(const std::string& filename)
+{
+	std::ifstream frames_file(filename.c_str());
+	if (!frames_file.is_open()) {
+		printf(RED_ "Could not open the frames file %s\n" COLOR_RESET, filename.c_str());
+		return false;
+	}
+
+	std::string dir;
+	size_t dir_pos = filename.find_last_of('/');
+	if (dir_pos != std::string::npos)
+		dir = filename.substr(0, dir_pos + 1);
+
+	std::string line;
+	while (std::getline(frames_file, line)) {
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		RecordedFrame frame;
+		std::istringstream line_stream(line);
+		if (!(line_stream >> frame.name >> frame.robot_state(0) >> frame.robot_state(1)
+				>> frame.robot_state(2) >> frame.robot_state(3))) {
+			printf(RED_ "Malformed frame: %s\n" COLOR_RESET, line.c_str());
+			return false;
+		}
+
+		// Reading the octomap and keeping it serialized in memory, so the
+		// deserialization can be measured as in the terrain map server
+		std::string octomap_file = frame.name[0] == '/' ? frame.name : dir + frame.name;
+		octomap::AbstractOcTree* tree = NULL;
+		if (octomap_file.size() > 3 &&
+				octomap_file.compare(octomap_file.size() - 3, 3, ".bt") == 0) {
+			octomap::OcTree* octree = new octomap::OcTree(0.1);
+			if (octree->readBinary(octomap_file))
+				tree = octree;
+			else
+				delete octree;
+		} else
+			tree = octomap::AbstractOcTree::read(octomap_file);
+
+		if (!tree) {
+			printf(RED_ "Could not read the octomap %s\n" COLOR_RESET, octomap_file.c_str());
+			return false;
+		}
+
+		std::ostringstream data;
+		tree->write(data);
+		frame.octomap_data = data.str();
+		delete tree;
+
+		frames_.push_back(frame);
+	}
+
+	printf(GREEN_ "Loaded %u frames\n" COLOR_RESET, (unsigned int) frames_.size());
+	return !frames_.empty();
+}
+
+
+void TerrainMappingBenchmark::setRepetitions(unsigned int num_warmup,
+											 unsigned int num_repeats)
+{
+	num_warmup_ = num_warmup;
+	num_repeats_ = num_repeats;
+}
+
+
+void TerrainMappingBenchmark::setOutputFile(const std::string& filename)
+{
+	output_file_ = filename;
+}
+
+
+void TerrainMappingBenchmark::run(const TerrainMappingConfig& config)
+{
+	TerrainMapping terrain_map;
+	config.apply(terrain_map);
+
+	Stage deserialize, pruning, surface, terrain_data, total;
+	deserialize.name = "deserialize";
+	pruning.name = "pruning";
+	surface.name = "surface";
+	terrain_data.name = "terrain data";
+	total.name = "total";
+
+	std::ofstream output;
+	if (!output_file_.empty()) {
+		output.open(output_file_.c_str());
+		output << "frame,deserialize,pruning,surface,terrain_data,total,"
+				"num_columns,num_cells,map_size\n";
+	}
+
+	unsigned long num_cells = 0;
+	double compute_time = 0.;
+	unsigned int num_frames = num_repeats_ * frames_.size();
+	for (unsigned int i = 0; i < num_frames; i++) {
+		const RecordedFrame& frame = frames_[i % frames_.size()];
+
+		// Deserializing the octomap
+		double start_time = getMonotonicTime();
+		std::istringstream data(frame.octomap_data);
+		octomap::AbstractOcTree* tree = octomap::AbstractOcTree::read(data);
+		octomap::OcTree* octomap = dynamic_cast<octomap::OcTree*>(tree);
+		if (!octomap) {
+			printf(RED_ "Failed to create octree structure\n" COLOR_RESET);
+			delete tree;
+			return;
+		}
+		double deserialize_time = getMonotonicTime() - start_time;
+
+		// Computing the terrain map
+		terrain_map.setResolution(octomap->getResolution(), false);
+		terrain_map.compute(octomap, frame.robot_state);
+		double total_time = getMonotonicTime() - start_time;
+		delete octomap;
+
+		// Recording the latencies after the warm-up frames
+		const TerrainMappingProfile& profile = terrain_map.getProfile();
+		if (i < num_warmup_)
+			continue;
+
+		deserialize.samples.push_back(deserialize_time);
+		pruning.samples.push_back(profile.pruning);
+		surface.samples.push_back(profile.surface);
+		terrain_data.samples.push_back(profile.terrain_data);
+		total.samples.push_back(total_time);
+		num_cells += profile.num_cells;
+		compute_time += total_time - deserialize_time;
+
+		if (output.is_open()) {
+			output << frame.name << "," << deserialize_time << "," << profile.pruning
+					<< "," << profile.surface << "," << profile.terrain_data << ","
+					<< total_time << "," << profile.num_columns << ","
+					<< profile.num_cells << "," << profile.map_size << "\n";
+		}
+	}
+
+	if (total.samples.empty()) {
+		printf(YELLOW_ "There are not frames after the warm-up\n" COLOR_RESET);
+		return;
+	}
+
+	// Printing the report
+	printf("%-14s %10s %10s %10s %10s %10s\n",
+			"stage [ms]", "mean", "p50", "p90", "p99", "max");
+	printStage(deserialize);
+	printStage(pruning);
+	printStage(surface);
+	printStage(terrain_data);
+	printStage(total);
+
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	printf("frames: %u\n", (unsigned int) total.samples.size());
+	printf("throughput: %.2f frames/s, %.0f cells/s\n",
+			total.samples.size() / compute_time, num_cells / compute_time);
+	printf("map size: %u cells\n", terrain_map.getProfile().map_size);
+	printf("peak memory: %.1f MB\n", usage.ru_maxrss / 1024.);
+}
+
+
+void TerrainMappingBenchmark::printStage(Stage& stage) const
+{
+	std::vector<double>& samples = stage.samples;
+	std::sort(samples.begin(), samples.end());
+
+	double mean = 0.;
+	for (unsigned int i = 0; i < samples.size(); i++)
+		mean += samples[i];
+	mean /= samples.size();
+
+	unsigned int n = samples.size() - 1;
+	printf("%-14s %10.3f %10.3f %10.3f %10.3f %10.3f\n", stage.name.c_str(),
+			1e3 * mean, 1e3 * samples[n / 2], 1e3 * samples[(9 * n) / 10],
+			1e3 * samples[(99 * n) / 100], 1e3 * samples[n]);
+}
+
+} //@namespace terrain_server
+
+
+
+int main(int argc, char **argv)
+{
+	if (argc < 3) {
+		printf("Usage: %s terrain_map.yaml frames.txt [-w warmup] [-r repeats] [-o latencies.csv]\n",
+				argv[0]);
+		return -1;
+	}
+
+	unsigned int num_warmup = 1, num_repeats = 1;
+	std::string output_file;
+	for (int i = 3; i + 1 < argc; i += 2) {
+		std::string option = argv[i];
+		if (option == "-w")
+			num_warmup = atoi(argv[i + 1]);
+		else if (option == "-r")
+			num_repeats = atoi(argv[i + 1]);
+		else if (option == "-o")
+			output_file = argv[i + 1];
+	}
+
+	terrain_server::TerrainMappingConfig config;
+	if (!config.loadFromYaml(argv[1]))
+		return -1;
+
+	terrain_server::TerrainMappingBenchmark benchmark;
+	if (!benchmark.loadFrames(argv[2]))
+		return -1;
+
+	benchmark.setRepetitions(num_warmup, num_repeats);
+	benchmark.setOutputFile(output_file);
+	benchmark.run(config);
+
+	return 0;
+}
@@ -8,8 +8,7 @@ namespace terrain_server
 namespace feature
 {
 
-CurvatureFeature::CurvatureFeature() :
-		positive_threshold_(6.0), negative_threshold_(-6.0)
+CurvatureFeature::CurvatureFeature()
 {
 	name_ = "Curvature";
 }
@@ -23,22 +22,18 @@ CurvatureFeature::~CurvatureFeature()
 void CurvatureFeature::computeCost(double& cost_value,
 								   const dwl::Terrain& terrain_info)
 {
-	double curvature = terrain_info.curvature;
-
-	// The worse condition
-	if (curvature * 10000 > 9) {
-		cost_value = max_cost_;
-		return;
-	}
-
-	if (curvature > positive_threshold_)
-		cost_value = 0.;
-	else if (curvature < negative_threshold_)
-		cost_value = max_cost_;
-	else
-		cost_value = max_cost_
-				- log((curvature - negative_threshold_)
-								/ (positive_threshold_ - negative_threshold_));
+	kernel_.max_cost = max_cost_;
+	cost_value = kernel_.computeCost(terrain_info);
+}
+
+
+CurvatureKernel CurvatureFeature::getKernel()
+{
+	CurvatureKernel kernel = kernel_;
+	kernel.max_cost = max_cost_;
+	getWeight(kernel.weight);
+
+	return kernel;
 }
 
 } //@namespace feature
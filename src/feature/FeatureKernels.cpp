@@ -0,0 +1,142 @@
+#include <terrain_server/feature/FeatureKernels.h>
+
+
+namespace terrain_server
+{
+
+namespace feature
+{
+
+HeightDeviationKernel::HeightDeviationKernel() : flat_height_deviation(0.01),
+		max_height_deviation(0.3), min_allowed_height(-std::numeric_limits<double>::max()),
+		min_x(0.), max_x(0.), min_y(0.), max_y(0.), resolution(0.04),
+		max_cost(0.), weight(1.), space_discretization_(0.04, 0.04, M_PI / 200)
+{
+
+}
+
+
+void HeightDeviationKernel::prepare(const dwl::Terrain& terrain_info)
+{
+	// Setting the grid resolution of the gridmap
+	space_discretization_.setEnvironmentResolution(terrain_info.resolution, true);
+	space_discretization_.setStateResolution(terrain_info.resolution);
+}
+
+
+double HeightDeviationKernel::computeCost(const dwl::Terrain& terrain_info)
+{
+	// Getting the cell position
+	Eigen::Vector2d cell_position = terrain_info.position.head(2);
+	dwl::Vertex cell_vertex;
+	space_discretization_.stateToVertex(cell_vertex, cell_position);
+	space_discretization_.vertexToState(cell_position, cell_vertex);
+
+	// Putting minimum cost to voxel with low height
+	std::map<dwl::Vertex,double>::const_iterator cell_it =
+			terrain_info.height_map->find(cell_vertex);
+	if (cell_it != terrain_info.height_map->end() && cell_it->second < min_allowed_height)
+		return max_cost;
+
+	// Computing the average height of the neighboring area
+	double height_average = 0, height_deviation = 0, estimated_height_deviation = 0;
+	int counter = 0, estimated_counter = 0;
+
+	Eigen::Vector2d boundary_min, boundary_max;
+	boundary_min(0) = min_x + cell_position(0);
+	boundary_min(1) = min_y + cell_position(1);
+	boundary_max(0) = max_x + cell_position(0);
+	boundary_max(1) = max_y + cell_position(1);
+	for (double y = boundary_min(1); y <= boundary_max(1); y += resolution) {
+		for (double x = boundary_min(0); x <= boundary_max(0); x += resolution) {
+			Eigen::Vector2d coord;
+			coord(0) = x;
+			coord(1) = y;
+			dwl::Vertex vertex_2d;
+			space_discretization_.coordToVertex(vertex_2d, coord);
+
+			std::map<dwl::Vertex,double>::const_iterator height_it =
+					terrain_info.height_map->find(vertex_2d);
+			if (height_it != terrain_info.height_map->end()) {
+				height_average += height_it->second;
+				counter++;
+			}
+		}
+	}
+
+	if (counter == 0)
+		return 0.;
+
+	height_average /= counter;
+
+	// Computing the standard deviation of the height
+	for (double y = boundary_min(1); y <= boundary_max(1); y += resolution) {
+		for (double x = boundary_min(0); x <= boundary_max(0); x += resolution) {
+			Eigen::Vector2d coord;
+			coord(0) = x;
+			coord(1) = y;
+			dwl::Vertex vertex_2d;
+			space_discretization_.coordToVertex(vertex_2d, coord);
+
+			std::map<dwl::Vertex,double>::const_iterator height_it =
+					terrain_info.height_map->find(vertex_2d);
+			if (height_it != terrain_info.height_map->end()) {
+				height_deviation += fabs(height_it->second - height_average);
+			} else {
+				// Computing the estimated ground
+				Eigen::Vector2d height_boundary_min, height_boundary_max;
+				height_boundary_min(0) = min_x + coord(0);
+				height_boundary_min(1) = min_y + coord(1);
+				height_boundary_max(0) = max_x + coord(0);
+				height_boundary_max(1) = max_y + coord(1);
+				double estimated_height = 0;
+				int height_counter = 0;
+				for (double y_e = height_boundary_min(1); y_e < height_boundary_max(1); y_e += resolution) {
+					for (double x_e = height_boundary_min(0); x_e < height_boundary_max(0); x_e += resolution) {
+						Eigen::Vector2d height_coord;
+						height_coord(0) = x_e;
+						height_coord(1) = y_e;
+						dwl::Vertex height_vertex_2d;
+						space_discretization_.coordToVertex(height_vertex_2d, height_coord);
+
+						std::map<dwl::Vertex,double>::const_iterator estimated_it =
+								terrain_info.height_map->find(height_vertex_2d);
+						if (estimated_it != terrain_info.height_map->end())
+							estimated_height += estimated_it->second;
+						else
+							estimated_height += terrain_info.min_height;
+
+						height_counter++;
+					}
+				}
+
+				if (height_counter != 0) {
+					estimated_height /= height_counter;
+					estimated_height_deviation += fabs(estimated_height - height_average);
+					estimated_counter++;
+				}
+			}
+		}
+	}
+
+	height_deviation /= counter;
+
+	if (estimated_counter != 0)
+		estimated_height_deviation /= estimated_counter;
+
+	double total_heigh_deviation = height_deviation + estimated_height_deviation;
+
+	if (total_heigh_deviation <= flat_height_deviation)
+		return 0.;
+	else if (total_heigh_deviation < max_height_deviation) {
+		double cost_value = -log(1 - (total_heigh_deviation - flat_height_deviation) /
+				(max_height_deviation - flat_height_deviation));
+		if (max_cost < cost_value)
+			cost_value = max_cost;
+		return cost_value;
+	} else
+		return max_cost;
+}
+
+} //@namespace feature
+} //@namespace terrain_server
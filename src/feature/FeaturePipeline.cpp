@@ -0,0 +1,98 @@
+#include <terrain_server/feature/FeaturePipeline.h>
+#include <terrain_server/feature/SlopeFeature.h>
+#include <terrain_server/feature/HeightDeviationFeature.h>
+#include <terrain_server/feature/CurvatureFeature.h>
+#include <terrain_server/Timer.h>
+
+
+namespace terrain_server
+{
+
+namespace feature
+{
+
+VirtualFeaturePipeline::VirtualFeaturePipeline(
+		const std::vector<dwl::environment::Feature*>& features) : features_(features)
+{
+
+}
+
+
+VirtualFeaturePipeline::~VirtualFeaturePipeline()
+{
+
+}
+
+
+void VirtualFeaturePipeline::computeCosts(std::vector<double>& costs,
+										  std::vector<double>& feature_costs,
+										  const std::vector<TerrainSample>& samples,
+										  dwl::Terrain& terrain_info,
+										  std::vector<double>* feature_times)
+{
+	unsigned int num_samples = samples.size();
+	costs.assign(num_samples, 0.);
+
+	unsigned int num_features = features_.size();
+	feature_costs.resize(num_samples * num_features);
+	if (feature_times)
+		feature_times->assign(num_features, 0.);
+
+	double cost_value, weight;
+	for (unsigned int n = 0; n < num_features; n++) {
+		double start_time = getMonotonicTime();
+		features_[n]->getWeight(weight);
+		for (unsigned int i = 0; i < num_samples; i++) {
+			const TerrainSample& sample = samples[i];
+			terrain_info.position = sample.position;
+			terrain_info.surface_normal = sample.surface_normal;
+			terrain_info.curvature = sample.curvature;
+
+			features_[n]->computeCost(cost_value, terrain_info);
+			feature_costs[i * num_features + n] = cost_value;
+			costs[i] += weight * cost_value;
+		}
+
+		if (feature_times)
+			(*feature_times)[n] = getMonotonicTime() - start_time;
+	}
+}
+
+
+bool VirtualFeaturePipeline::isFused() const
+{
+	return false;
+}
+
+
+FeaturePipeline* createFeaturePipeline(const std::vector<dwl::environment::Feature*>& features,
+									   bool allow_fused)
+{
+	if (allow_fused) {
+		// Getting the built-in features in the order of their addition
+		std::vector<SlopeFeature*> slope(features.size());
+		std::vector<HeightDeviationFeature*> height_dev(features.size());
+		std::vector<CurvatureFeature*> curvature(features.size());
+		for (unsigned int i = 0; i < features.size(); i++) {
+			slope[i] = dynamic_cast<SlopeFeature*>(features[i]);
+			height_dev[i] = dynamic_cast<HeightDeviationFeature*>(features[i]);
+			curvature[i] = dynamic_cast<CurvatureFeature*>(features[i]);
+		}
+
+		if (features.size() == 1 && height_dev[0]) {
+			return new FusedFeaturePipeline<HeightDeviationKernel>(
+					height_dev[0]->getKernel());
+		} else if (features.size() == 2 && slope[0] && height_dev[1]) {
+			return new FusedFeaturePipeline<SlopeKernel, HeightDeviationKernel>(
+					slope[0]->getKernel(), height_dev[1]->getKernel());
+		} else if (features.size() == 3 && slope[0] && height_dev[1] && curvature[2]) {
+			return new FusedFeaturePipeline<SlopeKernel, HeightDeviationKernel, CurvatureKernel>(
+					slope[0]->getKernel(), height_dev[1]->getKernel(), curvature[2]->getKernel());
+		}
+	}
+
+	return new VirtualFeaturePipeline(features);
+}
+
+} //@namespace feature
+} //@namespace terrain_server
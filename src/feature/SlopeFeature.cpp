@@ -9,8 +9,7 @@ namespace feature
 {
 
 
-SlopeFeature::SlopeFeature() : flat_threshold_(1.0 * (M_PI / 180.0)),
-		steep_threshold_(70.0 * (M_PI / 180.0))
+SlopeFeature::SlopeFeature()
 {
 	name_ = "Slope";
 }
@@ -25,16 +24,18 @@ SlopeFeature::~SlopeFeature()
 void SlopeFeature::computeCost(double& cost_value,
 							   const dwl::Terrain& terrain_info)
 {
-	double slope = fabs(acos((double) terrain_info.surface_normal(2)));
-
-	if (slope < flat_threshold_)
-		cost_value = 0.;
-	else if (slope < steep_threshold_) {
-		cost_value = -log(1 - (slope - flat_threshold_) / (steep_threshold_ - flat_threshold_));
-		if (max_cost_ < cost_value)
-			cost_value = max_cost_;
-	} else
-		cost_value = max_cost_;
+	kernel_.max_cost = max_cost_;
+	cost_value = kernel_.computeCost(terrain_info);
+}
+
+
+SlopeKernel SlopeFeature::getKernel()
+{
+	SlopeKernel kernel = kernel_;
+	kernel.max_cost = max_cost_;
+	getWeight(kernel.weight);
+
+	return kernel;
 }
 
 } //@namespace feature
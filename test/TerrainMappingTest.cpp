@@ -0,0 +1,1137 @@
+#include <terrain_server/TerrainMapping.h>
+#include <terrain_server/TerrainMappingConfig.h>
+#include <terrain_server/FootholdExtractor.h>
+#include <terrain_server/SceneGenerator.h>
+#include <terrain_server/UpdateScheduler.h>
+#include <terrain_server/Timer.h>
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+namespace terrain_server
+{
+
+/** @brief Expected surface of a scene at a certain position */
+struct ExpectedSurface
+{
+	ExpectedSurface() : defined(false), height(0.), edge_distance(0.) {}
+	ExpectedSurface(double height, double edge_distance) : defined(true),
+			height(height), edge_distance(edge_distance) {}
+
+	bool defined;
+	double height;
+	double edge_distance;
+};
+
+
+/** @brief Resolution of the octree and the terrain map */
+static const double octree_resolution = 0.02;
+static const double grid_resolution = 0.04;
+
+/** @brief Tolerances of the analytic expectations */
+static const double height_tolerance = octree_resolution + 1e-6;
+static const double min_normal_z = cos(10. * M_PI / 180.);
+static const double flat_cost_tolerance = 0.1;
+static const double min_coverage = 0.9;
+
+/** @brief Distance to the edges of the interior cells, i.e. cells that
+ * aren't affected by the neighboring area of the plane fitting and the
+ * height deviation */
+static const double interior_distance = 0.12;
+
+/** @brief Distance to the edges of the interior cells that aren't affected
+ * by the neighboring area of the plane fitting */
+static const double plane_interior_distance = 0.05;
+
+
+/**
+ * @brief Stairs of the stair_s3_h14_l30 world, i.e. 3 steps of 0.14 m
+ * height and 0.3 m length that start at 0.55 m
+ */
+static ExpectedSurface stairsSurface(double x, double y)
+{
+	const double edges[] = {0.55, 0.85, 1.15, 1.45};
+	double edge_distance = 0.4 - fabs(y);
+	for (unsigned int i = 0; i < 4; i++)
+		edge_distance = std::min(edge_distance, fabs(x - edges[i]));
+
+	if (x < edges[0])
+		return ExpectedSurface(0., edge_distance);
+	int step = std::min((int) floor((x - edges[0]) / 0.3), 2);
+	return ExpectedSurface(0.14 * (step + 1), edge_distance);
+}
+
+
+/**
+ * @brief Gap of the gap25 world, i.e. two platforms of 0.14 m height over
+ * the ground separated by 0.25 m
+ */
+static ExpectedSurface gapSurface(double x, double y)
+{
+	double edge_distance = std::min(fabs(x - 0.6), fabs(x - 0.85));
+	edge_distance = std::min(edge_distance, 0.4 - fabs(y));
+	if (x > 0.6 && x < 0.85)
+		return ExpectedSurface(0., edge_distance);
+
+	return ExpectedSurface(0.14, edge_distance);
+}
+
+
+/**
+ * @brief Stepping stones, i.e. 4x3 square stones of 0.2 m size with a
+ * distance of 0.35 m between them and without ground
+ */
+static ExpectedSurface steppingStonesSurface(double x, double y)
+{
+	int i = std::max(0, std::min(3, (int) floor((x - 1.0) / 0.35 + 2.)));
+	int j = std::max(0, std::min(2, (int) floor(y / 0.35 + 1.5)));
+	double dx = fabs(x - (1.0 + (i - 1.5) * 0.35));
+	double dy = fabs(y - (j - 1.) * 0.35);
+	double edge_distance = 0.1 - std::max(dx, dy);
+	if (edge_distance < 0.) {
+		ExpectedSurface surface;
+		surface.edge_distance = edge_distance;
+		return surface;
+	}
+
+	return ExpectedSurface(0.14, edge_distance);
+}
+
+
+/** @brief Step of 0.14 m height at x = 1.0 m */
+static ExpectedSurface stepSurface(double x, double y)
+{
+	return ExpectedSurface(x < 1. ? 0. : 0.14, fabs(x - 1.));
+}
+
+
+class TerrainMappingTest : public ::testing::Test
+{
+	protected:
+		TerrainMappingTest() : octree_(octree_resolution),
+				robot_state_(0., 0., 0.5, 0.)
+		{
+			// The search area covers the scenes in front of the robot
+			dwl::SearchArea area;
+			area.min_x = 0.1;
+			area.max_x = 1.9;
+			area.min_y = -0.3;
+			area.max_y = 0.3;
+			area.min_z = -0.8;
+			area.max_z = 0.2;
+			area.resolution = grid_resolution;
+			config_.search_areas.push_back(area);
+			config_.interest_radius_x = 10.;
+			config_.interest_radius_y = 10.;
+			config_.enable_slope = true;
+			config_.enable_height_deviation = true;
+			config_.height_deviation_size = 0.08;
+			config_.height_deviation_resolution = grid_resolution;
+			config_.apply(terrain_map_);
+		}
+
+		/** @brief Adds the ground of the gap world, i.e. it covers the search
+		 * area and its surroundings */
+		void addGround(SceneGenerator& scene)
+		{
+			Rectangle ground;
+			ground.center_x = 0.675;
+			ground.length = 3.3;
+			ground.width = 2.6;
+			ground.resolution = 0.01;
+			scene.addRectangle(ground);
+		}
+
+		/** @brief Makes the scene of the gap world, i.e. a gap of 0.25 m
+		 * between two platforms of 0.14 m height on the ground */
+		void makeGapScene(SceneGenerator& scene)
+		{
+			addGround(scene);
+			scene.addGap(0.725, 0., 0., 0.25, 1.2, 0.8, 0.14, 0.01);
+		}
+
+		/** @brief Computes the terrain map of the scene */
+		void computeMap(const SceneGenerator& scene)
+		{
+			octree_.clear();
+			scene.getOcTree(octree_);
+			terrain_map_.setResolution(octree_.getResolution(), false);
+			terrain_map_.compute(&octree_, robot_state_);
+		}
+
+		/**
+		 * @brief Compares the terrain map with the expected surface in the
+		 * centres of the cells of the search area
+		 * @param ExpectedSurface (*)(double,double) Expected surface
+		 * @param double Distance to the edges of the interior cells
+		 * @param bool Indicates if the costs are checked, i.e. zero in the
+		 * interior cells and higher in the edges
+		 */
+		void checkMap(ExpectedSurface (*surface)(double, double),
+					  double interior, bool check_cost)
+		{
+			const dwl::SearchArea& area = config_.search_areas[0];
+			unsigned int num_interior = 0, num_found = 0, num_edge = 0;
+			double interior_cost = 0., edge_cost = 0.;
+			double first_x = (floor(area.min_x / grid_resolution) + 0.5) * grid_resolution;
+			double first_y = (floor(area.min_y / grid_resolution) + 0.5) * grid_resolution;
+			for (double y = first_y; y < area.max_y; y += grid_resolution) {
+				for (double x = first_x; x < area.max_x; x += grid_resolution) {
+					ExpectedSurface expected = surface(x, y);
+					dwl::TerrainCell cell;
+					bool is_cell = terrain_map_.getTerrainData(cell, Eigen::Vector2d(x, y));
+
+					// There isn't surface far from the defined regions
+					if (!expected.defined) {
+						if (expected.edge_distance < -1.5 * grid_resolution) {
+							EXPECT_FALSE(is_cell) << "Unexpected cell at (" << x << ", " << y << ")";
+						}
+						continue;
+					}
+
+					if (expected.edge_distance > interior) {
+						num_interior++;
+						if (!is_cell)
+							continue;
+
+						num_found++;
+						EXPECT_NEAR(expected.height, cell.height, height_tolerance)
+								<< "Height of the cell at (" << x << ", " << y << ")";
+						EXPECT_GE(fabs(cell.normal(2)), min_normal_z)
+								<< "Normal of the cell at (" << x << ", " << y << ")";
+						if (check_cost) {
+							EXPECT_NEAR(0., cell.cost, flat_cost_tolerance)
+									<< "Cost of the cell at (" << x << ", " << y << ")";
+						}
+						interior_cost += cell.cost;
+					} else if (expected.edge_distance < grid_resolution && is_cell) {
+						num_edge++;
+						edge_cost += cell.cost;
+					}
+				}
+			}
+
+			ASSERT_GT(num_interior, 0u);
+			EXPECT_GE(num_found, min_coverage * num_interior);
+			if (check_cost && num_edge > 0 && num_found > 0) {
+				EXPECT_GT(edge_cost / num_edge, interior_cost / num_found + flat_cost_tolerance)
+						<< "The edges aren't detected";
+			}
+		}
+
+		/**
+		 * @brief Compares the region queries of the cost pyramid with a
+		 * brute-force scan of the cells of the map
+		 * @param const Eigen::Vector2d& Minimum corner of the box
+		 * @param const Eigen::Vector2d& Maximum corner of the box
+		 * @param const Eigen::Vector2d& Centre of the disc
+		 * @param double Radius of the disc
+		 */
+		void checkCostPyramid(const Eigen::Vector2d& min, const Eigen::Vector2d& max,
+							  const Eigen::Vector2d& centre, double radius)
+		{
+			const terrain_server::CostPyramid& pyramid = terrain_map_.getCostPyramid();
+			const dwl::TerrainDataMap& terrain_map = terrain_map_.getTerrainDataMap();
+			const dwl::environment::SpaceDiscretization& discretization =
+					terrain_map_.getSpaceDiscretization();
+			ASSERT_EQ(terrain_map.size(), pyramid.size());
+
+			// Getting the expected bounds of the box and the disc
+			unsigned short min_x, min_y, max_x, max_y;
+			ASSERT_TRUE(discretization.coordToKey(min_x, min(0), true));
+			ASSERT_TRUE(discretization.coordToKey(min_y, min(1), true));
+			ASSERT_TRUE(discretization.coordToKey(max_x, max(0), true));
+			ASSERT_TRUE(discretization.coordToKey(max_y, max(1), true));
+			double box_min_cost = std::numeric_limits<double>::max();
+			double box_max_cost = -std::numeric_limits<double>::max();
+			double min_height = std::numeric_limits<double>::max();
+			double max_height = -std::numeric_limits<double>::max();
+			double disc_min_cost = std::numeric_limits<double>::max();
+			for (dwl::TerrainDataMap::const_iterator cell_it = terrain_map.begin();
+					cell_it != terrain_map.end(); cell_it++) {
+				const dwl::TerrainCell& cell = cell_it->second;
+				if (cell.key.x >= min_x && cell.key.x <= max_x &&
+						cell.key.y >= min_y && cell.key.y <= max_y) {
+					box_min_cost = std::min(box_min_cost, cell.cost);
+					box_max_cost = std::max(box_max_cost, cell.cost);
+					min_height = std::min(min_height, cell.height);
+					max_height = std::max(max_height, cell.height);
+				}
+
+				Eigen::Vector2d position;
+				discretization.keyToCoord(position(0), cell.key.x, true);
+				discretization.keyToCoord(position(1), cell.key.y, true);
+				if ((position - centre).norm() <= radius)
+					disc_min_cost = std::min(disc_min_cost, cell.cost);
+			}
+			ASSERT_LT(box_min_cost, box_max_cost);
+			ASSERT_LT(min_height, max_height);
+
+			double cost, height_min, height_max;
+			Eigen::Vector2d position;
+			ASSERT_TRUE(pyramid.getMinCost(cost, position, min, max));
+			EXPECT_NEAR(box_min_cost, cost, 1e-9);
+			EXPECT_NEAR(cost, terrain_map_.getTerrainCost(position), 1e-9);
+			ASSERT_TRUE(pyramid.getMaxCost(cost, min, max));
+			EXPECT_NEAR(box_max_cost, cost, 1e-9);
+			ASSERT_TRUE(pyramid.getHeightRange(height_min, height_max, min, max));
+			EXPECT_NEAR(min_height, height_min, 1e-9);
+			EXPECT_NEAR(max_height, height_max, 1e-9);
+			ASSERT_TRUE(pyramid.getMinCostInDisc(cost, position, centre, radius));
+			EXPECT_NEAR(disc_min_cost, cost, 1e-9);
+			EXPECT_LE((position - centre).norm(), radius);
+		}
+
+		/**
+		 * @brief Gets the median duration (in seconds) of the terrain map
+		 * computation
+		 * @param const SceneGenerator& Scene
+		 * @param unsigned int Number of frames
+		 */
+		double getMedianLatency(const SceneGenerator& scene, unsigned int num_frames)
+		{
+			octree_.clear();
+			scene.getOcTree(octree_);
+			terrain_map_.setResolution(octree_.getResolution(), false);
+
+			std::vector<double> latencies;
+			for (unsigned int i = 0; i < num_frames; i++) {
+				double start_time = getMonotonicTime();
+				terrain_map_.compute(&octree_, robot_state_);
+				latencies.push_back(getMonotonicTime() - start_time);
+			}
+			std::sort(latencies.begin(), latencies.end());
+
+			return latencies[latencies.size() / 2];
+		}
+
+		TerrainMappingConfig config_;
+		TerrainMapping terrain_map_;
+		octomap::OcTree octree_;
+		Eigen::Vector4d robot_state_;
+};
+
+
+/**
+ * @brief Gets the median duration (in seconds) of a calibration loop, i.e.
+ * random searches in an octree, which is the dominant operation of the
+ * terrain mapping. It makes the latency budget independent of the machine
+ */
+static double getCalibrationLatency()
+{
+	std::mt19937 generator(0);
+	std::uniform_real_distribution<double> distribution(-1., 1.);
+	octomap::OcTree octree(octree_resolution);
+	for (unsigned int i = 0; i < 20000; i++) {
+		octree.updateNode(octomap::point3d(distribution(generator), distribution(generator),
+										   0.2 * distribution(generator)), true, true);
+	}
+	octree.updateInnerOccupancy();
+
+	std::vector<double> latencies;
+	unsigned int num_occupied = 0;
+	for (unsigned int n = 0; n < 7; n++) {
+		double start_time = getMonotonicTime();
+		for (unsigned int i = 0; i < 100000; i++) {
+			octomap::OcTreeNode* node =
+					octree.search(distribution(generator), distribution(generator),
+								  0.2 * distribution(generator));
+			if (node && octree.isNodeOccupied(node))
+				num_occupied++;
+		}
+		latencies.push_back(getMonotonicTime() - start_time);
+	}
+	std::sort(latencies.begin(), latencies.end());
+	EXPECT_GT(num_occupied, 0u);
+
+	return latencies[latencies.size() / 2];
+}
+
+
+TEST_F(TerrainMappingTest, Stairs)
+{
+	SceneGenerator scene;
+	Rectangle ground;
+	ground.center_x = 0.;
+	ground.length = 1.1;
+	ground.width = 0.8;
+	ground.resolution = 0.01;
+	scene.addRectangle(ground);
+	scene.addStairs(0.55, 0., 0., 3, 0.14, 0.3, 0.8, 0.01);
+
+	Rectangle top;
+	top.center_x = 1.9;
+	top.length = 0.9;
+	top.width = 0.8;
+	top.resolution = 0.01;
+	top.height = 0.42;
+	scene.addRectangle(top);
+
+	computeMap(scene);
+	checkMap(stairsSurface, interior_distance, true);
+}
+
+
+TEST_F(TerrainMappingTest, Gap)
+{
+	SceneGenerator scene;
+	makeGapScene(scene);
+
+	computeMap(scene);
+	checkMap(gapSurface, interior_distance, true);
+}
+
+
+TEST_F(TerrainMappingTest, SteppingStones)
+{
+	SceneGenerator scene;
+	scene.addSteppingStones(1.0, 0., 0., 4, 3, 0.2, 0.35, 0.14, 0., 0.01);
+
+	computeMap(scene);
+	checkMap(steppingStonesSurface, plane_interior_distance, false);
+}
+
+
+TEST_F(TerrainMappingTest, PointCloudStairs)
+{
+	SceneGenerator scene;
+	Rectangle ground;
+	ground.center_x = 0.;
+	ground.length = 1.1;
+	ground.width = 0.8;
+	ground.resolution = 0.01;
+	scene.addRectangle(ground);
+	scene.addStairs(0.55, 0., 0., 3, 0.14, 0.3, 0.8, 0.01);
+
+	Rectangle top;
+	top.center_x = 1.9;
+	top.length = 0.9;
+	top.width = 0.8;
+	top.resolution = 0.01;
+	top.height = 0.42;
+	scene.addRectangle(top);
+
+	// Binning the points directly in the heightmap, i.e. without an octree
+	const std::vector<Eigen::Vector3d>& scene_points = scene.getPoints();
+	std::vector<Eigen::Vector3f> points(scene_points.size());
+	for (unsigned int i = 0; i < scene_points.size(); i++)
+		points[i] = scene_points[i].cast<float>();
+
+	terrain_map_.computeFromPointCloud(points, robot_state_.head(3),
+									   Eigen::Quaterniond::Identity());
+	checkMap(stairsSurface, interior_distance, true);
+
+	// The percentile of the heights gives the same surface
+	terrain_map_.reset();
+	terrain_map_.setHeightBinning(true, 0.5, 2);
+	terrain_map_.computeFromPointCloud(points, robot_state_.head(3),
+									   Eigen::Quaterniond::Identity());
+	checkMap(stairsSurface, interior_distance, true);
+}
+
+
+TEST_F(TerrainMappingTest, IntegratedOcTree)
+{
+	SceneGenerator scene;
+	Rectangle ground;
+	ground.center_x = 0.;
+	ground.length = 1.1;
+	ground.width = 0.8;
+	ground.resolution = 0.01;
+	scene.addRectangle(ground);
+	scene.addStairs(0.55, 0., 0., 3, 0.14, 0.3, 0.8, 0.01);
+
+	Rectangle top;
+	top.center_x = 1.9;
+	top.length = 0.9;
+	top.width = 0.8;
+	top.resolution = 0.01;
+	top.height = 0.42;
+	scene.addRectangle(top);
+
+	const std::vector<Eigen::Vector3d>& scene_points = scene.getPoints();
+	std::vector<Eigen::Vector3f> points(scene_points.size());
+	for (unsigned int i = 0; i < scene_points.size(); i++)
+		points[i] = scene_points[i].cast<float>();
+
+	terrain_map_.setOctreeIntegration(octree_resolution, -1.);
+	Eigen::Vector3d sensor_origin(1., 0., 1.5);
+	terrain_map_.integratePointCloud(points, sensor_origin, robot_state_.head(3),
+									 Eigen::Quaterniond::Identity());
+	checkMap(stairsSurface, interior_distance, true);
+	unsigned int num_cells = terrain_map_.getProfile().num_cells;
+	ASSERT_GT(num_cells, 0u);
+
+	// The same cloud doesn't change the octree, so the cells aren't recomputed
+	terrain_map_.integratePointCloud(points, sensor_origin, robot_state_.head(3),
+									 Eigen::Quaterniond::Identity());
+	EXPECT_LT(terrain_map_.getProfile().num_cells, num_cells / 10);
+	checkMap(stairsSurface, interior_distance, true);
+
+	// Turning around with a smaller interest region, i.e. the cells of the
+	// stairs far behind the robot are pruned from the map
+	terrain_map_.setInterestRegion(1., 2.5);
+	Eigen::Quaterniond turned(Eigen::AngleAxisd(M_PI, Eigen::Vector3d::UnitZ()));
+	terrain_map_.integratePointCloud(points, sensor_origin, robot_state_.head(3), turned);
+	dwl::TerrainCell cell;
+	EXPECT_FALSE(terrain_map_.getTerrainData(cell, Eigen::Vector2d(1.5, 0.)));
+
+	// Turning back, the voxels of the stairs don't change but their cells
+	// are recovered
+	terrain_map_.integratePointCloud(points, sensor_origin, robot_state_.head(3),
+									 Eigen::Quaterniond::Identity());
+	EXPECT_TRUE(terrain_map_.getTerrainData(cell, Eigen::Vector2d(1.5, 0.)));
+	checkMap(stairsSurface, interior_distance, true);
+}
+
+
+TEST_F(TerrainMappingTest, DepthImageStep)
+{
+	// Rendering the depth image of a camera that looks down from 1.2 m over
+	// the step, i.e. the pixels of the positive columns see the step
+	CameraIntrinsics intrinsics;
+	intrinsics.fx = 300.;
+	intrinsics.fy = 300.;
+	intrinsics.cx = 320.;
+	intrinsics.cy = 240.;
+	std::vector<uint16_t> depths(640 * 480);
+	for (unsigned int v = 0; v < 480; v++) {
+		for (unsigned int u = 0; u < 640; u++)
+			depths[v * 640 + u] = u >= intrinsics.cx ? 1060 : 1200;
+	}
+
+	DepthImage image;
+	image.data = (const uint8_t*) depths.data();
+	image.width = 640;
+	image.height = 480;
+	image.step = 640 * sizeof(uint16_t);
+	image.encoding = DepthImage::UINT16;
+
+	Eigen::Affine3d camera_pose = Eigen::Affine3d::Identity();
+	camera_pose.linear() << 1., 0., 0., 0., -1., 0., 0., 0., -1.;
+	camera_pose.translation() << 1., 0., 1.2;
+
+	terrain_map_.computeFromDepthImage(image, intrinsics, camera_pose,
+									   robot_state_.head(3),
+									   Eigen::Quaterniond::Identity());
+	checkMap(stepSurface, interior_distance, true);
+}
+
+
+TEST_F(TerrainMappingTest, SensorFrustum)
+{
+	SceneGenerator ground_scene;
+	Rectangle ground;
+	ground.center_x = 1.;
+	ground.length = 2.2;
+	ground.width = 0.8;
+	ground.resolution = 0.01;
+	ground_scene.addRectangle(ground);
+	computeMap(ground_scene);
+	unsigned int num_columns = terrain_map_.getProfile().num_columns;
+
+	// A camera that looks down from 1.2 m, i.e. it only sees the middle of
+	// the search area
+	CameraIntrinsics intrinsics;
+	intrinsics.fx = 300.;
+	intrinsics.fy = 300.;
+	intrinsics.cx = 80.;
+	intrinsics.cy = 80.;
+	Eigen::Affine3d camera_pose = Eigen::Affine3d::Identity();
+	camera_pose.linear() << 1., 0., 0., 0., -1., 0., 0., 0., -1.;
+	camera_pose.translation() << 1.5, 0., 1.2;
+	SensorFrustum frustum;
+	ASSERT_TRUE(frustum.set(intrinsics, 160, 160, camera_pose, 0.1, 5.));
+	EXPECT_TRUE(frustum.isColumnVisible(1.5, 0., -0.3, 0.7));
+	EXPECT_FALSE(frustum.isColumnVisible(0.5, 0., -0.3, 0.7));
+
+	// The ground is raised, but only the visible columns are updated
+	SceneGenerator raised_scene;
+	ground.height = 0.14;
+	raised_scene.addRectangle(ground);
+	terrain_map_.setSensorFrustum(frustum);
+	computeMap(raised_scene);
+	EXPECT_LT(terrain_map_.getProfile().num_columns, num_columns / 2);
+
+	dwl::TerrainCell cell;
+	ASSERT_TRUE(terrain_map_.getTerrainData(cell, Eigen::Vector2d(1.5, 0.)));
+	EXPECT_NEAR(0.14, cell.height, height_tolerance);
+	ASSERT_TRUE(terrain_map_.getTerrainData(cell, Eigen::Vector2d(0.5, 0.)));
+	EXPECT_NEAR(0., cell.height, height_tolerance);
+
+	// Without the frustum, all the columns are updated
+	terrain_map_.clearSensorFrustum();
+	computeMap(raised_scene);
+	ASSERT_TRUE(terrain_map_.getTerrainData(cell, Eigen::Vector2d(0.5, 0.)));
+	EXPECT_NEAR(0.14, cell.height, height_tolerance);
+}
+
+
+TEST(UpdateSchedulerTest, DefaultThresholds)
+{
+	// Every frame updates the map without thresholds
+	UpdateScheduler scheduler;
+	Eigen::Vector4d robot_state = Eigen::Vector4d::Zero();
+	for (unsigned int i = 0; i < 3; i++)
+		EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.1 * i));
+}
+
+
+TEST(UpdateSchedulerTest, Translation)
+{
+	UpdateScheduler scheduler;
+	scheduler.setThresholds(0.05, 0.1, 0.01, 0.);
+	Eigen::Vector4d robot_state = Eigen::Vector4d::Zero();
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.));
+
+	// The translation is measured from the last update
+	robot_state(0) = 0.03;
+	EXPECT_FALSE(scheduler.isUpdateRequired(robot_state, 100., 0.1));
+	robot_state(0) = 0.06;
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.2));
+	robot_state(0) = 0.09;
+	EXPECT_FALSE(scheduler.isUpdateRequired(robot_state, 100., 0.3));
+	robot_state(2) = 0.06;
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.4));
+}
+
+
+TEST(UpdateSchedulerTest, Yaw)
+{
+	UpdateScheduler scheduler;
+	scheduler.setThresholds(0.05, 0.1, 0.01, 0.);
+	Eigen::Vector4d robot_state(0., 0., 0., M_PI - 0.02);
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.));
+
+	// The yaw change is wrapped, i.e. crossing pi is a small change
+	robot_state(3) = -M_PI + 0.02;
+	EXPECT_FALSE(scheduler.isUpdateRequired(robot_state, 100., 0.1));
+	robot_state(3) = -M_PI + 0.1;
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.2));
+	robot_state(3) = -M_PI + 0.05;
+	EXPECT_FALSE(scheduler.isUpdateRequired(robot_state, 100., 0.3));
+}
+
+
+TEST(UpdateSchedulerTest, SignatureChange)
+{
+	UpdateScheduler scheduler;
+	scheduler.setThresholds(0.05, 0.1, 0.01, 0.);
+	Eigen::Vector4d robot_state = Eigen::Vector4d::Zero();
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.));
+
+	// The change is relative to the signature of the last update
+	EXPECT_FALSE(scheduler.isUpdateRequired(robot_state, 100.5, 0.1));
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 102., 0.2));
+	EXPECT_FALSE(scheduler.isUpdateRequired(robot_state, 101.5, 0.3));
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.4));
+}
+
+
+TEST(UpdateSchedulerTest, MaxPeriod)
+{
+	UpdateScheduler scheduler;
+	scheduler.setThresholds(0.05, 0.1, 0.01, 1.);
+	Eigen::Vector4d robot_state = Eigen::Vector4d::Zero();
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.));
+
+	// A still robot updates the map at the minimum rate
+	EXPECT_FALSE(scheduler.isUpdateRequired(robot_state, 100., 0.5));
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 1.));
+	EXPECT_FALSE(scheduler.isUpdateRequired(robot_state, 100., 1.5));
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 2.1));
+}
+
+
+TEST(UpdateSchedulerTest, Reset)
+{
+	UpdateScheduler scheduler;
+	scheduler.setThresholds(0.05, 0.1, 0.01, 0.);
+	Eigen::Vector4d robot_state = Eigen::Vector4d::Zero();
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.));
+	EXPECT_FALSE(scheduler.isUpdateRequired(robot_state, 100., 0.1));
+
+	// The reset forces only the next frame
+	scheduler.reset();
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.2));
+	EXPECT_FALSE(scheduler.isUpdateRequired(robot_state, 100., 0.3));
+
+	// The forced frame becomes the reference of the next decisions
+	scheduler.reset();
+	robot_state(0) = 0.03;
+	EXPECT_TRUE(scheduler.isUpdateRequired(robot_state, 100., 0.4));
+	robot_state(0) = 0.07;
+	EXPECT_FALSE(scheduler.isUpdateRequired(robot_state, 100., 0.5));
+}
+
+
+TEST_F(TerrainMappingTest, Corridor)
+{
+	SceneGenerator scene;
+	addGround(scene);
+
+	// The path turns to the left of the search area
+	std::vector<Eigen::Vector2d> path;
+	path.push_back(Eigen::Vector2d(0., 0.));
+	path.push_back(Eigen::Vector2d(0.5, 0.));
+	path.push_back(Eigen::Vector2d(0.5, 1.2));
+	dwl::TerrainCell cell;
+	computeMap(scene);
+	EXPECT_FALSE(terrain_map_.getTerrainData(cell, Eigen::Vector2d(0.5, 0.9)));
+
+	terrain_map_.setCorridor(path, 0.2, 2.);
+	computeMap(scene);
+	ASSERT_TRUE(terrain_map_.getTerrainData(cell, Eigen::Vector2d(0.5, 0.9)));
+	EXPECT_NEAR(0., cell.height, height_tolerance);
+	EXPECT_GE(fabs(cell.normal(2)), min_normal_z);
+
+	// The chunks of the corridor are computed first
+	const dwl::environment::SpaceDiscretization& discretization =
+			terrain_map_.getSpaceDiscretization();
+	std::vector<bool> is_corridor_chunk;
+	terrain_map_.setChunkHandler([&](uint32_t id) {
+		const std::vector<dwl::Vertex>& corridor = terrain_map_.getCorridor();
+		std::vector<dwl::TerrainCell> cells;
+		terrain_map_.getChunkCells(cells, id);
+		bool is_corridor = false;
+		for (unsigned int i = 0; i < cells.size() && !is_corridor; i++) {
+			dwl::Vertex vertex_id;
+			discretization.keyToVertex(vertex_id, cells[i].key, true);
+			is_corridor = std::find(corridor.begin(), corridor.end(), vertex_id) != corridor.end();
+		}
+		is_corridor_chunk.push_back(is_corridor);
+	}, 8);
+	terrain_map_.reset();
+	computeMap(scene);
+	terrain_map_.clearChunkHandler();
+	ASSERT_GT(is_corridor_chunk.size(), 1u);
+	EXPECT_TRUE(is_corridor_chunk.front());
+	EXPECT_FALSE(is_corridor_chunk.back());
+	EXPECT_TRUE(std::is_sorted(is_corridor_chunk.rbegin(), is_corridor_chunk.rend()));
+
+	// The cells beyond the horizon aren't computed
+	terrain_map_.reset();
+	terrain_map_.setCorridor(path, 0.2, 1.);
+	computeMap(scene);
+	EXPECT_TRUE(terrain_map_.getTerrainData(cell, Eigen::Vector2d(0.5, 0.4)));
+	EXPECT_FALSE(terrain_map_.getTerrainData(cell, Eigen::Vector2d(0.5, 0.9)));
+}
+
+
+TEST_F(TerrainMappingTest, StreamingChunks)
+{
+	SceneGenerator scene;
+	makeGapScene(scene);
+	computeMap(scene);
+	dwl::TerrainDataMap expected_map = terrain_map_.getTerrainDataMap();
+
+	// The chunks are handed over with their final costs, and they are
+	// assembled as a subscriber of the chunks does
+	std::vector<uint32_t> chunk_ids;
+	std::map<std::pair<unsigned short, unsigned short>, double> chunk_costs;
+	std::map<uint32_t, std::vector<dwl::TerrainCell> > client_chunks;
+	terrain_map_.setChunkHandler([&](uint32_t id) {
+		std::vector<dwl::TerrainCell>& cells = client_chunks[id];
+		terrain_map_.getChunkCells(cells, id);
+		chunk_ids.push_back(id);
+		for (unsigned int i = 0; i < cells.size(); i++)
+			chunk_costs[std::make_pair(cells[i].key.x, cells[i].key.y)] = cells[i].cost;
+	}, 8);
+	terrain_map_.reset();
+	computeMap(scene);
+	ASSERT_GT(chunk_ids.size(), 1u);
+
+	// Every chunk is handed over once, and they cover the map
+	std::vector<uint32_t> map_ids;
+	terrain_map_.getChunkIds(map_ids);
+	std::sort(chunk_ids.begin(), chunk_ids.end());
+	EXPECT_TRUE(std::adjacent_find(chunk_ids.begin(), chunk_ids.end()) == chunk_ids.end());
+	EXPECT_TRUE(chunk_ids == map_ids);
+
+	const dwl::TerrainDataMap& terrain_map = terrain_map_.getTerrainDataMap();
+	ASSERT_EQ(expected_map.size(), terrain_map.size());
+	ASSERT_EQ(terrain_map.size(), chunk_costs.size());
+	for (dwl::TerrainDataMap::const_iterator cell_it = expected_map.begin();
+			cell_it != expected_map.end(); cell_it++) {
+		std::map<std::pair<unsigned short, unsigned short>, double>::const_iterator it =
+				chunk_costs.find(std::make_pair(cell_it->second.key.x, cell_it->second.key.y));
+		ASSERT_TRUE(it != chunk_costs.end());
+		EXPECT_NEAR(cell_it->second.cost, it->second, 1e-9);
+	}
+
+	// Moving the robot forward with a smaller interest region, i.e. the
+	// cells behind the robot are removed without being recomputed. The
+	// chunks that lost cells are handed over again, and the chunks that
+	// aren't in the map are dropped at the end of the frames
+	terrain_map_.setInterestRegion(0.6, 10.);
+	robot_state_(0) = 1.;
+	computeMap(scene);
+	dwl::TerrainCell removed_cell;
+	EXPECT_FALSE(terrain_map_.getTerrainData(removed_cell, Eigen::Vector2d(0.15, 0.)));
+
+	terrain_map_.getChunkIds(map_ids);
+	std::map<uint32_t, std::vector<dwl::TerrainCell> >::iterator chunk_it =
+			client_chunks.begin();
+	while (chunk_it != client_chunks.end()) {
+		if (!std::binary_search(map_ids.begin(), map_ids.end(), chunk_it->first))
+			client_chunks.erase(chunk_it++);
+		else
+			++chunk_it;
+	}
+
+	// The map assembled from the chunks is the map of the server
+	std::map<std::pair<unsigned short, unsigned short>, dwl::TerrainCell> client_map;
+	for (chunk_it = client_chunks.begin(); chunk_it != client_chunks.end(); chunk_it++) {
+		for (unsigned int i = 0; i < chunk_it->second.size(); i++) {
+			const dwl::TerrainCell& cell = chunk_it->second[i];
+			client_map[std::make_pair(cell.key.x, cell.key.y)] = cell;
+		}
+	}
+	const dwl::TerrainDataMap& server_map = terrain_map_.getTerrainDataMap();
+	ASSERT_EQ(server_map.size(), client_map.size());
+	for (dwl::TerrainDataMap::const_iterator cell_it = server_map.begin();
+			cell_it != server_map.end(); cell_it++) {
+		std::map<std::pair<unsigned short, unsigned short>, dwl::TerrainCell>::const_iterator it =
+				client_map.find(std::make_pair(cell_it->second.key.x, cell_it->second.key.y));
+		ASSERT_TRUE(it != client_map.end());
+		EXPECT_EQ(cell_it->second.key.z, it->second.key.z);
+		EXPECT_NEAR(cell_it->second.cost, it->second.cost, 1e-9);
+	}
+}
+
+
+TEST_F(TerrainMappingTest, CostPyramid)
+{
+	SceneGenerator scene;
+	makeGapScene(scene);
+	terrain_map_.setCostPyramid(true);
+	computeMap(scene);
+
+	// Getting a box and a disc across the gap
+	Eigen::Vector2d min(0.4, -0.3), max(1.1, 0.25);
+	Eigen::Vector2d centre(0.72, 0.03);
+	double radius = 0.15;
+	checkCostPyramid(min, max, centre, radius);
+
+	// Raising the platforms and moving the robot forward with a smaller
+	// interest region, i.e. the cells of the platforms are replaced and the
+	// cells behind the robot are removed
+	SceneGenerator raised_scene;
+	addGround(raised_scene);
+	raised_scene.addGap(0.725, 0., 0., 0.25, 1.2, 0.8, 0.2, 0.01);
+	terrain_map_.setInterestRegion(0.6, 10.);
+	robot_state_(0) = 0.8;
+	computeMap(raised_scene);
+	dwl::TerrainCell removed_cell;
+	EXPECT_FALSE(terrain_map_.getTerrainData(removed_cell, Eigen::Vector2d(0.15, 0.)));
+	checkCostPyramid(min, max, centre, radius);
+
+	// There isn't any cell outside the map
+	const terrain_server::CostPyramid& pyramid = terrain_map_.getCostPyramid();
+	double cost;
+	Eigen::Vector2d position;
+	EXPECT_FALSE(pyramid.getMinCostInDisc(cost, position, Eigen::Vector2d(10., 10.), 0.1));
+
+	terrain_map_.reset();
+	EXPECT_EQ(0u, pyramid.size());
+}
+
+
+TEST_F(TerrainMappingTest, FootholdCandidates)
+{
+	SceneGenerator scene;
+	makeGapScene(scene);
+	computeMap(scene);
+
+	// The edges of the gap are above the mean cost
+	const dwl::TerrainDataMap& terrain_map = terrain_map_.getTerrainDataMap();
+	double mean_cost = 0.;
+	for (dwl::TerrainDataMap::const_iterator cell_it = terrain_map.begin();
+			cell_it != terrain_map.end(); cell_it++)
+		mean_cost += cell_it->second.cost / terrain_map.size();
+
+	double clearance = 0.04, suppression_radius = 0.1;
+	terrain_server::FootholdExtractor extractor;
+	extractor.addRegion(0.3, 1.2, -0.3, 0.3);
+	extractor.setThresholds(mean_cost, min_normal_z, clearance);
+	extractor.setSuppression(suppression_radius, 16);
+	std::vector<terrain_server::Foothold> candidates;
+	extractor.compute(candidates, terrain_map, terrain_map_.getSpaceDiscretization(),
+					  robot_state_);
+	ASSERT_FALSE(candidates.empty());
+	EXPECT_LE(candidates.size(), 16u);
+
+	double resolution = terrain_map_.getResolution(true);
+	for (unsigned int i = 0; i < candidates.size(); i++) {
+		const terrain_server::Foothold& candidate = candidates[i];
+		EXPECT_GE(candidate.position(0), 0.3 - resolution);
+		EXPECT_LE(candidate.position(0), 1.2 + resolution);
+		EXPECT_LE(candidate.cost, mean_cost);
+		if (i > 0) {
+			EXPECT_GE(candidate.cost, candidates[i - 1].cost);
+		}
+
+		// The cells within the clearance are acceptable
+		for (double dx = -clearance; dx <= clearance + 1e-6; dx += resolution) {
+			for (double dy = -clearance; dy <= clearance + 1e-6; dy += resolution) {
+				dwl::TerrainCell cell;
+				Eigen::Vector2d position = candidate.position.head<2>() + Eigen::Vector2d(dx, dy);
+				ASSERT_TRUE(terrain_map_.getTerrainData(cell, position));
+				EXPECT_LE(cell.cost, mean_cost);
+				EXPECT_GE(fabs(cell.normal(2)), min_normal_z);
+			}
+		}
+
+		// The candidates are apart from each other
+		for (unsigned int j = 0; j < i; j++) {
+			EXPECT_GT((candidate.position - candidates[j].position).head<2>().norm(),
+					  suppression_radius);
+		}
+	}
+}
+
+
+TEST_F(TerrainMappingTest, FeatureWeights)
+{
+	SceneGenerator scene;
+	makeGapScene(scene);
+	computeMap(scene);
+
+	// Re-summing the cost layers with new weights
+	ASSERT_TRUE(terrain_map_.setFeatureWeight("Slope", 0.5));
+	ASSERT_TRUE(terrain_map_.setFeatureWeight("Height Deviation", 3.));
+	EXPECT_FALSE(terrain_map_.setFeatureWeight("Unknown", 1.));
+	terrain_map_.applyFeatureWeights();
+
+	// Computing the same map with these weights
+	TerrainMapping weighted_map;
+	TerrainMappingConfig config = config_;
+	config.slope_weight = 0.5;
+	config.height_deviation_weight = 3.;
+	config.apply(weighted_map);
+	weighted_map.setResolution(octree_.getResolution(), false);
+	weighted_map.compute(&octree_, robot_state_);
+
+	const dwl::TerrainDataMap& expected_map = weighted_map.getTerrainDataMap();
+	const dwl::TerrainDataMap& terrain_map = terrain_map_.getTerrainDataMap();
+	ASSERT_EQ(expected_map.size(), terrain_map.size());
+	ASSERT_EQ(terrain_map.size(), terrain_map_.getCostLayers().size());
+	bool has_cost = false;
+	for (dwl::TerrainDataMap::const_iterator cell_it = expected_map.begin();
+			cell_it != expected_map.end(); cell_it++) {
+		dwl::TerrainDataMap::const_iterator it = terrain_map.find(cell_it->first);
+		ASSERT_TRUE(it != terrain_map.end());
+		EXPECT_NEAR(cell_it->second.cost, it->second.cost, 1e-9);
+		has_cost |= it->second.cost > 0.;
+	}
+	EXPECT_TRUE(has_cost);
+}
+
+
+TEST_F(TerrainMappingTest, FusedFeatures)
+{
+	SceneGenerator scene;
+	makeGapScene(scene);
+	octree_.clear();
+	scene.getOcTree(octree_);
+
+	// The fused combinations, i.e. [Height Deviation], [Slope, Height
+	// Deviation] and [Slope, Height Deviation, Curvature]
+	bool is_slope[3] = {false, true, true};
+	bool is_curvature[3] = {false, false, true};
+	for (unsigned int n = 0; n < 3; n++) {
+		TerrainMappingConfig config = config_;
+		config.enable_slope = is_slope[n];
+		config.enable_height_deviation = true;
+		config.enable_curvature = is_curvature[n];
+
+		// Computing the same scene with the fused and the virtual pipelines
+		TerrainMapping fused_map, virtual_map;
+		config.fused_features = true;
+		config.apply(fused_map);
+		config.fused_features = false;
+		config.apply(virtual_map);
+		fused_map.setResolution(octree_.getResolution(), false);
+		virtual_map.setResolution(octree_.getResolution(), false);
+		fused_map.compute(&octree_, robot_state_);
+		virtual_map.compute(&octree_, robot_state_);
+		ASSERT_TRUE(fused_map.isFusedFeatures()) << "Combination " << n;
+		ASSERT_FALSE(virtual_map.isFusedFeatures()) << "Combination " << n;
+
+		// The costs, normals and cost layers of every cell are the same
+		const dwl::TerrainDataMap& expected_map = virtual_map.getTerrainDataMap();
+		const dwl::TerrainDataMap& terrain_map = fused_map.getTerrainDataMap();
+		ASSERT_GT(expected_map.size(), 0u);
+		ASSERT_EQ(expected_map.size(), terrain_map.size());
+		ASSERT_EQ(virtual_map.getNumFeatures(), fused_map.getCostLayers().getNumLayers());
+		std::vector<double> expected_costs, costs;
+		for (dwl::TerrainDataMap::const_iterator cell_it = expected_map.begin();
+				cell_it != expected_map.end(); cell_it++) {
+			dwl::TerrainDataMap::const_iterator it = terrain_map.find(cell_it->first);
+			ASSERT_TRUE(it != terrain_map.end());
+			EXPECT_NEAR(cell_it->second.cost, it->second.cost, 1e-9);
+			EXPECT_NEAR(0., (cell_it->second.normal - it->second.normal).norm(), 1e-9);
+
+			ASSERT_TRUE(virtual_map.getCostLayers().getCosts(expected_costs, cell_it->first));
+			ASSERT_TRUE(fused_map.getCostLayers().getCosts(costs, it->first));
+			ASSERT_EQ(expected_costs.size(), costs.size());
+			for (unsigned int k = 0; k < costs.size(); k++)
+				EXPECT_NEAR(expected_costs[k], costs[k], 1e-9) << "Layer " << k;
+		}
+	}
+}
+
+
+TEST_F(TerrainMappingTest, Snapshot)
+{
+	SceneGenerator scene;
+	scene.addSteppingStones(1.0, 0., 0., 4, 3, 0.2, 0.35, 0.14, 0., 0.01);
+	computeMap(scene);
+
+	// Getting a unique file for the snapshot, the writer replaces it
+	char filename_template[] = "/tmp/terrain_mapping_test_snapshot_XXXXXX";
+	int fd = mkstemp(filename_template);
+	ASSERT_NE(-1, fd);
+	close(fd);
+	std::string filename = filename_template;
+	int num_cells = TerrainMapSnapshot::write(filename, terrain_map_, "world", 0.);
+	ASSERT_GT(num_cells, 0);
+
+	// Loading the snapshot in a terrain map with different weights, i.e. the
+	// cost layers are re-summed
+	TerrainMapping loaded_map;
+	TerrainMappingConfig config = config_;
+	config.height_deviation_weight = 2.;
+	config.apply(loaded_map);
+
+	TerrainMapSnapshot snapshot;
+	ASSERT_TRUE(snapshot.open(filename));
+	EXPECT_EQ((uint64_t) num_cells, snapshot.getHeader().num_cells);
+	EXPECT_EQ(2u, snapshot.getHeader().num_layers);
+	ASSERT_TRUE(loaded_map.loadSnapshot(snapshot));
+	SnapshotHeader header = snapshot.getHeader();
+	snapshot.close();
+
+	// Rejecting a header whose number of cells wraps the sizes of the cells
+	// and the costs to the ones of the file
+	std::fstream header_file(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	SnapshotHeader wrapped_header = header;
+	wrapped_header.num_cells += (uint64_t) 1 << 61;
+	header_file.write((const char*) &wrapped_header, sizeof(SnapshotHeader));
+	header_file.close();
+	EXPECT_FALSE(snapshot.open(filename));
+
+	// Rejecting a file that isn't a snapshot
+	std::ofstream file(filename.c_str());
+	file << "not a snapshot";
+	file.close();
+	EXPECT_FALSE(snapshot.open(filename));
+	unlink(filename.c_str());
+
+	const dwl::TerrainDataMap& terrain_map = terrain_map_.getTerrainDataMap();
+	const dwl::TerrainDataMap& loaded = loaded_map.getTerrainDataMap();
+	ASSERT_EQ(terrain_map.size(), loaded.size());
+	std::vector<double> costs;
+	for (dwl::TerrainDataMap::const_iterator cell_it = terrain_map.begin();
+			cell_it != terrain_map.end(); cell_it++) {
+		dwl::TerrainDataMap::const_iterator it = loaded.find(cell_it->first);
+		ASSERT_TRUE(it != loaded.end());
+		EXPECT_EQ(cell_it->second.key.z, it->second.key.z);
+		EXPECT_DOUBLE_EQ(cell_it->second.height, it->second.height);
+		EXPECT_TRUE(cell_it->second.normal.isApprox(it->second.normal));
+
+		ASSERT_TRUE(terrain_map_.getCostLayers().getCosts(costs, cell_it->first));
+		EXPECT_NEAR(costs[0] + 2. * costs[1], it->second.cost, 1e-9);
+	}
+}
+
+
+TEST_F(TerrainMappingTest, Tiles)
+{
+	SceneGenerator scene;
+	scene.addSteppingStones(1.0, 0., 0., 4, 3, 0.2, 0.35, 0.14, 0., 0.01);
+	scene.getOcTree(octree_);
+
+	TerrainMapping tiled_map;
+	TerrainMappingConfig config = config_;
+	config.interest_radius_x = 2.;
+	config.interest_radius_y = 2.;
+	config.enable_tiles = true;
+	config.tile_size = 16;
+	config.max_tiles = 64;
+	config.tile_filename = "/tmp/terrain_mapping_test_tiles.bin";
+	config.apply(tiled_map);
+	tiled_map.setResolution(octree_.getResolution(), false);
+	tiled_map.compute(&octree_, robot_state_);
+	dwl::TerrainDataMap terrain_map = tiled_map.getTerrainDataMap();
+	ASSERT_FALSE(terrain_map.empty());
+
+	// Evicting the tiles by moving away from the scene
+	octomap::OcTree empty_octree(octree_resolution);
+	Eigen::Vector4d far_state(20., 0., 0.5, 0.);
+	tiled_map.compute(&empty_octree, far_state);
+	EXPECT_TRUE(tiled_map.getTerrainDataMap().empty());
+	EXPECT_GT(tiled_map.getProfile().num_evicted_tiles, 0u);
+
+	// Paging in the tiles by coming back, they are merged in a later frame
+	tiled_map.compute(&octree_, robot_state_);
+	for (int i = 0; i < 100 && tiled_map.getProfile().num_loaded_tiles == 0; i++) {
+		usleep(10000);
+		tiled_map.compute(&octree_, robot_state_);
+	}
+	EXPECT_GT(tiled_map.getProfile().num_loaded_tiles, 0u);
+
+	const dwl::TerrainDataMap& loaded = tiled_map.getTerrainDataMap();
+	ASSERT_EQ(terrain_map.size(), loaded.size());
+	for (dwl::TerrainDataMap::const_iterator cell_it = terrain_map.begin();
+			cell_it != terrain_map.end(); cell_it++) {
+		dwl::TerrainDataMap::const_iterator it = loaded.find(cell_it->first);
+		ASSERT_TRUE(it != loaded.end());
+		EXPECT_EQ(cell_it->second.key.z, it->second.key.z);
+	}
+	remove(config.tile_filename.c_str());
+}
+
+
+TEST_F(TerrainMappingTest, LatencyBudget)
+{
+	// The budget is the ratio between the median latency of a frame and the
+	// calibration loop, and it can be overwritten for slow machines. A frame
+	// of this scene searches the octree about as many times as the loop
+	// (the columns and the neighbors of the plane fits), i.e. the ratio is
+	// about 1.5-2 and the budget leaves a margin of 2-3 times it
+	double budget = 5.;
+	const char* budget_env = getenv("TERRAIN_SERVER_LATENCY_BUDGET");
+	if (budget_env)
+		budget = atof(budget_env);
+
+	SceneGenerator scene;
+	Rectangle ground;
+	ground.center_x = 0.;
+	ground.length = 1.1;
+	ground.width = 0.8;
+	ground.resolution = 0.01;
+	scene.addRectangle(ground);
+	scene.addStairs(0.55, 0., 0., 3, 0.14, 0.3, 0.8, 0.01);
+	scene.addSteppingStones(1.6, 0., 0., 2, 3, 0.2, 0.35, 0.42, 0.03, 0.01, 1);
+
+	double calibration = getCalibrationLatency();
+	double latency = getMedianLatency(scene, 9);
+	EXPECT_LE(latency / calibration, budget) << "Median latency: " << latency
+			<< " s, calibration: " << calibration << " s";
+}
+
+} //@namespace terrain_server
+
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}